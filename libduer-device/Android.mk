@@ -16,6 +16,8 @@
 
 DUER_DEBUG_LEVEL ?= 3
 DUER_MEMORY_DEBUG ?= false
+DUER_MEMORY_POOL ?= false
+DUER_MEMORY_PROFILE ?= false
 DUER_NSDL_DEBUG ?= false
 DUER_MBEDTLS_DEBUG ?= 0
 
@@ -53,6 +55,16 @@ endif
 
 COM_DEFS += MBED_CONF_MBED_CLIENT_SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE=1024
 
+# serve the small allocations from the size-class pool, see lightduer_memory.c
+ifeq ($(strip $(DUER_MEMORY_POOL)),true)
+COM_DEFS += DUER_MEMORY_POOL
+endif
+
+# record the live bytes by the call sites of DUER_MALLOC, see DUER_MEMPROF_DUMP
+ifeq ($(strip $(DUER_MEMORY_PROFILE)),true)
+COM_DEFS += DUER_MEMORY_PROFILE DUER_MEMORY_USAGE
+endif
+
 ifneq ($(strip $(COM_DEFS)),)
 COM_DEFS := $(foreach d,$(COM_DEFS),-D$(d))
 endif
@@ -0,0 +1,474 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_aes.c
+ * Desc: The throughput of the AES-CBC encrypted transport over a loopback
+ *       socket, the CoAP messages:
+ *         send, sent by duer_coap_send, the server decrypts and checks them,
+ *         recv, encrypted by the server and written at once, the client reads
+ *               them as the engine does: duer_coap_data_available until it
+ *               would block.
+ *       Report the MB/s of the payload, the client thread CPU time and heap
+ *       per message. The payload is at most 1024 bytes, not sent blockwise.
+ *
+ *   bench-aes [-count 20000] [-size 1000]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+#include "mbedtls/aes.h"
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_coap.h"
+
+#define BENCH_COAP_TCP_HDR      (0xbeefdead)
+#define BENCH_BDCAEC_MN         (0xBDCAEC01)
+
+// the bindToken and the uuid of the AES-CBC transport
+#define BENCH_BIND_TOKEN        "8cd34facea95d5491b2cb5fbacacb0f0"
+#define BENCH_UUID              "bench00000001"
+
+typedef enum _bench_mode_enum {
+    BENCH_SEND,
+    BENCH_RECV,
+} bench_mode_e;
+
+typedef struct _bench_server_s {
+    int                 listener;
+    int                 fd;
+    bench_mode_e        mode;
+    long                count;
+    long                size;
+    long                frames;
+    long                bad;
+} bench_server_t;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static volatile int s_ready = 0;
+
+static long s_received = 0;
+static long s_bad = 0;
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+    if (event == DUER_TEVT_SEND_RDY) {
+        pthread_mutex_lock(&s_mutex);
+        s_ready = 1;
+        pthread_cond_broadcast(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+static double bench_cpu(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_payload_check(const unsigned char *payload, long size)
+{
+    long i;
+
+    for (i = 0; i < size; i++) {
+        if (payload[i] != (unsigned char)(i * 7)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static duer_status_t bench_result(duer_context ctx, duer_coap_handler hdlr,
+                                  const duer_msg_t *msg, const duer_addr_t *addr)
+{
+    long size = (long)ctx;
+
+    if (msg->payload_len != size || bench_payload_check(msg->payload, size) < 0) {
+        s_bad++;
+    }
+    s_received++;
+
+    return DUER_OK;
+}
+
+static void bench_aes_setup(mbedtls_aes_context *aes, int encrypt)
+{
+    const char *token = BENCH_BIND_TOKEN;
+    unsigned char key[16];
+    unsigned int value;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        sscanf(token + i * 2, "%2x", &value);
+        key[i] = (unsigned char)value;
+    }
+
+    mbedtls_aes_init(aes);
+    if (encrypt) {
+        mbedtls_aes_setkey_enc(aes, key, 128);
+    } else {
+        mbedtls_aes_setkey_dec(aes, key, 128);
+    }
+}
+
+static int bench_read(int fd, unsigned char *buf, size_t size)
+{
+    size_t got = 0;
+    ssize_t rs;
+
+    while (got < size) {
+        rs = read(fd, buf + got, size - got);
+        if (rs <= 0) {
+            return -1;
+        }
+        got += rs;
+    }
+
+    return 0;
+}
+
+static int bench_write(int fd, const unsigned char *buf, size_t size)
+{
+    size_t sent = 0;
+    ssize_t rs;
+
+    while (sent < size) {
+        rs = write(fd, buf + sent, size - sent);
+        if (rs <= 0) {
+            return -1;
+        }
+        sent += rs;
+    }
+
+    return 0;
+}
+
+/*
+ * Decrypt the frames sent by the client, the payload is at the end of the
+ * CoAP message
+ */
+static void bench_server_check(bench_server_t *server)
+{
+    static unsigned char body[64 * 1024];
+    unsigned char iv[16];
+    unsigned char hdr[9];
+    mbedtls_aes_context aes;
+    duer_u32_t size;
+    duer_u32_t length;
+    size_t offset;
+
+    bench_aes_setup(&aes, 0);
+
+    while (bench_read(server->fd, hdr, sizeof(hdr)) == 0) {
+        size = ntohl(*(duer_u32_t *)(hdr + 4));
+        offset = hdr[8];
+        if (ntohl(*(duer_u32_t *)hdr) != BENCH_BDCAEC_MN
+                || size > sizeof(body) || size < 1 + offset + 16
+                || bench_read(server->fd, body, size - 1) < 0) {
+            server->bad++;
+            break;
+        }
+
+        size -= 1 + offset;
+        memset(iv, 0, sizeof(iv));
+        if (size % 16 != 0 || mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, size, iv,
+                                                    body + offset, body + offset) != 0) {
+            server->bad++;
+            break;
+        }
+
+        length = ntohl(*(duer_u32_t *)(body + offset + 4));
+        if (ntohl(*(duer_u32_t *)(body + offset)) != BENCH_COAP_TCP_HDR
+                || length + 8 > size || length < server->size
+                || bench_payload_check(body + offset + 8 + length - server->size,
+                                       server->size) < 0) {
+            server->bad++;
+        }
+        server->frames++;
+    }
+
+    mbedtls_aes_free(&aes);
+}
+
+/*
+ * Encrypt the NON 2.05 responses with the payload, and push them at once
+ */
+static void bench_server_push(bench_server_t *server)
+{
+    size_t raw = strlen(BENCH_UUID);
+    size_t frame = 9 + raw + server->size + 8 + 5 + 16;
+    unsigned char *buf = malloc(frame * server->count);
+    unsigned char *p = buf;
+    unsigned char *inner;
+    unsigned char iv[16];
+    mbedtls_aes_context aes;
+    size_t length;
+    long i;
+    long j;
+
+    bench_aes_setup(&aes, 1);
+
+    for (i = 0; i < server->count; i++) {
+        inner = p + 9 + raw;
+        length = 5 + server->size;
+        *(duer_u32_t *)inner = htonl(BENCH_COAP_TCP_HDR);
+        *(duer_u32_t *)(inner + 4) = htonl(length);
+        inner[8] = 0x50;    // version 1, NON, no token
+        inner[9] = 0x45;    // 2.05 Content
+        inner[10] = (unsigned char)((i + 1) >> 8);
+        inner[11] = (unsigned char)(i + 1);
+        inner[12] = 0xff;
+        for (j = 0; j < server->size; j++) {
+            inner[13 + j] = (unsigned char)(j * 7);
+        }
+
+        length += 8;
+        while (length % 16 != 0) {
+            inner[length++] = 0;
+        }
+        memset(iv, 0, sizeof(iv));
+        mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, length, iv, inner, inner);
+
+        *(duer_u32_t *)p = htonl(BENCH_BDCAEC_MN);
+        *(duer_u32_t *)(p + 4) = htonl(1 + raw + length);
+        p[8] = (unsigned char)raw;
+        memcpy(p + 9, BENCH_UUID, raw);
+        p += 9 + raw + length;
+    }
+
+    bench_write(server->fd, buf, p - buf);
+
+    mbedtls_aes_free(&aes);
+    free(buf);
+}
+
+static void *bench_server(void *arg)
+{
+    bench_server_t *server = (bench_server_t *)arg;
+    int one = 1;
+
+    server->fd = accept(server->listener, NULL, NULL);
+    if (server->fd < 0) {
+        return NULL;
+    }
+    setsockopt(server->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (server->mode == BENCH_SEND) {
+        bench_server_check(server);
+        close(server->fd);
+    } else {
+        bench_server_push(server);
+    }
+
+    return NULL;
+}
+
+static int bench_listen(int *port)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, 4) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        exit(1);
+    }
+
+    *port = ntohs(addr_in.sin_port);
+    return fd;
+}
+
+static duer_status_t bench_connect(duer_coap_handler coap, int port)
+{
+    duer_addr_t addr;
+    duer_status_t rs;
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        s_ready = 0;
+        pthread_mutex_unlock(&s_mutex);
+
+        rs = duer_coap_connect(coap, &addr, BENCH_BIND_TOKEN, strlen(BENCH_BIND_TOKEN));
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+            return rs;
+        }
+
+        pthread_mutex_lock(&s_mutex);
+        while (!s_ready) {
+            pthread_cond_wait(&s_cond, &s_mutex);
+        }
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+static void bench_send(duer_coap_handler coap, long count, long size, long *failed)
+{
+    unsigned char *payload = malloc(size);
+    duer_u8_t token[4] = {1, 2, 3, 4};
+    duer_msg_t msg;
+    long i;
+
+    for (i = 0; i < size; i++) {
+        payload[i] = (unsigned char)(i * 7);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = DUER_MSG_TYPE_NON_CONFIRMABLE;
+    msg.msg_code = DUER_MSG_REQ_POST;
+    msg.token = token;
+    msg.token_len = sizeof(token);
+    msg.path = (duer_u8_t *)"duer_private";
+    msg.path_len = strlen((const char *)msg.path);
+    msg.payload = payload;
+    msg.payload_len = size;
+
+    for (i = 0; i < count; i++) {
+        msg.msg_id = (duer_u16_t)(i + 1);
+        if (duer_coap_send(coap, &msg) < 0) {
+            (*failed)++;
+        }
+    }
+
+    free(payload);
+}
+
+static void bench_recv(duer_coap_handler coap, long count)
+{
+    duer_status_t rs;
+    double start = bench_now();
+
+    // read as the engine does, until all received or nothing for 1s
+    while (s_received < count && bench_now() - start < 1) {
+        do {
+            rs = duer_coap_data_available(coap);
+            if (rs >= DUER_OK) {
+                start = bench_now();
+            }
+        } while (rs >= DUER_OK);
+        usleep(50);
+    }
+}
+
+static void bench_run(bench_mode_e mode, long count, long size)
+{
+    bench_server_t server;
+    pthread_t thread;
+    duer_coap_handler coap;
+    bench_heap_t heap;
+    double start;
+    double elapsed;
+    double cpu;
+    long failed = 0;
+    long done;
+    int port;
+
+    memset(&server, 0, sizeof(server));
+    server.listener = bench_listen(&port);
+    server.mode = mode;
+    server.count = count;
+    server.size = size;
+    pthread_create(&thread, NULL, bench_server, &server);
+
+    coap = duer_coap_acquire(bench_result, (duer_context)size, bench_transevt, BENCH_UUID);
+    if (!coap || bench_connect(coap, port) != DUER_OK) {
+        BENCH_PRINT("connect failed\n");
+        exit(1);
+    }
+
+    s_received = 0;
+    s_bad = 0;
+    bench_heap_reset();
+    cpu = bench_cpu();
+    start = bench_now();
+    if (mode == BENCH_SEND) {
+        bench_send(coap, count, size, &failed);
+    } else {
+        bench_recv(coap, count);
+    }
+    elapsed = bench_now() - start;
+    cpu = bench_cpu() - cpu;
+    bench_heap_get(&heap);
+
+    duer_coap_release(coap);
+    pthread_join(thread, NULL);
+    if (mode == BENCH_RECV) {
+        close(server.fd);
+    }
+    close(server.listener);
+
+    done = mode == BENCH_SEND ? server.frames : s_received;
+    BENCH_PRINT("%-4s %5ld x %4ld bytes: done %5ld, bad %ld, failed %ld, %6.1f MB/s, "
+                "client cpu %5.2f us, heap %4.2f mallocs %6.1f bytes per message\n",
+                mode == BENCH_SEND ? "send" : "recv", count, size, done,
+                mode == BENCH_SEND ? server.bad : s_bad, failed,
+                (double)done * size / elapsed / 1e6, cpu * 1e6 / count,
+                (double)heap.mallocs / count, (double)heap.bytes / count);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 20000);
+    long size = bench_arg(argc, argv, "size", 1000);
+
+    bench_init(0);
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+    baidu_ca_transport_sendv_init(bcasoc_sendv);
+
+    if (size > 1024) {
+        size = 1024;
+    }
+
+    bench_run(BENCH_SEND, count, size);
+    bench_run(BENCH_RECV, count, size);
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_aes_cpb.c
+ * Desc: The cycles per byte of AES-128, by the TSC on x86 (the nanoseconds
+ *       on the others):
+ *         soft, the software block cipher in CBC, mbedtls_aes_encrypt/decrypt,
+ *         duer, duer_aes_cbc_encrypt/decrypt, the AES-CBC transport,
+ *         gcm,  mbedtls_gcm_crypt_and_tag, the AES-GCM TLS records.
+ *
+ *   bench-aes-cpb [-bytes 16384] [-rounds 2000]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+
+#include "bench_common.h"
+#include "lightduer_aes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BENCH_UNIT "cycles"
+#else
+#define BENCH_UNIT "ns"
+#endif
+
+typedef enum _bench_op_enum {
+    BENCH_SOFT_ENC,
+    BENCH_SOFT_DEC,
+    BENCH_DUER_ENC,
+    BENCH_DUER_DEC,
+    BENCH_GCM_ENC,
+    BENCH_OPS,
+} bench_op_e;
+
+static const char *s_op_names[BENCH_OPS] = {
+    "soft cbc encrypt",
+    "soft cbc decrypt",
+    "duer cbc encrypt",
+    "duer cbc decrypt",
+    "gcm encrypt",
+};
+
+static const unsigned char s_key[16] = {
+    0x8c, 0xd3, 0x4f, 0xac, 0xea, 0x95, 0xd5, 0x49,
+    0x1b, 0x2c, 0xb5, 0xfb, 0xac, 0xac, 0xb0, 0xf0,
+};
+
+static unsigned long long bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/*
+ * The CBC by the software block cipher, as the existing implementation
+ */
+static void bench_soft_cbc(mbedtls_aes_context *aes, int mode, size_t length,
+                           const unsigned char *input, unsigned char *output)
+{
+    unsigned char iv[16];
+    unsigned char tmp[16];
+    size_t i;
+    int j;
+
+    memset(iv, 0, sizeof(iv));
+    for (i = 0; i < length; i += 16) {
+        if (mode == MBEDTLS_AES_ENCRYPT) {
+            for (j = 0; j < 16; j++) {
+                tmp[j] = input[i + j] ^ iv[j];
+            }
+            mbedtls_aes_encrypt(aes, tmp, output + i);
+            memcpy(iv, output + i, 16);
+        } else {
+            memcpy(tmp, input + i, 16);
+            mbedtls_aes_decrypt(aes, input + i, output + i);
+            for (j = 0; j < 16; j++) {
+                output[i + j] ^= iv[j];
+            }
+            memcpy(iv, tmp, 16);
+        }
+    }
+}
+
+static void bench_run(bench_op_e op, size_t bytes, long rounds)
+{
+    unsigned char *input = malloc(bytes);
+    unsigned char *output = malloc(bytes);
+    unsigned char iv[16];
+    unsigned char tag[16];
+    mbedtls_aes_context enc;
+    mbedtls_aes_context dec;
+    duer_aes_context duer = duer_aes_context_init();
+#if defined(MBEDTLS_GCM_C)
+    mbedtls_gcm_context gcm;
+#endif
+    unsigned long long start;
+    unsigned long long best = (unsigned long long)-1;
+    unsigned long long ticks;
+    size_t i;
+    long r;
+
+    for (i = 0; i < bytes; i++) {
+        input[i] = (unsigned char)(i * 7);
+    }
+    memset(iv, 0, sizeof(iv));
+
+    mbedtls_aes_init(&enc);
+    mbedtls_aes_init(&dec);
+    mbedtls_aes_setkey_enc(&enc, s_key, 128);
+    mbedtls_aes_setkey_dec(&dec, s_key, 128);
+    duer_aes_setkey(duer, (unsigned char *)s_key, 128);
+    duer_aes_setiv(duer, iv);
+#if defined(MBEDTLS_GCM_C)
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, s_key, 128);
+#else
+    if (op == BENCH_GCM_ENC) {
+        BENCH_PRINT("%-18s not built, make DUER_TLS_ECDHE=true\n", s_op_names[op]);
+        goto exit;
+    }
+#endif
+
+    // the best of the rounds, the others are interrupted
+    for (r = 0; r < rounds; r++) {
+        start = bench_ticks();
+        switch (op) {
+        case BENCH_SOFT_ENC:
+            bench_soft_cbc(&enc, MBEDTLS_AES_ENCRYPT, bytes, input, output);
+            break;
+        case BENCH_SOFT_DEC:
+            bench_soft_cbc(&dec, MBEDTLS_AES_DECRYPT, bytes, input, output);
+            break;
+        case BENCH_DUER_ENC:
+            duer_aes_cbc_encrypt(duer, bytes, input, output);
+            break;
+        case BENCH_DUER_DEC:
+            duer_aes_cbc_decrypt(duer, bytes, input, output);
+            break;
+        default:
+#if defined(MBEDTLS_GCM_C)
+            mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, bytes, iv, 12, NULL, 0,
+                                      input, output, sizeof(tag), tag);
+#endif
+            break;
+        }
+        ticks = bench_ticks() - start;
+        if (ticks < best) {
+            best = ticks;
+        }
+    }
+
+    BENCH_PRINT("%-18s %6lu bytes: %7.2f %s per byte\n",
+                s_op_names[op], (unsigned long)bytes, (double)best / bytes, BENCH_UNIT);
+
+#if !defined(MBEDTLS_GCM_C)
+exit:
+#else
+    mbedtls_gcm_free(&gcm);
+#endif
+    mbedtls_aes_free(&enc);
+    mbedtls_aes_free(&dec);
+    duer_aes_context_destroy(duer);
+    free(input);
+    free(output);
+}
+
+int main(int argc, char* argv[])
+{
+    long bytes = bench_arg(argc, argv, "bytes", 16384) & ~15L;
+    long rounds = bench_arg(argc, argv, "rounds", 2000);
+    int op;
+
+    bench_init(0);
+
+    for (op = 0; op < BENCH_OPS; op++) {
+        bench_run((bench_op_e)op, bytes, rounds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,355 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_batch.c
+ * Desc: The small reports batched by the engine or not. A sensor reports
+ *       one key/value -rate times per second through the engine queue, as
+ *       duer_data_report does, and the messages are serialized by duer_coap
+ *       over TCP to a transport in memory. The CA is stubbed, started with
+ *       the report query of a real profile. Report the packets per second and
+ *       the bytes, the CoAP over TCP counted, plus the TLS record (AES-GCM,
+ *       29 bytes) and the TCP/IPv4 headers (40 bytes) per packet for the wire.
+ *       Every payload is parsed back, the reports received should be all.
+ *
+ *   bench-batch [-seconds 2] [-rate 50]
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_json.h"
+#include "lightduer_coap.h"
+#include "lightduer_engine.h"
+#include "lightduer_events.h"
+#include "lightduer_memory.h"
+#include "lightduer_net_transport.h"
+
+#define BENCH_TLS_RECORD    (5 + 8 + 16)
+#define BENCH_TCP_IP        (20 + 20)
+
+#define BENCH_REPORT_PATH   "v1/device/data"
+#define BENCH_REPORT_QUERY  "deviceUuid=0123456789abcdef0123456789abcdef" \
+                            "&token=ZmVkY2JhOTg3NjU0MzIxMGZlZGNiYTk4"
+
+typedef struct _bench_stats_s {
+    long    packets;
+    long    bytes;      // the CoAP over TCP
+    long    reports;    // parsed back from the payloads
+    long    bad;        // the payloads not parsed
+} bench_stats_t;
+
+static duer_coap_handler s_coap = NULL;
+static duer_events_handler s_events = NULL;
+static duer_u16_t s_token = 0;
+static bench_stats_t s_stats;
+
+/*
+ * The CA stubbed, only what the engine calls for the reports
+ */
+duer_handler baidu_ca_acquire(duer_transevt_func soc_ctx)
+{
+    return (duer_handler)&s_coap;
+}
+
+duer_bool baidu_ca_is_started(duer_handler hdlr)
+{
+    return DUER_TRUE;
+}
+
+duer_bool baidu_ca_is_stopped(duer_handler hdlr)
+{
+    return DUER_FALSE;
+}
+
+duer_status_t baidu_ca_load_configuration(duer_handler hdlr, const void *data, duer_size_t size)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_start(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_stop(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_release(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_add_resources(duer_handler hdlr, const duer_res_t list_res[],
+                                     duer_size_t list_res_size)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_data_available(duer_handler hdlr, const duer_addr_t *addr)
+{
+    return DUER_ERR_TRANS_WOULD_BLOCK;
+}
+
+duer_status_t baidu_ca_release_idle(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_msg_t *baidu_ca_build_report_message(duer_handler hdlr, duer_bool confirmable)
+{
+    duer_msg_t *msg = DUER_MALLOC(sizeof(duer_msg_t));
+
+    if (msg) {
+        memset(msg, 0, sizeof(duer_msg_t));
+        msg->msg_type = confirmable ? DUER_MSG_TYPE_CONFIRMABLE : DUER_MSG_TYPE_NON_CONFIRMABLE;
+        msg->msg_code = DUER_MSG_REQ_POST;
+        msg->path = (duer_u8_t *)BENCH_REPORT_PATH;
+        msg->path_len = strlen(BENCH_REPORT_PATH);
+        msg->query = (duer_u8_t *)BENCH_REPORT_QUERY;
+        msg->query_len = strlen(BENCH_REPORT_QUERY);
+        msg->token_len = sizeof(s_token);
+        msg->token = DUER_MALLOC(msg->token_len);
+        if (msg->token) {
+            memcpy(msg->token, &s_token, msg->token_len);
+        }
+        s_token++;
+    }
+
+    return msg;
+}
+
+duer_msg_t *baidu_ca_build_response_message(duer_handler hdlr, const duer_msg_t *msg,
+                                            duer_u8_t msg_code)
+{
+    return NULL;
+}
+
+void baidu_ca_release_message(duer_handler hdlr, duer_msg_t *msg)
+{
+    if (msg) {
+        DUER_FREE(msg->token);
+        DUER_FREE(msg);
+    }
+}
+
+duer_status_t baidu_ca_send_data(duer_handler hdlr, const duer_msg_t *msg,
+                                 const duer_addr_t *addr)
+{
+    baidu_json *value = NULL;
+    baidu_json *data = NULL;
+    char *payload = DUER_MALLOC(msg->payload_len + 1);
+
+    // what the server receives
+    if (payload) {
+        memcpy(payload, msg->payload, msg->payload_len);
+        payload[msg->payload_len] = '\0';
+        value = baidu_json_Parse(payload);
+        DUER_FREE(payload);
+    }
+    data = value ? baidu_json_GetObjectItem(value, "data") : NULL;
+    if (data == NULL) {
+        s_stats.bad++;
+    } else if (data->type == baidu_json_Array) {
+        s_stats.reports += baidu_json_GetArraySize(data);
+    } else {
+        s_stats.reports++;
+    }
+    if (value) {
+        baidu_json_Delete(value);
+    }
+
+    return duer_coap_send(s_coap, msg);
+}
+
+/*
+ * The transport in memory, counts what sent
+ */
+static duer_socket_t bench_soc_create(duer_transevt_func func)
+{
+    return (duer_socket_t)&s_stats;
+}
+
+static duer_status_t bench_soc_connect(duer_socket_t sock, const duer_addr_t *addr)
+{
+    return DUER_OK;
+}
+
+static duer_status_t bench_soc_send(duer_socket_t sock, const void *data, duer_size_t size,
+                                    const duer_addr_t *addr)
+{
+    s_stats.packets++;
+    s_stats.bytes += size;
+    return size;
+}
+
+static duer_status_t bench_soc_recv(duer_socket_t sock, void *data, duer_size_t size,
+                                    duer_addr_t *addr)
+{
+    return DUER_ERR_TRANS_WOULD_BLOCK;
+}
+
+static duer_status_t bench_soc_close(duer_socket_t sock)
+{
+    return DUER_OK;
+}
+
+static duer_status_t bench_soc_destroy(duer_socket_t sock)
+{
+    return DUER_OK;
+}
+
+/*
+ * As lightduer_connagent.c does
+ */
+int duer_data_send(void)
+{
+    return duer_events_call_coalesced(s_events, DUER_EVENTS_PRIORITY_NORMAL,
+                                      duer_engine_send, 0, NULL);
+}
+
+int duer_data_idle(void)
+{
+    return duer_events_call_coalesced(s_events, DUER_EVENTS_PRIORITY_NORMAL,
+                                      duer_engine_release_idle, 0, NULL);
+}
+
+int duer_data_report(const baidu_json *data)
+{
+    int rs = duer_engine_enqueue_report_data(data);
+    if (rs == DUER_OK && duer_engine_qcache_length() == 1) {
+        duer_data_send();
+    }
+    return rs;
+}
+
+int duer_data_available(void)
+{
+    return DUER_OK;
+}
+
+static void bench_notify(int event, int status, int what, void *object)
+{
+    if (event == DUER_EVT_SEND_DATA && status >= 0 && duer_engine_qcache_length() > 0) {
+        duer_data_send();
+    }
+}
+
+/*
+ * A sensor's key/value, the keys in turn
+ */
+static baidu_json *bench_report(long i)
+{
+    static const char *keys[] = {"temperature", "humidity", "pm25", "illuminance", "switch"};
+    baidu_json *data = baidu_json_CreateObject();
+
+    if (data) {
+        baidu_json_AddNumberToObject(data, keys[i % 5], (double)(i % 97) / 2);
+    }
+
+    return data;
+}
+
+static void bench_run(duer_u32_t linger, duer_size_t bytes, double seconds, long rate)
+{
+    long count = (long)(seconds * rate);
+    baidu_json *data = NULL;
+    double start;
+    double elapsed;
+    double wait;
+    long reported = 0;
+    long i;
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    duer_engine_set_report_batch(linger, bytes);
+
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        wait = start + (double)i / rate - bench_now();
+        if (wait > 0) {
+            usleep((useconds_t)(wait * 1e6));
+        }
+
+        data = bench_report(i);
+        if (data && duer_data_report(data) == DUER_OK) {
+            reported++;
+        }
+        baidu_json_Delete(data);
+    }
+    elapsed = bench_now() - start;
+
+    // the last batch closed by the linger
+    while (duer_engine_qcache_length() > 0 || s_stats.reports < reported) {
+        if (bench_now() - start > seconds + 1 + linger / 1000.0) {
+            break;
+        }
+        usleep(1000);
+    }
+
+    if (linger == 0) {
+        BENCH_PRINT("batch off:                ");
+    } else {
+        BENCH_PRINT("linger %3u ms, %5u bytes: ", (unsigned)linger, (unsigned)bytes);
+    }
+    BENCH_PRINT("%6.1f packets/s, %5.2f reports/packet, %6.1f CoAP bytes/report, "
+                "%6.1f wire bytes/report, %7.0f wire bytes/s, %s\n",
+                s_stats.packets / elapsed, (double)s_stats.reports / s_stats.packets,
+                (double)s_stats.bytes / s_stats.reports,
+                (double)(s_stats.bytes + s_stats.packets * (BENCH_TLS_RECORD + BENCH_TCP_IP))
+                / s_stats.reports,
+                (s_stats.bytes + s_stats.packets * (BENCH_TLS_RECORD + BENCH_TCP_IP)) / elapsed,
+                s_stats.bad == 0 && s_stats.reports == reported && reported == count
+                ? "ok" : "WRONG");
+}
+
+int main(int argc, char* argv[])
+{
+    static const duer_u32_t lingers[] = {0, 20, 50, 200, 200};
+    static const duer_size_t budgets[] = {0, 1024, 1024, 1024, 128};
+    double seconds = bench_arg(argc, argv, "seconds", 2);
+    long rate = bench_arg(argc, argv, "rate", 50);
+    duer_addr_t addr;
+    size_t i;
+
+    bench_init(bench_arg(argc, argv, "verbose", 0));
+    baidu_ca_transport_init(bench_soc_create, bench_soc_connect, bench_soc_send,
+                            bench_soc_recv, NULL, bench_soc_close, bench_soc_destroy);
+
+    s_events = duer_events_create("bench_batch", 0, 16);
+    s_coap = duer_coap_acquire(NULL, NULL, NULL, NULL);
+    if (s_events == NULL || s_coap == NULL) {
+        BENCH_PRINT("create failed\n");
+        return 1;
+    }
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = 443;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+    duer_coap_connect(s_coap, &addr, NULL, 0);
+
+    duer_engine_register_notify(bench_notify);
+    duer_engine_create(0, NULL);
+
+    for (i = 0; i < sizeof(lingers) / sizeof(lingers[0]); i++) {
+        bench_run(lingers[i], budgets[i], seconds, rate);
+    }
+
+    duer_coap_release(s_coap);
+    return 0;
+}
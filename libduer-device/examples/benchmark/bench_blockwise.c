@@ -0,0 +1,488 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_blockwise.c
+ * Desc: The blockwise transfer (RFC 7959) through a local stand-in server
+ *       over TCP. The client POSTs the payload by duer_coap_send as the
+ *       engine does (again on DUER_ERR_TRANS_WOULD_BLOCK), the server takes
+ *       it by Block1 and answers as large a payload by Block2, which the
+ *       client gets in f_result block by block. Both sides check the
+ *       offsets and the bytes. Report the time up and down, and the heap
+ *       peak of the client, for:
+ *         1024, the server takes the 1024 bytes blocks,
+ *         256,  the server asks the 256 bytes blocks at the first one,
+ *         whole, a CON message without the token, not streamed: the stack
+ *                blockwises it by itself with the whole message kept, for
+ *                the heap compared.
+ *
+ *   bench-blockwise [-bytes 1048576] [-whole 60000]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_coap.h"
+
+#define BENCH_COAP_TCP_HDR      (0xbeefdead)
+#define BENCH_PACKET_MAX        (2048)
+
+#define BENCH_OPT_BLOCK2        (23)
+#define BENCH_OPT_BLOCK1        (27)
+#define BENCH_OPT_SIZE2         (28)
+
+#define BENCH_CODE_CHANGED      (0x44)
+#define BENCH_CODE_CONTINUE     (0x5f)
+
+typedef struct _bench_server_s {
+    int             fd;
+    int             ack;        // the request is CON, answered by the ACK
+    duer_u16_t      msg_id;     // of the request
+    int             szx;        // the block size the server takes
+    long            total;      // the response payload
+    long            expected;   // the Block1 offset expected
+    long            bad;
+    long            continues;  // the 2.31 sent
+} bench_server_t;
+
+typedef struct _bench_client_s {
+    long            received;
+    long            total;
+    long            bad;
+    long            results;
+    int             done;
+} bench_client_t;
+
+static unsigned char bench_up(long i)
+{
+    return (unsigned char)(i * 7 + (i >> 8));
+}
+
+static unsigned char bench_down(long i)
+{
+    return (unsigned char)(i * 13 + (i >> 9));
+}
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+}
+
+static duer_status_t bench_result(duer_context ctx, duer_coap_handler hdlr,
+                                  const duer_msg_t *msg, const duer_addr_t *addr)
+{
+    bench_client_t *client = (bench_client_t *)ctx;
+    duer_size_t i;
+
+    client->results++;
+    if (msg->msg_code == BENCH_CODE_CONTINUE) {
+        // the 2.31 of Block1 shouldn't come here
+        client->bad++;
+    }
+
+    if (msg->block_offset != (duer_size_t)client->received) {
+        client->bad++;
+    }
+    for (i = 0; i < msg->payload_len; i++) {
+        if (msg->payload[i] != bench_down(msg->block_offset + i)) {
+            client->bad++;
+            break;
+        }
+    }
+    client->received = msg->block_offset + msg->payload_len;
+    if (!msg->block_more) {
+        client->done = 1;
+    }
+
+    return DUER_OK;
+}
+
+static unsigned char *bench_option(unsigned char *p, int *last, int number,
+                                   unsigned long value)
+{
+    unsigned char bytes[4];
+    int len = 0;
+    int delta = number - *last;
+
+    while (value > 0) {
+        bytes[len++] = value & 0xff;
+        value >>= 8;
+    }
+
+    // the deltas here < 269
+    if (delta < 13) {
+        *p++ = (delta << 4) | len;
+    } else {
+        *p++ = (13 << 4) | len;
+        *p++ = delta - 13;
+    }
+    while (len > 0) {
+        *p++ = bytes[--len];
+    }
+    *last = number;
+
+    return p;
+}
+
+/*
+ * Send the response with the options, the payload by the Block2, piggybacked
+ * in the ACK to the CON request, or else NON
+ */
+static void bench_respond(bench_server_t *server, int code, const unsigned char *token,
+                          int token_len, long block2, long block1, long size2,
+                          long offset, long len)
+{
+    static duer_u16_t msg_id = 0;
+    unsigned char buf[BENCH_PACKET_MAX + 64];
+    duer_u32_t *hdr = (duer_u32_t *)buf;
+    unsigned char *p = buf + 8;
+    int last = 0;
+    long i;
+
+    if (server->ack) {
+        msg_id = server->msg_id;
+    } else {
+        msg_id++;
+    }
+    *p++ = (server->ack ? 0x60 : 0x50) | token_len;
+    *p++ = code;
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    memcpy(p, token, token_len);
+    p += token_len;
+
+    if (block2 >= 0) {
+        p = bench_option(p, &last, BENCH_OPT_BLOCK2, block2);
+    }
+    if (block1 >= 0) {
+        p = bench_option(p, &last, BENCH_OPT_BLOCK1, block1);
+    }
+    if (size2 > 0) {
+        p = bench_option(p, &last, BENCH_OPT_SIZE2, size2);
+    }
+    if (len > 0) {
+        *p++ = 0xff;
+        for (i = 0; i < len; i++) {
+            *p++ = bench_down(offset + i);
+        }
+    }
+
+    hdr[0] = htonl(BENCH_COAP_TCP_HDR);
+    hdr[1] = htonl(p - buf - 8);
+    write(server->fd, buf, p - buf);
+}
+
+/*
+ * The request: Block1 goes on by 2.31, the last one is answered by the
+ * first block of the response, Block2 asks the following ones
+ */
+static void bench_serve(bench_server_t *server, const unsigned char *packet, long size)
+{
+    const unsigned char *p = packet + 4;
+    const unsigned char *end = packet + size;
+    const unsigned char *token = p;
+    int token_len = packet[0] & 0x0f;
+    long block1 = -1;
+    long block2 = -1;
+    long number = 0;
+    long delta;
+    long len;
+    long value;
+    long offset;
+    long bsize;
+    long i;
+    int szx;
+
+    server->ack = (packet[0] & 0x30) == 0x00;
+    server->msg_id = (packet[2] << 8) | packet[3];
+
+    p += token_len;
+    while (p < end && *p != 0xff) {
+        delta = *p >> 4;
+        len = *p & 0x0f;
+        p++;
+        if (delta == 13) {
+            delta = *p++ + 13;
+        }
+        if (len == 13) {
+            len = *p++ + 13;
+        }
+        number += delta;
+        for (value = 0, i = 0; i < len; i++) {
+            value = (value << 8) | p[i];
+        }
+        if (number == BENCH_OPT_BLOCK1) {
+            block1 = value;
+        } else if (number == BENCH_OPT_BLOCK2) {
+            block2 = value;
+        }
+        p += len;
+    }
+    if (p < end) {
+        p++;
+    }
+    len = end - p;
+
+    if (block1 >= 0) {
+        szx = block1 & 0x07;
+        offset = (block1 >> 4) << (szx + 4);
+        if (offset != server->expected) {
+            server->bad++;
+        }
+        for (i = 0; i < len; i++) {
+            if (p[i] != bench_up(offset + i)) {
+                server->bad++;
+                break;
+            }
+        }
+        server->expected = offset + len;
+
+        if (block1 & 0x08) {
+            server->continues++;
+            bench_respond(server, BENCH_CODE_CONTINUE, token, token_len, -1,
+                          (block1 & ~0x07) | (szx < server->szx ? szx : server->szx),
+                          0, 0, 0);
+            return;
+        }
+
+        bsize = 16 << server->szx;
+        bench_respond(server, BENCH_CODE_CHANGED, token, token_len,
+                      server->total > 0 ? (server->total > bsize ? 0x08 : 0) | server->szx : -1,
+                      block1, server->total, 0, server->total < bsize ? server->total : bsize);
+        return;
+    }
+
+    if (block2 >= 0) {
+        szx = (block2 & 0x07) < server->szx ? (block2 & 0x07) : server->szx;
+        offset = (block2 >> 4) << ((block2 & 0x07) + 4);
+        bsize = 16 << szx;
+        len = server->total - offset < bsize ? server->total - offset : bsize;
+        bench_respond(server, BENCH_CODE_CHANGED, token, token_len,
+                      ((offset >> (szx + 4)) << 4) | (offset + len < server->total ? 0x08 : 0)
+                      | szx, -1, 0, offset, len);
+        return;
+    }
+
+    // the whole message
+    for (i = 0; i < len; i++) {
+        if (p[i] != bench_up(i)) {
+            server->bad++;
+            break;
+        }
+    }
+    server->expected = len;
+    bench_respond(server, BENCH_CODE_CHANGED, token, token_len, -1, -1, 0, 0, 0);
+}
+
+static void *bench_server(void *arg)
+{
+    bench_server_t *server = (bench_server_t *)arg;
+    size_t cap = 256 * 1024;
+    unsigned char *buf = malloc(cap);
+    size_t have = 0;
+    size_t used;
+    duer_u32_t size;
+    ssize_t rs;
+
+    for (;;) {
+        rs = read(server->fd, buf + have, cap - have);
+        if (rs <= 0) {
+            break;
+        }
+        have += rs;
+
+        used = 0;
+        while (have - used >= 8) {
+            memcpy(&size, buf + used + 4, sizeof(size));
+            size = ntohl(size);
+            if (have - used < 8 + size) {
+                break;
+            }
+            bench_serve(server, buf + used + 8, size);
+            used += 8 + size;
+        }
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static int bench_listen(int *port)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, 4) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        exit(1);
+    }
+
+    *port = ntohs(addr_in.sin_port);
+    return fd;
+}
+
+static duer_status_t bench_connect(duer_coap_handler coap, int port)
+{
+    duer_addr_t addr;
+    duer_status_t rs;
+    double start = bench_now();
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+
+    do {
+        rs = duer_coap_connect(coap, &addr, NULL, 0);
+    } while (rs == DUER_ERR_TRANS_WOULD_BLOCK && bench_now() - start < 5);
+
+    return rs;
+}
+
+/*
+ * Read what the server has sent, as the engine does on DUER_TEVT_RECV_RDY
+ */
+static void bench_poll(duer_coap_handler coap)
+{
+    while (duer_coap_data_available(coap) >= DUER_OK) {
+    }
+}
+
+static void bench_run(const char *name, int server_szx, long bytes, duer_bool blockwise)
+{
+    static duer_u8_t token[4] = {0x12, 0x34, 0x56, 0x78};
+    bench_server_t server;
+    bench_client_t client;
+    bench_heap_t heap;
+    pthread_t thread;
+    duer_coap_handler coap;
+    duer_msg_t msg;
+    duer_u8_t *payload = malloc(bytes);
+    duer_status_t rs;
+    double start;
+    double up;
+    double down;
+    int listener;
+    int port;
+    int one = 1;
+    long i;
+
+    for (i = 0; i < bytes; i++) {
+        payload[i] = bench_up(i);
+    }
+
+    memset(&client, 0, sizeof(client));
+    listener = bench_listen(&port);
+    coap = duer_coap_acquire(bench_result, &client, bench_transevt, NULL);
+    if (!coap || bench_connect(coap, port) != DUER_OK) {
+        BENCH_PRINT("connect failed\n");
+        exit(1);
+    }
+
+    memset(&server, 0, sizeof(server));
+    server.fd = accept(listener, NULL, NULL);
+    server.szx = server_szx;
+    server.total = blockwise ? bytes : 0;
+    setsockopt(server.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    pthread_create(&thread, NULL, bench_server, &server);
+
+    memset(&msg, 0, sizeof(msg));
+    // not blockwise here, the stack sends it by its own Block1, the whole kept
+    msg.msg_type = blockwise ? DUER_MSG_TYPE_NON_CONFIRMABLE : DUER_MSG_TYPE_CONFIRMABLE;
+    msg.msg_code = DUER_MSG_REQ_POST;
+    msg.path = (duer_u8_t *)"v1/report";
+    msg.path_len = strlen((char *)msg.path);
+    msg.token = blockwise ? token : NULL;
+    msg.token_len = blockwise ? sizeof(token) : 0;
+    msg.payload = payload;
+    msg.payload_len = bytes;
+
+    bench_heap_reset();
+
+    // up, the message kept and sent again until done, or until the server has it all
+    start = bench_now();
+    while ((rs = duer_coap_send(coap, &msg)) == DUER_ERR_TRANS_WOULD_BLOCK
+            && bench_now() - start < 10) {
+        bench_poll(coap);
+    }
+    while (rs == DUER_OK && *(volatile long *)&server.expected < bytes
+            && bench_now() - start < 10) {
+        bench_poll(coap);
+    }
+    up = bench_now() - start;
+
+    // down, the following blocks asked in f_result
+    start = bench_now();
+    while (!client.done && bench_now() - start < 10) {
+        bench_poll(coap);
+    }
+    down = bench_now() - start;
+
+    bench_heap_get(&heap);
+
+    BENCH_PRINT("%-5s %8ld bytes: up %7.2f MB/s (%ld 2.31), down %7.2f MB/s, "
+                "heap peak %7lld bytes, %s\n",
+                name, bytes, bytes / up / 1e6, server.continues,
+                down > 0 ? client.received / down / 1e6 : 0, heap.peak,
+                rs == DUER_OK && server.expected == bytes && server.bad == 0
+                && client.done && client.received == server.total && client.bad == 0
+                ? "ok" : "WRONG");
+
+    duer_coap_release(coap);
+    shutdown(server.fd, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(server.fd);
+    close(listener);
+    free(payload);
+}
+
+int main(int argc, char* argv[])
+{
+    long bytes = bench_arg(argc, argv, "bytes", 1024 * 1024);
+    long whole = bench_arg(argc, argv, "whole", 60000);
+
+    bench_init(bench_arg(argc, argv, "verbose", 0));
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+
+    bench_run("1024", 6, bytes, DUER_TRUE);
+    bench_run("256", 4, bytes, DUER_TRUE);
+    bench_run("whole", 6, whole, DUER_FALSE);
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_coalesce.c
+ * Desc: Queue the data and post a send event for each, like duer_data_report,
+ *       the send event drains all the queued data,
+ *       report the events handled and folded with or without coalescing.
+ *
+ *   bench-coalesce [-coalesce 1] [-count 1000000]
+ */
+
+#include "bench_common.h"
+#include "lightduer_events.h"
+
+static long s_queued = 0;
+static long s_sent = 0;
+static long s_sends = 0;
+
+static void bench_send(int what, void *object)
+{
+    long queued = __atomic_exchange_n(&s_queued, 0, __ATOMIC_SEQ_CST);
+
+    s_sends++;
+    __atomic_add_fetch(&s_sent, queued, __ATOMIC_SEQ_CST);
+}
+
+int main(int argc, char* argv[])
+{
+    long coalesce = bench_arg(argc, argv, "coalesce", 1);
+    long count = bench_arg(argc, argv, "count", 1000000);
+    duer_events_handler events = NULL;
+    duer_events_stats_t stats;
+    double start;
+    double elapsed;
+    long i;
+
+    bench_init(0);
+
+    events = duer_events_create("bench_coalesce", 0, 16);
+    if (events == NULL) {
+        return 1;
+    }
+
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        __atomic_add_fetch(&s_queued, 1, __ATOMIC_SEQ_CST);
+        if (coalesce) {
+            duer_events_call_coalesced(events, DUER_EVENTS_PRIORITY_NORMAL, bench_send, 0, NULL);
+        } else {
+            duer_events_call(events, bench_send, 0, NULL);
+        }
+    }
+    while (__atomic_load_n(&s_sent, __ATOMIC_SEQ_CST) != count) {
+    }
+    elapsed = bench_now() - start;
+
+    if (duer_events_get_stats("bench_coalesce", &stats) != DUER_OK) {
+        return 1;
+    }
+
+    BENCH_PRINT("%s: %.2f M data/s, %ld sends for %ld data, %zu folded, max depth %zu\n",
+                coalesce ? "coalesced" : "plain", count / elapsed / 1e6,
+                s_sends, count, stats.folded, stats.max_depth);
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_common.c
+ * Desc: The common helpers shared by the benchmarks.
+ */
+
+#include "bench_common.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "lightduer_memory.h"
+#include "lightduer_mutex.h"
+#include "lightduer_debug.h"
+#include "lightduer_timestamp.h"
+
+static unsigned long s_bench_malloc_counts = 0;
+
+// the heap used by the calling thread, the block freed by another thread is
+// counted there
+static __thread bench_heap_t s_bench_heap;
+static int s_bench_heap_libc = 0;
+
+void bench_heap_libc(void)
+{
+    s_bench_heap_libc = 1;
+}
+
+void bench_heap_add(void* ptr)
+{
+    if (ptr) {
+        s_bench_heap.mallocs++;
+        s_bench_heap.bytes += malloc_usable_size(ptr);
+        s_bench_heap.in_use += malloc_usable_size(ptr);
+        if (s_bench_heap.in_use > s_bench_heap.peak) {
+            s_bench_heap.peak = s_bench_heap.in_use;
+        }
+    }
+}
+
+void bench_heap_remove(void* ptr)
+{
+    if (ptr) {
+        s_bench_heap.in_use -= malloc_usable_size(ptr);
+    }
+}
+
+static void* bench_malloc(duer_context ctx, duer_size_t size)
+{
+    void* ptr;
+
+    __atomic_add_fetch(&s_bench_malloc_counts, 1, __ATOMIC_RELAXED);
+    ptr = malloc(size);
+    if (!s_bench_heap_libc) {
+        bench_heap_add(ptr);
+    }
+    return ptr;
+}
+
+static void* bench_realloc(duer_context ctx, void* ptr, duer_size_t size)
+{
+    __atomic_add_fetch(&s_bench_malloc_counts, 1, __ATOMIC_RELAXED);
+    if (!s_bench_heap_libc) {
+        bench_heap_remove(ptr);
+    }
+    ptr = realloc(ptr, size);
+    if (!s_bench_heap_libc) {
+        bench_heap_add(ptr);
+    }
+    return ptr;
+}
+
+unsigned long bench_malloc_counts(void)
+{
+    return __atomic_load_n(&s_bench_malloc_counts, __ATOMIC_RELAXED);
+}
+
+static void bench_free(duer_context ctx, void* ptr)
+{
+    if (!s_bench_heap_libc) {
+        bench_heap_remove(ptr);
+    }
+    free(ptr);
+}
+
+void bench_heap_reset(void)
+{
+    s_bench_heap.mallocs = 0;
+    s_bench_heap.bytes = 0;
+    s_bench_heap.peak = s_bench_heap.in_use;
+}
+
+void bench_heap_get(bench_heap_t* heap)
+{
+    *heap = s_bench_heap;
+}
+
+// use the libc malloc directly, to avoid recursion when the pool creates its lock
+static duer_mutex_t bench_mutex_create(void)
+{
+    pthread_mutex_t* mutex = malloc(sizeof(pthread_mutex_t));
+
+    if (mutex) {
+        pthread_mutex_init(mutex, NULL);
+    }
+
+    return mutex;
+}
+
+static duer_status_t bench_mutex_lock(duer_mutex_t mutex)
+{
+    return pthread_mutex_lock((pthread_mutex_t*)mutex) ? DUER_ERR_FAILED : DUER_OK;
+}
+
+static duer_status_t bench_mutex_unlock(duer_mutex_t mutex)
+{
+    return pthread_mutex_unlock((pthread_mutex_t*)mutex) ? DUER_ERR_FAILED : DUER_OK;
+}
+
+static duer_status_t bench_mutex_destroy(duer_mutex_t mutex)
+{
+    pthread_mutex_destroy((pthread_mutex_t*)mutex);
+    free(mutex);
+    return DUER_OK;
+}
+
+static void bench_debug(duer_context ctx, duer_u32_t level, const char* file,
+                        duer_u32_t line, const char* msg)
+{
+    fprintf(stderr, "[%u] %s\n", level, msg);
+}
+
+static duer_u32_t bench_timestamp(void)
+{
+    return bench_now_us() / 1000;
+}
+
+void bench_init(int verbose)
+{
+    baidu_ca_memory_init(NULL, bench_malloc, bench_realloc, bench_free);
+    baidu_ca_mutex_init(bench_mutex_create, bench_mutex_lock,
+                        bench_mutex_unlock, bench_mutex_destroy);
+    baidu_ca_timestamp_init(bench_timestamp);
+    if (verbose) {
+        baidu_ca_debug_init(NULL, bench_debug);
+    }
+}
+
+duer_u32_t bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (duer_u32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long bench_arg(int argc, char* argv[], const char* name, long def)
+{
+    int i;
+
+    for (i = 1; i + 1 < argc; i++) {
+        if (argv[i][0] == '-' && strcmp(argv[i] + 1, name) == 0) {
+            return strtol(argv[i + 1], NULL, 0);
+        }
+    }
+
+    return def;
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_common.h
+ * Desc: The common helpers shared by the benchmarks.
+ */
+
+#ifndef BAIDU_DUER_EXAMPLES_BENCHMARK_BENCH_COMMON_H
+#define BAIDU_DUER_EXAMPLES_BENCHMARK_BENCH_COMMON_H
+
+#include <stdio.h>
+#include "lightduer_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_PRINT(...)    do { fprintf(stdout, __VA_ARGS__); fflush(stdout); } while (0)
+
+/*
+ * Install the libc memory and the pthread mutex callbacks,
+ * the benchmarks don't depend on the platform port.
+ *
+ * @Param verbose, int, print the SDK logs or not
+ */
+void bench_init(int verbose);
+
+/*
+ * Obtain how many times the platform malloc/realloc called
+ */
+unsigned long bench_malloc_counts(void);
+
+/*
+ * The heap used by the calling thread, through the SDK memory callbacks
+ */
+typedef struct _bench_heap_s {
+    unsigned long       mallocs;    // the malloc/realloc calls
+    unsigned long long  bytes;      // the bytes allocated
+    long long           in_use;     // the bytes not freed yet
+    long long           peak;       // the most in_use since reset
+} bench_heap_t;
+
+/*
+ * Count the heap by the libc malloc/calloc/realloc/free instead, for the
+ * libraries not using the SDK memory callbacks (mbedtls). The benchmark links
+ * with -Wl,--wrap for them, and calls bench_heap_add/bench_heap_remove.
+ */
+void bench_heap_libc(void);
+void bench_heap_add(void* ptr);
+void bench_heap_remove(void* ptr);
+
+/*
+ * Reset the calling thread's malloc counts, the peak starts from the in_use
+ */
+void bench_heap_reset(void);
+
+/*
+ * Obtain the calling thread's heap usage
+ */
+void bench_heap_get(bench_heap_t* heap);
+
+/*
+ * Obtain the monotonic time by microseconds
+ */
+duer_u32_t bench_now_us(void);
+
+/*
+ * Obtain the monotonic time by seconds (floating)
+ */
+double bench_now(void);
+
+/*
+ * Parse the integer argument, "-name value"
+ *
+ * @Return the value, or the def if the argument not found
+ */
+long bench_arg(int argc, char* argv[], const char* name, long def);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BAIDU_DUER_EXAMPLES_BENCHMARK_BENCH_COMMON_H
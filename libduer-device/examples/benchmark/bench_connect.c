@@ -0,0 +1,227 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_connect.c
+ * Desc: Cold start connects of the linux socket adapter against a local server.
+ *       The resolver is stubbed, it answers from its own thread after -dns ms
+ *       (as cached if 0): "live.bench" is 127.0.0.1, where the server
+ *       listens, "blackhole.bench" is 127.0.0.2 then 127.0.0.1, and 127.0.0.2
+ *       is a listener with a full backlog, so its SYNs are dropped,
+ *       "dead.bench" is only 127.0.0.2 and runs into the connect deadline.
+ *       Report how long the caller was blocked and when the connect completed.
+ *
+ *   bench-connect [-runs 5] [-dead 1] [-dns 20]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_connagent.h"
+#include "lightduer_dns.h"
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static int s_done = 0;
+
+typedef struct _bench_lookup_s {
+    char                host[32];
+    duer_dns_callback   callback;
+    void               *ctx;
+} bench_lookup_t;
+
+// how long (ms) the stub resolver takes, 0 answers as cached
+static long s_dns_delay = 20;
+
+static void bench_answer(bench_lookup_t *lookup)
+{
+    const char *ips[2] = {NULL, NULL};
+    duer_dns_result_t result;
+    int i;
+
+    if (strcmp(lookup->host, "live.bench") == 0) {
+        ips[0] = "127.0.0.1";
+    } else if (strcmp(lookup->host, "blackhole.bench") == 0) {
+        ips[0] = "127.0.0.2";
+        ips[1] = "127.0.0.1";
+    } else if (strcmp(lookup->host, "dead.bench") == 0) {
+        ips[0] = "127.0.0.2";
+    }
+
+    memset(&result, 0, sizeof(result));
+    for (i = 0; i < 2 && ips[i] != NULL; i++) {
+        result.addrs[i].family = DUER_DNS_INET;
+        inet_pton(AF_INET, ips[i], result.addrs[i].addr);
+        result.count++;
+    }
+
+    lookup->callback(result.count > 0 ? DUER_OK : DUER_ERR_FAILED,
+                     lookup->host, &result, lookup->ctx);
+}
+
+static void *bench_resolver(void *arg)
+{
+    bench_lookup_t *lookup = (bench_lookup_t *)arg;
+
+    usleep(s_dns_delay * 1000);
+    bench_answer(lookup);
+    free(lookup);
+
+    return NULL;
+}
+
+duer_status_t duer_dns_lookup(const char *host, duer_dns_callback callback, void *ctx)
+{
+    bench_lookup_t *lookup = calloc(1, sizeof(*lookup));
+    pthread_t thread;
+
+    snprintf(lookup->host, sizeof(lookup->host), "%s", host);
+    lookup->callback = callback;
+    lookup->ctx = ctx;
+
+    if (s_dns_delay <= 0) {
+        bench_answer(lookup);
+        free(lookup);
+        return DUER_OK;
+    }
+
+    pthread_create(&thread, NULL, bench_resolver, lookup);
+    pthread_detach(thread);
+
+    return DUER_ERR_TRANS_WOULD_BLOCK;
+}
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+    if (event == DUER_TEVT_SEND_RDY) {
+        pthread_mutex_lock(&s_mutex);
+        s_done = 1;
+        pthread_cond_broadcast(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+static int bench_listen(const char *ip, int port, int backlog)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr_in.sin_addr);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, backlog) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen on %s failed\n", ip);
+        exit(1);
+    }
+
+    return ntohs(addr_in.sin_port);
+}
+
+static void bench_blackhole(int port)
+{
+    struct sockaddr_in addr_in;
+    int i;
+
+    bench_listen("127.0.0.2", port, 0);
+
+    // fill the backlog, the later SYNs are dropped
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.2", &addr_in.sin_addr);
+    for (i = 0; i < 4; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        connect(fd, (struct sockaddr *)&addr_in, sizeof(addr_in));
+        usleep(20000);
+    }
+}
+
+static void bench_connect(const char *host, int port)
+{
+    duer_addr_t addr;
+    duer_socket_t soc = bcasoc_create(bench_transevt);
+    double start = bench_now();
+    double blocked;
+    int rs;
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = (void *)host;
+    addr.host_size = strlen(host);
+
+    s_done = 0;
+    rs = bcasoc_connect(soc, &addr);
+    blocked = bench_now() - start;
+    if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+        pthread_mutex_lock(&s_mutex);
+        while (!s_done) {
+            pthread_cond_wait(&s_cond, &s_mutex);
+        }
+        pthread_mutex_unlock(&s_mutex);
+        rs = bcasoc_connect(soc, &addr);
+    }
+
+    BENCH_PRINT("%-16s rs %d, caller blocked %.2f ms, connected after %.2f ms\n",
+                host, rs, blocked * 1000, (bench_now() - start) * 1000);
+
+    bcasoc_close(soc);
+    bcasoc_destroy(soc);
+}
+
+int main(int argc, char* argv[])
+{
+    long runs = bench_arg(argc, argv, "runs", 5);
+    long dead = bench_arg(argc, argv, "dead", 1);
+    int port;
+    long i;
+
+    s_dns_delay = bench_arg(argc, argv, "dns", 20);
+
+    bench_init(0);
+    bcasoc_initialize();
+
+    port = bench_listen("127.0.0.1", 0, 64);
+    bench_blackhole(port);
+
+    for (i = 0; i < runs; i++) {
+        bench_connect("live.bench", port);
+    }
+    for (i = 0; i < runs; i++) {
+        bench_connect("blackhole.bench", port);
+    }
+    if (dead) {
+        bench_connect("dead.bench", port);
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_dcs.c
+ * Desc: Compare the heap and the arena for parsing the directives,
+ *       report the malloc calls and the time per directive.
+ *
+ *   bench-dcs [-count 100000]
+ */
+
+#include <string.h>
+
+#include "bench_common.h"
+#include "lightduer_memory.h"
+#include "lightduer_arena.h"
+#include "lightduer_lib.h"
+#include "baidu_json.h"
+
+static const char *s_directives[] = {
+    "{\"directive\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_output\","
+    "\"name\":\"Speak\",\"messageId\":\"ZDJlNmI0ZjktMzRkZi00ZjYwLWI2NjQtMmZlOGQ2YTZiM2Q2\","
+    "\"dialogRequestId\":\"12\"},\"payload\":{\"url\":\"http://tts.baidu.com/text2audio?tex=%E4%BD%A0%E5%A5%BD"
+    "&cuid=0123456789&lan=zh&ctp=1&pdt=319\",\"format\":\"AUDIO_MPEG\",\"token\":"
+    "\"eyJib3RfaWQiOiJ1cyIsInJlc3VsdF90b2tlbiI6IjFhNWUxYzQ4In0=\"}}}",
+
+    "{\"directive\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.audio_player\","
+    "\"name\":\"Play\",\"messageId\":\"NzA3NWJlZjMtNDQ1My00ZGE0LWI5YTEtMWM0YWNiZDI0ZjQw\","
+    "\"dialogRequestId\":\"13\"},\"payload\":{\"playBehavior\":\"REPLACE_ALL\",\"audioItem\":"
+    "{\"audioItemId\":\"1234567\",\"stream\":{\"url\":\"http://music.example.com/song/1234567.mp3\","
+    "\"streamFormat\":\"AUDIO_MPEG\",\"offsetInMilliseconds\":0,\"token\":\"song-1234567\","
+    "\"progressReport\":{\"progressReportDelayInMilliseconds\":0,"
+    "\"progressReportIntervalInMilliseconds\":30000}}}}}}",
+
+    "{\"directive\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.alerts\","
+    "\"name\":\"SetAlert\",\"messageId\":\"YWxlcnQtMTIzNA==\",\"dialogRequestId\":\"14\"},"
+    "\"payload\":{\"token\":\"alert-20171010-0730\",\"type\":\"ALARM\","
+    "\"scheduledTime\":\"2017-10-10T07:30:00+0800\"}}}",
+};
+
+#define DIRECTIVE_COUNTS    (sizeof(s_directives) / sizeof(s_directives[0]))
+
+// what the router does with a handler reading a few fields
+static int bench_route(const baidu_json *value)
+{
+    baidu_json *directive = baidu_json_GetObjectItem(value, "directive");
+    baidu_json *header = directive ? baidu_json_GetObjectItem(directive, "header") : NULL;
+    baidu_json *name = header ? baidu_json_GetObjectItem(header, "name") : NULL;
+    baidu_json *payload = directive ? baidu_json_GetObjectItem(directive, "payload") : NULL;
+
+    return name && payload ? (int)strlen(name->valuestring) : -1;
+}
+
+static int bench_heap(const char *data, size_t len)
+{
+    char *payload = DUER_MALLOC(len + 1);
+    baidu_json *value = NULL;
+    int rs = -1;
+
+    if (payload) {
+        DUER_MEMCPY(payload, data, len);
+        payload[len] = '\0';
+        value = baidu_json_Parse(payload);
+        if (value) {
+            rs = bench_route(value);
+            baidu_json_Delete(value);
+        }
+        DUER_FREE(payload);
+    }
+
+    return rs;
+}
+
+static void *bench_arena_alloc(void *ctx, size_t size)
+{
+    return duer_arena_alloc(ctx, size);
+}
+
+static int bench_arena(duer_arena_handler arena, const char *data, size_t len)
+{
+    baidu_json_Allocator allocator = {arena, bench_arena_alloc};
+    char *payload = duer_arena_alloc(arena, len + 1);
+    baidu_json *value = NULL;
+    int rs = -1;
+
+    if (payload) {
+        DUER_MEMCPY(payload, data, len);
+        payload[len] = '\0';
+        value = baidu_json_ParseWithAllocator(payload, &allocator);
+        if (value) {
+            rs = bench_route(value);
+        }
+    }
+
+    duer_arena_reset(arena);
+
+    return rs;
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 100000);
+    duer_arena_handler arena = NULL;
+    unsigned long mallocs;
+    double start;
+    double heap_time;
+    double arena_time;
+    long i;
+
+    bench_init(0);
+
+    arena = duer_arena_create(2048);
+    if (arena == NULL) {
+        return 1;
+    }
+
+    mallocs = bench_malloc_counts();
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        const char *data = s_directives[i % DIRECTIVE_COUNTS];
+        if (bench_heap(data, strlen(data)) < 0) {
+            BENCH_PRINT("heap: parse failed\n");
+            return 1;
+        }
+    }
+    heap_time = bench_now() - start;
+    BENCH_PRINT("heap:  %.1f mallocs/directive, %.2f us/directive\n",
+                (double)(bench_malloc_counts() - mallocs) / count, heap_time * 1e6 / count);
+
+    mallocs = bench_malloc_counts();
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        const char *data = s_directives[i % DIRECTIVE_COUNTS];
+        if (bench_arena(arena, data, strlen(data)) < 0) {
+            BENCH_PRINT("arena: parse failed\n");
+            return 1;
+        }
+    }
+    arena_time = bench_now() - start;
+    BENCH_PRINT("arena: %.1f mallocs/directive, %.2f us/directive\n",
+                (double)(bench_malloc_counts() - mallocs) / count, arena_time * 1e6 / count);
+
+    duer_arena_destroy(arena);
+
+    return 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_deflate.c
+ * Desc: The report payloads compressed by the deflate with the dictionary.
+ *       The payloads are what the engine sends for the DCS events (as built
+ *       by modules/dcs, the tokens and ids as the server gives), and the small
+ *       data reports. Report the size, the deflated with and without the
+ *       dictionary, the time to deflate and to inflate each, the heap of the
+ *       compressor. Every payload is inflated back and compared.
+ *       Built with DUER_REPORT_DEFLATE=true only.
+ *
+ *   bench-deflate [-count 10000]
+ */
+
+#include <string.h>
+
+#include "bench_common.h"
+#include "lightduer_memory.h"
+#include "lightduer_report_deflate.h"
+#include "zlib.h"
+
+#define BENCH_CONTEXT \
+    "\"clientContext\":[{\"header\":{\"namespace\":\"ai.dueros.device_interface.alerts\"," \
+    "\"name\":\"AlertsState\"},\"payload\":{\"allAlerts\":[{\"token\":\"alert-20171010-0730\"," \
+    "\"type\":\"ALARM\",\"scheduledTime\":\"2017-10-10T07:30:00+0800\"}]}}," \
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.audio_player\"," \
+    "\"name\":\"PlaybackState\"},\"payload\":{\"token\":\"song-1234567\"," \
+    "\"offsetInMilliseconds\":0,\"playerActivity\":\"PLAYING\"}}," \
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.speaker_controller\"," \
+    "\"name\":\"VolumeState\"},\"payload\":{\"volume\":60,\"muted\":false}}," \
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_output\"," \
+    "\"name\":\"SpeechState\"},\"payload\":{\"token\":" \
+    "\"eyJib3RfaWQiOiJ1cyIsInJlc3VsdF90b2tlbiI6IjFhNWUxYzQ4In0=\"," \
+    "\"offsetInMilliseconds\":0,\"playerActivity\":\"FINISHED\"}}]"
+
+typedef struct _bench_payload_s {
+    const char *name;
+    const char *data;
+} bench_payload_t;
+
+static const bench_payload_t s_payloads[] = {
+    {"ListenStarted",
+     "{\"data\":{" BENCH_CONTEXT ",\"event\":{\"header\":{"
+     "\"namespace\":\"ai.dueros.device_interface.voice_input\",\"name\":\"ListenStarted\","
+     "\"dialogRequestId\":\"12\"},\"payload\":{\"format\":\"AUDIO_L16_RATE_16000_CHANNELS_1\"}}}}"},
+
+    {"SynchronizeState",
+     "{\"data\":{" BENCH_CONTEXT ",\"event\":{\"header\":{"
+     "\"namespace\":\"ai.dueros.device_interface.system\",\"name\":\"SynchronizeState\"},"
+     "\"payload\":{}}}}"},
+
+    {"PlayCommandIssued",
+     "{\"data\":{" BENCH_CONTEXT ",\"event\":{\"header\":{"
+     "\"namespace\":\"ai.dueros.device_interface.playback_controller\","
+     "\"name\":\"PlayCommandIssued\"},\"payload\":{}}}}"},
+
+    {"SpeechStarted",
+     "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_output\","
+     "\"name\":\"SpeechStarted\"},\"payload\":{\"token\":"
+     "\"eyJib3RfaWQiOiJ1cyIsInJlc3VsdF90b2tlbiI6IjFhNWUxYzQ4In0=\"}}}}"},
+
+    {"SpeechFinished",
+     "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_output\","
+     "\"name\":\"SpeechFinished\"},\"payload\":{\"token\":"
+     "\"eyJib3RfaWQiOiJ1cyIsInJlc3VsdF90b2tlbiI6IjFhNWUxYzQ4In0=\"}}}}"},
+
+    {"PlaybackStarted",
+     "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.audio_player\","
+     "\"name\":\"PlaybackStarted\"},\"payload\":{\"token\":\"song-1234567\","
+     "\"offsetInMilliseconds\":0}}}}"},
+
+    {"PlaybackNearlyFinished",
+     "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.audio_player\","
+     "\"name\":\"PlaybackNearlyFinished\"},\"payload\":{\"token\":\"song-1234567\","
+     "\"offsetInMilliseconds\":0}}}}"},
+
+    {"VolumeChanged",
+     "{\"data\":{\"event\":{\"header\":{"
+     "\"namespace\":\"ai.dueros.device_interface.speaker_controller\","
+     "\"name\":\"VolumeChanged\"},\"payload\":{\"volume\":60,\"mute\":false}}}}"},
+
+    {"AlertStarted",
+     "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.alerts\","
+     "\"name\":\"AlertStarted\"},\"payload\":{\"token\":\"alert-20171010-0730\"}}}}"},
+
+    {"UserInactivityReport",
+     "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.system\","
+     "\"name\":\"UserInactivityReport\"},\"payload\":{\"inactiveTimeInSeconds\":3600}}}}"},
+
+    {"ExceptionEncountered",
+     "{\"data\":{" BENCH_CONTEXT ",\"event\":{\"header\":{"
+     "\"namespace\":\"ai.dueros.device_interface.system\",\"name\":\"ExceptionEncountered\"},"
+     "\"payload\":{\"unparsedDirective\":\"{\\\"header\\\":{\\\"namespace\\\":"
+     "\\\"ai.dueros.device_interface.screen\\\",\\\"name\\\":\\\"RenderCard\\\"}}\","
+     "\"error\":{\"type\":\"UNSUPPORTED_OPERATION\",\"message\":\"Unknow directive\"}}}}}"},
+
+    {"sensor",
+     "{\"data\":{\"temperature\":23.5}}"},
+
+    {"sensors batched",
+     "{\"data\":[{\"temperature\":23.5},{\"humidity\":41},{\"pm25\":12},"
+     "{\"illuminance\":320},{\"switch\":1},{\"temperature\":23.6},{\"humidity\":41},"
+     "{\"pm25\":13},{\"illuminance\":318},{\"switch\":1}]}"},
+};
+
+#define PAYLOAD_COUNTS  (sizeof(s_payloads) / sizeof(s_payloads[0]))
+
+static voidpf bench_zalloc(voidpf opaque, uInt items, uInt size)
+{
+    return DUER_MALLOC(items * size);
+}
+
+static void bench_zfree(voidpf opaque, voidpf address)
+{
+    DUER_FREE(address);
+}
+
+/*
+ * The raw deflate with the same settings, but no dictionary
+ */
+static size_t bench_plain(const char *data, size_t size)
+{
+    unsigned char out[2048];
+    z_stream stream;
+    size_t rs = 0;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = bench_zalloc;
+    stream.zfree = bench_zfree;
+    if (deflateInit2(&stream, 6, Z_DEFLATED, -12, 4, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return 0;
+    }
+
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    stream.next_out = out;
+    stream.avail_out = sizeof(out);
+    if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
+        rs = stream.total_out;
+    }
+    deflateEnd(&stream);
+
+    return rs;
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 10000);
+    bench_heap_t heap;
+    duer_u8_t *deflated = NULL;
+    duer_u8_t *inflated = NULL;
+    duer_size_t deflated_size = 0;
+    duer_size_t inflated_size = 0;
+    size_t total = 0;
+    size_t total_deflated = 0;
+    size_t total_plain = 0;
+    double deflate_sum = 0;
+    double inflate_sum = 0;
+    double start;
+    double deflate_time;
+    double inflate_time;
+    size_t size;
+    size_t plain;
+    size_t i;
+    long j;
+    int bad = 0;
+
+    bench_init(0);
+
+    bench_heap_reset();
+    if (duer_report_deflate_init() != DUER_OK) {
+        BENCH_PRINT("duer_report_deflate_init failed\n");
+        return 1;
+    }
+    bench_heap_get(&heap);
+    BENCH_PRINT("compressor: %lld bytes kept, %lld bytes peak\n", heap.in_use, heap.peak);
+
+    for (i = 0; i < PAYLOAD_COUNTS; i++) {
+        size = strlen(s_payloads[i].data);
+        plain = bench_plain(s_payloads[i].data, size);
+
+        if (duer_report_deflate(s_payloads[i].data, size, &deflated, &deflated_size) != DUER_OK) {
+            // sent as is
+            deflated = NULL;
+            deflated_size = size;
+        }
+
+        bench_heap_reset();
+        start = bench_now();
+        for (j = 0; j < count; j++) {
+            duer_u8_t *out = NULL;
+            duer_size_t out_size = 0;
+            if (duer_report_deflate(s_payloads[i].data, size, &out, &out_size) == DUER_OK) {
+                DUER_FREE(out);
+            }
+        }
+        deflate_time = (bench_now() - start) / count;
+        bench_heap_get(&heap);
+
+        inflate_time = 0;
+        if (deflated) {
+            start = bench_now();
+            for (j = 0; j < count; j++) {
+                if (duer_report_inflate(deflated, deflated_size, &inflated, &inflated_size)
+                        != DUER_OK) {
+                    bad++;
+                    break;
+                }
+                if (j + 1 < count) {
+                    DUER_FREE(inflated);
+                }
+            }
+            inflate_time = (bench_now() - start) / count;
+
+            if (inflated_size != size || memcmp(inflated, s_payloads[i].data, size) != 0) {
+                bad++;
+            }
+            DUER_FREE(inflated);
+            DUER_FREE(deflated);
+        }
+
+        BENCH_PRINT("%-22s %4zu bytes => %4zu (%5.1f%%), %4zu without the dictionary (%5.1f%%), "
+                    "deflate %6.2f us, %.1f mallocs, inflate %6.2f us\n",
+                    s_payloads[i].name, size, (size_t)deflated_size,
+                    100.0 * deflated_size / size, plain, 100.0 * plain / size,
+                    deflate_time * 1e6, (double)heap.mallocs / count, inflate_time * 1e6);
+
+        total += size;
+        total_deflated += deflated_size;
+        total_plain += plain;
+        deflate_sum += deflate_time;
+        inflate_sum += inflate_time;
+    }
+
+    BENCH_PRINT("all %zu payloads: %zu bytes => %zu (%.1f%%), %zu without the dictionary (%.1f%%), "
+                "deflate %.2f us, inflate %.2f us per payload on average, %s\n",
+                PAYLOAD_COUNTS, total, total_deflated, 100.0 * total_deflated / total,
+                total_plain, 100.0 * total_plain / total,
+                deflate_sum * 1e6 / PAYLOAD_COUNTS, inflate_sum * 1e6 / PAYLOAD_COUNTS,
+                bad == 0 ? "ok" : "WRONG");
+
+    duer_report_deflate_release();
+
+    return 0;
+}
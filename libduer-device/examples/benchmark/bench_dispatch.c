@@ -0,0 +1,248 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_dispatch.c
+ * Desc: The CoAP requests dispatched to the dynamic resources, through
+ *       duer_coap_data_available and a transport in memory (every recv is
+ *       one NON GET datagram, the responses are dropped). Report the time
+ *       to add the resources, and the time per request dispatched, by the
+ *       resources registered. The paths are checked in the resource handler,
+ *       and after the half of the resources removed, only the others should
+ *       be dispatched.
+ *
+ *   bench-dispatch [-requests 1000000] [-resources 500]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_common.h"
+#include "lightduer_coap.h"
+#include "lightduer_net_transport.h"
+
+#define BENCH_PATH_MAX      (32)
+#define BENCH_PACKET_MAX    (48)
+
+typedef struct _bench_request_s {
+    unsigned char   packet[BENCH_PACKET_MAX];
+    size_t          size;
+    const char*     path;
+} bench_request_t;
+
+static char (*s_paths)[BENCH_PATH_MAX] = NULL;
+static bench_request_t *s_requests = NULL;
+static long s_next = 0;
+static long s_count = 0;
+static long s_dispatched = 0;
+static long s_bad = 0;
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static duer_socket_t bench_soc_create(duer_transevt_func func)
+{
+    return (duer_socket_t)&s_next;
+}
+
+static duer_status_t bench_soc_connect(duer_socket_t sock, const duer_addr_t *addr)
+{
+    return DUER_OK;
+}
+
+static duer_status_t bench_soc_send(duer_socket_t sock, const void *data, duer_size_t size,
+                                    const duer_addr_t *addr)
+{
+    return size;
+}
+
+static duer_status_t bench_soc_recv(duer_socket_t sock, void *data, duer_size_t size,
+                                    duer_addr_t *addr)
+{
+    const bench_request_t *req = &s_requests[s_next % s_count];
+
+    memcpy(data, req->packet, req->size);
+    return req->size;
+}
+
+static duer_status_t bench_soc_close(duer_socket_t sock)
+{
+    return DUER_OK;
+}
+
+static duer_status_t bench_soc_destroy(duer_socket_t sock)
+{
+    return DUER_OK;
+}
+
+static duer_status_t bench_res(duer_context ctx, duer_msg_t *msg, duer_addr_t *addr)
+{
+    const char *path = s_requests[s_next % s_count].path;
+
+    if (msg->path_len != strlen(path) || memcmp(msg->path, path, msg->path_len) != 0) {
+        s_bad++;
+    }
+    s_dispatched++;
+
+    return DUER_OK;
+}
+
+static void bench_path(char *path, long i)
+{
+    // as the control points, a few prefixes with the numbered names
+    static const char *prefixes[] = {"duer/ctrl", "duer/state", "dev/attr", "alert"};
+
+    snprintf(path, BENCH_PATH_MAX, "%s/p%ld", prefixes[i % 4], i);
+}
+
+/*
+ * A NON GET request, the path segments as the Uri-Path options
+ */
+static size_t bench_packet(unsigned char *buf, duer_u16_t msg_id, const char *path)
+{
+    unsigned char *p = buf;
+    const char *seg = path;
+    const char *end;
+    size_t len;
+    int first = 1;
+
+    *p++ = 0x50;    // version 1, NON, no token
+    *p++ = 0x01;    // GET
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+
+    while (*seg) {
+        end = strchr(seg, '/');
+        len = end ? (size_t)(end - seg) : strlen(seg);
+        *p++ = ((first ? 11 : 0) << 4) | len;   // Uri-Path, the segments < 13 bytes
+        memcpy(p, seg, len);
+        p += len;
+        seg += len + (end ? 1 : 0);
+        first = 0;
+    }
+
+    return p - buf;
+}
+
+static void bench_run(long resources, long requests)
+{
+    duer_coap_handler coap;
+    duer_addr_t addr;
+    duer_res_t res;
+    double start;
+    double add;
+    double elapsed;
+    long dispatched;
+    long i;
+
+    coap = duer_coap_acquire(NULL, NULL, NULL, NULL);
+    if (!coap) {
+        BENCH_PRINT("duer_coap_acquire failed\n");
+        exit(1);
+    }
+
+    addr.type = DUER_PROTO_UDP;
+    addr.port = 5683;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+    duer_coap_connect(coap, &addr, NULL, 0);
+
+    memset(&res, 0, sizeof(res));
+    res.mode = DUER_RES_MODE_DYNAMIC;
+    res.allowed = DUER_RES_OP_GET;
+    res.res.f_res = bench_res;
+
+    start = bench_now();
+    for (i = 0; i < resources; i++) {
+        res.path = s_paths[i];
+        if (duer_coap_resource_add(coap, &res) != DUER_OK) {
+            BENCH_PRINT("duer_coap_resource_add %s failed\n", s_paths[i]);
+            exit(1);
+        }
+    }
+    add = bench_now() - start;
+
+    // every resource in turn, as the requests spread over them
+    s_count = resources;
+    for (i = 0; i < resources; i++) {
+        s_requests[i].path = s_paths[(i * 7919) % resources];
+        s_requests[i].size = bench_packet(s_requests[i].packet, (duer_u16_t)i,
+                                          s_requests[i].path);
+    }
+
+    s_dispatched = 0;
+    s_bad = 0;
+    start = bench_now();
+    for (s_next = 0; s_next < requests; s_next++) {
+        duer_coap_data_available(coap);
+    }
+    elapsed = bench_now() - start;
+
+    for (i = 0; i < resources; i += 2) {
+        duer_coap_resource_remove(coap, s_paths[i]);
+    }
+
+    dispatched = s_dispatched;
+    for (s_next = 0; s_next < resources; s_next++) {
+        duer_coap_data_available(coap);
+    }
+    dispatched = s_dispatched - dispatched;
+
+    duer_coap_release(coap);
+
+    BENCH_PRINT("%4ld resources: add %7.2f us each, %8ld requests dispatched (%ld wrong), "
+                "%7.1f ns per request, %ld left after removed %s\n",
+                resources, add * 1e6 / resources, s_dispatched - dispatched, s_bad,
+                elapsed * 1e9 / requests, dispatched,
+                dispatched == resources / 2 ? "ok" : "WRONG");
+}
+
+int main(int argc, char* argv[])
+{
+    static const long counts[] = {10, 100, 500, 2000};
+    long requests = bench_arg(argc, argv, "requests", 1000000);
+    long resources = bench_arg(argc, argv, "resources", 500);
+    long most = resources;
+    size_t i;
+
+    bench_init(bench_arg(argc, argv, "verbose", 0));
+    baidu_ca_transport_init(bench_soc_create, bench_soc_connect, bench_soc_send,
+                            bench_soc_recv, NULL, bench_soc_close, bench_soc_destroy);
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        if (counts[i] > most) {
+            most = counts[i];
+        }
+    }
+
+    s_paths = malloc(most * sizeof(*s_paths));
+    s_requests = malloc(most * sizeof(*s_requests));
+    for (i = 0; i < (size_t)most; i++) {
+        bench_path(s_paths[i], (long)i);
+    }
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        if (counts[i] != resources) {
+            bench_run(counts[i], requests / 10);
+        }
+    }
+    bench_run(resources, requests);
+
+    free(s_paths);
+    free(s_requests);
+    return 0;
+}
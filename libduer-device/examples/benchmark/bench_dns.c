@@ -0,0 +1,414 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_dns.c
+ * Desc: The shared resolver against a local stub name server, which answers
+ *       "hostN.bench" with 10.0.0.N and the others with NXDOMAIN, each after
+ *       the rtt. The connections of the SDK resolve a few hosts over and over,
+ *       compare with getaddrinfo (uncached) when the stub could take port 53
+ *       of 127.0.0.1, the name server of /etc/resolv.conf here.
+ *
+ *   bench-dns [-hosts 4] [-lookups 400] [-rtt 20] [-ttl 300] [-threads 8]
+ */
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_dns.h"
+#include "lightduer_net_transport.h"
+#include "lightduer_sleep.h"
+
+#define STUB_PENDING_MAX    (64)
+
+typedef struct _stub_reply_s {
+    double              due;
+    struct sockaddr_in  peer;
+    int                 len;
+    unsigned char       buf[512];
+} stub_reply_t;
+
+static int s_stub_fd = -1;
+static int s_stub_port = 0;
+static long s_rtt = 20;
+static long s_ttl = 300;
+static volatile int s_stub_queries = 0;
+static stub_reply_t s_replies[STUB_PENDING_MAX];
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_sleep(duer_u32_t ms)
+{
+    usleep(ms * 1000);
+}
+
+/*
+ * Answer the query in buf, return the response length or 0 to drop it
+ */
+static int stub_answer(unsigned char *buf, int len)
+{
+    static const unsigned char soa[] = {
+        0xC0, 0x0C, 0x00, 0x06, 0x00, 0x01, 0x00, 0x00, 0x0E, 0x10, 0x00, 0x16,
+        0x00, 0x00,
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x00, 0x00, 0x1E                          // MINIMUM 30s
+    };
+    char name[256];
+    int pos = 12;
+    int n = 0;
+    int host = 0;
+    unsigned short type = 0;
+
+    if (len < 12) {
+        return 0;
+    }
+
+    while (pos < len && buf[pos] != 0 && n + buf[pos] + 1 < (int)sizeof(name)) {
+        if (n > 0) {
+            name[n++] = '.';
+        }
+        memcpy(name + n, buf + pos + 1, buf[pos]);
+        n += buf[pos];
+        pos += buf[pos] + 1;
+    }
+    name[n] = '\0';
+    pos += 1;
+    if (pos + 4 > len) {
+        return 0;
+    }
+    type = (buf[pos] << 8) | buf[pos + 1];
+    pos += 4;
+
+    // QR, RD, RA, only the question kept
+    buf[2] = 0x81;
+    buf[3] = 0x80;
+    memset(buf + 6, 0, 6);
+
+    if (sscanf(name, "host%d.bench", &host) != 1) {
+        buf[3] |= 0x03;
+        buf[9] = 1;
+        memcpy(buf + pos, soa, sizeof(soa));
+        return pos + sizeof(soa);
+    }
+
+    if (type == DUER_DNS_TYPE_A) {
+        unsigned char rr[] = {
+            0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01,
+            (unsigned char)(s_ttl >> 24), (unsigned char)(s_ttl >> 16),
+            (unsigned char)(s_ttl >> 8), (unsigned char)s_ttl,
+            0x00, 0x04, 10, 0, 0, (unsigned char)host
+        };
+        buf[7] = 1;
+        memcpy(buf + pos, rr, sizeof(rr));
+        return pos + sizeof(rr);
+    }
+
+    // no other records
+    return pos;
+}
+
+static void *stub_server(void *arg)
+{
+    struct pollfd pfd;
+    socklen_t peer_len;
+    double now;
+    double next;
+    int timeout;
+    int i;
+
+    pfd.fd = s_stub_fd;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        now = bench_now();
+        next = 0;
+        for (i = 0; i < STUB_PENDING_MAX; i++) {
+            if (s_replies[i].len <= 0) {
+                continue;
+            }
+            if (s_replies[i].due <= now) {
+                sendto(s_stub_fd, s_replies[i].buf, s_replies[i].len, 0,
+                       (struct sockaddr *)&s_replies[i].peer, sizeof(s_replies[i].peer));
+                s_replies[i].len = 0;
+            } else if (next == 0 || s_replies[i].due < next) {
+                next = s_replies[i].due;
+            }
+        }
+
+        timeout = next == 0 ? -1 : (int)((next - now) * 1000) + 1;
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+
+        for (i = 0; i < STUB_PENDING_MAX && s_replies[i].len > 0; i++) {
+        }
+        if (i == STUB_PENDING_MAX) {
+            continue;
+        }
+        peer_len = sizeof(s_replies[i].peer);
+        s_replies[i].len = recvfrom(s_stub_fd, s_replies[i].buf, sizeof(s_replies[i].buf), 0,
+                                    (struct sockaddr *)&s_replies[i].peer, &peer_len);
+        if (s_replies[i].len > 0) {
+            __atomic_add_fetch(&s_stub_queries, 1, __ATOMIC_RELAXED);
+            s_replies[i].len = stub_answer(s_replies[i].buf, s_replies[i].len);
+            s_replies[i].due = bench_now() + s_rtt / 1000.0;
+        }
+    }
+
+    return NULL;
+}
+
+static void stub_start(void)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    pthread_t thread;
+
+    s_stub_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_port = htons(53);
+    inet_pton(AF_INET, "127.0.0.1", &addr_in.sin_addr);
+    if (bind(s_stub_fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0) {
+        addr_in.sin_port = 0;
+        bind(s_stub_fd, (struct sockaddr *)&addr_in, sizeof(addr_in));
+    }
+    getsockname(s_stub_fd, (struct sockaddr *)&addr_in, &len);
+    s_stub_port = ntohs(addr_in.sin_port);
+
+    pthread_create(&thread, NULL, stub_server, NULL);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double l = *(const double *)a;
+    double r = *(const double *)b;
+
+    return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+static void print_latency(const char *name, double *samples, long count, int queries)
+{
+    double sum = 0;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    qsort(samples, count, sizeof(double), compare_double);
+
+    BENCH_PRINT("%-12s avg %8.3f ms, p50 %8.3f ms, p99 %8.3f ms, max %8.3f ms, "
+                "queries %d, total %.2f s\n",
+                name, sum / count * 1000, samples[count / 2] * 1000,
+                samples[count * 99 / 100] * 1000, samples[count - 1] * 1000,
+                queries, sum);
+}
+
+static void bench_getaddrinfo(long hosts, long lookups, double *samples)
+{
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    char host[32];
+    double start;
+    int queries = s_stub_queries;
+    long i;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    for (i = 0; i < lookups; i++) {
+        snprintf(host, sizeof(host), "host%ld.bench", i % hosts + 1);
+        start = bench_now();
+        if (getaddrinfo(host, NULL, &hints, &res) == 0) {
+            freeaddrinfo(res);
+        } else {
+            BENCH_PRINT("getaddrinfo %s failed\n", host);
+        }
+        samples[i] = bench_now() - start;
+    }
+
+    print_latency("getaddrinfo", samples, lookups, s_stub_queries - queries);
+}
+
+static void bench_resolve(long hosts, long lookups, double *samples)
+{
+    duer_dns_result_t result;
+    duer_dns_stats_t stats;
+    char host[32];
+    double start;
+    int queries = s_stub_queries;
+    long i;
+
+    duer_dns_flush();
+
+    for (i = 0; i < lookups; i++) {
+        snprintf(host, sizeof(host), "host%ld.bench", i % hosts + 1);
+        start = bench_now();
+        if (duer_dns_resolve(host, &result) != DUER_OK) {
+            BENCH_PRINT("duer_dns_resolve %s failed\n", host);
+        }
+        samples[i] = bench_now() - start;
+    }
+
+    print_latency("duer_dns", samples, lookups, s_stub_queries - queries);
+
+    duer_dns_get_stats(&stats);
+    BENCH_PRINT("             lookups %u, hits %u, misses %u, hit rate %.1f%%\n",
+                stats.lookups, stats.hits, stats.misses,
+                stats.lookups ? 100.0 * stats.hits / stats.lookups : 0);
+}
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static double s_done_at = 0;
+
+static void lookup_callback(duer_status_t status, const char *host,
+                            const duer_dns_result_t *result, void *ctx)
+{
+    pthread_mutex_lock(&s_mutex);
+    s_done_at = bench_now();
+    pthread_cond_broadcast(&s_cond);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static void bench_lookup(void)
+{
+    double start;
+    double blocked;
+    int queries = s_stub_queries;
+    int rs;
+
+    start = bench_now();
+    rs = duer_dns_lookup("host100.bench", lookup_callback, NULL);
+    blocked = bench_now() - start;
+
+    pthread_mutex_lock(&s_mutex);
+    while (rs == DUER_ERR_TRANS_WOULD_BLOCK && s_done_at == 0) {
+        pthread_cond_wait(&s_cond, &s_mutex);
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    BENCH_PRINT("lookup       rs %d, caller blocked %.3f ms, answered after %.2f ms, queries %d\n",
+                rs, blocked * 1000, (s_done_at - start) * 1000, s_stub_queries - queries);
+}
+
+static void *resolve_thread(void *arg)
+{
+    duer_dns_result_t result;
+
+    duer_dns_resolve((const char *)arg, &result);
+
+    return NULL;
+}
+
+static void bench_storm(long threads)
+{
+    pthread_t ids[64];
+    duer_dns_stats_t before;
+    duer_dns_stats_t after;
+    double start = bench_now();
+    int queries = s_stub_queries;
+    long i;
+
+    duer_dns_get_stats(&before);
+    for (i = 0; i < threads && i < 64; i++) {
+        pthread_create(&ids[i], NULL, resolve_thread, "host200.bench");
+    }
+    for (i = 0; i < threads && i < 64; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    duer_dns_get_stats(&after);
+
+    BENCH_PRINT("storm        %ld threads on one cold host: %.2f ms, joined %u, queries %d\n",
+                threads, (bench_now() - start) * 1000,
+                after.joined - before.joined, s_stub_queries - queries);
+}
+
+static void bench_negative(long lookups)
+{
+    duer_dns_result_t result;
+    duer_dns_stats_t before;
+    duer_dns_stats_t after;
+    double start = bench_now();
+    int queries = s_stub_queries;
+    int failed = 0;
+    long i;
+
+    duer_dns_get_stats(&before);
+    for (i = 0; i < lookups; i++) {
+        if (duer_dns_resolve("nx.bench", &result) == DUER_ERR_FAILED) {
+            failed++;
+        }
+    }
+    duer_dns_get_stats(&after);
+
+    BENCH_PRINT("negative     %ld lookups of nx.bench: %d not found, negative hits %u, "
+                "queries %d, total %.2f ms\n",
+                lookups, failed, after.negative_hits - before.negative_hits,
+                s_stub_queries - queries, (bench_now() - start) * 1000);
+}
+
+int main(int argc, char* argv[])
+{
+    long hosts = bench_arg(argc, argv, "hosts", 4);
+    long lookups = bench_arg(argc, argv, "lookups", 400);
+    long threads = bench_arg(argc, argv, "threads", 8);
+    double *samples = NULL;
+
+    s_rtt = bench_arg(argc, argv, "rtt", 20);
+    s_ttl = bench_arg(argc, argv, "ttl", 300);
+    samples = (double *)malloc(sizeof(double) * lookups);
+
+    bench_init(0);
+    baidu_ca_sleep_init(bench_sleep);
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+
+    stub_start();
+    duer_dns_initialize();
+    duer_dns_add_server("127.0.0.1", s_stub_port);
+
+    BENCH_PRINT("stub name server on port %d, rtt %ld ms, ttl %ld s, %ld hosts, %ld lookups\n",
+                s_stub_port, s_rtt, s_ttl, hosts, lookups);
+
+    if (s_stub_port == 53) {
+        bench_getaddrinfo(hosts, lookups, samples);
+    } else {
+        BENCH_PRINT("getaddrinfo  skipped, port 53 is taken\n");
+    }
+    bench_resolve(hosts, lookups, samples);
+    bench_lookup();
+    bench_storm(threads);
+    bench_negative(lookups);
+
+    free(samples);
+
+    return 0;
+}
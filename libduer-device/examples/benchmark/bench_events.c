@@ -0,0 +1,136 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_events.c
+ * Desc: Post the no-op events to the linux events looper,
+ *       report the events per second and the malloc calls per event.
+ *
+ *   bench-events [-count 2000000] [-queue 10] [-producers 1] [-window 0]
+ *
+ *   -window N keeps at most N events pending, 0 means post as fast as possible
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "bench_common.h"
+#include "lightduer_events.h"
+
+typedef struct _bench_producer_s {
+    pthread_t           thread;
+    duer_events_handler events;
+    long                count;
+} bench_producer_t;
+
+static pthread_mutex_t s_done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_done_cond = PTHREAD_COND_INITIALIZER;
+static long s_handled = 0;
+static long s_expected = 0;
+static long s_posted = 0;
+static long s_window = 0;
+
+static void bench_noop(int what, void *object)
+{
+    if (__atomic_add_fetch(&s_handled, 1, __ATOMIC_RELAXED) == s_expected) {
+        pthread_mutex_lock(&s_done_mutex);
+        pthread_cond_signal(&s_done_cond);
+        pthread_mutex_unlock(&s_done_mutex);
+    }
+}
+
+static void *bench_producer(void *arg)
+{
+    bench_producer_t *producer = (bench_producer_t *)arg;
+    long i;
+
+    for (i = 0; i < producer->count; i++) {
+        while (s_window > 0 && __atomic_load_n(&s_posted, __ATOMIC_RELAXED)
+                - __atomic_load_n(&s_handled, __ATOMIC_RELAXED) >= s_window) {
+            sched_yield();
+        }
+        __atomic_add_fetch(&s_posted, 1, __ATOMIC_RELAXED);
+        while (duer_events_call(producer->events, bench_noop, (int)i, NULL) != DUER_OK) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 2000000);
+    long queue = bench_arg(argc, argv, "queue", 10);
+    long producers = bench_arg(argc, argv, "producers", 1);
+    long window = bench_arg(argc, argv, "window", 0);
+    bench_producer_t workers[16];
+    duer_events_handler events = NULL;
+    duer_events_stats_t stats;
+    unsigned long mallocs;
+    double start;
+    double elapsed;
+    long i;
+
+    bench_init(0);
+
+    if (producers < 1 || producers > 16) {
+        producers = 1;
+    }
+
+    events = duer_events_create("bench_events", 0, queue);
+    if (events == NULL) {
+        return 1;
+    }
+
+    s_expected = count / producers * producers;
+    s_window = window;
+
+    mallocs = bench_malloc_counts();
+    start = bench_now();
+    for (i = 0; i < producers; i++) {
+        workers[i].events = events;
+        workers[i].count = count / producers;
+        pthread_create(&workers[i].thread, NULL, bench_producer, &workers[i]);
+    }
+    for (i = 0; i < producers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    pthread_mutex_lock(&s_done_mutex);
+    while (__atomic_load_n(&s_handled, __ATOMIC_RELAXED) != s_expected) {
+        pthread_cond_wait(&s_done_cond, &s_done_mutex);
+    }
+    pthread_mutex_unlock(&s_done_mutex);
+    elapsed = bench_now() - start;
+
+    BENCH_PRINT("queue %ld, window %ld, %ld producers: %.2f Mevents/s, %.2f mallocs/event\n",
+                queue, window, producers, s_expected / elapsed / 1e6,
+                (double)(bench_malloc_counts() - mallocs) / s_expected);
+
+    if (duer_events_get_stats("bench_events", &stats) == DUER_OK && stats.func_count > 0) {
+        BENCH_PRINT("max depth %zu, wait p50 %u us p99 %u us max %u us, exec p99 %u us\n",
+                    stats.max_depth,
+                    duer_events_hist_percentile(stats.funcs[0].wait_hist, 50,
+                                                stats.funcs[0].wait_max),
+                    duer_events_hist_percentile(stats.funcs[0].wait_hist, 99,
+                                                stats.funcs[0].wait_max),
+                    stats.funcs[0].wait_max,
+                    duer_events_hist_percentile(stats.funcs[0].exec_hist, 99,
+                                                stats.funcs[0].exec_max));
+    }
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_memory.c
+ * Desc: Soak the memory management with the allocation pattern of the SDK,
+ *       report the allocations per second and the heap fragmentation.
+ *
+ *   bench-memory [-seconds 86400] [-slots 4096] [-seed 1] [-report 60] [-threads 1]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include "bench_common.h"
+#include "lightduer_memory.h"
+
+typedef struct _bench_slot_s {
+    void*       ptr;
+    duer_size_t size;
+} bench_slot_t;
+
+typedef struct _bench_worker_s {
+    pthread_t           thread;
+    bench_slot_t*       table;
+    long                slots;
+    double              seconds;
+    double              report;
+    unsigned int        seed;
+    unsigned long long  ops;
+    unsigned long long  failed;
+} bench_worker_t;
+
+static unsigned int bench_rand(unsigned int* seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 8) & 0xFFFFFF;
+}
+
+/*
+ * The size mix seen in the SDK hot paths: queue nodes and event messages,
+ * json nodes and strings, CoAP frames and the AES padding buffers,
+ * with a few large blocks such as the voice data.
+ */
+static duer_size_t bench_pick_size(unsigned int* seed)
+{
+    unsigned int r = bench_rand(seed) % 100;
+
+    if (r < 30) {
+        return 8 + bench_rand(seed) % 24;           // qcache node, event message
+    } else if (r < 60) {
+        return 32 + bench_rand(seed) % 96;          // json node, short strings
+    } else if (r < 80) {
+        return 128 + bench_rand(seed) % 128;        // json strings, coap header
+    } else if (r < 95) {
+        return 256 + bench_rand(seed) % 1792;       // coap frame, aes buffer
+    } else {
+        return 2048 + bench_rand(seed) % 6144;      // voice data, report payload
+    }
+}
+
+static void bench_heap(const char* tag)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    double frag = mi.arena ? (double)mi.fordblks / mi.arena : 0;
+    BENCH_PRINT("%s heap: arena=%zu in_use=%zu free=%zu fragmentation=%.2f%%\n",
+                tag, mi.arena, mi.uordblks, mi.fordblks, frag * 100);
+#else
+    BENCH_PRINT("%s heap: mallinfo2 not available\n", tag);
+#endif
+}
+
+static void bench_pool(void)
+{
+#ifdef DUER_MEMORY_POOL
+    duer_mempool_stats_t stats;
+    size_t slab_bytes = 0;
+    size_t used_bytes = 0;
+    int i;
+
+    if (duer_mempool_get_stats(&stats) != DUER_OK) {
+        return;
+    }
+
+    for (i = 0; i < DUER_MEMPOOL_CLASS_NUM; i++) {
+        BENCH_PRINT("  class %4zu: hits=%u misses=%u in_use=%u high_water=%u slabs=%u\n",
+                    (size_t)stats.classes[i].size, stats.classes[i].hits,
+                    stats.classes[i].misses, stats.classes[i].in_use,
+                    stats.classes[i].high_water, stats.classes[i].slabs);
+        slab_bytes += (size_t)stats.classes[i].slabs * DUER_MEMPOOL_SLAB_SIZE;
+        used_bytes += (size_t)stats.classes[i].in_use * stats.classes[i].size;
+    }
+    BENCH_PRINT("  large: live=%u total=%u, pool slab=%zu used=%zu\n",
+                stats.large_counts, stats.large_total, slab_bytes, used_bytes);
+#endif
+}
+
+static void bench_profile(void)
+{
+#ifdef DUER_MEMORY_PROFILE
+    duer_memprof_site_t sites[5];
+    int counts = duer_memprof_snapshot(sites, 5);
+    int i;
+
+    for (i = 0; i < counts; i++) {
+        BENCH_PRINT("  site %s:%u live=%zu(%u) peak=%zu allocs=%u frees=%u\n",
+                    sites[i].file, sites[i].line, (size_t)sites[i].live_bytes,
+                    sites[i].live_counts, (size_t)sites[i].peak_bytes,
+                    sites[i].allocs, sites[i].frees);
+    }
+#endif
+}
+
+static void* bench_worker(void* arg)
+{
+    bench_worker_t* worker = (bench_worker_t*)arg;
+    double start = bench_now();
+    double last = start;
+    double now;
+    long i;
+
+    do {
+        for (i = 0; i < 4096; i++) {
+            bench_slot_t* slot = &worker->table[bench_rand(&worker->seed) % worker->slots];
+
+            if (slot->ptr) {
+                if (bench_rand(&worker->seed) % 8 == 0) {
+                    slot->size = bench_pick_size(&worker->seed);
+                    void* p = DUER_REALLOC(slot->ptr, slot->size);
+                    if (p) {
+                        slot->ptr = p;
+                        memset(slot->ptr, 0x5A, slot->size);
+                    } else {
+                        worker->failed++;
+                    }
+                    worker->ops++;
+                    continue;
+                }
+                DUER_FREE(slot->ptr);
+                slot->ptr = NULL;
+            }
+
+            slot->size = bench_pick_size(&worker->seed);
+            slot->ptr = DUER_MALLOC(slot->size);
+            if (slot->ptr) {
+                memset(slot->ptr, 0xA5, slot->size);
+            } else {
+                worker->failed++;
+            }
+            worker->ops++;
+        }
+
+        now = bench_now();
+        if (worker->report > 0 && now - last >= worker->report) {
+            BENCH_PRINT("[%8.0fs] %.0f allocs/sec\n", now - start, worker->ops / (now - start));
+            bench_heap("         ");
+            last = now;
+        }
+    } while (now - start < worker->seconds);
+
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    long seconds = bench_arg(argc, argv, "seconds", 10);
+    long slots = bench_arg(argc, argv, "slots", 4096);
+    long report = bench_arg(argc, argv, "report", 60);
+    long threads = bench_arg(argc, argv, "threads", 1);
+    unsigned int seed = (unsigned int)bench_arg(argc, argv, "seed", 1);
+    bench_worker_t* workers = NULL;
+    unsigned long long ops = 0;
+    unsigned long long failed = 0;
+    double start;
+    double now;
+    long i;
+    long j;
+
+    bench_init(0);
+
+    workers = calloc(threads, sizeof(*workers));
+    if (workers == NULL) {
+        return 1;
+    }
+
+#ifdef DUER_MEMORY_POOL
+    BENCH_PRINT("bench-memory: pool enabled, slab = %d, threads = %ld\n",
+                DUER_MEMPOOL_SLAB_SIZE, threads);
+#else
+    BENCH_PRINT("bench-memory: pool disabled, threads = %ld\n", threads);
+#endif
+
+    start = bench_now();
+
+    for (i = 0; i < threads; i++) {
+        workers[i].table = calloc(slots, sizeof(bench_slot_t));
+        workers[i].slots = slots;
+        workers[i].seconds = seconds;
+        workers[i].report = i == 0 ? report : 0;
+        workers[i].seed = seed + i;
+        pthread_create(&workers[i].thread, NULL, bench_worker, &workers[i]);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        ops += workers[i].ops;
+        failed += workers[i].failed;
+    }
+
+    now = bench_now();
+
+    BENCH_PRINT("result: %llu allocs in %.1fs, %.0f allocs/sec, %llu failed\n",
+                ops, now - start, ops / (now - start), failed);
+    bench_heap("steady");
+    bench_pool();
+    bench_profile();
+
+    for (i = 0; i < threads; i++) {
+        for (j = 0; j < slots; j++) {
+            if (workers[i].table[j].ptr) {
+                DUER_FREE(workers[i].table[j].ptr);
+            }
+        }
+        free(workers[i].table);
+    }
+    free(workers);
+
+    bench_heap("drained");
+    bench_pool();
+    bench_profile();
+
+    return 0;
+}
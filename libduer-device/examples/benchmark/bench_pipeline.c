@@ -0,0 +1,363 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_pipeline.c
+ * Desc: The confirmable reports pipelined by the in-flight window (NSTART),
+ *       through a local stand-in server over TCP that answers every CON by
+ *       the piggybacked ACK after the emulated RTT, give or take 20%, so the
+ *       ACKs come out of order. The client sends as the engine does (again
+ *       on DUER_ERR_TRANS_WOULD_BLOCK once DUER_TEVT_SEND_RDY), and checks
+ *       the answers come to f_result in the order sent. Report the messages
+ *       answered per second, by the RTT and the window.
+ *
+ *   bench-pipeline [-seconds 2] [-size 100]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_coap.h"
+
+#define BENCH_COAP_TCP_HDR      (0xbeefdead)
+#define BENCH_PACKET_MAX        (2048)
+#define BENCH_PENDING_MAX       (256)
+#define BENCH_ACK_MAX           (24)
+
+typedef struct _bench_pending_s {
+    double          due;
+    size_t          size;
+    unsigned char   packet[BENCH_ACK_MAX];
+} bench_pending_t;
+
+typedef struct _bench_server_s {
+    int             fd;
+    double          rtt;
+    bench_pending_t pending[BENCH_PENDING_MAX];
+    int             count;
+    long            received;
+    long            reordered;  // the ACKs sent before an earlier request's
+    duer_u32_t      last;       // the sequence of the last ACK sent
+} bench_server_t;
+
+typedef struct _bench_client_s {
+    long            answered;
+    long            bad;        // not in the order sent, or not the ACK
+    volatile int    ready;      // DUER_TEVT_SEND_RDY since the last send
+} bench_client_t;
+
+static bench_client_t *s_client = NULL;
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+    if (event == DUER_TEVT_SEND_RDY && s_client) {
+        s_client->ready = 1;
+    }
+}
+
+static duer_u32_t bench_sequence(const unsigned char *token)
+{
+    return ((duer_u32_t)token[0] << 24) | (token[1] << 16) | (token[2] << 8) | token[3];
+}
+
+static duer_status_t bench_result(duer_context ctx, duer_coap_handler hdlr,
+                                  const duer_msg_t *msg, const duer_addr_t *addr)
+{
+    bench_client_t *client = (bench_client_t *)ctx;
+
+    if (msg->msg_type != DUER_MSG_TYPE_ACKNOWLEDGEMENT || msg->token_len != 4
+            || bench_sequence(msg->token) != (duer_u32_t)client->answered) {
+        client->bad++;
+    }
+    client->answered++;
+
+    return DUER_OK;
+}
+
+/*
+ * Answer the CON by the piggybacked 2.04 after the RTT, 0.8 to 1.2 of it
+ */
+static void bench_serve(bench_server_t *server, const unsigned char *packet, long size)
+{
+    bench_pending_t *p;
+    int token_len = packet[0] & 0x0f;
+
+    server->received++;
+    if (server->count >= BENCH_PENDING_MAX || token_len != 4 || size < 8) {
+        return;
+    }
+
+    p = &server->pending[server->count++];
+    p->due = bench_now() + server->rtt * (0.8 + 0.4 * rand() / RAND_MAX);
+    p->size = 8 + 4 + token_len;
+    p->packet[0] = (BENCH_COAP_TCP_HDR >> 24) & 0xff;
+    p->packet[1] = (BENCH_COAP_TCP_HDR >> 16) & 0xff;
+    p->packet[2] = (BENCH_COAP_TCP_HDR >> 8) & 0xff;
+    p->packet[3] = BENCH_COAP_TCP_HDR & 0xff;
+    p->packet[4] = 0;
+    p->packet[5] = 0;
+    p->packet[6] = 0;
+    p->packet[7] = 4 + token_len;
+    p->packet[8] = 0x60 | token_len;    // ACK
+    p->packet[9] = 0x44;                // 2.04
+    p->packet[10] = packet[2];          // the message id of the request
+    p->packet[11] = packet[3];
+    memcpy(p->packet + 12, packet + 4, token_len);
+}
+
+/*
+ * Send the ACKs due, the earliest first
+ *
+ * @Return the milliseconds till the next one due, -1 if none
+ */
+static int bench_answer(bench_server_t *server)
+{
+    double now = bench_now();
+    duer_u32_t sequence;
+    int next;
+    int i;
+
+    for (;;) {
+        next = -1;
+        for (i = 0; i < server->count; i++) {
+            if (next < 0 || server->pending[i].due < server->pending[next].due) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            return -1;
+        }
+        if (server->pending[next].due > now) {
+            return (int)((server->pending[next].due - now) * 1000) + 1;
+        }
+
+        sequence = bench_sequence(server->pending[next].packet + 12);
+        if (sequence < server->last) {
+            server->reordered++;
+        }
+        server->last = sequence;
+        write(server->fd, server->pending[next].packet, server->pending[next].size);
+        server->pending[next] = server->pending[--server->count];
+    }
+}
+
+static void *bench_server(void *arg)
+{
+    bench_server_t *server = (bench_server_t *)arg;
+    size_t cap = 64 * 1024;
+    unsigned char *buf = malloc(cap);
+    size_t have = 0;
+    size_t used;
+    duer_u32_t size;
+    struct pollfd pfd;
+    ssize_t rs;
+    int timeout;
+
+    pfd.fd = server->fd;
+    pfd.events = POLLIN;
+    for (;;) {
+        timeout = bench_answer(server);
+        if (poll(&pfd, 1, timeout) == 0) {
+            continue;
+        }
+
+        rs = read(server->fd, buf + have, cap - have);
+        if (rs <= 0) {
+            break;
+        }
+        have += rs;
+
+        used = 0;
+        while (have - used >= 8) {
+            memcpy(&size, buf + used + 4, sizeof(size));
+            size = ntohl(size);
+            if (have - used < 8 + size) {
+                break;
+            }
+            bench_serve(server, buf + used + 8, size);
+            used += 8 + size;
+        }
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static int bench_listen(int *port)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, 4) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        exit(1);
+    }
+
+    *port = ntohs(addr_in.sin_port);
+    return fd;
+}
+
+static duer_status_t bench_connect(duer_coap_handler coap, int port)
+{
+    duer_addr_t addr;
+    duer_status_t rs;
+    double start = bench_now();
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+
+    do {
+        rs = duer_coap_connect(coap, &addr, NULL, 0);
+    } while (rs == DUER_ERR_TRANS_WOULD_BLOCK && bench_now() - start < 5);
+
+    return rs;
+}
+
+static void bench_run(double rtt, duer_size_t nstart, double seconds, long size)
+{
+    static unsigned char payload[BENCH_PACKET_MAX];
+    bench_server_t *server = malloc(sizeof(bench_server_t));
+    bench_client_t client;
+    pthread_t thread;
+    duer_coap_handler coap;
+    duer_msg_t msg;
+    unsigned char token[4];
+    duer_u32_t sequence = 0;
+    duer_status_t rs;
+    double start;
+    double elapsed;
+    int listener;
+    int port;
+    int one = 1;
+
+    memset(&client, 0, sizeof(client));
+    s_client = &client;
+    listener = bench_listen(&port);
+    coap = duer_coap_acquire(bench_result, &client, bench_transevt, NULL);
+    if (!coap || bench_connect(coap, port) != DUER_OK
+            || duer_coap_set_nstart(coap, nstart) != DUER_OK) {
+        BENCH_PRINT("connect failed\n");
+        exit(1);
+    }
+
+    memset(server, 0, sizeof(*server));
+    server->fd = accept(listener, NULL, NULL);
+    server->rtt = rtt;
+    setsockopt(server->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    pthread_create(&thread, NULL, bench_server, server);
+
+    memset(payload, 'r', sizeof(payload));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = DUER_MSG_TYPE_CONFIRMABLE;
+    msg.msg_code = DUER_MSG_REQ_POST;
+    msg.path = (duer_u8_t *)"v1/device/data";
+    msg.path_len = strlen((char *)msg.path);
+    msg.token = token;
+    msg.token_len = sizeof(token);
+    msg.payload = payload;
+    msg.payload_len = size < BENCH_PACKET_MAX ? size : BENCH_PACKET_MAX;
+
+    // the queue never empty, the next report sent as soon as the window allows
+    start = bench_now();
+    while ((elapsed = bench_now() - start) < seconds) {
+        token[0] = sequence >> 24;
+        token[1] = sequence >> 16;
+        token[2] = sequence >> 8;
+        token[3] = sequence;
+        msg.msg_id = 0;
+
+        client.ready = 0;
+        rs = duer_coap_send(coap, &msg);
+        if (rs >= DUER_OK) {
+            sequence++;
+            continue;
+        }
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+            BENCH_PRINT("duer_coap_send failed: %d\n", rs);
+            break;
+        }
+
+        while (!client.ready && bench_now() - start < seconds) {
+            while (duer_coap_data_available(coap) >= DUER_OK) {
+            }
+            usleep(100);
+        }
+    }
+
+    BENCH_PRINT("rtt %3.0f ms, nstart %2u: %8.1f msgs/s, %5ld answered, %4ld reordered "
+                "by the server, %s\n",
+                rtt * 1000, (unsigned)nstart, client.answered / elapsed, client.answered,
+                server->reordered,
+                client.bad == 0 && client.answered + (long)nstart >= (long)sequence
+                ? "ok" : "WRONG");
+
+    duer_coap_release(coap);
+    shutdown(server->fd, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(server->fd);
+    close(listener);
+    free(server);
+    s_client = NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    static const long rtts[] = {50, 200, 500};
+    static const duer_size_t windows[] = {1, 2, 4, 8, 16};
+    double seconds = bench_arg(argc, argv, "seconds", 2);
+    long size = bench_arg(argc, argv, "size", 100);
+    size_t i;
+    size_t j;
+
+    bench_init(bench_arg(argc, argv, "verbose", 0));
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+    srand(20171018);
+
+    for (i = 0; i < sizeof(rtts) / sizeof(rtts[0]); i++) {
+        for (j = 0; j < sizeof(windows) / sizeof(windows[0]); j++) {
+            bench_run(rtts[i] / 1000.0, windows[j], seconds, size);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_priority.c
+ * Desc: Keep the events looper saturated by the bulk events (like the voice upload),
+ *       post the response events periodically, report how long they wait.
+ *
+ *   bench-priority [-urgent 1] [-responses 500] [-backlog 200] [-work 50]
+ *
+ *   -backlog, the bulk events kept pending
+ *   -work, the busy time of each bulk event, us
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "lightduer_events.h"
+
+static duer_events_handler s_events = NULL;
+static long s_backlog = 200;
+static long s_work = 50;
+static volatile int s_stop = 0;
+static long s_bulk_posted = 0;
+static long s_bulk_handled = 0;
+
+static void bench_bulk(int what, void *object)
+{
+    duer_u32_t begin = bench_now_us();
+
+    while (bench_now_us() - begin < (duer_u32_t)s_work) {
+    }
+    __atomic_add_fetch(&s_bulk_handled, 1, __ATOMIC_RELAXED);
+}
+
+static void bench_response(int what, void *object)
+{
+}
+
+static void *bench_bulk_producer(void *arg)
+{
+    while (!s_stop) {
+        if (__atomic_load_n(&s_bulk_posted, __ATOMIC_RELAXED)
+                - __atomic_load_n(&s_bulk_handled, __ATOMIC_RELAXED) >= s_backlog) {
+            sched_yield();
+            continue;
+        }
+        if (duer_events_call(s_events, bench_bulk, 0, NULL) == DUER_OK) {
+            __atomic_add_fetch(&s_bulk_posted, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    long urgent = bench_arg(argc, argv, "urgent", 1);
+    long responses = bench_arg(argc, argv, "responses", 500);
+    duer_events_priority_t priority = urgent ? DUER_EVENTS_PRIORITY_URGENT : DUER_EVENTS_PRIORITY_NORMAL;
+    duer_events_stats_t stats;
+    pthread_t producer;
+    size_t i;
+    long n;
+
+    s_backlog = bench_arg(argc, argv, "backlog", 200);
+    s_work = bench_arg(argc, argv, "work", 50);
+
+    bench_init(0);
+
+    s_events = duer_events_create("bench_priority", 0, s_backlog + 16);
+    if (s_events == NULL) {
+        return 1;
+    }
+
+    pthread_create(&producer, NULL, bench_bulk_producer, NULL);
+
+    // let the backlog build up
+    usleep(100000);
+
+    for (n = 0; n < responses; n++) {
+        duer_events_call_with_priority(s_events, priority, bench_response, (int)n, NULL);
+        usleep(2000);
+    }
+
+    s_stop = 1;
+    pthread_join(producer, NULL);
+    // wait for the backlog drained
+    usleep(s_backlog * s_work + 100000);
+
+    if (duer_events_get_stats("bench_priority", &stats) != DUER_OK) {
+        return 1;
+    }
+
+    for (i = 0; i < stats.func_count; i++) {
+        if (stats.funcs[i].func == bench_response) {
+            BENCH_PRINT("%s responses: %u handled, wait p50 %u us, p99 %u us, max %u us\n",
+                        urgent ? "urgent" : "normal", stats.funcs[i].count,
+                        duer_events_hist_percentile(stats.funcs[i].wait_hist, 50,
+                                                    stats.funcs[i].wait_max),
+                        duer_events_hist_percentile(stats.funcs[i].wait_hist, 99,
+                                                    stats.funcs[i].wait_max),
+                        stats.funcs[i].wait_max);
+        } else if (stats.funcs[i].func == bench_bulk) {
+            BENCH_PRINT("bulk: %u handled, wait p50 %u us, max depth %zu\n",
+                        stats.funcs[i].count,
+                        duer_events_hist_percentile(stats.funcs[i].wait_hist, 50,
+                                                    stats.funcs[i].wait_max),
+                        stats.max_depth);
+        }
+    }
+
+    return 0;
+}
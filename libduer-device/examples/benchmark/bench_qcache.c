@@ -0,0 +1,93 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_qcache.c
+ * Desc: Compare the linked list queue cache and the ring cache,
+ *       keep -depth messages queued, then push/pop -count times.
+ *
+ *   bench-qcache [-count 10000000] [-depth 8]
+ */
+
+#include "bench_common.h"
+#include "lightduer_queue_cache.h"
+#include "lightduer_ring_cache.h"
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 10000000);
+    long depth = bench_arg(argc, argv, "depth", 8);
+    duer_qcache_handler qcache = NULL;
+    duer_rcache_handler rcache = NULL;
+    unsigned long mallocs;
+    double start;
+    double elapsed;
+    void *data = NULL;
+    size_t check = 0;
+    long i;
+
+    bench_init(0);
+
+    qcache = duer_qcache_create();
+    rcache = duer_rcache_create(depth + 1, DUER_RCACHE_REJECT, NULL);
+    if (qcache == NULL || rcache == NULL) {
+        return 1;
+    }
+
+    for (i = 0; i < depth; i++) {
+        duer_qcache_push(qcache, (void *)(i + 1));
+        duer_rcache_push(rcache, (void *)(i + 1));
+    }
+
+    mallocs = bench_malloc_counts();
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        data = duer_qcache_pop(qcache);
+        check += (size_t)data;
+        if (duer_qcache_push(qcache, data) != DUER_OK) {
+            BENCH_PRINT("list: push failed\n");
+            return 1;
+        }
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("list: %.1f Mops/s, %.2f mallocs/op\n",
+                count / elapsed / 1e6, (double)(bench_malloc_counts() - mallocs) / count);
+
+    mallocs = bench_malloc_counts();
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        data = duer_rcache_pop(rcache);
+        check -= (size_t)data;
+        if (duer_rcache_push(rcache, data) != DUER_OK) {
+            BENCH_PRINT("ring: push failed\n");
+            return 1;
+        }
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("ring: %.1f Mops/s, %.2f mallocs/op\n",
+                count / elapsed / 1e6, (double)(bench_malloc_counts() - mallocs) / count);
+
+    if (check != 0) {
+        BENCH_PRINT("order mismatch\n");
+        return 1;
+    }
+
+    while (duer_qcache_pop(qcache) != NULL) {
+    }
+    duer_qcache_destroy(qcache);
+    duer_rcache_destroy(rcache);
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_recv.c
+ * Desc: A local server pushes the CoAP messages over TCP, the client reads
+ *       them as the engine does: duer_coap_data_available until it would
+ *       block. Report the messages received and the recv calls (linked with
+ *       -Wl,--wrap=recv) per message for:
+ *         burst, all the messages written at once,
+ *         split, every message written in 3 pieces, cut inside the header,
+ *         large, the messages larger than the 2KB of the old stack buffer.
+ *
+ *   bench-recv [-count 1000] [-size 200] [-large 6000]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_coap.h"
+
+#define BENCH_COAP_TCP_HDR      (0xbeefdead)
+
+typedef enum _bench_mode_enum {
+    BENCH_BURST,
+    BENCH_SPLIT,
+} bench_mode_e;
+
+typedef struct _bench_push_s {
+    int             fd;
+    bench_mode_e    mode;
+    long            count;
+    long            size;
+} bench_push_t;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static volatile int s_ready = 0;
+
+static volatile int s_counting = 0;
+static unsigned long s_recv_calls = 0;
+static long s_received = 0;
+static long s_bad = 0;
+
+ssize_t __real_recv(int fd, void *buf, size_t len, int flags);
+
+ssize_t __wrap_recv(int fd, void *buf, size_t len, int flags)
+{
+    if (s_counting) {
+        __sync_fetch_and_add(&s_recv_calls, 1);
+    }
+    return __real_recv(fd, buf, len, flags);
+}
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+    if (event == DUER_TEVT_SEND_RDY) {
+        pthread_mutex_lock(&s_mutex);
+        s_ready = 1;
+        pthread_cond_broadcast(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+static duer_status_t bench_result(duer_context ctx, duer_coap_handler hdlr,
+                                  const duer_msg_t *msg, const duer_addr_t *addr)
+{
+    long size = (long)ctx;
+    long i;
+
+    for (i = 0; i < size && i < msg->payload_len; i++) {
+        if (msg->payload[i] != (duer_u8_t)(i * 7)) {
+            break;
+        }
+    }
+    if (msg->payload_len != size || i != size) {
+        s_bad++;
+    }
+    s_received++;
+
+    return DUER_OK;
+}
+
+/*
+ * The frame of a NON 2.05 response, with the payload
+ */
+static size_t bench_frame(unsigned char *buf, duer_u16_t msg_id, long size)
+{
+    duer_u32_t *hdr = (duer_u32_t *)buf;
+    unsigned char *p = buf + 8;
+    long i;
+
+    *p++ = 0x50;    // version 1, NON, no token
+    *p++ = 0x45;    // 2.05 Content
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    *p++ = 0xff;
+    for (i = 0; i < size; i++) {
+        *p++ = (unsigned char)(i * 7);
+    }
+
+    hdr[0] = htonl(BENCH_COAP_TCP_HDR);
+    hdr[1] = htonl(p - buf - 8);
+
+    return p - buf;
+}
+
+static void *bench_push(void *arg)
+{
+    bench_push_t *push = (bench_push_t *)arg;
+    size_t frame = push->size + 16;
+    unsigned char *buf = malloc(frame * push->count);
+    size_t total = 0;
+    size_t len;
+    long i;
+
+    if (push->mode == BENCH_BURST) {
+        for (i = 0; i < push->count; i++) {
+            total += bench_frame(buf + total, (duer_u16_t)(i + 1), push->size);
+        }
+        write(push->fd, buf, total);
+    } else {
+        for (i = 0; i < push->count; i++) {
+            len = bench_frame(buf, (duer_u16_t)(i + 1), push->size);
+            write(push->fd, buf, 3);
+            usleep(200);
+            write(push->fd, buf + 3, len / 2 - 3);
+            usleep(200);
+            write(push->fd, buf + len / 2, len - len / 2);
+            usleep(200);
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+static int bench_listen(int *port)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, 4) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        exit(1);
+    }
+
+    *port = ntohs(addr_in.sin_port);
+    return fd;
+}
+
+static duer_status_t bench_connect(duer_coap_handler coap, int port)
+{
+    duer_addr_t addr;
+    duer_status_t rs;
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        s_ready = 0;
+        pthread_mutex_unlock(&s_mutex);
+
+        rs = duer_coap_connect(coap, &addr, NULL, 0);
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+            return rs;
+        }
+
+        pthread_mutex_lock(&s_mutex);
+        while (!s_ready) {
+            pthread_cond_wait(&s_cond, &s_mutex);
+        }
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+static void bench_run(const char *name, bench_mode_e mode, long count, long size)
+{
+    bench_push_t push;
+    pthread_t pusher;
+    duer_coap_handler coap;
+    duer_status_t rs;
+    int listener;
+    int port;
+    int one = 1;
+    double start;
+
+    listener = bench_listen(&port);
+    coap = duer_coap_acquire(bench_result, (duer_context)size, bench_transevt, NULL);
+    if (!coap || bench_connect(coap, port) != DUER_OK) {
+        BENCH_PRINT("connect failed\n");
+        exit(1);
+    }
+
+    push.fd = accept(listener, NULL, NULL);
+    setsockopt(push.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    push.mode = mode;
+    push.count = count;
+    push.size = size;
+
+    s_received = 0;
+    s_bad = 0;
+    s_recv_calls = 0;
+    s_counting = 1;
+    pthread_create(&pusher, NULL, bench_push, &push);
+
+    // read as the engine does, until all received or nothing for 1s
+    start = bench_now();
+    while (s_received < count && bench_now() - start < 1) {
+        do {
+            rs = duer_coap_data_available(coap);
+            if (rs >= DUER_OK) {
+                start = bench_now();
+            }
+        } while (rs >= DUER_OK);
+        usleep(100);
+    }
+    s_counting = 0;
+
+    pthread_join(pusher, NULL);
+    BENCH_PRINT("%-6s %5ld x %5ld bytes: received %5ld, bad %ld, recv calls %.2f per message\n",
+                name, count, size, s_received, s_bad,
+                s_received ? (double)s_recv_calls / s_received : (double)s_recv_calls);
+
+    duer_coap_release(coap);
+    close(push.fd);
+    close(listener);
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 1000);
+    long size = bench_arg(argc, argv, "size", 200);
+    long large = bench_arg(argc, argv, "large", 6000);
+
+    bench_init(0);
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+
+    bench_run("burst", BENCH_BURST, count, size);
+    bench_run("split", BENCH_SPLIT, count / 10, size);
+    bench_run("large", BENCH_BURST, count / 10, large);
+
+    return 0;
+}
@@ -0,0 +1,380 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_response.c
+ * Desc: The directive responses sent by the engine while the voice upload
+ *       keeps its queue full. The CA is stubbed, the uplink takes -kbps and
+ *       buffers -window bytes like a socket, it blocks the send above that
+ *       and reports DUER_TEVT_SEND_RDY when drained. A directive arrives
+ *       every -interval ms as the received data does (an urgent event),
+ *       and is answered with duer_response. The voice keeps -backlog chunks
+ *       queued, below the capacity. Report the time from the
+ *       directive to its response taken by the uplink, and the voice rate.
+ *       -fifo 1 queues the responses behind the reports, as before.
+ *
+ *   bench-response [-fifo 0] [-directives 50] [-interval 100] [-kbps 256]
+ *                  [-chunk 2048] [-window 8192] [-backlog 16]
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_json.h"
+#include "lightduer_ca.h"
+#include "lightduer_engine.h"
+#include "lightduer_events.h"
+#include "lightduer_memory.h"
+
+#define BENCH_DIRECTIVES_MAX    (1000)
+
+extern int duer_engine_enqueue_response(
+        const duer_msg_t *req, int msg_code, const void *data, duer_size_t size);
+
+static duer_events_handler s_events = NULL;
+static long s_fifo = 0;
+static long s_kbps = 256;
+static long s_chunk = 2048;
+static long s_window = 8192;
+static long s_backlog = 16;
+static volatile int s_stop = 0;
+
+static pthread_mutex_t s_link_mutex = PTHREAD_MUTEX_INITIALIZER;
+static double s_busy_until = 0;     // when the uplink has sent all it took
+static int s_link_blocked = 0;      // a send would block, report when drained
+static long s_voice_bytes = 0;
+
+static double s_posted[BENCH_DIRECTIVES_MAX];
+static double s_latency[BENCH_DIRECTIVES_MAX];
+static volatile long s_answered = 0;
+
+/*
+ * The CA stubbed, only what the engine calls
+ */
+duer_handler baidu_ca_acquire(duer_transevt_func soc_ctx)
+{
+    return (duer_handler)&s_events;
+}
+
+duer_bool baidu_ca_is_started(duer_handler hdlr)
+{
+    return DUER_TRUE;
+}
+
+duer_bool baidu_ca_is_stopped(duer_handler hdlr)
+{
+    return DUER_FALSE;
+}
+
+duer_status_t baidu_ca_load_configuration(duer_handler hdlr, const void *data, duer_size_t size)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_start(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_stop(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_release(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_add_resources(duer_handler hdlr, const duer_res_t list_res[],
+                                     duer_size_t list_res_size)
+{
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_data_available(duer_handler hdlr, const duer_addr_t *addr)
+{
+    return DUER_ERR_TRANS_WOULD_BLOCK;
+}
+
+duer_status_t baidu_ca_release_idle(duer_handler hdlr)
+{
+    return DUER_OK;
+}
+
+static duer_msg_t *bench_message(duer_u8_t msg_code)
+{
+    duer_msg_t *msg = DUER_MALLOC(sizeof(duer_msg_t));
+
+    if (msg) {
+        memset(msg, 0, sizeof(duer_msg_t));
+        msg->msg_code = msg_code;
+    }
+
+    return msg;
+}
+
+duer_msg_t *baidu_ca_build_report_message(duer_handler hdlr, duer_bool confirmable)
+{
+    return bench_message(DUER_MSG_REQ_POST);
+}
+
+duer_msg_t *baidu_ca_build_response_message(duer_handler hdlr, const duer_msg_t *msg,
+                                            duer_u8_t msg_code)
+{
+    return bench_message(msg_code);
+}
+
+void baidu_ca_release_message(duer_handler hdlr, duer_msg_t *msg)
+{
+    DUER_FREE(msg);
+}
+
+duer_status_t baidu_ca_send_data(duer_handler hdlr, const duer_msg_t *msg,
+                                 const duer_addr_t *addr)
+{
+    double bytes_time = 8.0 / (s_kbps * 1000);
+    double now = bench_now();
+    const char *found = NULL;
+    char text[64];
+    long id = 0;
+    duer_size_t len = 0;
+
+    pthread_mutex_lock(&s_link_mutex);
+    if (s_busy_until - now > s_window * bytes_time) {
+        s_link_blocked = 1;
+        pthread_mutex_unlock(&s_link_mutex);
+        return DUER_ERR_TRANS_WOULD_BLOCK;
+    }
+    s_busy_until = (s_busy_until > now ? s_busy_until : now) + msg->payload_len * bytes_time;
+    pthread_mutex_unlock(&s_link_mutex);
+
+    // the responses are small, the voice chunks counted
+    if (msg->payload_len >= sizeof(text)) {
+        s_voice_bytes += msg->payload_len;
+        return DUER_OK;
+    }
+
+    len = msg->payload_len;
+    memcpy(text, msg->payload, len);
+    text[len] = '\0';
+    found = strstr(text, "\"response\":");
+    if (found) {
+        id = atol(found + strlen("\"response\":"));
+        if (id >= 0 && id < BENCH_DIRECTIVES_MAX) {
+            s_latency[id] = now - s_posted[id];
+            __atomic_add_fetch(&s_answered, 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    return DUER_OK;
+}
+
+/*
+ * As lightduer_connagent.c does
+ */
+int duer_data_send(void)
+{
+    return duer_events_call_coalesced(s_events, DUER_EVENTS_PRIORITY_NORMAL,
+                                      duer_engine_send, 0, NULL);
+}
+
+int duer_data_idle(void)
+{
+    return duer_events_call_coalesced(s_events, DUER_EVENTS_PRIORITY_NORMAL,
+                                      duer_engine_release_idle, 0, NULL);
+}
+
+int duer_data_report(const baidu_json *data)
+{
+    int rs = duer_engine_enqueue_report_data(data);
+    if (rs == DUER_OK && duer_engine_qcache_length() == 1) {
+        duer_data_send();
+    }
+    return rs;
+}
+
+int duer_data_available(void)
+{
+    return DUER_OK;
+}
+
+static void bench_notify(int event, int status, int what, void *object)
+{
+    if (event == DUER_EVT_SEND_DATA && status >= 0 && duer_engine_qcache_length() > 0) {
+        duer_data_send();
+    }
+}
+
+/*
+ * The uplink drained below the window, as the socket reactor reports it
+ */
+static void *bench_link(void *arg)
+{
+    int ready = 0;
+
+    while (!s_stop) {
+        usleep(1000);
+        pthread_mutex_lock(&s_link_mutex);
+        ready = s_link_blocked
+                && s_busy_until - bench_now() <= s_window * 8.0 / (s_kbps * 1000);
+        if (ready) {
+            s_link_blocked = 0;
+        }
+        pthread_mutex_unlock(&s_link_mutex);
+        if (ready) {
+            duer_data_send();
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * The voice upload, keeps the backlog queued
+ */
+static void *bench_voice(void *arg)
+{
+    baidu_json *data = baidu_json_CreateObject();
+    char *chunk = malloc(s_chunk + 1);
+
+    memset(chunk, 'v', s_chunk);
+    chunk[s_chunk] = '\0';
+    baidu_json_AddStringToObject(data, "voice", chunk);
+    free(chunk);
+
+    while (!s_stop) {
+        if (duer_engine_qcache_length() >= s_backlog || duer_data_report(data) != DUER_OK) {
+            usleep(1000);
+        }
+    }
+
+    baidu_json_Delete(data);
+
+    return NULL;
+}
+
+/*
+ * The directive received, answered as the handler of the resource does
+ */
+static void bench_directive(int what, void *object)
+{
+    duer_msg_t req;
+    baidu_json *data = NULL;
+    char text[32];
+    int len = 0;
+
+    if (s_fifo) {
+        data = baidu_json_CreateObject();
+        baidu_json_AddNumberToObject(data, "response", what);
+        duer_data_report(data);
+        baidu_json_Delete(data);
+        return;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.msg_code = DUER_MSG_REQ_PUT;
+    len = snprintf(text, sizeof(text), "{\"response\":%d}", what);
+    if (duer_engine_enqueue_response(&req, DUER_MSG_RSP_CHANGED, text, len) == DUER_OK) {
+        duer_events_call_coalesced(s_events, DUER_EVENTS_PRIORITY_URGENT,
+                                   duer_engine_send, 0, NULL);
+    }
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double l = *(const double *)a;
+    double r = *(const double *)b;
+
+    return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+int main(int argc, char* argv[])
+{
+    long directives = bench_arg(argc, argv, "directives", 50);
+    long interval = bench_arg(argc, argv, "interval", 100);
+    pthread_t link;
+    pthread_t voice;
+    double start;
+    double elapsed;
+    double *latency = NULL;
+    long answered;
+    long i;
+
+    s_fifo = bench_arg(argc, argv, "fifo", 0);
+    s_kbps = bench_arg(argc, argv, "kbps", 256);
+    s_chunk = bench_arg(argc, argv, "chunk", 2048);
+    s_window = bench_arg(argc, argv, "window", 8192);
+    s_backlog = bench_arg(argc, argv, "backlog", 16);
+    if (directives > BENCH_DIRECTIVES_MAX) {
+        directives = BENCH_DIRECTIVES_MAX;
+    }
+
+    bench_init(bench_arg(argc, argv, "verbose", 0));
+
+    s_events = duer_events_create("bench_response", 0, 64);
+    if (s_events == NULL) {
+        BENCH_PRINT("create failed\n");
+        return 1;
+    }
+
+    duer_engine_register_notify(bench_notify);
+    duer_engine_create(0, NULL);
+
+    pthread_create(&link, NULL, bench_link, NULL);
+    pthread_create(&voice, NULL, bench_voice, NULL);
+
+    // let the queue fill up
+    usleep(500000);
+
+    start = bench_now();
+    s_voice_bytes = 0;
+    for (i = 0; i < directives; i++) {
+        s_posted[i] = bench_now();
+        s_latency[i] = -1;
+        duer_events_call_with_priority(s_events, DUER_EVENTS_PRIORITY_URGENT,
+                                       bench_directive, (int)i, NULL);
+        usleep(interval * 1000);
+    }
+
+    // the last responses behind the queue
+    while (__atomic_load_n(&s_answered, __ATOMIC_ACQUIRE) < directives
+            && bench_now() - start < directives * interval / 1000.0 + 30) {
+        usleep(10000);
+    }
+    elapsed = bench_now() - start;
+    answered = __atomic_load_n(&s_answered, __ATOMIC_ACQUIRE);
+
+    s_stop = 1;
+    pthread_join(voice, NULL);
+    pthread_join(link, NULL);
+
+    BENCH_PRINT("%s: %ld/%ld answered",
+                s_fifo ? "fifo  " : "urgent", answered, directives);
+    if (answered > 0) {
+        // the unanswered are sorted first as -1
+        qsort(s_latency, directives, sizeof(double), compare_double);
+        latency = s_latency + directives - answered;
+        BENCH_PRINT(", response p50 %.1f ms, p99 %.1f ms, max %.1f ms",
+                    latency[answered / 2] * 1000, latency[answered * 99 / 100] * 1000,
+                    latency[answered - 1] * 1000);
+    }
+    BENCH_PRINT(", voice %.1f kbps of %ld\n", s_voice_bytes * 8 / elapsed / 1000, s_kbps);
+
+    return 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_sendv.c
+ * Desc: The CoAP messages sent over TCP to a local server, through the linux
+ *       socket adapter. Report the bytes copied by memcpy (linked with
+ *       -Wl,--wrap=memcpy) and the mallocs per message, and check the frames
+ *       the server receives. Built as bench-sendv-aes, the transport is the
+ *       AES-CBC encrypted one.
+ *
+ *   bench-sendv [-count 2000] [-size 1000] [-sendv 1]
+ *
+ *   -sendv 0 leaves the platform sendv unset, the segments are gathered
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_coap.h"
+#include "lightduer_net_util.h"
+
+#define BENCH_COAP_TCP_HDR      (0xbeefdead)
+#define BENCH_BDCAEC_MN         (0xBDCAEC01)
+
+// the bindToken and the uuid of the AES-CBC transport
+#define BENCH_BIND_TOKEN        "8cd34facea95d5491b2cb5fbacacb0f0"
+#define BENCH_UUID              "bench00000001"
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static volatile int s_ready = 0;
+
+static volatile int s_counting = 0;
+static unsigned long s_memcpy_calls = 0;
+static unsigned long s_memcpy_bytes = 0;
+
+static long s_frames = 0;
+static long s_bad_frames = 0;
+static unsigned long long s_bytes = 0;
+static duer_u32_t s_checksum = 2166136261u;
+
+void *__real_memcpy(void *dst, const void *src, size_t n);
+
+void *__wrap_memcpy(void *dst, const void *src, size_t n)
+{
+    if (s_counting) {
+        __sync_fetch_and_add(&s_memcpy_calls, 1);
+        __sync_fetch_and_add(&s_memcpy_bytes, n);
+    }
+    return __real_memcpy(dst, src, n);
+}
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+    if (event == DUER_TEVT_SEND_RDY) {
+        pthread_mutex_lock(&s_mutex);
+        s_ready = 1;
+        pthread_cond_broadcast(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+static int bench_read(int fd, unsigned char *buf, size_t size)
+{
+    size_t got = 0;
+    ssize_t rs;
+    size_t i;
+
+    while (got < size) {
+        rs = read(fd, buf + got, size - got);
+        if (rs <= 0) {
+            return -1;
+        }
+        got += rs;
+    }
+
+    // FNV-1a of all the bytes received, the same for the same frames
+    for (i = 0; i < size; i++) {
+        s_checksum = (s_checksum ^ buf[i]) * 16777619u;
+    }
+    s_bytes += size;
+
+    return 0;
+}
+
+static void *bench_server(void *arg)
+{
+    int fd = accept((int)(long)arg, NULL, NULL);
+    static unsigned char body[64 * 1024];
+    duer_u32_t hdr[2];
+    duer_u32_t size;
+
+    while (fd >= 0 && bench_read(fd, (unsigned char *)hdr, sizeof(hdr)) == 0) {
+        size = ntohl(hdr[1]);
+        if ((ntohl(hdr[0]) != BENCH_COAP_TCP_HDR && ntohl(hdr[0]) != BENCH_BDCAEC_MN)
+                || size > sizeof(body)
+                || bench_read(fd, body, size) < 0) {
+            s_bad_frames++;
+            break;
+        }
+        if (ntohl(hdr[0]) == BENCH_BDCAEC_MN
+                && (size < 1 + body[0] || (size - 1 - body[0]) % 16 != 0)) {
+            s_bad_frames++;
+        }
+        s_frames++;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    return NULL;
+}
+
+static int bench_listen(void)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, 4) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        exit(1);
+    }
+
+    return fd;
+}
+
+static duer_status_t bench_connect(duer_coap_handler coap, int port)
+{
+    duer_addr_t addr;
+    duer_status_t rs;
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        s_ready = 0;
+        pthread_mutex_unlock(&s_mutex);
+
+#ifdef NET_TRANS_ENCRYPTED_BY_AES_CBC
+        rs = duer_coap_connect(coap, &addr, BENCH_BIND_TOKEN, strlen(BENCH_BIND_TOKEN));
+#else
+        rs = duer_coap_connect(coap, &addr, NULL, 0);
+#endif
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+            return rs;
+        }
+
+        pthread_mutex_lock(&s_mutex);
+        while (!s_ready) {
+            pthread_cond_wait(&s_cond, &s_mutex);
+        }
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 2000);
+    long size = bench_arg(argc, argv, "size", 1000);
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    pthread_t server;
+    duer_coap_handler coap;
+    unsigned char *payload;
+    unsigned long mallocs;
+    duer_msg_t msg;
+    duer_u8_t token[4] = {1, 2, 3, 4};
+    double start;
+    double elapsed;
+    long failed = 0;
+    long i;
+    int fd;
+
+    bench_init(0);
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+    baidu_ca_transport_sendv_init(bench_arg(argc, argv, "sendv", 1) ? bcasoc_sendv : NULL);
+
+    fd = bench_listen();
+    getsockname(fd, (struct sockaddr *)&addr_in, &len);
+    pthread_create(&server, NULL, bench_server, (void *)(long)fd);
+
+    coap = duer_coap_acquire(NULL, NULL, bench_transevt, BENCH_UUID);
+    if (!coap || bench_connect(coap, ntohs(addr_in.sin_port)) != DUER_OK) {
+        BENCH_PRINT("connect failed\n");
+        return 1;
+    }
+
+    payload = malloc(size);
+    for (i = 0; i < size; i++) {
+        payload[i] = (unsigned char)(i * 7);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = DUER_MSG_TYPE_NON_CONFIRMABLE;
+    msg.msg_code = DUER_MSG_REQ_POST;
+    msg.token = token;
+    msg.token_len = sizeof(token);
+    msg.path = (duer_u8_t *)"duer_private";
+    msg.path_len = strlen((const char *)msg.path);
+    msg.payload = payload;
+    msg.payload_len = size;
+
+    mallocs = bench_malloc_counts();
+    s_counting = 1;
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        msg.msg_id = (duer_u16_t)(i + 1);
+        if (duer_coap_send(coap, &msg) < 0) {
+            failed++;
+        }
+    }
+    elapsed = bench_now() - start;
+    s_counting = 0;
+    mallocs = bench_malloc_counts() - mallocs;
+
+    duer_coap_release(coap);
+    pthread_join(server, NULL);
+
+#ifdef NET_TRANS_ENCRYPTED_BY_AES_CBC
+    BENCH_PRINT("transport          AES-CBC\n");
+#else
+    BENCH_PRINT("transport          plain TCP\n");
+#endif
+    BENCH_PRINT("messages           %ld x %ld bytes payload, %ld failed\n", count, size, failed);
+    BENCH_PRINT("frames received    %ld, %ld bad, %llu bytes, checksum %08x\n",
+                s_frames, s_bad_frames, s_bytes, s_checksum);
+    BENCH_PRINT("memcpy per message %.1f calls, %.1f bytes\n",
+                (double)s_memcpy_calls / count, (double)s_memcpy_bytes / count);
+    BENCH_PRINT("malloc per message %.2f\n", (double)mallocs / count);
+    BENCH_PRINT("time per message   %.2f us\n", elapsed * 1e6 / count);
+
+    free(payload);
+
+    return s_bad_frames == 0 && s_frames == count ? 0 : 1;
+}
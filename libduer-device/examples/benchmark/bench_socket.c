@@ -0,0 +1,234 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_socket.c
+ * Desc: Connect the loopback sockets with the linux socket adapter, a writer
+ *       sends timestamped records to them round robin, and the readiness
+ *       drains every socket on an events queue like the engine does,
+ *       report the receive latency and the context switches per record.
+ *
+ *   bench-socket [-sockets 1] [-count 20000] [-interval 200]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_connagent.h"
+#include "lightduer_events.h"
+
+#define BENCH_MAX_SOCKETS   (64)
+
+typedef struct _bench_record_s {
+    duer_u32_t  stamp;
+    duer_u32_t  seq;
+} bench_record_t;
+
+typedef struct _bench_socket_s {
+    duer_socket_t   soc;
+    int             peer;
+    char            buf[sizeof(bench_record_t)];
+    duer_size_t     offset;
+} bench_socket_t;
+
+static bench_socket_t s_sockets[BENCH_MAX_SOCKETS];
+static long s_socket_count = 1;
+static long s_count = 20000;
+static long s_interval = 200;
+static duer_events_handler s_ca = NULL;
+static duer_u32_t *s_latency = NULL;
+static long s_received = 0;
+static long s_drains = 0;
+static long s_writer_switches = 0;
+
+static void bench_drain(int what, void *object)
+{
+    bench_socket_t *sock = NULL;
+    bench_record_t record;
+    int rs = 0;
+    long i;
+
+    s_drains++;
+    for (i = 0; i < s_socket_count; i++) {
+        sock = &s_sockets[i];
+        do {
+            rs = bcasoc_recv(sock->soc, sock->buf + sock->offset,
+                             sizeof(sock->buf) - sock->offset, NULL);
+            if (rs <= 0) {
+                break;
+            }
+            sock->offset += rs;
+            if (sock->offset == sizeof(sock->buf)) {
+                memcpy(&record, sock->buf, sizeof(record));
+                if (record.seq < s_count) {
+                    s_latency[record.seq] = bench_now_us() - record.stamp;
+                }
+                sock->offset = 0;
+                __atomic_add_fetch(&s_received, 1, __ATOMIC_SEQ_CST);
+            }
+        } while (1);
+    }
+}
+
+int duer_data_available()
+{
+    return duer_events_call_coalesced(s_ca, DUER_EVENTS_PRIORITY_URGENT, bench_drain, 0, NULL);
+}
+
+static long bench_switches(int who)
+{
+    struct rusage usage;
+
+    getrusage(who, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static void *bench_writer(void *arg)
+{
+    bench_record_t record;
+    long switches = bench_switches(RUSAGE_THREAD);
+    long i;
+
+    for (i = 0; i < s_count; i++) {
+        record.seq = i;
+        record.stamp = bench_now_us();
+        if (write(s_sockets[i % s_socket_count].peer, &record, sizeof(record)) != sizeof(record)) {
+            BENCH_PRINT("write failed at %ld\n", i);
+            break;
+        }
+        if (s_interval > 0) {
+            usleep(s_interval);
+        }
+    }
+
+    s_writer_switches = bench_switches(RUSAGE_THREAD) - switches;
+
+    return NULL;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+    duer_u32_t x = *(const duer_u32_t *)a;
+    duer_u32_t y = *(const duer_u32_t *)b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+int main(int argc, char* argv[])
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    duer_addr_t addr;
+    pthread_t writer;
+    long switches;
+    double start;
+    double elapsed;
+    double sum = 0;
+    int listener;
+    int rs;
+    long i;
+
+    s_socket_count = bench_arg(argc, argv, "sockets", 1);
+    s_count = bench_arg(argc, argv, "count", 20000);
+    s_interval = bench_arg(argc, argv, "interval", 200);
+    if (s_socket_count < 1 || s_socket_count > BENCH_MAX_SOCKETS) {
+        BENCH_PRINT("sockets should be 1..%d\n", BENCH_MAX_SOCKETS);
+        return 1;
+    }
+
+    bench_init(0);
+    bcasoc_initialize();
+
+    s_ca = duer_events_create("bench_ca", 0, 16);
+    s_latency = calloc(s_count, sizeof(*s_latency));
+    if (s_ca == NULL || s_latency == NULL) {
+        return 1;
+    }
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(listener, BENCH_MAX_SOCKETS) < 0
+            || getsockname(listener, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        return 1;
+    }
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = ntohs(addr_in.sin_port);
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+    for (i = 0; i < s_socket_count; i++) {
+        s_sockets[i].soc = bcasoc_create(NULL);
+        // no transport callback, poll for the connect result
+        while ((rs = bcasoc_connect(s_sockets[i].soc, &addr)) == DUER_ERR_TRANS_WOULD_BLOCK) {
+            usleep(1000);
+        }
+        if (rs < 0) {
+            BENCH_PRINT("connect failed at %ld\n", i);
+            return 1;
+        }
+        s_sockets[i].peer = accept(listener, NULL, NULL);
+    }
+
+    usleep(100000);
+    switches = bench_switches(RUSAGE_SELF);
+    start = bench_now();
+    pthread_create(&writer, NULL, bench_writer, NULL);
+    pthread_join(writer, NULL);
+    while (__atomic_load_n(&s_received, __ATOMIC_SEQ_CST) < s_count && bench_now() - start < 30) {
+        usleep(1000);
+    }
+    elapsed = bench_now() - start;
+    switches = bench_switches(RUSAGE_SELF) - switches - s_writer_switches;
+
+    BENCH_PRINT("sockets %ld, received %ld/%ld in %.2f s, drains %ld\n",
+                s_socket_count, s_received, s_count, elapsed, s_drains);
+    BENCH_PRINT("context switches (excluding the writer): %.2f per record\n",
+                (double)switches / s_count);
+
+    if (s_received == s_count) {
+        for (i = 0; i < s_count; i++) {
+            sum += s_latency[i];
+        }
+        qsort(s_latency, s_count, sizeof(*s_latency), bench_cmp);
+        BENCH_PRINT("latency avg %.1f us, p50 %u us, p99 %u us, max %u us\n",
+                    sum / s_count, s_latency[s_count / 2], s_latency[s_count * 99 / 100],
+                    s_latency[s_count - 1]);
+    }
+
+    // hang up first, the adapter may be waiting for the readiness
+    for (i = 0; i < s_socket_count; i++) {
+        close(s_sockets[i].peer);
+    }
+    usleep(100000);
+    for (i = 0; i < s_socket_count; i++) {
+        bcasoc_close(s_sockets[i].soc);
+        bcasoc_destroy(s_sockets[i].soc);
+    }
+    close(listener);
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_timers.c
+ * Desc: Run many concurrent timers on the linux timer port,
+ *       report the start/stop cost, the expiry lateness and the threads used.
+ *
+ *   bench-timers [-count 10000] [-spread 1000]
+ *
+ *   -spread, the delays are 100ms + [0, spread)ms
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_common.h"
+#include "lightduer_timers.h"
+
+typedef struct _bench_timer_s {
+    duer_timer_handler  handler;
+    double              expected;
+} bench_timer_t;
+
+static bench_timer_t *s_timers = NULL;
+static long s_fired = 0;
+static double s_late_sum = 0;
+static double s_late_max = 0;
+
+static void bench_timer_expired(void *param)
+{
+    bench_timer_t *timer = (bench_timer_t *)param;
+    double late = bench_now() - timer->expected;
+
+    // the callbacks might run on different threads
+    __atomic_add_fetch(&s_fired, 1, __ATOMIC_RELAXED);
+    s_late_sum += late;
+    if (late > s_late_max) {
+        s_late_max = late;
+    }
+}
+
+static int bench_threads(void)
+{
+    char line[128];
+    int threads = 0;
+    FILE *fp = fopen("/proc/self/status", "r");
+
+    if (fp) {
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "Threads:", 8) == 0) {
+                threads = atoi(line + 8);
+                break;
+            }
+        }
+        fclose(fp);
+    }
+
+    return threads;
+}
+
+int main(int argc, char* argv[])
+{
+    long count = bench_arg(argc, argv, "count", 10000);
+    long spread = bench_arg(argc, argv, "spread", 1000);
+    double start;
+    double elapsed;
+    int threads = 0;
+    int max_threads = 0;
+    long round;
+    long i;
+
+    bench_init(0);
+    srand(1);
+
+    s_timers = calloc(count, sizeof(bench_timer_t));
+    if (s_timers == NULL) {
+        return 1;
+    }
+
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        s_timers[i].handler = duer_timer_acquire(bench_timer_expired, &s_timers[i], DUER_TIMER_ONCE);
+        if (s_timers[i].handler == NULL) {
+            BENCH_PRINT("acquire failed at %ld\n", i);
+            return 1;
+        }
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("acquire: %.2f us/timer\n", elapsed * 1e6 / count);
+
+    // restart all of them a few times, like the keepalive and the socket poll timers
+    start = bench_now();
+    for (round = 0; round < 10; round++) {
+        for (i = 0; i < count; i++) {
+            long delay = 100 + rand() % spread;
+            s_timers[i].expected = bench_now() + delay / 1000.0;
+            duer_timer_start(s_timers[i].handler, delay);
+        }
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("start: %.2f us/op\n", elapsed * 1e6 / (count * 10));
+
+    start = bench_now();
+    while (__atomic_load_n(&s_fired, __ATOMIC_RELAXED) < count && bench_now() - start < 30) {
+        threads = bench_threads();
+        if (threads > max_threads) {
+            max_threads = threads;
+        }
+        usleep(5000);
+    }
+
+    BENCH_PRINT("fired %ld/%ld, late avg %.2f ms, max %.2f ms, max threads %d\n",
+                s_fired, count, s_late_sum * 1000 / (s_fired ? s_fired : 1),
+                s_late_max * 1000, max_threads);
+
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        duer_timer_stop(s_timers[i].handler);
+        duer_timer_release(s_timers[i].handler);
+    }
+    elapsed = bench_now() - start;
+    BENCH_PRINT("stop+release: %.2f us/timer\n", elapsed * 1e6 / count);
+
+    free(s_timers);
+
+    return 0;
+}
@@ -0,0 +1,719 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: bench_tls.c
+ * Desc: The TLS connections to a local mbedtls server, through the encrypted
+ *       transport and the linux socket adapter. Report the handshake time,
+ *       the client and the server CPU time, the handshake bytes, the
+ *       sessions resumed, and the client heap by the connection (the mallocs,
+ *       the bytes allocated and the peak), against the server:
+ *         full,    no session resumed,
+ *         id,      the session cache, resumed by the session id,
+ *         ticket,  the session tickets,
+ *         persist, the session tickets, the client cache dropped before every
+ *                  connection and loaded back through the platform hook.
+ *       Then the full handshakes by the cipher suite the server is limited to,
+ *       the ECDHE ones are built by make DUER_TLS_ECDHE=true.
+ *       Then by the record sizes, duer_trans_set_record_size (the received one
+ *       is the max_fragment_length negotiated): the client heap held by the
+ *       live connection while idle and the peak, and the throughput of the
+ *       1KB messages sent and the stream received.
+ *
+ *   bench-tls [-count 50] [-bytes 1048576]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+#include "mbedtls/certs.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_cache.h"
+#include "mbedtls/ssl_ticket.h"
+#include "mbedtls/x509_crt.h"
+
+#include "bench_common.h"
+#include "baidu_ca_adapter_internal.h"
+#include "lightduer_net_trans_encrypted.h"
+#include "lightduer_net_transport_wrapper.h"
+
+typedef enum _bench_mode_enum {
+    BENCH_FULL,
+    BENCH_ID,
+    BENCH_TICKET,
+    BENCH_PERSIST,
+    BENCH_MODES,
+} bench_mode_e;
+
+static const char *s_mode_names[BENCH_MODES] = {"full", "id", "ticket", "persist"};
+
+typedef struct _bench_suite_s {
+    const char                 *name;
+    int                         id;
+    int                         ec;     // the server has the EC certificate
+} bench_suite_t;
+
+static const bench_suite_t s_suites[] = {
+    {"RSA-AES256-CBC-SHA256", MBEDTLS_TLS_RSA_WITH_AES_256_CBC_SHA256, 0},
+    {"RSA-AES128-CBC-SHA256", MBEDTLS_TLS_RSA_WITH_AES_128_CBC_SHA256, 0},
+    {"RSA-AES128-GCM-SHA256", MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256, 0},
+    {"ECDHE-RSA-AES128-GCM-SHA256", MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256, 0},
+    {"ECDHE-ECDSA-AES128-GCM-SHA256", MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, 1},
+};
+
+typedef struct _bench_server_s {
+    int                         listener;
+    long                        count;
+    bench_mode_e                mode;
+    const bench_suite_t        *suite;
+    int                         suites[2];
+    unsigned long               stream;     // the bytes exchanged after the handshake
+    mbedtls_entropy_context     entropy;
+    mbedtls_ctr_drbg_context    drbg;
+    mbedtls_x509_crt            crt;
+    mbedtls_pk_context          key;
+    mbedtls_ssl_config          conf;
+    mbedtls_ssl_cache_context   cache;
+    mbedtls_ssl_ticket_context  ticket;
+} bench_server_t;
+
+typedef struct _bench_io_s {
+    int                         fd;
+    unsigned long               bytes;
+} bench_io_t;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static volatile int s_event = 0;
+
+// the server side, by the connection handshaked
+static unsigned long s_bytes = 0;
+static double s_server_cpu = 0;
+static long s_resumed = 0;
+static long s_failed = 0;
+static const char *s_negotiated = NULL;
+
+// the session saved through the platform hook
+static unsigned char s_saved[1024];
+static duer_size_t s_saved_size = 0;
+static int s_keep_saved = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+
+    bench_heap_add(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *ptr = __real_calloc(n, size);
+
+    bench_heap_add(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    bench_heap_remove(ptr);
+    ptr = __real_realloc(ptr, size);
+    bench_heap_add(ptr);
+    return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    bench_heap_remove(ptr);
+    __real_free(ptr);
+}
+
+int duer_data_available()
+{
+    return DUER_OK;
+}
+
+static double bench_cpu(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_transevt(duer_transevt_e event)
+{
+    pthread_mutex_lock(&s_mutex);
+    s_event = 1;
+    pthread_cond_broadcast(&s_cond);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static void bench_wait_event(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 5 * 1000 * 1000;
+    if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000 * 1000 * 1000;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    while (!s_event) {
+        if (pthread_cond_timedwait(&s_cond, &s_mutex, &ts) != 0) {
+            break;
+        }
+    }
+    s_event = 0;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static duer_status_t bench_session_save(const void *data, duer_size_t size)
+{
+    if (size > sizeof(s_saved)) {
+        return DUER_ERR_FAILED;
+    }
+    if (size == 0 && s_keep_saved) {
+        return DUER_OK;
+    }
+
+    memcpy(s_saved, data, size);
+    s_saved_size = size;
+    return DUER_OK;
+}
+
+static duer_status_t bench_session_load(void *data, duer_size_t size)
+{
+    if (s_saved_size > size) {
+        return DUER_ERR_FAILED;
+    }
+
+    memcpy(data, s_saved, s_saved_size);
+    return s_saved_size;
+}
+
+static int bench_entropy(void *ctx, unsigned char *output, size_t len, size_t *olen)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        output[i] = rand() & 0xff;
+    }
+    *olen = len;
+
+    return 0;
+}
+
+static int bench_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    bench_io_t *io = (bench_io_t *)ctx;
+    ssize_t rs = write(io->fd, buf, len);
+
+    if (rs > 0) {
+        io->bytes += rs;
+    }
+    return rs < 0 ? MBEDTLS_ERR_SSL_INTERNAL_ERROR : (int)rs;
+}
+
+static int bench_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    bench_io_t *io = (bench_io_t *)ctx;
+    ssize_t rs = read(io->fd, buf, len);
+
+    if (rs > 0) {
+        io->bytes += rs;
+    }
+    return rs < 0 ? MBEDTLS_ERR_SSL_INTERNAL_ERROR : (int)rs;
+}
+
+// count the sessions the server resumes
+static int bench_cache_get(void *data, mbedtls_ssl_session *session)
+{
+    int rs = mbedtls_ssl_cache_get(data, session);
+
+    if (rs == 0) {
+        s_resumed++;
+    }
+    return rs;
+}
+
+static int bench_ticket_parse(void *p_ticket, mbedtls_ssl_session *session,
+                              unsigned char *buf, size_t len)
+{
+    int rs = mbedtls_ssl_ticket_parse(p_ticket, session, buf, len);
+
+    if (rs == 0) {
+        s_resumed++;
+    }
+    return rs;
+}
+
+static void bench_server_setup(bench_server_t *server)
+{
+    const char *crt = mbedtls_test_srv_crt_rsa;
+    size_t crt_len = mbedtls_test_srv_crt_rsa_len;
+    const char *key = mbedtls_test_srv_key_rsa;
+    size_t key_len = mbedtls_test_srv_key_rsa_len;
+
+#if defined(MBEDTLS_ECDSA_C)
+    if (server->suite && server->suite->ec) {
+        crt = mbedtls_test_srv_crt_ec;
+        crt_len = mbedtls_test_srv_crt_ec_len;
+        key = mbedtls_test_srv_key_ec;
+        key_len = mbedtls_test_srv_key_ec_len;
+    }
+#endif
+
+    mbedtls_entropy_init(&server->entropy);
+    mbedtls_ctr_drbg_init(&server->drbg);
+    mbedtls_x509_crt_init(&server->crt);
+    mbedtls_pk_init(&server->key);
+    mbedtls_ssl_config_init(&server->conf);
+    mbedtls_ssl_cache_init(&server->cache);
+    mbedtls_ssl_ticket_init(&server->ticket);
+
+    if (mbedtls_entropy_add_source(&server->entropy, bench_entropy, NULL, 32,
+                                   MBEDTLS_ENTROPY_SOURCE_STRONG) != 0
+            || mbedtls_ctr_drbg_seed(&server->drbg, mbedtls_entropy_func,
+                                     &server->entropy, NULL, 0) != 0
+            || mbedtls_x509_crt_parse(&server->crt, (const unsigned char *)crt, crt_len) != 0
+            || mbedtls_pk_parse_key(&server->key, (const unsigned char *)key, key_len,
+                                    NULL, 0) != 0
+            || mbedtls_ssl_config_defaults(&server->conf, MBEDTLS_SSL_IS_SERVER,
+                                           MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT) != 0
+            || mbedtls_ssl_conf_own_cert(&server->conf, &server->crt, &server->key) != 0) {
+        BENCH_PRINT("server setup failed\n");
+        exit(1);
+    }
+
+    mbedtls_ssl_conf_rng(&server->conf, mbedtls_ctr_drbg_random, &server->drbg);
+
+    if (server->suite) {
+        server->suites[0] = server->suite->id;
+        server->suites[1] = 0;
+        mbedtls_ssl_conf_ciphersuites(&server->conf, server->suites);
+    }
+
+    if (server->mode == BENCH_ID) {
+        mbedtls_ssl_conf_session_cache(&server->conf, &server->cache,
+                                       bench_cache_get, mbedtls_ssl_cache_set);
+    } else if (server->mode == BENCH_TICKET || server->mode == BENCH_PERSIST) {
+        if (mbedtls_ssl_ticket_setup(&server->ticket, mbedtls_ctr_drbg_random,
+                                     &server->drbg, MBEDTLS_CIPHER_AES_256_CCM,
+                                     86400) != 0) {
+            BENCH_PRINT("ticket setup failed\n");
+            exit(1);
+        }
+        mbedtls_ssl_conf_session_tickets_cb(&server->conf, mbedtls_ssl_ticket_write,
+                                            bench_ticket_parse, &server->ticket);
+    }
+}
+
+static void bench_server_free(bench_server_t *server)
+{
+    mbedtls_ssl_ticket_free(&server->ticket);
+    mbedtls_ssl_cache_free(&server->cache);
+    mbedtls_ssl_config_free(&server->conf);
+    mbedtls_pk_free(&server->key);
+    mbedtls_x509_crt_free(&server->crt);
+    mbedtls_ctr_drbg_free(&server->drbg);
+    mbedtls_entropy_free(&server->entropy);
+}
+
+/*
+ * Read the bytes the client sends, ack them, then send them back
+ */
+static void bench_server_stream(mbedtls_ssl_context *ssl, unsigned long stream)
+{
+    unsigned char buf[1024];
+    unsigned long done = 0;
+    int rs;
+
+    memset(buf, 0x5a, sizeof(buf));
+
+    while (done < stream) {
+        rs = mbedtls_ssl_read(ssl, buf, sizeof(buf));
+        if (rs <= 0) {
+            return;
+        }
+        done += rs;
+    }
+
+    if (mbedtls_ssl_write(ssl, buf, 1) != 1) {
+        return;
+    }
+
+    for (done = 0; done < stream; done += rs) {
+        rs = mbedtls_ssl_write(ssl, buf, stream - done < sizeof(buf) ? stream - done : sizeof(buf));
+        if (rs <= 0) {
+            return;
+        }
+    }
+}
+
+static void *bench_server(void *arg)
+{
+    bench_server_t *server = (bench_server_t *)arg;
+    mbedtls_ssl_context ssl;
+    unsigned char buf[256];
+    bench_io_t io;
+    double cpu;
+    long i;
+    int one = 1;
+    int rs;
+
+    for (i = 0; i < server->count; i++) {
+        io.fd = accept(server->listener, NULL, NULL);
+        io.bytes = 0;
+        if (io.fd < 0) {
+            break;
+        }
+        setsockopt(io.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        mbedtls_ssl_init(&ssl);
+        mbedtls_ssl_setup(&ssl, &server->conf);
+        mbedtls_ssl_set_bio(&ssl, &io, bench_send, bench_recv, NULL);
+
+        cpu = bench_cpu();
+        rs = mbedtls_ssl_handshake(&ssl);
+        s_server_cpu += bench_cpu() - cpu;
+        s_bytes += io.bytes;
+        if (rs != 0) {
+            s_failed++;
+        } else {
+            s_negotiated = mbedtls_ssl_get_ciphersuite(&ssl);
+        }
+
+        if (rs == 0 && server->stream > 0) {
+            bench_server_stream(&ssl, server->stream);
+        }
+
+        // until the client closes
+        while (rs == 0 && mbedtls_ssl_read(&ssl, buf, sizeof(buf)) > 0) {
+        }
+
+        mbedtls_ssl_free(&ssl);
+        close(io.fd);
+    }
+
+    return NULL;
+}
+
+static int bench_listen(int *port)
+{
+    struct sockaddr_in addr_in;
+    socklen_t len = sizeof(addr_in);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr_in, 0, sizeof(addr_in));
+    addr_in.sin_family = AF_INET;
+    addr_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr_in, sizeof(addr_in)) < 0
+            || listen(fd, 16) < 0
+            || getsockname(fd, (struct sockaddr *)&addr_in, &len) < 0) {
+        BENCH_PRINT("listen failed\n");
+        exit(1);
+    }
+
+    *port = ntohs(addr_in.sin_port);
+    return fd;
+}
+
+static duer_status_t bench_connect(duer_trans_handler trans, int port)
+{
+    duer_addr_t addr;
+    duer_status_t rs;
+
+    addr.type = DUER_PROTO_TCP;
+    addr.port = port;
+    addr.host = "127.0.0.1";
+    addr.host_size = strlen(addr.host);
+
+    for (;;) {
+        rs = duer_trans_connect(trans, &addr);
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+            return rs;
+        }
+        bench_wait_event();
+    }
+}
+
+static void bench_run(bench_mode_e mode, const bench_suite_t *suite, long count)
+{
+    bench_server_t server;
+    pthread_t thread;
+    duer_trans_handler trans;
+    bench_heap_t heap;
+    unsigned long mallocs = 0;
+    unsigned long long bytes = 0;
+    long long peak = 0;
+    long long base;
+    double elapsed = 0;
+    double cpu = 0;
+    double start;
+    double start_cpu;
+    long failed = 0;
+    long i;
+    int port;
+
+    memset(&server, 0, sizeof(server));
+    server.listener = bench_listen(&port);
+    server.count = count;
+    server.mode = mode;
+    server.suite = suite;
+    bench_server_setup(&server);
+
+    s_bytes = 0;
+    s_server_cpu = 0;
+    s_resumed = 0;
+    s_failed = 0;
+    s_negotiated = NULL;
+    duer_trans_encrypted_forget_session();
+    s_saved_size = 0;
+    baidu_ca_tls_session_init(mode == BENCH_PERSIST ? bench_session_save : NULL,
+                              mode == BENCH_PERSIST ? bench_session_load : NULL);
+
+    pthread_create(&thread, NULL, bench_server, &server);
+
+    for (i = 0; i < count; i++) {
+        if (mode == BENCH_PERSIST) {
+            // as if rebooted, only the session saved is left
+            s_keep_saved = 1;
+            duer_trans_encrypted_forget_session();
+            s_keep_saved = 0;
+            baidu_ca_tls_session_init(bench_session_save, bench_session_load);
+        }
+
+        bench_heap_reset();
+        bench_heap_get(&heap);
+        base = heap.in_use;
+
+        trans = duer_trans_acquire(bench_transevt, NULL);
+        duer_trans_set_pk(trans, mbedtls_test_cas_pem, mbedtls_test_cas_pem_len);
+
+        start = bench_now();
+        start_cpu = bench_cpu();
+        if (bench_connect(trans, port) != DUER_OK) {
+            failed++;
+        }
+        cpu += bench_cpu() - start_cpu;
+        elapsed += bench_now() - start;
+
+        duer_trans_release(trans);
+
+        bench_heap_get(&heap);
+        mallocs += heap.mallocs;
+        bytes += heap.bytes;
+        if (heap.peak - base > peak) {
+            peak = heap.peak - base;
+        }
+    }
+
+    pthread_join(thread, NULL);
+    close(server.listener);
+    bench_server_free(&server);
+
+    if (suite) {
+        BENCH_PRINT("%-30s %4ld handshakes: failed %ld/%ld, wall %7.2f ms, "
+                    "client cpu %6.2f ms, server cpu %6.2f ms, %5lu bytes, "
+                    "client peak heap %6lld bytes\n",
+                    suite->name, count, failed, s_failed, elapsed * 1e3 / count,
+                    cpu * 1e3 / count, s_server_cpu * 1e3 / count, s_bytes / count, peak);
+        return;
+    }
+
+    BENCH_PRINT("%-8s %4ld connections: resumed %4ld, failed %ld/%ld, "
+                "handshake %7.2f ms, client cpu %6.2f ms, server cpu %6.2f ms, %5lu bytes\n",
+                s_mode_names[mode], count, s_resumed, failed, s_failed,
+                elapsed * 1e3 / count, cpu * 1e3 / count, s_server_cpu * 1e3 / count,
+                s_bytes / count);
+    BENCH_PRINT("%-8s client heap by connection: %5.1f mallocs, %6llu bytes allocated, "
+                "%6lld bytes peak, %s\n",
+                "", (double)mallocs / count, bytes / count, peak,
+                s_negotiated ? s_negotiated : "none");
+}
+
+static duer_status_t bench_recv_all(duer_trans_handler trans, unsigned long bytes)
+{
+    unsigned char buf[4096];
+    unsigned long done = 0;
+    duer_status_t rs;
+
+    while (done < bytes) {
+        rs = duer_trans_recv(trans, buf, sizeof(buf), NULL);
+        if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+            bench_wait_event();
+            continue;
+        }
+        if (rs <= 0) {
+            return DUER_ERR_FAILED;
+        }
+        done += rs;
+    }
+
+    return DUER_OK;
+}
+
+static void bench_records(duer_size_t in_size, duer_size_t out_size, unsigned long bytes)
+{
+    bench_server_t server;
+    pthread_t thread;
+    duer_trans_handler trans;
+    bench_heap_t heap;
+    unsigned char msg[1024];
+    unsigned long done;
+    long long base;
+    long long idle = 0;
+    long long peak = 0;
+    double up = 0;
+    double down = 0;
+    double start;
+    duer_status_t rs = DUER_ERR_FAILED;
+    int port;
+
+    memset(&server, 0, sizeof(server));
+    server.listener = bench_listen(&port);
+    server.count = 1;
+    server.mode = BENCH_FULL;
+    server.stream = bytes;
+    bench_server_setup(&server);
+    memset(msg, 0xa5, sizeof(msg));
+
+    s_failed = 0;
+    duer_trans_encrypted_forget_session();
+    baidu_ca_tls_session_init(NULL, NULL);
+    pthread_create(&thread, NULL, bench_server, &server);
+
+    bench_heap_reset();
+    bench_heap_get(&heap);
+    base = heap.in_use;
+
+    trans = duer_trans_acquire(bench_transevt, NULL);
+    duer_trans_set_pk(trans, mbedtls_test_cas_pem, mbedtls_test_cas_pem_len);
+    if (duer_trans_set_record_size(trans, in_size, out_size) != DUER_OK
+            || bench_connect(trans, port) != DUER_OK) {
+        goto exit;
+    }
+
+    start = bench_now();
+    for (done = 0; done < bytes; done += rs) {
+        rs = duer_trans_send(trans, msg, bytes - done < sizeof(msg) ? bytes - done : sizeof(msg),
+                             NULL);
+        if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+            bench_wait_event();
+            rs = 0;
+        } else if (rs <= 0) {
+            goto exit;
+        }
+    }
+    if ((rs = bench_recv_all(trans, 1)) != DUER_OK) {
+        goto exit;
+    }
+    up = bench_now() - start;
+
+    start = bench_now();
+    if ((rs = bench_recv_all(trans, bytes)) != DUER_OK) {
+        goto exit;
+    }
+    down = bench_now() - start;
+
+    // the connection is live, nothing in flight, as the engine's idle timer does
+    duer_trans_release_idle(trans);
+    bench_heap_get(&heap);
+    idle = heap.in_use - base;
+    peak = heap.peak - base;
+
+exit:
+    duer_trans_release(trans);
+    pthread_join(thread, NULL);
+    close(server.listener);
+    bench_server_free(&server);
+
+    if (rs != DUER_OK || s_failed > 0) {
+        BENCH_PRINT("record in %4lu, out %4lu: failed %d\n",
+                    (unsigned long)in_size, (unsigned long)out_size, rs);
+        return;
+    }
+
+    BENCH_PRINT("record in %4lu, out %4lu: client heap idle %6lld bytes, peak %6lld bytes, "
+                "send %6.1f MB/s, recv %6.1f MB/s\n",
+                (unsigned long)in_size, (unsigned long)out_size, idle, peak,
+                bytes / up / 1e6, bytes / down / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    static const duer_size_t records[][2] = {
+        {0, 0}, {2048, 2048}, {1024, 1024}, {512, 512}, {512, 1024}, {4096, 4096},
+    };
+    long count = bench_arg(argc, argv, "count", 50);
+    long bytes = bench_arg(argc, argv, "bytes", 1024 * 1024);
+    size_t i;
+    int mode;
+
+    bench_init(bench_arg(argc, argv, "verbose", 0));
+    bench_heap_libc();
+    bcasoc_initialize();
+    baidu_ca_transport_init(bcasoc_create, bcasoc_connect, bcasoc_send, bcasoc_recv,
+                            NULL, bcasoc_close, bcasoc_destroy);
+
+    for (mode = 0; mode < BENCH_MODES; mode++) {
+        bench_run((bench_mode_e)mode, NULL, count);
+    }
+
+    BENCH_PRINT("\n");
+    for (i = 0; i < sizeof(s_suites) / sizeof(s_suites[0]); i++) {
+        if (!mbedtls_ssl_ciphersuite_from_id(s_suites[i].id)) {
+            BENCH_PRINT("%-30s not built\n", s_suites[i].name);
+            continue;
+        }
+        bench_run(BENCH_FULL, &s_suites[i], count);
+    }
+
+    BENCH_PRINT("\nthe largest record %d bytes\n", MBEDTLS_SSL_MAX_CONTENT_LEN);
+    for (i = 0; i < sizeof(records) / sizeof(records[0]); i++) {
+        if (records[i][0] > MBEDTLS_SSL_MAX_CONTENT_LEN) {
+            continue;
+        }
+        bench_records(records[i][0], records[i][1], bytes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,560 @@
+#
+# Copyright (2017) Baidu Inc. All rights reserveed.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+##
+# Build for the benchmarks, such as:
+#   make CUSTOMER=linux bench-memory
+#   make CUSTOMER=linux DUER_MEMORY_POOL=true bench-memory
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)/examples/benchmark
+
+LOCAL_MODULE := bench-memory
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/bench_common.c \
+    $(MODULE_PATH)/bench_memory.c
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)/examples/benchmark
+
+LOCAL_MODULE := bench-dcs
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/bench_common.c \
+    $(MODULE_PATH)/bench_dcs.c
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)/examples/benchmark
+
+LOCAL_MODULE := bench-qcache
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/bench_common.c \
+    $(MODULE_PATH)/bench_qcache.c
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+# the events looper is built from the linux port directly,
+# the port-linux library depends on the whole SDK
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-events
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_events.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-priority
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_priority.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-coalesce
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_coalesce.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-timers
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_timers.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_timers.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-socket
+
+LOCAL_STATIC_LIBRARIES := framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_socket.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-connect
+
+LOCAL_STATIC_LIBRARIES := framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_connect.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-dns
+
+LOCAL_STATIC_LIBRARIES := framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_dns.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-sendv
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_sendv.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread -Wl,--wrap=memcpy
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+# the transport is built here with the AES-CBC encryption,
+# the framework library has the mbedtls one
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-sendv-aes
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_sendv.c \
+    $(MODULE_PATH)/framework/core/lightduer_net_transport.c \
+    $(MODULE_PATH)/framework/core/lightduer_net_transport_wrapper.c \
+    $(MODULE_PATH)/framework/core/lightduer_net_trans_aes_cbc_encrypted.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_CDEFS := NET_TRANS_ENCRYPTED_BY_AES_CBC
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread -Wl,--wrap=memcpy
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-recv
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_recv.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread -Wl,--wrap=recv
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the TLS handshake benchmark
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-tls
+
+LOCAL_STATIC_LIBRARIES := framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_tls.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_CDEFS := MBEDTLS_CONFIG_FILE=\"baidu_ca_mbedtls_config.h\"
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/connagent \
+    $(MODULE_PATH)/external/mbedtls-port
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread \
+    -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc -Wl,--wrap=free
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the AES-CBC transport throughput benchmark
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-aes
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_aes.c \
+    $(MODULE_PATH)/framework/core/lightduer_net_transport.c \
+    $(MODULE_PATH)/framework/core/lightduer_net_transport_wrapper.c \
+    $(MODULE_PATH)/framework/core/lightduer_net_trans_aes_cbc_encrypted.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent \
+    $(MODULE_PATH)/external/mbedtls-port
+
+LOCAL_CDEFS := NET_TRANS_ENCRYPTED_BY_AES_CBC MBEDTLS_CONFIG_FILE=\"baidu_ca_mbedtls_config.h\"
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the AES cycles per byte benchmark
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-aes-cpb
+
+LOCAL_STATIC_LIBRARIES := framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_aes_cpb.c
+
+LOCAL_CDEFS := MBEDTLS_CONFIG_FILE=\"baidu_ca_mbedtls_config.h\"
+
+LOCAL_INCLUDES := $(MODULE_PATH)/external/mbedtls-port
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the CoAP resource dispatch benchmark
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-dispatch
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_dispatch.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/modules/coap
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the CoAP blockwise transfer benchmark
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-blockwise
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_blockwise.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the CoAP in-flight window benchmark
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-pipeline
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_pipeline.c \
+    $(MODULE_PATH)/platform/source-linux/baidu_ca_socket_adp.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/platform/source-linux \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+##
+# Build for the report batching benchmark, the engine with the CA stubbed
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-batch
+
+LOCAL_STATIC_LIBRARIES := coap nsdl framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_batch.c \
+    $(MODULE_PATH)/modules/connagent/lightduer_engine.c \
+    $(MODULE_PATH)/modules/connagent/lightduer_report_deflate.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_timers.c \
+    $(wildcard $(MODULE_PATH)/modules/OTA/Zliblite/*.c)
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent \
+    $(MODULE_PATH)/modules/OTA/Zliblite
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-response
+
+LOCAL_STATIC_LIBRARIES := framework cjson mbedtls
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_response.c \
+    $(MODULE_PATH)/modules/connagent/lightduer_engine.c \
+    $(MODULE_PATH)/modules/connagent/lightduer_report_deflate.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_events.c \
+    $(MODULE_PATH)/platform/source-linux/lightduer_timers.c \
+    $(wildcard $(MODULE_PATH)/modules/OTA/Zliblite/*.c)
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/platform/include \
+    $(MODULE_PATH)/modules/coap \
+    $(MODULE_PATH)/modules/connagent \
+    $(MODULE_PATH)/modules/OTA/Zliblite
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+ifeq ($(strip $(DUER_REPORT_DEFLATE)),true)
+
+##
+# Build for the report payload compression benchmark,
+# make DUER_REPORT_DEFLATE=true bench-deflate
+#
+
+include $(CLEAR_VAR)
+
+MODULE_PATH := $(BASE_DIR)
+
+LOCAL_MODULE := bench-deflate
+
+LOCAL_STATIC_LIBRARIES := framework cjson
+
+LOCAL_SRC_FILES := \
+    $(MODULE_PATH)/examples/benchmark/bench_common.c \
+    $(MODULE_PATH)/examples/benchmark/bench_deflate.c \
+    $(MODULE_PATH)/modules/connagent/lightduer_report_deflate.c \
+    $(wildcard $(MODULE_PATH)/modules/OTA/Zliblite/*.c)
+
+LOCAL_INCLUDES := \
+    $(MODULE_PATH)/modules/connagent \
+    $(MODULE_PATH)/modules/OTA/Zliblite
+
+LOCAL_LDFLAGS := -lm -lrt -lpthread
+
+include $(BUILD_EXECUTABLE)
+
+endif
@@ -93,10 +93,25 @@ void baidu_json_InitHooks(baidu_json_Hooks* hooks)
     baidu_json_free = (hooks->free_fn) ? hooks->free_fn : free;
 }
 
+/* The allocator used by the parser, the global hooks or the one supplied to baidu_json_ParseWithAllocator. */
+typedef struct internal_hooks
+{
+    void *ctx;
+    void *(*allocate)(void *ctx, size_t sz);
+} internal_hooks;
+
+static void *global_allocate(void *ctx, size_t sz)
+{
+    (void)ctx;
+    return baidu_json_malloc(sz);
+}
+
+static const internal_hooks global_hooks = { 0, global_allocate };
+
 /* Internal constructor. */
-static baidu_json *baidu_json_New_Item(void)
+static baidu_json *baidu_json_New_Item_With(const internal_hooks *hooks)
 {
-    baidu_json* node = (baidu_json*)baidu_json_malloc(sizeof(baidu_json));
+    baidu_json* node = (baidu_json*)hooks->allocate(hooks->ctx, sizeof(baidu_json));
     if (node)
     {
         memset(node, 0, sizeof(baidu_json));
@@ -105,6 +120,11 @@ static baidu_json *baidu_json_New_Item(void)
     return node;
 }
 
+static baidu_json *baidu_json_New_Item(void)
+{
+    return baidu_json_New_Item_With(&global_hooks);
+}
+
 /* Delete a baidu_json structure. */
 void baidu_json_Delete(baidu_json *c)
 {
@@ -443,7 +463,7 @@ static const unsigned char firstByteMark[7] =
 };
 
 /* Parse the input text into an unescaped cstring, and populate item. */
-static const char *parse_string(baidu_json *item, const char *str, const char **ep)
+static const char *parse_string(baidu_json *item, const char *str, const char **ep, const internal_hooks *hooks)
 {
     const char *ptr = str + 1;
     const char *end_ptr =str + 1;
@@ -475,7 +495,7 @@ static const char *parse_string(baidu_json *item, const char *str, const char **
     }
 
     /* This is at most how long we need for the string, roughly. */
-    out = (char*)baidu_json_malloc(len + 1);
+    out = (char*)hooks->allocate(hooks->ctx, len + 1);
     if (!out)
     {
         return 0;
@@ -766,11 +786,11 @@ static char *print_string(const baidu_json *item, printbuffer *p)
 }
 
 /* Predeclare these prototypes. */
-static const char *parse_value(baidu_json *item, const char *value, const char **ep);
+static const char *parse_value(baidu_json *item, const char *value, const char **ep, const internal_hooks *hooks);
 static char *print_value(const baidu_json *item, int depth, int fmt, printbuffer *p);
-static const char *parse_array(baidu_json *item, const char *value, const char **ep);
+static const char *parse_array(baidu_json *item, const char *value, const char **ep, const internal_hooks *hooks);
 static char *print_array(const baidu_json *item, int depth, int fmt, printbuffer *p);
-static const char *parse_object(baidu_json *item, const char *value, const char **ep);
+static const char *parse_object(baidu_json *item, const char *value, const char **ep, const internal_hooks *hooks);
 static char *print_object(const baidu_json *item, int depth, int fmt, printbuffer *p);
 
 /* Utility to jump whitespace and cr/lf */
@@ -785,23 +805,26 @@ static const char *skip(const char *in)
 }
 
 /* Parse an object - create a new root, and populate. */
-baidu_json *baidu_json_ParseWithOpts(const char *value, const char **return_parse_end, int require_null_terminated)
+static baidu_json *parse_with_hooks(const char *value, const char **return_parse_end, int require_null_terminated, const internal_hooks *hooks)
 {
     const char *end = 0;
     /* use global error pointer if no specific one was given */
     const char **ep = return_parse_end ? return_parse_end : &global_ep;
-    baidu_json *c = baidu_json_New_Item();
+    baidu_json *c = baidu_json_New_Item_With(hooks);
     *ep = 0;
     if (!c) /* memory fail */
     {
         return 0;
     }
 
-    end = parse_value(c, skip(value), ep);
+    end = parse_value(c, skip(value), ep, hooks);
     if (!end)
     {
-        /* parse failure. ep is set. */
-        baidu_json_Delete(c);
+        /* parse failure. ep is set. the allocator owns the memory if supplied. */
+        if (hooks == &global_hooks)
+        {
+            baidu_json_Delete(c);
+        }
         return 0;
     }
 
@@ -811,7 +834,10 @@ baidu_json *baidu_json_ParseWithOpts(const char *value, const char **return_pars
         end = skip(end);
         if (*end)
         {
-            baidu_json_Delete(c);
+            if (hooks == &global_hooks)
+            {
+                baidu_json_Delete(c);
+            }
             *ep = end;
             return 0;
         }
@@ -824,6 +850,26 @@ baidu_json *baidu_json_ParseWithOpts(const char *value, const char **return_pars
     return c;
 }
 
+baidu_json *baidu_json_ParseWithOpts(const char *value, const char **return_parse_end, int require_null_terminated)
+{
+    return parse_with_hooks(value, return_parse_end, require_null_terminated, &global_hooks);
+}
+
+baidu_json *baidu_json_ParseWithAllocator(const char *value, const baidu_json_Allocator *allocator)
+{
+    internal_hooks hooks;
+
+    if (!allocator || !allocator->alloc_fn)
+    {
+        return 0;
+    }
+
+    hooks.ctx = allocator->ctx;
+    hooks.allocate = allocator->alloc_fn;
+
+    return parse_with_hooks(value, 0, 0, &hooks);
+}
+
 /* Default options for baidu_json_Parse */
 baidu_json *baidu_json_Parse(const char *value)
 {
@@ -853,7 +899,7 @@ char *baidu_json_PrintBuffered(const baidu_json *item, int prebuffer, int fmt)
 
 
 /* Parser core - when encountering text, process appropriately. */
-static const char *parse_value(baidu_json *item, const char *value, const char **ep)
+static const char *parse_value(baidu_json *item, const char *value, const char **ep, const internal_hooks *hooks)
 {
     if (!value)
     {
@@ -880,7 +926,7 @@ static const char *parse_value(baidu_json *item, const char *value, const char *
     }
     if (*value == '\"')
     {
-        return parse_string(item, value, ep);
+        return parse_string(item, value, ep, hooks);
     }
     if ((*value == '-') || ((*value >= '0') && (*value <= '9')))
     {
@@ -888,11 +934,11 @@ static const char *parse_value(baidu_json *item, const char *value, const char *
     }
     if (*value == '[')
     {
-        return parse_array(item, value, ep);
+        return parse_array(item, value, ep, hooks);
     }
     if (*value == '{')
     {
-        return parse_object(item, value, ep);
+        return parse_object(item, value, ep, hooks);
     }
 
     *ep=value;return 0;	/* failure. */
@@ -978,7 +1024,7 @@ static char *print_value(const baidu_json *item, int depth, int fmt, printbuffer
 }
 
 /* Build an array from input text. */
-static const char *parse_array(baidu_json *item,const char *value,const char **ep)
+static const char *parse_array(baidu_json *item,const char *value,const char **ep, const internal_hooks *hooks)
 {
     baidu_json *child;
     if (*value != '[')
@@ -996,14 +1042,14 @@ static const char *parse_array(baidu_json *item,const char *value,const char **e
         return value + 1;
     }
 
-    item->child = child = baidu_json_New_Item();
+    item->child = child = baidu_json_New_Item_With(hooks);
     if (!item->child)
     {
         /* memory fail */
         return 0;
     }
     /* skip any spacing, get the value. */
-    value = skip(parse_value(child, skip(value), ep));
+    value = skip(parse_value(child, skip(value), ep, hooks));
     if (!value)
     {
         return 0;
@@ -1013,7 +1059,7 @@ static const char *parse_array(baidu_json *item,const char *value,const char **e
     while (*value == ',')
     {
         baidu_json *new_item;
-        if (!(new_item = baidu_json_New_Item()))
+        if (!(new_item = baidu_json_New_Item_With(hooks)))
         {
             /* memory fail */
             return 0;
@@ -1024,7 +1070,7 @@ static const char *parse_array(baidu_json *item,const char *value,const char **e
         child = new_item;
 
         /* go to the next comma */
-        value = skip(parse_value(child, skip(value + 1), ep));
+        value = skip(parse_value(child, skip(value + 1), ep, hooks));
         if (!value)
         {
             /* memory fail */
@@ -1211,7 +1257,7 @@ static char *print_array(const baidu_json *item, int depth, int fmt, printbuffer
 }
 
 /* Build an object from the text. */
-static const char *parse_object(baidu_json *item, const char *value, const char **ep)
+static const char *parse_object(baidu_json *item, const char *value, const char **ep, const internal_hooks *hooks)
 {
     baidu_json *child;
     if (*value != '{')
@@ -1229,14 +1275,14 @@ static const char *parse_object(baidu_json *item, const char *value, const char
         return value + 1;
     }
 
-    child = baidu_json_New_Item();
+    child = baidu_json_New_Item_With(hooks);
     item->child = child;
     if (!item->child)
     {
         return 0;
     }
     /* parse first key */
-    value = skip(parse_string(child, skip(value), ep));
+    value = skip(parse_string(child, skip(value), ep, hooks));
     if (!value)
     {
         return 0;
@@ -1252,7 +1298,7 @@ static const char *parse_object(baidu_json *item, const char *value, const char
         return 0;
     }
     /* skip any spacing, get the value. */
-    value = skip(parse_value(child, skip(value + 1), ep));
+    value = skip(parse_value(child, skip(value + 1), ep, hooks));
     if (!value)
     {
         return 0;
@@ -1261,7 +1307,7 @@ static const char *parse_object(baidu_json *item, const char *value, const char
     while (*value == ',')
     {
         baidu_json *new_item;
-        if (!(new_item = baidu_json_New_Item()))
+        if (!(new_item = baidu_json_New_Item_With(hooks)))
         {
             /* memory fail */
             return 0;
@@ -1271,7 +1317,7 @@ static const char *parse_object(baidu_json *item, const char *value, const char
         new_item->prev = child;
 
         child = new_item;
-        value = skip(parse_string(child, skip(value + 1), ep));
+        value = skip(parse_string(child, skip(value + 1), ep, hooks));
         if (!value)
         {
             return 0;
@@ -1288,7 +1334,7 @@ static const char *parse_object(baidu_json *item, const char *value, const char
             return 0;
         }
         /* skip any spacing, get the value. */
-        value = skip(parse_value(child, skip(value + 1), ep));
+        value = skip(parse_value(child, skip(value + 1), ep, hooks));
         if (!value)
         {
             return 0;
@@ -1938,6 +1984,70 @@ baidu_json *baidu_json_CreateObject(void)
     return item;
 }
 
+/* The hooks of the allocator, or the global hooks if it's NULL. */
+static const internal_hooks *allocator_hooks(const baidu_json_Allocator *allocator, internal_hooks *hooks)
+{
+    if (!allocator || !allocator->alloc_fn)
+    {
+        return &global_hooks;
+    }
+
+    hooks->ctx = allocator->ctx;
+    hooks->allocate = allocator->alloc_fn;
+
+    return hooks;
+}
+
+baidu_json *baidu_json_CreateObjectWithAllocator(const baidu_json_Allocator *allocator)
+{
+    internal_hooks hooks;
+    baidu_json *item = baidu_json_New_Item_With(allocator_hooks(allocator, &hooks));
+    if (item)
+    {
+        item->type = baidu_json_Object;
+    }
+
+    return item;
+}
+
+baidu_json *baidu_json_CreateNumberWithAllocator(double num, const baidu_json_Allocator *allocator)
+{
+    internal_hooks hooks;
+    baidu_json *item = baidu_json_New_Item_With(allocator_hooks(allocator, &hooks));
+    if (item)
+    {
+        item->type = baidu_json_Number;
+        item->valuedouble = num;
+        item->valueint = (int)num;
+    }
+
+    return item;
+}
+
+baidu_json *baidu_json_CreateStringWithAllocator(const char *string, const baidu_json_Allocator *allocator)
+{
+    internal_hooks hooks;
+    const internal_hooks *used = allocator_hooks(allocator, &hooks);
+    size_t len = strlen(string) + 1;
+    baidu_json *item = baidu_json_New_Item_With(used);
+    if (item)
+    {
+        item->type = baidu_json_String;
+        item->valuestring = (char*)used->allocate(used->ctx, len);
+        if (!item->valuestring)
+        {
+            if (used == &global_hooks)
+            {
+                baidu_json_Delete(item);
+            }
+            return 0;
+        }
+        memcpy(item->valuestring, string, len);
+    }
+
+    return item;
+}
+
 /* Create Arrays: */
 baidu_json *baidu_json_CreateIntArray(const int *numbers, int count)
 {
@@ -74,6 +74,13 @@ typedef struct baidu_json_Hooks
 /* Supply malloc, realloc and free functions to baidu_json */
 extern void baidu_json_InitHooks(baidu_json_Hooks* hooks);
 
+/* The allocator for baidu_json_ParseWithAllocator, such as an arena. */
+typedef struct baidu_json_Allocator
+{
+      void *ctx;
+      void *(*alloc_fn)(void *ctx, size_t sz);
+} baidu_json_Allocator;
+
 
 /* Supply a block of JSON, and this returns a baidu_json object you can interrogate. Call baidu_json_Delete when finished. */
 extern baidu_json *baidu_json_Parse(const char *value);
@@ -106,6 +113,13 @@ extern baidu_json *baidu_json_CreateString(const char *string);
 extern baidu_json *baidu_json_CreateArray(void);
 extern baidu_json *baidu_json_CreateObject(void);
 
+/* Create the items with the memory from the allocator, or by the hooks if it's NULL.
+   The items from an allocator are released together with it: add them by baidu_json_AddItemToObjectCS,
+   and don't call baidu_json_Delete on them. */
+extern baidu_json *baidu_json_CreateObjectWithAllocator(const baidu_json_Allocator *allocator);
+extern baidu_json *baidu_json_CreateNumberWithAllocator(double num, const baidu_json_Allocator *allocator);
+extern baidu_json *baidu_json_CreateStringWithAllocator(const char *string, const baidu_json_Allocator *allocator);
+
 /* These utilities create an Array of count items. */
 extern baidu_json *baidu_json_CreateIntArray(const int *numbers, int count);
 extern baidu_json *baidu_json_CreateFloatArray(const float *numbers, int count);
@@ -141,6 +155,10 @@ The item->next and ->prev pointers are always zero on return from Duplicate. */
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error. If not, then baidu_json_GetErrorPtr() does the job. */
 extern baidu_json *baidu_json_ParseWithOpts(const char *value, const char **return_parse_end, int require_null_terminated);
 
+/* Parse with the memory from the allocator, the items are released together with the allocator.
+   Don't call baidu_json_Delete on the result, and don't add the items created by the hooks to it. */
+extern baidu_json *baidu_json_ParseWithAllocator(const char *value, const baidu_json_Allocator *allocator);
+
 extern void baidu_json_Minify(char *json);
 
 extern void baidu_json_release(void *ptr);
@@ -114,6 +114,13 @@ struct sn_coap_hdr_;
 #endif
 
 
+/* The messages with the Block1/Block2 options are passed to the user one block each (the user        */
+/* streams the blocks) instead of rejected, if blockwising is not compiled in. If it is, the responses  */
+/* are passed the same, unless they answer a message blockwised here                                    */
+#ifndef SN_COAP_BLOCKWISE_PASS_THROUGH
+#define SN_COAP_BLOCKWISE_PASS_THROUGH              1
+#endif
+
 #ifndef SN_COAP_BLOCKWISE_MAX_TIME_DATA_STORED
 #define SN_COAP_BLOCKWISE_MAX_TIME_DATA_STORED      10 /**< Maximum time in seconds of data (messages and payload) to be stored for blockwising */
 #endif
@@ -64,6 +64,9 @@ static void                  sn_coap_protocol_linked_list_blockwise_remove_old_d
 static sn_coap_hdr_s        *sn_coap_handle_blockwise_message(struct coap_s *handle, sn_nsdl_addr_s *src_addr_ptr, sn_coap_hdr_s *received_coap_msg_ptr, void *param);
 static int8_t                sn_coap_convert_block_size(uint16_t block_size);
 static sn_coap_hdr_s        *sn_coap_protocol_copy_header(struct coap_s *handle, sn_coap_hdr_s *source_header_ptr);
+#if SN_COAP_BLOCKWISE_PASS_THROUGH
+static bool                  sn_coap_protocol_blockwise_passed(struct coap_s *handle, sn_coap_hdr_s *received_coap_msg_ptr);
+#endif
 #endif
 #if ENABLE_RESENDINGS
 static void                  sn_coap_protocol_linked_list_send_msg_store(struct coap_s *handle, sn_nsdl_addr_s *dst_addr_ptr, uint16_t send_packet_data_len, uint8_t *send_packet_data_ptr, uint32_t sending_time, void *param, uint8_t *uri_path_ptr, uint8_t uri_path_len);
@@ -593,7 +596,7 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
     }
 
 
-#if !SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE /* If Message blockwising is used, this part of code will not be compiled */
+#if !SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE && !SN_COAP_BLOCKWISE_PASS_THROUGH /* If Message blockwising is used, this part of code will not be compiled */
     /* If blockwising used in received message */
     if (returned_dst_coap_msg_ptr->options_list_ptr != NULL &&
             (returned_dst_coap_msg_ptr->options_list_ptr->block1 != COAP_OPTION_BLOCK_NONE ||
@@ -603,7 +606,7 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
         //todo: send response -> not implemented
         return returned_dst_coap_msg_ptr;
     }
-#endif /* !SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE */
+#endif /* !SN_COAP_MAX_BLOCKWISE_PAYLOAD_SIZE && !SN_COAP_BLOCKWISE_PASS_THROUGH */
 
 #if SN_COAP_DUPLICATION_MAX_MSGS_COUNT/* If Message duplication is used, this part of code will not be compiled */
 
@@ -643,7 +646,11 @@ sn_coap_hdr_s *sn_coap_protocol_parse(struct coap_s *handle, sn_nsdl_addr_s *src
 
     if (returned_dst_coap_msg_ptr->options_list_ptr != NULL &&
             (returned_dst_coap_msg_ptr->options_list_ptr->block1 != COAP_OPTION_BLOCK_NONE ||
-             returned_dst_coap_msg_ptr->options_list_ptr->block2 != COAP_OPTION_BLOCK_NONE)) {
+             returned_dst_coap_msg_ptr->options_list_ptr->block2 != COAP_OPTION_BLOCK_NONE)
+#if SN_COAP_BLOCKWISE_PASS_THROUGH
+            && !sn_coap_protocol_blockwise_passed(handle, returned_dst_coap_msg_ptr)
+#endif
+            ) {
         returned_dst_coap_msg_ptr = sn_coap_handle_blockwise_message(handle, src_addr_ptr, returned_dst_coap_msg_ptr, param);
     } else {
         /* Get ... */
@@ -1510,6 +1517,35 @@ void sn_coap_protocol_block_remove(struct coap_s *handle, sn_nsdl_addr_s *source
         }
     }
 }
+#if SN_COAP_BLOCKWISE_PASS_THROUGH
+/**************************************************************************//**
+ * \fn static bool sn_coap_protocol_blockwise_passed(struct coap_s *handle, sn_coap_hdr_s *received_coap_msg_ptr)
+ *
+ * \brief Checks if the received block is passed to the user as it is
+ *
+ * The responses are, unless they answer a message blockwised here (found by
+ * the message ID), as the user sent the blocks and streams them itself.
+ *
+ * \param *received_coap_msg_ptr pointer to parsed CoAP message structure
+ *
+ * \return true if passed to the user, false if handled here
+ *****************************************************************************/
+static bool sn_coap_protocol_blockwise_passed(struct coap_s *handle, sn_coap_hdr_s *received_coap_msg_ptr)
+{
+    if (received_coap_msg_ptr->msg_code <= COAP_MSG_CODE_REQUEST_DELETE) {
+        return false;
+    }
+
+    ns_list_foreach(coap_blockwise_msg_s, msg, &handle->linked_list_blockwise_sent_msgs) {
+        if (msg->coap_msg_ptr && received_coap_msg_ptr->msg_id == msg->coap_msg_ptr->msg_id) {
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
 /**************************************************************************//**
  * \fn static int8_t sn_coap_handle_blockwise_message(void)
  *
@@ -58,6 +58,11 @@ struct grs_s {
 
     uint16_t resource_root_count;
     resource_list_t resource_root_list;
+
+    /* The exact path index of the resources, open addressing by the path hash.
+     * NULL if it's not built, the list is searched then */
+    sn_nsdl_resource_info_s **resource_index;
+    uint16_t resource_index_size;
 };
 
 
@@ -39,10 +39,18 @@
 #define WELLKNOWN_PATH_LEN              16
 #define WELLKNOWN_PATH                  (".well-known/core")
 
+/* The largest path index, the alloc takes uint16_t. The list is searched
+ * if more resources than half of it */
+#define SN_GRS_INDEX_MIN                16
+#define SN_GRS_INDEX_MAX                (0x8000 / sizeof(sn_nsdl_resource_info_s *))
+
 /* Local static function prototypes */
 static int8_t                       sn_grs_resource_info_free(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr);
 static uint8_t                     *sn_grs_convert_uri(uint16_t *uri_len, uint8_t *uri_ptr);
 static int8_t                       sn_grs_add_resource_to_list(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr);
+static void                         sn_grs_index_add(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr);
+static void                         sn_grs_index_remove(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr);
+static void                         sn_grs_index_free(struct grs_s *handle);
 static int8_t                       sn_grs_core_request(struct nsdl_s *handle, sn_nsdl_addr_s *src_addr_ptr, sn_coap_hdr_s *coap_packet_ptr);
 static uint8_t                      coap_tx_callback(uint8_t *, uint16_t, sn_nsdl_addr_s *, void *);
 static int8_t                       coap_rx_callback(sn_coap_hdr_s *coap_ptr, sn_nsdl_addr_s *address_ptr, void *param);
@@ -65,6 +73,7 @@ extern int8_t sn_grs_destroy(struct grs_s *handle)
         --handle->resource_root_count;
         sn_grs_resource_info_free(handle, tmp);
     }
+    sn_grs_index_free(handle);
     handle->sn_grs_free(handle);
 
     return 0;
@@ -259,6 +268,7 @@ extern int8_t sn_grs_delete_resource(struct grs_s *handle, uint16_t pathlen, uin
     /* If found, delete it and delete also subresources, if there is any */
     do {
         /* Remove from list */
+        sn_grs_index_remove(handle, resource_temp);
         ns_list_remove(&handle->resource_root_list, resource_temp);
         --handle->resource_root_count;
 
@@ -368,6 +378,7 @@ int8_t sn_grs_put_resource(struct grs_s *handle, sn_nsdl_resource_info_s *res)
 
     ns_list_add_to_start(&handle->resource_root_list, res);
     ++handle->resource_root_count;
+    sn_grs_index_add(handle, res);
 
     return SN_NSDL_SUCCESS;
 }
@@ -738,6 +749,130 @@ static int8_t sn_grs_core_request(struct nsdl_s *handle, sn_nsdl_addr_s *src_add
     return SN_NSDL_SUCCESS;
 }
 
+/**
+ * \fn  static uint32_t sn_grs_index_hash(uint16_t pathlen, const uint8_t *path)
+ *
+ * \brief FNV-1a hash of the path, for the path index
+ */
+static uint32_t sn_grs_index_hash(uint16_t pathlen, const uint8_t *path)
+{
+    uint32_t hash = 2166136261u;
+
+    while (pathlen--) {
+        hash ^= *path++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * \fn  static uint16_t sn_grs_index_slot(struct grs_s *handle, uint16_t pathlen, const uint8_t *path)
+ *
+ * \brief Finds the slot of the path in the index, or the empty slot it would be put in.
+ *        The paths of the same hash are told apart by comparing them.
+ */
+static uint16_t sn_grs_index_slot(struct grs_s *handle, uint16_t pathlen, const uint8_t *path)
+{
+    uint16_t mask = handle->resource_index_size - 1;
+    uint16_t i = sn_grs_index_hash(pathlen, path) & mask;
+    sn_nsdl_resource_info_s *resource_ptr;
+
+    while ((resource_ptr = handle->resource_index[i]) != NULL) {
+        if (resource_ptr->pathlen == pathlen && 0 == memcmp(resource_ptr->path, path, pathlen)) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static sn_nsdl_resource_info_s *sn_grs_index_search(struct grs_s *handle, uint16_t pathlen, const uint8_t *path)
+{
+    return handle->resource_index[sn_grs_index_slot(handle, pathlen, path)];
+}
+
+static void sn_grs_index_free(struct grs_s *handle)
+{
+    if (handle->resource_index) {
+        handle->sn_grs_free(handle->resource_index);
+        handle->resource_index = NULL;
+        handle->resource_index_size = 0;
+    }
+}
+
+/**
+ * \fn  static void sn_grs_index_add(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr)
+ *
+ * \brief Adds the resource just put in the list to the index. The index is rebuilt from
+ *        the list by double size when it's half full, or dropped if it can't be.
+ */
+static void sn_grs_index_add(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr)
+{
+    uint16_t size = handle->resource_index_size;
+
+    if (handle->resource_index && handle->resource_root_count * 2 <= size) {
+        handle->resource_index[sn_grs_index_slot(handle, resource_ptr->pathlen, resource_ptr->path)] = resource_ptr;
+        return;
+    }
+
+    sn_grs_index_free(handle);
+
+    if (size < SN_GRS_INDEX_MIN) {
+        size = SN_GRS_INDEX_MIN;
+    }
+    while (size < SN_GRS_INDEX_MAX && handle->resource_root_count * 2 > size) {
+        size *= 2;
+    }
+    if (handle->resource_root_count * 2 > size) {
+        return;
+    }
+
+    handle->resource_index = handle->sn_grs_alloc(size * sizeof(sn_nsdl_resource_info_s *));
+    if (!handle->resource_index) {
+        return;
+    }
+    memset(handle->resource_index, 0, size * sizeof(sn_nsdl_resource_info_s *));
+    handle->resource_index_size = size;
+
+    ns_list_foreach(sn_nsdl_resource_info_s, tmp, &handle->resource_root_list) {
+        handle->resource_index[sn_grs_index_slot(handle, tmp->pathlen, tmp->path)] = tmp;
+    }
+}
+
+/**
+ * \fn  static void sn_grs_index_remove(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr)
+ *
+ * \brief Removes the resource from the index, the following entries are shifted back
+ */
+static void sn_grs_index_remove(struct grs_s *handle, sn_nsdl_resource_info_s *resource_ptr)
+{
+    uint16_t mask = handle->resource_index_size - 1;
+    uint16_t hole;
+    uint16_t home;
+    uint16_t j;
+
+    if (!handle->resource_index) {
+        return;
+    }
+
+    hole = sn_grs_index_slot(handle, resource_ptr->pathlen, resource_ptr->path);
+    if (handle->resource_index[hole] != resource_ptr) {
+        return;
+    }
+
+    for (j = (hole + 1) & mask; handle->resource_index[j]; j = (j + 1) & mask) {
+        home = sn_grs_index_hash(handle->resource_index[j]->pathlen, handle->resource_index[j]->path) & mask;
+        if ((hole <= j) ? (home <= hole || home > j) : (home <= hole && home > j)) {
+            handle->resource_index[hole] = handle->resource_index[j];
+            hole = j;
+        }
+    }
+
+    handle->resource_index[hole] = NULL;
+}
+
 /**
  * \fn  static sn_grs_resource_info_s *sn_grs_search_resource(uint16_t pathlen, uint8_t *path, uint8_t search_method)
  *
@@ -769,7 +904,9 @@ sn_nsdl_resource_info_s *sn_grs_search_resource(struct grs_s *handle, uint16_t p
     path_temp_ptr = sn_grs_convert_uri(&pathlen, path);
 
     /* Searchs exact path */
-    if (search_method == SN_GRS_SEARCH_METHOD) {
+    if (search_method == SN_GRS_SEARCH_METHOD && handle->resource_index) {
+        return sn_grs_index_search(handle, pathlen, path_temp_ptr);
+    } else if (search_method == SN_GRS_SEARCH_METHOD) {
         /* Scan all nodes on list */
         ns_list_foreach(sn_nsdl_resource_info_s, resource_search_temp, &handle->resource_root_list) {
             /* If length equals.. */
@@ -922,6 +1059,7 @@ static int8_t sn_grs_add_resource_to_list(struct grs_s *handle, sn_nsdl_resource
     /* Add copied resource to the linked list */
     ns_list_add_to_start(&handle->resource_root_list, resource_copy_ptr);
     ++handle->resource_root_count;
+    sn_grs_index_add(handle, resource_copy_ptr);
 
     return SN_NSDL_SUCCESS;
 }
@@ -25,6 +25,21 @@
 //#define MBEDTLS_HAVE_ASM
 //#define MBEDTLS_HAVE_TIME
 
+/*
+ * The AES instructions of the x86 AES-NI and the ARMv8 Cryptography Extensions
+ * for the AES blocks (duer_aes and the TLS records), and the carry-less
+ * multiplication for AES-GCM on x86. The CPU is checked at runtime, the
+ * software AES runs without them. Define DUER_AES_SOFTWARE to leave them out.
+ */
+#if !defined(DUER_AES_SOFTWARE) && defined(__GNUC__) && defined(__linux__)
+#if defined(__x86_64__)
+#define MBEDTLS_HAVE_ASM
+#define MBEDTLS_AESNI_C
+#elif defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+#define MBEDTLS_AESCE_C
+#endif
+#endif
+
 #if defined(TARGET_UNO_91H)
 #define MBEDTLS_AES_ENCRYPT_CBC_ALT
 #define MBEDTLS_AES_SETKEY_ENC_ALT
@@ -42,6 +57,24 @@
 #define MBEDTLS_KEY_EXCHANGE_RSA_ENABLED
 //#define MBEDTLS_SSL_PROTO_TLS1_1
 
+/*
+ * The forward secret ECDHE-RSA/ECDHE-ECDSA suites with AES-GCM, by the
+ * DUER_TLS_ECDHE=true of the Makefile. The key exchange is on P-256, P-384
+ * is for verifying the certificate chains signed on it. The TLS layer of this
+ * mbedtls version doesn't support Curve25519.
+ */
+#if defined(DUER_TLS_ECDHE)
+#define MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
+#define MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
+#define MBEDTLS_ECP_DP_SECP256R1_ENABLED
+#define MBEDTLS_ECP_DP_SECP384R1_ENABLED
+#define MBEDTLS_ECP_NIST_OPTIM
+#define MBEDTLS_ECDH_C
+#define MBEDTLS_ECDSA_C
+#define MBEDTLS_ECP_C
+#define MBEDTLS_GCM_C
+#endif
+
 /* mbed TLS modules */
 #define MBEDTLS_AES_C
 #define MBEDTLS_ASN1_PARSE_C
@@ -106,7 +139,26 @@
 #define MBEDTLS_SSL_PROTO_TLS1_2
 #endif
 
+/*
+ * The largest record, the record buffers of the connection are sized up to
+ * it: the input by the max_fragment_length negotiated, the output by the
+ * connection, see duer_trans_set_record_size(). They're allocated on use
+ * and released while the connection is idle. DUER_TLS_MAX_CONTENT_LEN=16384
+ * of the Makefile for the servers not supporting the max_fragment_length.
+ */
+#if defined(DUER_TLS_MAX_CONTENT_LEN)
+#define MBEDTLS_SSL_MAX_CONTENT_LEN         DUER_TLS_MAX_CONTENT_LEN
+#else
 #define MBEDTLS_SSL_MAX_CONTENT_LEN         (2*1024)
+#endif
+#define MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+
+// resume the session by the session id or the ticket, see DUER_TLS_SESSION_RESUMPTION,
+// the cache and the ticket are the server side, only linked by the server
+#define MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_CACHE_C
+#define MBEDTLS_SSL_TICKET_C
 
 #define MBEDTLS_NO_PLATFORM_ENTROPY
 
@@ -0,0 +1,66 @@
+/**
+ * \file aesce.h
+ *
+ * \brief AES by the ARMv8 Cryptography Extensions on the AArch64 processors
+ *
+ *  Copyright (2017) Baidu Inc. All rights reserveed.
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef MBEDTLS_AESCE_H
+#define MBEDTLS_AESCE_H
+
+#include "aes.h"
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__) && \
+    ! defined(__ARM_BIG_ENDIAN) && ! defined(MBEDTLS_HAVE_ARM64)
+#define MBEDTLS_HAVE_ARM64
+#endif
+
+#if defined(MBEDTLS_HAVE_ARM64)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          ARMv8 Cryptography Extensions detection routine
+ *
+ * \return         1 if CPU has the AES instructions, 0 otherwise
+ */
+int mbedtls_aesce_has_support( void );
+
+/**
+ * \brief          ARMv8 Cryptography Extensions AES-ECB block en(de)cryption
+ *
+ * \param ctx      AES context, the round keys are the ones expanded by
+ *                 mbedtls_aes_setkey_enc/mbedtls_aes_setkey_dec
+ * \param mode     MBEDTLS_AES_ENCRYPT or MBEDTLS_AES_DECRYPT
+ * \param input    16-byte input block
+ * \param output   16-byte output block
+ *
+ * \return         0 on success (cannot fail)
+ */
+int mbedtls_aesce_crypt_ecb( mbedtls_aes_context *ctx,
+                     int mode,
+                     const unsigned char input[16],
+                     unsigned char output[16] );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBEDTLS_HAVE_ARM64 */
+
+#endif /* MBEDTLS_AESCE_H */
@@ -1101,6 +1101,18 @@
  */
 #define MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
 
+/**
+ * \def MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+ *
+ * Size the record buffers by the SSL context instead of
+ * MBEDTLS_SSL_MAX_CONTENT_LEN: the output by mbedtls_ssl_set_record_len(),
+ * the input by the max_fragment_length negotiated. The buffers are
+ * allocated on use and freed by mbedtls_ssl_release_buffers().
+ *
+ * Uncomment this macro to size the record buffers by the context
+ */
+//#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+
 /**
  * \def MBEDTLS_SSL_PROTO_SSL3
  *
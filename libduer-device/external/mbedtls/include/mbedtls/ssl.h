@@ -851,6 +851,20 @@ struct mbedtls_ssl_context
     size_t out_msglen;          /*!< record header: message length    */
     size_t out_left;            /*!< amount of data not yet written   */
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    /*
+     * Record buffers sized by the context, see mbedtls_ssl_set_record_len()
+     */
+    size_t in_buf_len;          /*!< length of in_buf, 0 if released  */
+    size_t out_buf_len;         /*!< length of out_buf, 0 if released */
+    size_t out_content_len;     /*!< largest record to emit, 0 default*/
+    unsigned char mfl_code;     /*!< max_fragment_length to negotiate */
+    size_t in_msg_off;          /*!< in_msg offset while released     */
+    size_t out_msg_off;         /*!< out_msg offset while released    */
+    unsigned char in_ctr_save[8];   /*!< in_ctr while released        */
+    unsigned char out_ctr_save[8];  /*!< out_ctr while released       */
+#endif
+
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     unsigned char *compress_buf;        /*!<  zlib data buffer        */
 #endif
@@ -2047,6 +2061,47 @@ void mbedtls_ssl_conf_arc4_support( mbedtls_ssl_config *conf, char arc4 );
 int mbedtls_ssl_conf_max_frag_len( mbedtls_ssl_config *conf, unsigned char mfl_code );
 #endif /* MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+/**
+ * \brief          Set the record sizes of this context, instead of the
+ *                 MBEDTLS_SSL_MAX_CONTENT_LEN for both directions.
+ *
+ *                 The output buffer holds records of out_len. The input
+ *                 buffer holds MBEDTLS_SSL_MAX_CONTENT_LEN during the
+ *                 handshake, and the max_fragment_length negotiated by
+ *                 mfl_code after it (MBEDTLS_SSL_MAX_CONTENT_LEN if the
+ *                 peer didn't accept it). The buffers are allocated when
+ *                 they're used, see mbedtls_ssl_release_buffers().
+ *
+ * \note           Call it before the handshake.
+ *
+ * \param ssl      SSL context
+ * \param mfl_code Code for the maximum fragment length to negotiate,
+ *                 overriding the one of the configuration (client), or
+ *                 MBEDTLS_SSL_MAX_FRAG_LEN_NONE for the configuration's
+ * \param out_len  Largest plaintext of the records emitted, from 512 to
+ *                 MBEDTLS_SSL_MAX_CONTENT_LEN, or 0 for the default
+ *
+ * \return         0 if successful or MBEDTLS_ERR_SSL_BAD_INPUT_DATA
+ */
+int mbedtls_ssl_set_record_len( mbedtls_ssl_context *ssl, unsigned char mfl_code,
+                                size_t out_len );
+
+/**
+ * \brief          Free the record buffers while the connection is idle,
+ *                 they're allocated again by the next read, write or
+ *                 handshake, at the length of that time.
+ *
+ * \param ssl      SSL context
+ *
+ * \return         0 if the buffers were released (or weren't allocated),
+ *                 MBEDTLS_ERR_SSL_WANT_READ if received data is pending,
+ *                 MBEDTLS_ERR_SSL_WANT_WRITE if data to send is pending,
+ *                 MBEDTLS_ERR_SSL_BAD_INPUT_DATA during the handshake
+ */
+int mbedtls_ssl_release_buffers( mbedtls_ssl_context *ssl );
+#endif /* MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH */
+
 #if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
 /**
  * \brief          Activate negotiation of truncated HMAC
@@ -138,13 +138,16 @@
 #define MBEDTLS_SSL_PADDING_ADD              0
 #endif
 
-#define MBEDTLS_SSL_BUFFER_LEN  ( MBEDTLS_SSL_MAX_CONTENT_LEN               \
-                        + MBEDTLS_SSL_COMPRESSION_ADD               \
+#define MBEDTLS_SSL_BUFFER_OVERHEAD ( MBEDTLS_SSL_COMPRESSION_ADD       \
                         + 29 /* counter + header + IV */    \
                         + MBEDTLS_SSL_MAC_ADD                       \
                         + MBEDTLS_SSL_PADDING_ADD                   \
                         )
 
+#define MBEDTLS_SSL_BUFFER_LEN  ( MBEDTLS_SSL_MAX_CONTENT_LEN               \
+                        + MBEDTLS_SSL_BUFFER_OVERHEAD               \
+                        )
+
 /*
  * TLS extension flags (for extensions with outgoing ServerHello content
  * that need it (e.g. for RENEGOTIATION_INFO the server already knows because
@@ -461,6 +464,54 @@ static inline size_t mbedtls_ssl_hs_hdr_len( const mbedtls_ssl_context *ssl )
     return( 4 );
 }
 
+/*
+ * The record buffer lengths, MBEDTLS_SSL_BUFFER_LEN unless they're sized by
+ * the context, see MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+ */
+static inline size_t mbedtls_ssl_in_buffer_len( const mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    return( ssl->in_buf_len );
+#else
+    ((void) ssl);
+    return( MBEDTLS_SSL_BUFFER_LEN );
+#endif
+}
+
+static inline size_t mbedtls_ssl_out_buffer_len( const mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    return( ssl->out_buf_len );
+#else
+    ((void) ssl);
+    return( MBEDTLS_SSL_BUFFER_LEN );
+#endif
+}
+
+static inline size_t mbedtls_ssl_in_content_len( const mbedtls_ssl_context *ssl )
+{
+    return( mbedtls_ssl_in_buffer_len( ssl ) - MBEDTLS_SSL_BUFFER_OVERHEAD );
+}
+
+static inline size_t mbedtls_ssl_out_content_len( const mbedtls_ssl_context *ssl )
+{
+    return( mbedtls_ssl_out_buffer_len( ssl ) - MBEDTLS_SSL_BUFFER_OVERHEAD );
+}
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+/*
+ * The max_fragment_length the client negotiates
+ */
+static inline unsigned char mbedtls_ssl_own_mfl_code( const mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ssl->mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE )
+        return( ssl->mfl_code );
+#endif
+    return( ssl->conf->mfl_code );
+}
+#endif
+
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
 void mbedtls_ssl_send_flight_completed( mbedtls_ssl_context *ssl );
 void mbedtls_ssl_recv_flight_completed( mbedtls_ssl_context *ssl );
@@ -0,0 +1,115 @@
+/*
+ *  AES by the ARMv8 Cryptography Extensions
+ *
+ *  Copyright (2017) Baidu Inc. All rights reserveed.
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * [ARMv8-ARM] ARM Architecture Reference Manual ARMv8, C7.2 AESE/AESD/AESMC/AESIMC
+ *
+ * The round keys are the ones of the software key expansion: on the little
+ * endian CPU the encryption keys are the FIPS-197 bytes, and the decryption
+ * keys are already the equivalent inverse cipher ones (InvMixColumns
+ * applied), in the order AESD needs.
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_AESCE_C)
+
+#include "mbedtls/aesce.h"
+
+#if defined(MBEDTLS_HAVE_ARM64)
+
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+/*
+ * Only the functions of this file use the AES instructions, they're called
+ * after mbedtls_aesce_has_support()
+ */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("crypto"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target ("+crypto")
+#endif
+
+#include <arm_neon.h>
+
+/*
+ * ARMv8 Cryptography Extensions detection routine
+ */
+int mbedtls_aesce_has_support( void )
+{
+    static int done = 0;
+    static int c = 0;
+
+    if( ! done )
+    {
+        c = ( getauxval( AT_HWCAP ) & HWCAP_AES ) != 0;
+        done = 1;
+    }
+
+    return( c );
+}
+
+/*
+ * ARMv8 Cryptography Extensions AES-ECB block en(de)cryption
+ */
+int mbedtls_aesce_crypt_ecb( mbedtls_aes_context *ctx,
+                     int mode,
+                     const unsigned char input[16],
+                     unsigned char output[16] )
+{
+    const unsigned char *rk = (const unsigned char *) ctx->rk;
+    uint8x16_t block = vld1q_u8( input );
+    int i;
+
+    if( mode == MBEDTLS_AES_ENCRYPT )
+    {
+        for( i = 1; i < ctx->nr; i++, rk += 16 )
+            block = vaesmcq_u8( vaeseq_u8( block, vld1q_u8( rk ) ) );
+
+        block = vaeseq_u8( block, vld1q_u8( rk ) );
+    }
+    else
+    {
+        for( i = 1; i < ctx->nr; i++, rk += 16 )
+            block = vaesimcq_u8( vaesdq_u8( block, vld1q_u8( rk ) ) );
+
+        block = vaesdq_u8( block, vld1q_u8( rk ) );
+    }
+
+    block = veorq_u8( block, vld1q_u8( rk + 16 ) );
+    vst1q_u8( output, block );
+
+    return( 0 );
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* MBEDTLS_HAVE_ARM64 */
+
+#endif /* MBEDTLS_AESCE_C */
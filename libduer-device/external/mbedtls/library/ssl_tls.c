@@ -482,6 +482,10 @@ static void ssl_calc_finished_tls_sha384( mbedtls_ssl_context *, unsigned char *
 #endif
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+static int ssl_alloc_buffers( mbedtls_ssl_context * );
+#endif
+
 int mbedtls_ssl_derive_keys( mbedtls_ssl_context *ssl )
 {
     int ret = 0;
@@ -2097,7 +2101,7 @@ static int ssl_compress_buf( mbedtls_ssl_context *ssl )
     ssl->transform_out->ctx_deflate.next_in = msg_pre;
     ssl->transform_out->ctx_deflate.avail_in = len_pre;
     ssl->transform_out->ctx_deflate.next_out = msg_post;
-    ssl->transform_out->ctx_deflate.avail_out = MBEDTLS_SSL_BUFFER_LEN;
+    ssl->transform_out->ctx_deflate.avail_out = mbedtls_ssl_out_buffer_len( ssl );
 
     ret = deflate( &ssl->transform_out->ctx_deflate, Z_SYNC_FLUSH );
     if( ret != Z_OK )
@@ -2106,7 +2110,7 @@ static int ssl_compress_buf( mbedtls_ssl_context *ssl )
         return( MBEDTLS_ERR_SSL_COMPRESSION_FAILED );
     }
 
-    ssl->out_msglen = MBEDTLS_SSL_BUFFER_LEN -
+    ssl->out_msglen = mbedtls_ssl_out_buffer_len( ssl ) -
                       ssl->transform_out->ctx_deflate.avail_out;
 
     MBEDTLS_SSL_DEBUG_MSG( 3, ( "after compression: msglen = %d, ",
@@ -2143,7 +2147,7 @@ static int ssl_decompress_buf( mbedtls_ssl_context *ssl )
     ssl->transform_in->ctx_inflate.next_in = msg_pre;
     ssl->transform_in->ctx_inflate.avail_in = len_pre;
     ssl->transform_in->ctx_inflate.next_out = msg_post;
-    ssl->transform_in->ctx_inflate.avail_out = MBEDTLS_SSL_MAX_CONTENT_LEN;
+    ssl->transform_in->ctx_inflate.avail_out = mbedtls_ssl_in_content_len( ssl );
 
     ret = inflate( &ssl->transform_in->ctx_inflate, Z_SYNC_FLUSH );
     if( ret != Z_OK )
@@ -2152,7 +2156,7 @@ static int ssl_decompress_buf( mbedtls_ssl_context *ssl )
         return( MBEDTLS_ERR_SSL_COMPRESSION_FAILED );
     }
 
-    ssl->in_msglen = MBEDTLS_SSL_MAX_CONTENT_LEN -
+    ssl->in_msglen = mbedtls_ssl_in_content_len( ssl ) -
                      ssl->transform_in->ctx_inflate.avail_out;
 
     MBEDTLS_SSL_DEBUG_MSG( 3, ( "after decompression: msglen = %d, ",
@@ -2227,7 +2231,7 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
     }
 
-    if( nb_want > MBEDTLS_SSL_BUFFER_LEN - (size_t)( ssl->in_hdr - ssl->in_buf ) )
+    if( nb_want > mbedtls_ssl_in_buffer_len( ssl ) - (size_t)( ssl->in_hdr - ssl->in_buf ) )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "requesting more data than fits" ) );
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
@@ -2310,7 +2314,7 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
             ret = MBEDTLS_ERR_SSL_TIMEOUT;
         else
         {
-            len = MBEDTLS_SSL_BUFFER_LEN - ( ssl->in_hdr - ssl->in_buf );
+            len = mbedtls_ssl_in_buffer_len( ssl ) - ( ssl->in_hdr - ssl->in_buf );
 
             if( ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER )
                 timeout = ssl->handshake->retransmit_timeout;
@@ -2957,7 +2961,7 @@ static int ssl_reassemble_dtls_handshake( mbedtls_ssl_context *ssl )
         MBEDTLS_SSL_DEBUG_MSG( 2, ( "initialize reassembly, total length = %d",
                             msg_len ) );
 
-        if( ssl->in_hslen > MBEDTLS_SSL_MAX_CONTENT_LEN )
+        if( ssl->in_hslen > mbedtls_ssl_in_content_len( ssl ) )
         {
             MBEDTLS_SSL_DEBUG_MSG( 1, ( "handshake message too large" ) );
             return( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE );
@@ -3061,7 +3065,7 @@ static int ssl_reassemble_dtls_handshake( mbedtls_ssl_context *ssl )
         ssl->next_record_offset = new_remain - ssl->in_hdr;
         ssl->in_left = ssl->next_record_offset + remain_len;
 
-        if( ssl->in_left > MBEDTLS_SSL_BUFFER_LEN -
+        if( ssl->in_left > mbedtls_ssl_in_buffer_len( ssl ) -
                            (size_t)( ssl->in_hdr - ssl->in_buf ) )
         {
             MBEDTLS_SSL_DEBUG_MSG( 1, ( "reassembled message too large for buffer" ) );
@@ -3431,7 +3435,7 @@ static int ssl_handle_possible_reconnect( mbedtls_ssl_context *ssl )
             ssl->conf->p_cookie,
             ssl->cli_id, ssl->cli_id_len,
             ssl->in_buf, ssl->in_left,
-            ssl->out_buf, MBEDTLS_SSL_MAX_CONTENT_LEN, &len );
+            ssl->out_buf, mbedtls_ssl_out_content_len( ssl ), &len );
 
     MBEDTLS_SSL_DEBUG_RET( 2, "ssl_check_dtls_clihlo_cookie", ret );
 
@@ -3528,7 +3532,7 @@ static int ssl_parse_record_header( mbedtls_ssl_context *ssl )
     }
 
     /* Check length against the size of our buffer */
-    if( ssl->in_msglen > MBEDTLS_SSL_BUFFER_LEN
+    if( ssl->in_msglen > mbedtls_ssl_in_buffer_len( ssl )
                          - (size_t)( ssl->in_msg - ssl->in_buf ) )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "bad message length" ) );
@@ -3999,6 +4003,11 @@ int mbedtls_ssl_send_alert_message( mbedtls_ssl_context *ssl,
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ( ret = ssl_alloc_buffers( ssl ) ) != 0 )
+        return( ret );
+#endif
+
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> send alert message" ) );
 
     ssl->out_msgtype = MBEDTLS_SSL_MSG_ALERT;
@@ -4143,10 +4152,10 @@ int mbedtls_ssl_write_certificate( mbedtls_ssl_context *ssl )
     while( crt != NULL )
     {
         n = crt->raw.len;
-        if( n > MBEDTLS_SSL_MAX_CONTENT_LEN - 3 - i )
+        if( n > mbedtls_ssl_out_content_len( ssl ) - 3 - i )
         {
             MBEDTLS_SSL_DEBUG_MSG( 1, ( "certificate too large, %d > %d",
-                           i + 3 + n, MBEDTLS_SSL_MAX_CONTENT_LEN ) );
+                           i + 3 + n, mbedtls_ssl_out_content_len( ssl ) ) );
             return( MBEDTLS_ERR_SSL_CERTIFICATE_TOO_LARGE );
         }
 
@@ -5358,30 +5367,12 @@ void mbedtls_ssl_init( mbedtls_ssl_context *ssl )
 }
 
 /*
- * Setup an SSL context
+ * Point the record fields into the buffers
  */
-int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
-                       const mbedtls_ssl_config *conf )
+static void ssl_set_buffer_pointers( mbedtls_ssl_context *ssl )
 {
-    int ret;
-    const size_t len = MBEDTLS_SSL_BUFFER_LEN;
-
-    ssl->conf = conf;
-
-    /*
-     * Prepare base structures
-     */
-    if( ( ssl-> in_buf = mbedtls_calloc( 1, len ) ) == NULL ||
-        ( ssl->out_buf = mbedtls_calloc( 1, len ) ) == NULL )
-    {
-        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", len ) );
-        mbedtls_free( ssl->in_buf );
-        ssl->in_buf = NULL;
-        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
-    }
-
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
-    if( conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
+    if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
     {
         ssl->out_hdr = ssl->out_buf;
         ssl->out_ctr = ssl->out_buf +  3;
@@ -5410,6 +5401,180 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
         ssl->in_iv  = ssl->in_buf + 13;
         ssl->in_msg = ssl->in_buf + 13;
     }
+}
+
+static void ssl_free_buffers( mbedtls_ssl_context *ssl )
+{
+    if( ssl->out_buf != NULL )
+    {
+        mbedtls_zeroize( ssl->out_buf, mbedtls_ssl_out_buffer_len( ssl ) );
+        mbedtls_free( ssl->out_buf );
+        ssl->out_buf = NULL;
+    }
+
+    if( ssl->in_buf != NULL )
+    {
+        mbedtls_zeroize( ssl->in_buf, mbedtls_ssl_in_buffer_len( ssl ) );
+        mbedtls_free( ssl->in_buf );
+        ssl->in_buf = NULL;
+    }
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    ssl->in_buf_len = 0;
+    ssl->out_buf_len = 0;
+#endif
+}
+
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+/*
+ * Allocate the record buffers not allocated yet or released. The input one
+ * holds the max_fragment_length negotiated once the handshake is over.
+ */
+static int ssl_alloc_buffers( mbedtls_ssl_context *ssl )
+{
+    size_t in_len = MBEDTLS_SSL_MAX_CONTENT_LEN;
+    size_t out_len = MBEDTLS_SSL_MAX_CONTENT_LEN;
+
+    if( ssl->in_buf != NULL )
+        return( 0 );
+
+    if( ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER && ssl->session != NULL &&
+        mfl_code_to_length[ssl->session->mfl_code] < in_len )
+    {
+        in_len = mfl_code_to_length[ssl->session->mfl_code];
+    }
+
+    if( ssl->out_content_len != 0 && ssl->out_content_len < out_len )
+        out_len = ssl->out_content_len;
+
+    in_len += MBEDTLS_SSL_BUFFER_OVERHEAD;
+    out_len += MBEDTLS_SSL_BUFFER_OVERHEAD;
+
+    if( ( ssl-> in_buf = mbedtls_calloc( 1, in_len ) ) == NULL ||
+        ( ssl->out_buf = mbedtls_calloc( 1, out_len ) ) == NULL )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", in_len + out_len ) );
+        mbedtls_free( ssl->in_buf );
+        ssl->in_buf = NULL;
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+    }
+
+    ssl->in_buf_len = in_len;
+    ssl->out_buf_len = out_len;
+    ssl_set_buffer_pointers( ssl );
+
+    /* continue the records where the buffers were released */
+    if( ssl->in_msg_off != 0 )
+        ssl->in_msg = ssl->in_buf + ssl->in_msg_off;
+    if( ssl->out_msg_off != 0 )
+        ssl->out_msg = ssl->out_buf + ssl->out_msg_off;
+    memcpy( ssl->in_ctr, ssl->in_ctr_save, 8 );
+    memcpy( ssl->out_ctr, ssl->out_ctr_save, 8 );
+
+    MBEDTLS_SSL_DEBUG_MSG( 3, ( "record buffers: in %d, out %d bytes",
+                                in_len, out_len ) );
+
+    return( 0 );
+}
+
+int mbedtls_ssl_set_record_len( mbedtls_ssl_context *ssl, unsigned char mfl_code,
+                                size_t out_len )
+{
+    if( ssl == NULL ||
+        mfl_code >= MBEDTLS_SSL_MAX_FRAG_LEN_INVALID ||
+        mfl_code_to_length[mfl_code] > MBEDTLS_SSL_MAX_CONTENT_LEN ||
+        ( out_len != 0 && out_len < 512 ) ||
+        out_len > MBEDTLS_SSL_MAX_CONTENT_LEN )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    ssl->mfl_code = mfl_code;
+    ssl->out_content_len = out_len;
+
+    return( 0 );
+}
+
+int mbedtls_ssl_release_buffers( mbedtls_ssl_context *ssl )
+{
+    size_t in_pending;
+
+    if( ssl == NULL || ssl->conf == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ssl->in_buf == NULL )
+        return( 0 );
+
+    if( ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    in_pending = ssl->in_left;
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
+    {
+        in_pending = ssl->in_left > ssl->next_record_offset
+                     ? ssl->in_left - ssl->next_record_offset : 0;
+    }
+#endif
+
+    /* the application data not read yet, the record partially received,
+     * or the handshake messages following in the same record */
+    if( in_pending != 0 || ssl->in_offt != NULL || ssl->record_read != 0 ||
+        ( ssl->in_hslen != 0 && ssl->in_hslen < ssl->in_msglen ) )
+    {
+        return( MBEDTLS_ERR_SSL_WANT_READ );
+    }
+
+    if( ssl->out_left != 0 )
+        return( MBEDTLS_ERR_SSL_WANT_WRITE );
+
+    memcpy( ssl->in_ctr_save, ssl->in_ctr, 8 );
+    memcpy( ssl->out_ctr_save, ssl->out_ctr, 8 );
+    ssl->in_msg_off = ssl->in_msg - ssl->in_buf;
+    ssl->out_msg_off = ssl->out_msg - ssl->out_buf;
+
+    ssl->in_left = 0;
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    ssl->next_record_offset = 0;
+#endif
+    ssl->in_msglen = 0;
+    ssl->in_hslen = 0;
+
+    ssl_free_buffers( ssl );
+
+    return( 0 );
+}
+#endif /* MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH */
+
+/*
+ * Setup an SSL context
+ */
+int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
+                       const mbedtls_ssl_config *conf )
+{
+    int ret;
+#if !defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    const size_t len = MBEDTLS_SSL_BUFFER_LEN;
+#endif
+
+    ssl->conf = conf;
+
+    /*
+     * Prepare base structures, the buffers sized by the context are
+     * allocated on use, see ssl_alloc_buffers()
+     */
+#if !defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ( ssl-> in_buf = mbedtls_calloc( 1, len ) ) == NULL ||
+        ( ssl->out_buf = mbedtls_calloc( 1, len ) ) == NULL )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", len ) );
+        mbedtls_free( ssl->in_buf );
+        ssl->in_buf = NULL;
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+    }
+
+    ssl_set_buffer_pointers( ssl );
+#endif
 
     if( ( ret = ssl_handshake_init( ssl ) ) != 0 )
         return( ret );
@@ -5474,9 +5639,21 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
     ssl->transform_in = NULL;
     ssl->transform_out = NULL;
 
-    memset( ssl->out_buf, 0, MBEDTLS_SSL_BUFFER_LEN );
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    /* the next handshake allocates them again, at the full length */
     if( partial == 0 )
-        memset( ssl->in_buf, 0, MBEDTLS_SSL_BUFFER_LEN );
+        ssl_free_buffers( ssl );
+
+    ssl->in_msg_off = 0;
+    ssl->out_msg_off = 0;
+    memset( ssl->in_ctr_save, 0, sizeof( ssl->in_ctr_save ) );
+    memset( ssl->out_ctr_save, 0, sizeof( ssl->out_ctr_save ) );
+#endif
+
+    if( ssl->out_buf != NULL )
+        memset( ssl->out_buf, 0, mbedtls_ssl_out_buffer_len( ssl ) );
+    if( partial == 0 && ssl->in_buf != NULL )
+        memset( ssl->in_buf, 0, mbedtls_ssl_in_buffer_len( ssl ) );
 
 #if defined(MBEDTLS_SSL_HW_RECORD_ACCEL)
     if( mbedtls_ssl_hw_record_reset != NULL )
@@ -6230,7 +6407,7 @@ size_t mbedtls_ssl_get_max_frag_len( const mbedtls_ssl_context *ssl )
     /*
      * Assume mfl_code is correct since it was checked when set
      */
-    max_len = mfl_code_to_length[ssl->conf->mfl_code];
+    max_len = mfl_code_to_length[mbedtls_ssl_own_mfl_code( ssl )];
 
     /*
      * Check if a smaller max length was negotiated
@@ -6241,6 +6418,11 @@ size_t mbedtls_ssl_get_max_frag_len( const mbedtls_ssl_context *ssl )
         max_len = mfl_code_to_length[ssl->session_out->mfl_code];
     }
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ssl->out_content_len != 0 && ssl->out_content_len < max_len )
+        max_len = ssl->out_content_len;
+#endif
+
     return max_len;
 }
 #endif /* MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
@@ -6280,6 +6462,11 @@ int mbedtls_ssl_handshake_step( mbedtls_ssl_context *ssl )
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ( ret = ssl_alloc_buffers( ssl ) ) != 0 )
+        return( ret );
+#endif
+
 #if defined(MBEDTLS_SSL_CLI_C)
     if( ssl->conf->endpoint == MBEDTLS_SSL_IS_CLIENT )
         ret = mbedtls_ssl_handshake_client_step( ssl );
@@ -6400,6 +6587,11 @@ int mbedtls_ssl_renegotiate( mbedtls_ssl_context *ssl )
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ( ret = ssl_alloc_buffers( ssl ) ) != 0 )
+        return( ret );
+#endif
+
 #if defined(MBEDTLS_SSL_SRV_C)
     /* On server, just send the request */
     if( ssl->conf->endpoint == MBEDTLS_SSL_IS_SERVER )
@@ -6480,6 +6672,11 @@ int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ( ret = ssl_alloc_buffers( ssl ) ) != 0 )
+        return( ret );
+#endif
+
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> read" ) );
 
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
@@ -6826,6 +7023,11 @@ int mbedtls_ssl_write( mbedtls_ssl_context *ssl, const unsigned char *buf, size_
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    if( ( ret = ssl_alloc_buffers( ssl ) ) != 0 )
+        return( ret );
+#endif
+
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
     if( ( ret = ssl_check_ctr_renegotiate( ssl ) ) != 0 )
     {
@@ -7024,17 +7226,7 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> free" ) );
 
-    if( ssl->out_buf != NULL )
-    {
-        mbedtls_zeroize( ssl->out_buf, MBEDTLS_SSL_BUFFER_LEN );
-        mbedtls_free( ssl->out_buf );
-    }
-
-    if( ssl->in_buf != NULL )
-    {
-        mbedtls_zeroize( ssl->in_buf, MBEDTLS_SSL_BUFFER_LEN );
-        mbedtls_free( ssl->in_buf );
-    }
+    ssl_free_buffers( ssl );
 
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     if( ssl->compress_buf != NULL )
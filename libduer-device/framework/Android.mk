@@ -33,7 +33,8 @@ LOCAL_SRC_FILES := $(MY_SRC_FILES:$(LOCAL_PATH)/%=%)
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH)/include \
     $(LOCAL_PATH)/core \
-    $(LOCAL_PATH)/utils
+    $(LOCAL_PATH)/utils \
+    $(LOCAL_PATH)/../platform/include
 
 LOCAL_EXPORT_C_INCLUDES := \
     $(LOCAL_PATH)/include \
@@ -0,0 +1,943 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_dns.c
+ * Desc: The DNS resolver shared by all the connections.
+ */
+
+#include "lightduer_dns.h"
+#include "lightduer_events.h"
+#include "lightduer_lib.h"
+#include "lightduer_log.h"
+#include "lightduer_memory.h"
+#include "lightduer_mutex.h"
+#include "lightduer_net_transport_wrapper.h"
+#include "lightduer_random.h"
+#include "lightduer_sleep.h"
+#include "lightduer_timestamp.h"
+
+// the hosts cached
+#ifndef DUER_DNS_CACHE_SIZE
+#define DUER_DNS_CACHE_SIZE         (16)
+#endif
+
+// how long to wait for one name server, in ms
+#ifndef DUER_DNS_TIMEOUT
+#define DUER_DNS_TIMEOUT            (2000)
+#endif
+
+// how long to wait for the other family once one has answered, in ms (RFC 8305)
+#ifndef DUER_DNS_RESOLUTION_DELAY
+#define DUER_DNS_RESOLUTION_DELAY   (50)
+#endif
+
+// the cache time bounds, in seconds
+#define DUER_DNS_TTL_MIN            (5)
+#define DUER_DNS_TTL_MAX            (24 * 3600)
+#define DUER_DNS_NEGATIVE_TTL       (60)    // no SOA in the answer
+#define DUER_DNS_NEGATIVE_TTL_MAX   (600)
+
+#define DUER_DNS_SERVERS_MAX        (3)
+#define DUER_DNS_MSG_SIZE           (512)
+#define DUER_DNS_HEADER_SIZE        (12)
+#define DUER_DNS_NAME_MAX           (255)
+#define DUER_DNS_LABEL_MAX          (63)
+#define DUER_DNS_CLASS_IN           (1)
+#define DUER_DNS_FLAG_QR            (0x8000)
+#define DUER_DNS_FLAG_RD            (0x0100)
+#define DUER_DNS_RCODE_MASK         (0x000F)
+#define DUER_DNS_RCODE_NXDOMAIN     (3)
+#define DUER_DNS_POLL_MAX           (4)     // the longest sleep between the recv polls, in ms
+
+#define DUER_DNS_STACK_SIZE         (1024 * 4)
+#define DUER_DNS_QUEUE_LENGTH       (8)
+
+typedef enum _duer_dns_state_enum {
+    DUER_DNS_EMPTY,
+    DUER_DNS_PENDING,           // the query is in flight
+    DUER_DNS_POSITIVE,
+    DUER_DNS_NEGATIVE,          // the host doesn't exist
+} duer_dns_state_e;
+
+typedef struct _duer_dns_waiter_s {
+    duer_dns_callback           callback;
+    void                       *ctx;
+    struct _duer_dns_waiter_s  *next;
+} duer_dns_waiter_t;
+
+typedef struct _duer_dns_entry_s {
+    char                       *host;
+    duer_u8_t                   state;
+    duer_u32_t                  expires;    // duer_timestamp()
+    duer_u32_t                  used;       // duer_timestamp() of the last lookup
+    duer_dns_result_t           result;
+    duer_dns_waiter_t          *waiters;
+} duer_dns_entry_t;
+
+typedef struct _duer_dns_server_s {
+    char                        ip[16];
+    duer_u16_t                  port;
+} duer_dns_server_t;
+
+DUER_LOC_IMPL duer_mutex_t s_dns_mutex = NULL;
+DUER_LOC_IMPL duer_events_handler s_dns_events = NULL;
+DUER_LOC_IMPL duer_dns_server_t s_dns_servers[DUER_DNS_SERVERS_MAX];
+DUER_LOC_IMPL duer_size_t s_dns_server_count = 0;
+DUER_LOC_IMPL duer_dns_entry_t s_dns_cache[DUER_DNS_CACHE_SIZE];
+DUER_LOC_IMPL duer_dns_stats_t s_dns_stats;
+
+DUER_LOC_IMPL int duer_dns_tolower(int c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+DUER_LOC_IMPL duer_bool duer_dns_host_equal(const char *a, const char *b)
+{
+    while (*a && duer_dns_tolower(*a) == duer_dns_tolower(*b)) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+DUER_LOC_IMPL duer_bool duer_dns_parse_ipv4(const char *ip, duer_u8_t addr[4])
+{
+    int part = 0;
+    int digits = 0;
+    duer_u32_t value = 0;
+
+    for (;; ip++) {
+        if (*ip >= '0' && *ip <= '9') {
+            value = value * 10 + (*ip - '0');
+            if (++digits > 3 || value > 255) {
+                return DUER_FALSE;
+            }
+        } else if ((*ip == '.' || *ip == '\0') && digits > 0 && part < 4) {
+            addr[part++] = (duer_u8_t)value;
+            value = 0;
+            digits = 0;
+            if (*ip == '\0') {
+                break;
+            }
+        } else {
+            return DUER_FALSE;
+        }
+    }
+
+    return part == 4 ? DUER_TRUE : DUER_FALSE;
+}
+
+/*
+ * Answer the IPv4 literal and "localhost" without a query
+ */
+DUER_LOC_IMPL duer_bool duer_dns_literal(const char *host, duer_dns_result_t *result)
+{
+    duer_u8_t addr[4];
+
+    if (duer_dns_host_equal(host, "localhost")) {
+        addr[0] = 127;
+        addr[1] = 0;
+        addr[2] = 0;
+        addr[3] = 1;
+    } else if (!duer_dns_parse_ipv4(host, addr)) {
+        return DUER_FALSE;
+    }
+
+    DUER_MEMSET(result, 0, sizeof(*result));
+    result->ttl = DUER_DNS_TTL_MAX;
+    result->count = 1;
+    result->addrs[0].family = DUER_DNS_INET;
+    DUER_MEMCPY(result->addrs[0].addr, addr, sizeof(addr));
+    return DUER_TRUE;
+}
+
+DUER_INT_IMPL int duer_dns_build_query(duer_u8_t *buf, duer_size_t size, duer_u16_t id,
+                                       const char *host, duer_u16_t type)
+{
+    duer_size_t pos = DUER_DNS_HEADER_SIZE;
+    duer_size_t label = 0;
+    duer_size_t len = 0;
+    duer_size_t host_len = 0;
+
+    if (buf == NULL || host == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    host_len = DUER_STRLEN(host);
+    if (host_len > 0 && host[host_len - 1] == '.') {
+        host_len--;
+    }
+    // the labels with their length bytes, the root label, QTYPE and QCLASS
+    if (host_len == 0 || host_len + 2 > DUER_DNS_NAME_MAX
+            || size < DUER_DNS_HEADER_SIZE + host_len + 2 + 4) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    DUER_MEMSET(buf, 0, DUER_DNS_HEADER_SIZE);
+    buf[0] = (duer_u8_t)(id >> 8);
+    buf[1] = (duer_u8_t)id;
+    buf[2] = (duer_u8_t)(DUER_DNS_FLAG_RD >> 8);
+    buf[5] = 1;     // QDCOUNT
+
+    label = pos++;
+    for (len = 0; len < host_len; len++) {
+        if (host[len] == '.') {
+            if (pos - label - 1 == 0) {
+                return DUER_ERR_INVALID_PARAMETER;
+            }
+            buf[label] = (duer_u8_t)(pos - label - 1);
+            label = pos++;
+        } else {
+            buf[pos++] = (duer_u8_t)host[len];
+            if (pos - label - 1 > DUER_DNS_LABEL_MAX) {
+                return DUER_ERR_INVALID_PARAMETER;
+            }
+        }
+    }
+    if (pos - label - 1 == 0) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+    buf[label] = (duer_u8_t)(pos - label - 1);
+    buf[pos++] = 0;
+
+    buf[pos++] = (duer_u8_t)(type >> 8);
+    buf[pos++] = (duer_u8_t)type;
+    buf[pos++] = 0;
+    buf[pos++] = DUER_DNS_CLASS_IN;
+
+    return (int)pos;
+}
+
+DUER_LOC_IMPL duer_u16_t duer_dns_read16(const duer_u8_t *p)
+{
+    return (duer_u16_t)((p[0] << 8) | p[1]);
+}
+
+DUER_LOC_IMPL duer_u32_t duer_dns_read32(const duer_u8_t *p)
+{
+    return ((duer_u32_t)p[0] << 24) | ((duer_u32_t)p[1] << 16)
+            | ((duer_u32_t)p[2] << 8) | p[3];
+}
+
+/*
+ * Skip the (maybe compressed) name at pos
+ *
+ * @Return duer_size_t, the position after the name, or 0 if it's malformed
+ */
+DUER_LOC_IMPL duer_size_t duer_dns_skip_name(const duer_u8_t *buf, duer_size_t len,
+                                             duer_size_t pos)
+{
+    while (pos < len) {
+        if ((buf[pos] & 0xC0) == 0xC0) {
+            return pos + 2 <= len ? pos + 2 : 0;
+        } else if (buf[pos] & 0xC0) {
+            return 0;
+        } else if (buf[pos] == 0) {
+            return pos + 1;
+        }
+        pos += buf[pos] + 1;
+    }
+    return 0;
+}
+
+DUER_INT_IMPL duer_status_t duer_dns_parse_response(const duer_u8_t *buf, duer_size_t len,
+                                                    duer_u16_t id, duer_dns_result_t *result)
+{
+    duer_u16_t flags = 0;
+    duer_u16_t qdcount = 0;
+    duer_u16_t ancount = 0;
+    duer_u16_t nscount = 0;
+    duer_u16_t type = 0;
+    duer_u16_t rdlength = 0;
+    duer_u32_t ttl = 0;
+    duer_u32_t negative_ttl = DUER_DNS_NEGATIVE_TTL;
+    duer_size_t pos = DUER_DNS_HEADER_SIZE;
+    duer_size_t i = 0;
+
+    if (buf == NULL || result == NULL || len < DUER_DNS_HEADER_SIZE) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    flags = duer_dns_read16(buf + 2);
+    if (duer_dns_read16(buf) != id || !(flags & DUER_DNS_FLAG_QR)) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    DUER_MEMSET(result, 0, sizeof(*result));
+    result->ttl = DUER_DNS_TTL_MAX;
+
+    if ((flags & DUER_DNS_RCODE_MASK) != 0
+            && (flags & DUER_DNS_RCODE_MASK) != DUER_DNS_RCODE_NXDOMAIN) {
+        // SERVFAIL, REFUSED..., ask the next server
+        return DUER_ERR_TRANS_INTERNAL_ERROR;
+    }
+
+    qdcount = duer_dns_read16(buf + 4);
+    ancount = duer_dns_read16(buf + 6);
+    nscount = duer_dns_read16(buf + 8);
+
+    for (i = 0; i < qdcount; i++) {
+        pos = duer_dns_skip_name(buf, len, pos);
+        if (pos == 0 || pos + 4 > len) {
+            return DUER_ERR_INVALID_PARAMETER;
+        }
+        pos += 4;
+    }
+
+    for (i = 0; i < (duer_size_t)ancount + nscount; i++) {
+        pos = duer_dns_skip_name(buf, len, pos);
+        if (pos == 0 || pos + 10 > len) {
+            return DUER_ERR_INVALID_PARAMETER;
+        }
+        type = duer_dns_read16(buf + pos);
+        ttl = duer_dns_read32(buf + pos + 4);
+        rdlength = duer_dns_read16(buf + pos + 8);
+        pos += 10;
+        if (pos + rdlength > len) {
+            return DUER_ERR_INVALID_PARAMETER;
+        }
+
+        if (duer_dns_read16(buf + pos - 8) != DUER_DNS_CLASS_IN) {
+            // skip it
+        } else if (i >= ancount) {
+            // RFC 2308: the negative answer is cached by the SOA TTL and MINIMUM
+            if (type == DUER_DNS_TYPE_SOA && rdlength >= 20) {
+                negative_ttl = duer_dns_read32(buf + pos + rdlength - 4);
+                if (ttl < negative_ttl) {
+                    negative_ttl = ttl;
+                }
+            }
+        } else if ((type == DUER_DNS_TYPE_A && rdlength == 4)
+                || (type == DUER_DNS_TYPE_AAAA && rdlength == 16)) {
+            if (result->count < DUER_DNS_ADDRS_MAX) {
+                result->addrs[result->count].family =
+                        type == DUER_DNS_TYPE_A ? DUER_DNS_INET : DUER_DNS_INET6;
+                DUER_MEMCPY(result->addrs[result->count].addr, buf + pos, rdlength);
+                result->count++;
+            }
+            if (ttl < result->ttl) {
+                result->ttl = ttl;
+            }
+        } else if (type == DUER_DNS_TYPE_CNAME) {
+            if (ttl < result->ttl) {
+                result->ttl = ttl;
+            }
+        } else {
+            // skip it
+        }
+        pos += rdlength;
+    }
+
+    if (result->count > 0) {
+        if (result->ttl < DUER_DNS_TTL_MIN) {
+            result->ttl = DUER_DNS_TTL_MIN;
+        }
+        return DUER_OK;
+    }
+
+    if (negative_ttl < DUER_DNS_TTL_MIN) {
+        negative_ttl = DUER_DNS_TTL_MIN;
+    } else if (negative_ttl > DUER_DNS_NEGATIVE_TTL_MAX) {
+        negative_ttl = DUER_DNS_NEGATIVE_TTL_MAX;
+    }
+    result->ttl = negative_ttl;
+
+    return (flags & DUER_DNS_RCODE_MASK) == DUER_DNS_RCODE_NXDOMAIN ? DUER_ERR_FAILED : DUER_OK;
+}
+
+/*
+ * Merge the A and AAAA answers, interleaved with IPv6 first (RFC 8305)
+ */
+DUER_LOC_IMPL void duer_dns_merge(duer_dns_result_t *result,
+                                  const duer_dns_result_t *v6, const duer_dns_result_t *v4)
+{
+    duer_size_t i = 0;
+
+    DUER_MEMSET(result, 0, sizeof(*result));
+
+    if (v6->count > 0 && v4->count > 0) {
+        result->ttl = v6->ttl < v4->ttl ? v6->ttl : v4->ttl;
+    } else if (v6->count > 0) {
+        result->ttl = v6->ttl;
+    } else if (v4->count > 0) {
+        result->ttl = v4->ttl;
+    } else {
+        result->ttl = v6->ttl < v4->ttl ? v6->ttl : v4->ttl;
+    }
+
+    for (i = 0; i < DUER_DNS_ADDRS_MAX && result->count < DUER_DNS_ADDRS_MAX; i++) {
+        if (i < v6->count) {
+            result->addrs[result->count++] = v6->addrs[i];
+        }
+        if (i < v4->count && result->count < DUER_DNS_ADDRS_MAX) {
+            result->addrs[result->count++] = v4->addrs[i];
+        }
+    }
+}
+
+DUER_LOC_IMPL void duer_dns_transevt(duer_transevt_e event)
+{
+    // the answers are polled in duer_dns_query_server
+}
+
+/*
+ * Ask one server for both A and AAAA records, each query by a random id,
+ * so the off-path answers can't be guessed into the cache
+ *
+ * @Return duer_status_t, DUER_OK, DUER_ERR_FAILED if the host doesn't exist,
+ *         or the other errors if the server hasn't answered both
+ */
+DUER_LOC_IMPL duer_status_t duer_dns_query_server(const duer_dns_server_t *server,
+                                                  const char *host,
+                                                  duer_dns_result_t *result)
+{
+    duer_u8_t buf[DUER_DNS_MSG_SIZE];
+    duer_dns_result_t answers[2];     // AAAA, A
+    duer_status_t status[2] = {DUER_ERR_TRANS_TIMEOUT, DUER_ERR_TRANS_TIMEOUT};
+    const duer_u16_t types[2] = {DUER_DNS_TYPE_AAAA, DUER_DNS_TYPE_A};
+    duer_u16_t ids[2];
+    duer_trans_handler trans = NULL;
+    duer_addr_t addr;
+    duer_u32_t start = 0;
+    duer_u32_t timeout = DUER_DNS_TIMEOUT;
+    duer_u32_t interval = 1;
+    duer_u32_t elapsed = 0;
+    duer_u16_t received = 0;
+    duer_status_t rs = DUER_OK;
+    int i = 0;
+
+    DUER_MEMSET(answers, 0, sizeof(answers));
+    ids[0] = (duer_u16_t)duer_random();
+    ids[1] = (duer_u16_t)duer_random();
+    if (ids[1] == ids[0]) {
+        // the answers are told apart by the id
+        ids[1] ^= 0x8000;
+    }
+
+    addr.type = DUER_PROTO_UDP;
+    addr.port = server->port;
+    addr.host = (void *)server->ip;
+    addr.host_size = DUER_STRLEN(server->ip);
+
+    trans = duer_trans_acquire(duer_dns_transevt, NULL);
+    if (trans == NULL) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    do {
+        rs = duer_trans_connect(trans, &addr);
+        if (rs < 0) {
+            DUER_LOGW("connect to the name server %s failed: %d", server->ip, rs);
+            break;
+        }
+
+        for (i = 0; i < 2; i++) {
+            rs = duer_dns_build_query(buf, sizeof(buf), ids[i], host, types[i]);
+            if (rs > 0) {
+                rs = duer_trans_send(trans, buf, rs, &addr);
+            }
+            if (rs < 0) {
+                DUER_LOGW("send the query to %s failed: %d", server->ip, rs);
+                break;
+            }
+        }
+        if (rs < 0) {
+            break;
+        }
+
+        duer_mutex_lock(s_dns_mutex);
+        s_dns_stats.queries += 2;
+        duer_mutex_unlock(s_dns_mutex);
+
+        start = duer_timestamp();
+        while (received < 2 && elapsed < timeout) {
+            duer_trans_set_read_timeout(trans, timeout - elapsed);
+            rs = duer_trans_recv(trans, buf, sizeof(buf), &addr);
+            if (rs >= DUER_DNS_HEADER_SIZE) {
+                i = duer_dns_read16(buf) == ids[0] ? 0 : (duer_dns_read16(buf) == ids[1] ? 1 : -1);
+                if (i >= 0 && status[i] == DUER_ERR_TRANS_TIMEOUT) {
+                    status[i] = duer_dns_parse_response(buf, rs, ids[i], &answers[i]);
+                    if (status[i] == DUER_ERR_INVALID_PARAMETER) {
+                        status[i] = DUER_ERR_TRANS_TIMEOUT;
+                    } else {
+                        received++;
+                    }
+                    if (answers[i].count > 0 && timeout > elapsed + DUER_DNS_RESOLUTION_DELAY) {
+                        timeout = elapsed + DUER_DNS_RESOLUTION_DELAY;
+                    }
+                }
+                interval = 1;
+            } else if (rs == DUER_ERR_TRANS_WOULD_BLOCK || rs == DUER_ERR_TRANS_TIMEOUT
+                    || rs >= 0) {
+                // the transport without recv timeout returns at once, poll with backoff
+                duer_sleep(interval);
+                if (interval < DUER_DNS_POLL_MAX) {
+                    interval <<= 1;
+                }
+            } else {
+                DUER_LOGW("recv from the name server %s failed: %d", server->ip, rs);
+                break;
+            }
+            elapsed = duer_timestamp() - start;
+        }
+    } while (0);
+
+    duer_trans_close(trans);
+    duer_trans_release(trans);
+
+    if (answers[0].count > 0 || answers[1].count > 0) {
+        duer_dns_merge(result, &answers[0], &answers[1]);
+        return DUER_OK;
+    }
+
+    // negative only if the name doesn't exist (NXDOMAIN for either), or neither
+    // type has a record (NODATA for both): one NODATA with the other lost would
+    // cache a host that may well have the other records
+    if (status[0] == DUER_ERR_FAILED || status[1] == DUER_ERR_FAILED
+            || (status[0] == DUER_OK && status[1] == DUER_OK)) {
+        duer_dns_merge(result, &answers[0], &answers[1]);
+        return DUER_ERR_FAILED;
+    }
+
+    for (i = 0; i < 2; i++) {
+        if (status[i] != DUER_OK && status[i] != DUER_ERR_TRANS_TIMEOUT) {
+            return status[i];
+        }
+    }
+
+    return DUER_ERR_TRANS_TIMEOUT;
+}
+
+/*
+ * Ask the servers in order until one answers
+ */
+DUER_LOC_IMPL duer_status_t duer_dns_query(const char *host, duer_dns_result_t *result)
+{
+    duer_dns_server_t servers[DUER_DNS_SERVERS_MAX];
+    duer_size_t count = 0;
+    duer_size_t i = 0;
+    duer_status_t rs = DUER_ERR_TRANS_TIMEOUT;
+
+    DUER_MEMSET(result, 0, sizeof(*result));
+
+    duer_mutex_lock(s_dns_mutex);
+    count = s_dns_server_count;
+    DUER_MEMCPY(servers, s_dns_servers, sizeof(servers));
+    duer_mutex_unlock(s_dns_mutex);
+
+    for (i = 0; i < count; i++) {
+        rs = duer_dns_query_server(&servers[i], host, result);
+        if (rs == DUER_OK || rs == DUER_ERR_FAILED) {
+            return rs;
+        }
+    }
+
+    return DUER_ERR_TRANS_TIMEOUT;
+}
+
+/*
+ * Find the host in the cache, the expired answers are dropped, should be locked
+ */
+DUER_LOC_IMPL duer_dns_entry_t *duer_dns_find(const char *host, duer_u32_t now)
+{
+    duer_dns_entry_t *entry = NULL;
+    int i = 0;
+
+    for (i = 0; i < DUER_DNS_CACHE_SIZE; i++) {
+        entry = &s_dns_cache[i];
+        if (entry->state == DUER_DNS_EMPTY || !duer_dns_host_equal(entry->host, host)) {
+            continue;
+        }
+        if (entry->state != DUER_DNS_PENDING && (duer_s32_t)(entry->expires - now) <= 0) {
+            return NULL;
+        }
+        entry->used = now;
+        return entry;
+    }
+
+    return NULL;
+}
+
+DUER_LOC_IMPL void duer_dns_drop(duer_dns_entry_t *entry)
+{
+    if (entry->host) {
+        DUER_FREE(entry->host);
+        entry->host = NULL;
+    }
+    entry->state = DUER_DNS_EMPTY;
+}
+
+/*
+ * Take an entry for the host, reuse the expired or the least recently used one,
+ * should be locked
+ *
+ * @Return duer_dns_entry_t *, NULL if all are in flight
+ */
+DUER_LOC_IMPL duer_dns_entry_t *duer_dns_alloc(const char *host, duer_u32_t now)
+{
+    duer_dns_entry_t *entry = NULL;
+    duer_dns_entry_t *victim = NULL;
+    duer_size_t size = DUER_STRLEN(host) + 1;
+    int i = 0;
+
+    for (i = 0; i < DUER_DNS_CACHE_SIZE; i++) {
+        entry = &s_dns_cache[i];
+        if (entry->state == DUER_DNS_EMPTY) {
+            victim = entry;
+            break;
+        }
+        if (entry->state == DUER_DNS_PENDING) {
+            continue;
+        }
+        if ((duer_s32_t)(entry->expires - now) <= 0 || duer_dns_host_equal(entry->host, host)) {
+            victim = entry;
+            break;
+        }
+        if (victim == NULL || (duer_s32_t)(entry->used - victim->used) < 0) {
+            victim = entry;
+        }
+    }
+
+    if (victim == NULL) {
+        return NULL;
+    }
+
+    duer_dns_drop(victim);
+    victim->host = DUER_MALLOC(size);
+    if (victim->host == NULL) {
+        return NULL;
+    }
+    DUER_MEMCPY(victim->host, host, size);
+    victim->state = DUER_DNS_PENDING;
+    victim->used = now;
+    victim->waiters = NULL;
+    return victim;
+}
+
+/*
+ * Cache the answer of the query in flight and notify its waiters
+ */
+DUER_LOC_IMPL void duer_dns_complete(duer_dns_entry_t *entry, duer_status_t status,
+                                     const duer_dns_result_t *result)
+{
+    duer_dns_waiter_t *waiters = NULL;
+    duer_dns_waiter_t *waiter = NULL;
+    char host[DUER_DNS_NAME_MAX + 1];
+
+    duer_mutex_lock(s_dns_mutex);
+    waiters = entry->waiters;
+    entry->waiters = NULL;
+    // the entry might be reused once unlocked
+    DUER_SNPRINTF(host, sizeof(host), "%s", entry->host);
+    if (status == DUER_OK || status == DUER_ERR_FAILED) {
+        entry->state = status == DUER_OK ? DUER_DNS_POSITIVE : DUER_DNS_NEGATIVE;
+        entry->expires = duer_timestamp() + result->ttl * 1000;
+        entry->result = *result;
+    } else {
+        // not cached, the next lookup asks again
+        s_dns_stats.failures++;
+        duer_dns_drop(entry);
+    }
+    duer_mutex_unlock(s_dns_mutex);
+
+    while (waiters) {
+        waiter = waiters;
+        waiters = waiter->next;
+        waiter->callback(status, host, result, waiter->ctx);
+        DUER_FREE(waiter);
+    }
+}
+
+DUER_LOC_IMPL void duer_dns_run(int what, void *object)
+{
+    duer_dns_entry_t *entry = (duer_dns_entry_t *)object;
+    duer_dns_result_t result;
+    duer_status_t rs = DUER_OK;
+
+    // the host is kept while the entry is pending
+    rs = duer_dns_query(entry->host, &result);
+    duer_dns_complete(entry, rs, &result);
+}
+
+DUER_INT_IMPL void duer_dns_initialize(void)
+{
+    if (s_dns_mutex == NULL) {
+        s_dns_mutex = duer_mutex_create();
+        DUER_MEMSET(s_dns_cache, 0, sizeof(s_dns_cache));
+        DUER_MEMSET(&s_dns_stats, 0, sizeof(s_dns_stats));
+    }
+}
+
+DUER_INT_IMPL duer_status_t duer_dns_add_server(const char *ip, duer_u16_t port)
+{
+    duer_u8_t addr[4];
+    duer_status_t rs = DUER_OK;
+
+    if (s_dns_mutex == NULL || ip == NULL || !duer_dns_parse_ipv4(ip, addr)) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    duer_mutex_lock(s_dns_mutex);
+    if (s_dns_server_count < DUER_DNS_SERVERS_MAX) {
+        DUER_SNPRINTF(s_dns_servers[s_dns_server_count].ip,
+                      sizeof(s_dns_servers[0].ip), "%s", ip);
+        s_dns_servers[s_dns_server_count].port = port;
+        s_dns_server_count++;
+    } else {
+        rs = DUER_ERR_FAILED;
+    }
+    duer_mutex_unlock(s_dns_mutex);
+
+    return rs;
+}
+
+DUER_INT_IMPL void duer_dns_clear_servers(void)
+{
+    if (s_dns_mutex) {
+        duer_mutex_lock(s_dns_mutex);
+        s_dns_server_count = 0;
+        duer_mutex_unlock(s_dns_mutex);
+    }
+}
+
+/*
+ * Look up the cache, take the entry for the query if it's missed
+ *
+ * @Param entry, out, the cached or the pending entry
+ * @Return duer_status_t, DUER_OK if it's cached, DUER_ERR_TRANS_WOULD_BLOCK if
+ *         it's in flight (joined), DUER_ERR_TRANS_TIMEOUT if it should be queried
+ *         (with the entry taken, NULL if all are in flight), or other errors
+ */
+DUER_LOC_IMPL duer_status_t duer_dns_check(const char *host, duer_dns_entry_t **entry)
+{
+    duer_u32_t now = duer_timestamp();
+
+    s_dns_stats.lookups++;
+
+    *entry = duer_dns_find(host, now);
+    if (*entry == NULL) {
+        if (s_dns_server_count == 0) {
+            return DUER_ERR_INVALID_PARAMETER;
+        }
+        s_dns_stats.misses++;
+        *entry = duer_dns_alloc(host, now);
+        return DUER_ERR_TRANS_TIMEOUT;
+    }
+
+    if ((*entry)->state == DUER_DNS_PENDING) {
+        s_dns_stats.joined++;
+        return DUER_ERR_TRANS_WOULD_BLOCK;
+    }
+
+    s_dns_stats.hits++;
+    if ((*entry)->state == DUER_DNS_NEGATIVE) {
+        s_dns_stats.negative_hits++;
+    }
+    return DUER_OK;
+}
+
+DUER_INT_IMPL duer_status_t duer_dns_resolve(const char *host, duer_dns_result_t *result)
+{
+    duer_dns_entry_t *entry = NULL;
+    duer_u32_t start = 0;
+    duer_status_t rs = DUER_OK;
+
+    if (host == NULL || result == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    if (duer_dns_literal(host, result)) {
+        return DUER_OK;
+    }
+
+    if (s_dns_mutex == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    duer_mutex_lock(s_dns_mutex);
+    rs = duer_dns_check(host, &entry);
+    if (rs == DUER_OK) {
+        *result = entry->result;
+        rs = entry->state == DUER_DNS_POSITIVE ? DUER_OK : DUER_ERR_FAILED;
+    }
+    duer_mutex_unlock(s_dns_mutex);
+
+    if (rs == DUER_ERR_TRANS_TIMEOUT) {
+        rs = duer_dns_query(host, result);
+        if (entry) {
+            duer_dns_complete(entry, rs, result);
+        }
+    } else if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+        // wait for the query in flight, it ends in DUER_DNS_TIMEOUT for each server
+        start = duer_timestamp();
+        do {
+            duer_sleep(DUER_DNS_POLL_MAX);
+            duer_mutex_lock(s_dns_mutex);
+            entry = duer_dns_find(host, duer_timestamp());
+            if (entry == NULL) {
+                rs = DUER_ERR_TRANS_TIMEOUT;
+            } else if (entry->state != DUER_DNS_PENDING) {
+                *result = entry->result;
+                rs = entry->state == DUER_DNS_POSITIVE ? DUER_OK : DUER_ERR_FAILED;
+            }
+            duer_mutex_unlock(s_dns_mutex);
+        } while (rs == DUER_ERR_TRANS_WOULD_BLOCK
+                && duer_timestamp() - start < DUER_DNS_TIMEOUT * (DUER_DNS_SERVERS_MAX + 1));
+        if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+            rs = DUER_ERR_TRANS_TIMEOUT;
+        }
+    } else {
+        // cached or failed
+    }
+
+    return rs;
+}
+
+DUER_INT_IMPL duer_status_t duer_dns_lookup(const char *host, duer_dns_callback callback, void *ctx)
+{
+    duer_dns_entry_t *entry = NULL;
+    duer_dns_waiter_t *waiter = NULL;
+    duer_dns_result_t result;
+    duer_status_t rs = DUER_OK;
+
+    if (host == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    if (duer_dns_literal(host, &result)) {
+        if (callback) {
+            callback(DUER_OK, host, &result, ctx);
+        }
+        return DUER_OK;
+    }
+
+    if (s_dns_mutex == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    if (callback) {
+        waiter = (duer_dns_waiter_t *)DUER_MALLOC(sizeof(*waiter));
+        if (waiter == NULL) {
+            return DUER_ERR_MEMORY_OVERLOW;
+        }
+        waiter->callback = callback;
+        waiter->ctx = ctx;
+    }
+
+    duer_mutex_lock(s_dns_mutex);
+    do {
+        rs = duer_dns_check(host, &entry);
+        if (rs == DUER_OK) {
+            result = entry->result;
+            rs = entry->state == DUER_DNS_POSITIVE ? DUER_OK : DUER_ERR_FAILED;
+            break;
+        }
+
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK && rs != DUER_ERR_TRANS_TIMEOUT) {
+            break;
+        }
+
+        if (rs == DUER_ERR_TRANS_TIMEOUT && entry == NULL) {
+            DUER_LOGW("too many lookups in flight for %s", host);
+            rs = DUER_ERR_MEMORY_OVERLOW;
+            break;
+        }
+
+        if (rs == DUER_ERR_TRANS_TIMEOUT) {
+            if (s_dns_events == NULL) {
+                s_dns_events = duer_events_create("lightduer_dns",
+                                                  DUER_DNS_STACK_SIZE, DUER_DNS_QUEUE_LENGTH);
+            }
+            if (s_dns_events == NULL
+                    || duer_events_call(s_dns_events, duer_dns_run, 0, entry) != DUER_OK) {
+                DUER_LOGE("post the lookup of %s failed", host);
+                duer_dns_drop(entry);
+                rs = DUER_ERR_FAILED;
+                break;
+            }
+        }
+
+        if (waiter) {
+            waiter->next = entry->waiters;
+            entry->waiters = waiter;
+            waiter = NULL;
+        }
+        rs = DUER_ERR_TRANS_WOULD_BLOCK;
+    } while (0);
+    duer_mutex_unlock(s_dns_mutex);
+
+    if (waiter) {
+        if (rs == DUER_OK || rs == DUER_ERR_FAILED) {
+            callback(rs, host, &result, ctx);
+            rs = DUER_OK;
+        }
+        DUER_FREE(waiter);
+    } else if (callback == NULL && rs == DUER_ERR_FAILED) {
+        // cached as not exist
+        rs = DUER_OK;
+    }
+
+    return rs;
+}
+
+DUER_INT_IMPL duer_status_t duer_dns_prefetch(const char *host)
+{
+    duer_status_t rs = duer_dns_lookup(host, NULL, NULL);
+
+    return rs == DUER_ERR_TRANS_WOULD_BLOCK ? DUER_OK : rs;
+}
+
+DUER_INT_IMPL void duer_dns_flush(void)
+{
+    int i = 0;
+
+    if (s_dns_mutex == NULL) {
+        return;
+    }
+
+    duer_mutex_lock(s_dns_mutex);
+    for (i = 0; i < DUER_DNS_CACHE_SIZE; i++) {
+        if (s_dns_cache[i].state != DUER_DNS_PENDING) {
+            duer_dns_drop(&s_dns_cache[i]);
+        }
+    }
+    duer_mutex_unlock(s_dns_mutex);
+}
+
+DUER_INT_IMPL void duer_dns_get_stats(duer_dns_stats_t *stats)
+{
+    int i = 0;
+
+    if (stats == NULL) {
+        return;
+    }
+
+    if (s_dns_mutex == NULL) {
+        DUER_MEMSET(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    duer_mutex_lock(s_dns_mutex);
+    *stats = s_dns_stats;
+    stats->entries = 0;
+    for (i = 0; i < DUER_DNS_CACHE_SIZE; i++) {
+        if (s_dns_cache[i].state == DUER_DNS_POSITIVE
+                || s_dns_cache[i].state == DUER_DNS_NEGATIVE) {
+            stats->entries++;
+        }
+    }
+    duer_mutex_unlock(s_dns_mutex);
+}
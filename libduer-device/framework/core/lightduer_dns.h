@@ -0,0 +1,173 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_dns.h
+ * Desc: The DNS resolver shared by all the connections, it queries the
+ *       name servers through the transport (UDP), and caches the answers
+ *       and the failures by their TTL.
+ */
+
+#ifndef BAIDU_DUER_LIGHTDUER_CORE_LIGHTDUER_DNS_H
+#define BAIDU_DUER_LIGHTDUER_CORE_LIGHTDUER_DNS_H
+
+#include "lightduer_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the addresses kept for one host
+#define DUER_DNS_ADDRS_MAX      (4)
+
+// the DNS record types
+#define DUER_DNS_TYPE_A         (1)
+#define DUER_DNS_TYPE_CNAME     (5)
+#define DUER_DNS_TYPE_SOA       (6)
+#define DUER_DNS_TYPE_AAAA      (28)
+
+typedef enum _duer_dns_family_enum {
+    DUER_DNS_INET,              // 4 bytes address
+    DUER_DNS_INET6,             // 16 bytes address
+} duer_dns_family_t;
+
+typedef struct _duer_dns_addr_s {
+    duer_u8_t   family;         // duer_dns_family_t
+    duer_u8_t   addr[16];       // network byte order
+} duer_dns_addr_t;
+
+typedef struct _duer_dns_result_s {
+    duer_u32_t      ttl;        // seconds, how long the answer could be cached
+    duer_size_t     count;      // 0 if the host doesn't exist
+    duer_dns_addr_t addrs[DUER_DNS_ADDRS_MAX];  // IPv6 and IPv4 interleaved, IPv6 first
+} duer_dns_result_t;
+
+typedef struct _duer_dns_stats_s {
+    duer_u32_t  lookups;        // the resolve, lookup and prefetch calls
+    duer_u32_t  hits;           // answered from the cache, including the negative
+    duer_u32_t  negative_hits;  // answered "not exist" from the cache
+    duer_u32_t  joined;         // waited for the same query in flight
+    duer_u32_t  misses;         // needed a query
+    duer_u32_t  queries;        // the DNS messages sent
+    duer_u32_t  failures;       // no answer from any name server
+    duer_u32_t  entries;        // the hosts cached now
+} duer_dns_stats_t;
+
+/*
+ * Called when the asynchronous lookup is done
+ *
+ * @Param status, DUER_OK with the addresses, DUER_ERR_FAILED if the host
+ *        doesn't exist, or DUER_ERR_TRANS_TIMEOUT if no server answered
+ * @Param host, the host looked up
+ * @Param result, the answer, valid only in the callback
+ * @Param ctx, the context passed to duer_dns_lookup
+ */
+typedef void (*duer_dns_callback)(duer_status_t status, const char *host,
+                                  const duer_dns_result_t *result, void *ctx);
+
+/*
+ * Initialize the resolver, should be called by the platform adapter
+ * after the mutex callbacks are set
+ */
+DUER_INT void duer_dns_initialize(void);
+
+/*
+ * Add a name server, at most 3 are kept, the first one is asked first
+ *
+ * @Param ip, the IPv4 address of the server, like "114.114.114.114"
+ * @Param port, the server port, 53 normally
+ * @Return duer_status_t, DUER_OK on success
+ */
+DUER_INT duer_status_t duer_dns_add_server(const char *ip, duer_u16_t port);
+
+/*
+ * Remove all the name servers
+ */
+DUER_INT void duer_dns_clear_servers(void);
+
+/*
+ * Resolve the host, block the caller if it's not cached,
+ * the IPv4 literal and "localhost" are answered without a query
+ *
+ * @Param host, the host name
+ * @Param result, out, the addresses
+ * @Return duer_status_t, DUER_OK with the addresses, DUER_ERR_FAILED if the
+ *         host doesn't exist, DUER_ERR_TRANS_TIMEOUT if no server answered,
+ *         or DUER_ERR_INVALID_PARAMETER if no server is added
+ */
+DUER_INT duer_status_t duer_dns_resolve(const char *host, duer_dns_result_t *result);
+
+/*
+ * Resolve the host without blocking the caller
+ *
+ * @Param host, the host name
+ * @Param callback, called with the answer; directly from here if it's cached,
+ *        otherwise from the resolver thread
+ * @Param ctx, passed to the callback
+ * @Return duer_status_t, DUER_OK if the callback has been called,
+ *         DUER_ERR_TRANS_WOULD_BLOCK if it will be called later, or other errors
+ */
+DUER_INT duer_status_t duer_dns_lookup(const char *host, duer_dns_callback callback, void *ctx);
+
+/*
+ * Start resolving the host in the background if it's not cached,
+ * so the later connect finds it in the cache
+ */
+DUER_INT duer_status_t duer_dns_prefetch(const char *host);
+
+/*
+ * Drop all the cached answers, the queries in flight are kept
+ */
+DUER_INT void duer_dns_flush(void);
+
+/*
+ * Obtain the statistics since initialized
+ */
+DUER_INT void duer_dns_get_stats(duer_dns_stats_t *stats);
+
+/*
+ * Build the query message
+ *
+ * @Param buf, out, the message
+ * @Param size, the buf size
+ * @Param id, the message id
+ * @Param host, the host name
+ * @Param type, DUER_DNS_TYPE_A or DUER_DNS_TYPE_AAAA
+ * @Return int, the message length, or DUER_ERR_INVALID_PARAMETER
+ */
+DUER_INT int duer_dns_build_query(duer_u8_t *buf, duer_size_t size, duer_u16_t id,
+                                  const char *host, duer_u16_t type);
+
+/*
+ * Parse the response message, the ttl is the lowest of the records used,
+ * or by the SOA record (RFC 2308) if there is no address
+ *
+ * @Param buf, the message
+ * @Param len, the message length
+ * @Param id, the id of the query
+ * @Param result, out, the addresses
+ * @Return duer_status_t, DUER_OK if answered (maybe no address),
+ *         DUER_ERR_FAILED if the host doesn't exist,
+ *         DUER_ERR_TRANS_INTERNAL_ERROR if the server failed to answer,
+ *         or DUER_ERR_INVALID_PARAMETER if it's not a valid answer to the query
+ */
+DUER_INT duer_status_t duer_dns_parse_response(const duer_u8_t *buf, duer_size_t len,
+                                               duer_u16_t id, duer_dns_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BAIDU_DUER_LIGHTDUER_CORE_LIGHTDUER_DNS_H
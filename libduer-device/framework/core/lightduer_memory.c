@@ -21,6 +21,9 @@
 #include "lightduer_lib.h"
 #include "lightduer_log.h"
 #include "baidu_json.h"
+#ifdef DUER_MEMORY_POOL
+#include "lightduer_mutex.h"
+#endif
 
 typedef struct _baidu_ca_memory_s {
     duer_context     context;
@@ -36,9 +39,312 @@ typedef struct _baidu_ca_memory_s {
 
 DUER_LOC_IMPL duer_memory_t s_duer_memory = {NULL};
 
+#ifdef DUER_MEMORY_POOL
+
+/*
+ * Every block handed out by the pool carries an 8-bytes header, the tag tells
+ * which size class it belongs to, or DUER_MEMPOOL_LARGE for the ones served
+ * by f_malloc directly. The free chunks are linked through their payload.
+ */
+#define DUER_MEMPOOL_MAGIC          (0xD5A10000)
+#define DUER_MEMPOOL_MAGIC_MASK     (0xFFFF0000)
+#define DUER_MEMPOOL_LARGE          (0xFFFF)
+#define DUER_MEMPOOL_UNTRACKED      (0xFFFE)    // large, allocated before the lock ready
+
+#define DUER_MEMPOOL_TAG(_c)        (DUER_MEMPOOL_MAGIC | (_c))
+#define DUER_MEMPOOL_CLASS(_t)      ((_t) & ~DUER_MEMPOOL_MAGIC_MASK)
+
+typedef struct _baidu_ca_mempool_chunk_s {
+    duer_u32_t  tag;
+    duer_u32_t  size;
+} duer_mpchunk_t;
+
+typedef struct _baidu_ca_mempool_free_s {
+    struct _baidu_ca_mempool_free_s *next;
+} duer_mpfree_t;
+
+typedef struct _baidu_ca_mempool_class_s {
+    duer_mpfree_t  *free_list;
+    char           *carve;      // the unused tail of the newest slab
+    char           *carve_end;
+} duer_mpclass_t;
+
+typedef struct _baidu_ca_mempool_s {
+    duer_mutex_t        lock;
+    duer_bool           creating;
+    duer_mpclass_t      classes[DUER_MEMPOOL_CLASS_NUM];
+    duer_mempool_stats_t stats;
+} duer_mempool_t;
+
+DUER_LOC_IMPL const duer_size_t s_duer_mempool_sizes[DUER_MEMPOOL_CLASS_NUM] = {
+    16, 32, 64, 128, 256
+};
+
+DUER_LOC_IMPL duer_mempool_t s_duer_mempool;
+
+DUER_LOC_IMPL int duer_mempool_class_of(duer_size_t size) {
+    int i;
+
+    for (i = 0; i < DUER_MEMPOOL_CLASS_NUM; i++) {
+        if (size <= s_duer_mempool_sizes[i]) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * The lock is created on demand, since baidu_ca_memory_init is called before
+ * the mutex callbacks are ready. The mutex itself is allocated by DUER_MALLOC,
+ * so the nested call is served as a large block while we are creating it.
+ */
+DUER_LOC_IMPL duer_bool duer_mempool_lock(void) {
+    if (s_duer_mempool.lock == NULL) {
+        if (s_duer_mempool.creating) {
+            return DUER_FALSE;
+        }
+
+        s_duer_mempool.creating = DUER_TRUE;
+        s_duer_mempool.lock = duer_mutex_create();
+        s_duer_mempool.creating = DUER_FALSE;
+
+        if (s_duer_mempool.lock == NULL) {
+            return DUER_FALSE;
+        }
+    }
+
+    return duer_mutex_lock(s_duer_mempool.lock) == DUER_OK ? DUER_TRUE : DUER_FALSE;
+}
+
+DUER_LOC_IMPL void duer_mempool_unlock(void) {
+    duer_mutex_unlock(s_duer_mempool.lock);
+}
+
+DUER_LOC_IMPL void* duer_mempool_large_alloc(duer_size_t size) {
+    duer_mpchunk_t* chunk = s_duer_memory.f_malloc(s_duer_memory.context,
+                                                   sizeof(duer_mpchunk_t) + size);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->tag = DUER_MEMPOOL_TAG(DUER_MEMPOOL_UNTRACKED);
+    chunk->size = size;
+
+    if (duer_mempool_lock()) {
+        chunk->tag = DUER_MEMPOOL_TAG(DUER_MEMPOOL_LARGE);
+        s_duer_mempool.stats.large_counts++;
+        s_duer_mempool.stats.large_total++;
+        duer_mempool_unlock();
+    }
+
+    return chunk + 1;
+}
+
+// called with the lock held
+DUER_LOC_IMPL void* duer_mempool_class_alloc(int index) {
+    duer_mpclass_t* cls = &s_duer_mempool.classes[index];
+    duer_mempool_class_stats_t* stats = &s_duer_mempool.stats.classes[index];
+    duer_size_t stride = sizeof(duer_mpchunk_t) + s_duer_mempool_sizes[index];
+    duer_mpchunk_t* chunk = NULL;
+
+    if (cls->free_list) {
+        chunk = (duer_mpchunk_t*)cls->free_list - 1;
+        cls->free_list = cls->free_list->next;
+        stats->hits++;
+    } else {
+        if (cls->carve == NULL || cls->carve + stride > cls->carve_end) {
+            // the slab is kept by the class until the process exits
+            char* slab = s_duer_memory.f_malloc(s_duer_memory.context,
+                                                DUER_MEMPOOL_SLAB_SIZE);
+            if (slab == NULL) {
+                return NULL;
+            }
+            cls->carve = slab;
+            cls->carve_end = slab + DUER_MEMPOOL_SLAB_SIZE;
+            stats->slabs++;
+        }
+        chunk = (duer_mpchunk_t*)cls->carve;
+        cls->carve += stride;
+        stats->misses++;
+    }
+
+    chunk->tag = DUER_MEMPOOL_TAG(index);
+    chunk->size = s_duer_mempool_sizes[index];
+
+    stats->in_use++;
+    if (stats->high_water < stats->in_use) {
+        stats->high_water = stats->in_use;
+    }
+
+    return chunk + 1;
+}
+
+DUER_LOC_IMPL void* duer_mempool_malloc(duer_size_t size) {
+    void* rs = NULL;
+    int index = duer_mempool_class_of(size);
+
+    if (index >= 0 && duer_mempool_lock()) {
+        rs = duer_mempool_class_alloc(index);
+        duer_mempool_unlock();
+        if (rs) {
+            return rs;
+        }
+    }
+
+    return duer_mempool_large_alloc(size);
+}
+
+DUER_LOC_IMPL duer_mpchunk_t* duer_mempool_chunk(void* ptr) {
+    duer_mpchunk_t* chunk = (duer_mpchunk_t*)ptr - 1;
+
+    if ((chunk->tag & DUER_MEMPOOL_MAGIC_MASK) != DUER_MEMPOOL_MAGIC) {
+        DUER_LOGE("The memory <%x> is not allocated by the pool!!!", ptr);
+        return NULL;
+    }
+
+    return chunk;
+}
+
+DUER_LOC_IMPL void duer_mempool_free(void* ptr) {
+    duer_mpchunk_t* chunk = NULL;
+    duer_u32_t index;
+
+    if (ptr == NULL || (chunk = duer_mempool_chunk(ptr)) == NULL) {
+        return;
+    }
+
+    index = DUER_MEMPOOL_CLASS(chunk->tag);
+
+    if (index == DUER_MEMPOOL_LARGE || index == DUER_MEMPOOL_UNTRACKED) {
+        if (index == DUER_MEMPOOL_LARGE && duer_mempool_lock()) {
+            s_duer_mempool.stats.large_counts--;
+            duer_mempool_unlock();
+        }
+        s_duer_memory.f_free(s_duer_memory.context, chunk);
+    } else if (index < DUER_MEMPOOL_CLASS_NUM && duer_mempool_lock()) {
+        duer_mpfree_t* node = (duer_mpfree_t*)ptr;
+        node->next = s_duer_mempool.classes[index].free_list;
+        s_duer_mempool.classes[index].free_list = node;
+        s_duer_mempool.stats.classes[index].in_use--;
+        duer_mempool_unlock();
+    } else {
+        DUER_LOGE("The memory <%x> has been trampled!!!", ptr);
+    }
+}
+
+DUER_LOC_IMPL void* duer_mempool_realloc(void* ptr, duer_size_t size) {
+    duer_mpchunk_t* chunk = NULL;
+    void* rs = NULL;
+
+    if (ptr == NULL) {
+        return duer_mempool_malloc(size);
+    }
+
+    if ((chunk = duer_mempool_chunk(ptr)) == NULL) {
+        return NULL;
+    }
+
+    if (DUER_MEMPOOL_CLASS(chunk->tag) >= DUER_MEMPOOL_CLASS_NUM
+            && duer_mempool_class_of(size) < 0
+            && s_duer_memory.f_realloc) {
+        chunk = s_duer_memory.f_realloc(s_duer_memory.context, chunk,
+                                        sizeof(duer_mpchunk_t) + size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->size = size;
+        return chunk + 1;
+    }
+
+    if (size <= chunk->size && duer_mempool_class_of(size) == duer_mempool_class_of(chunk->size)) {
+        return ptr;
+    }
+
+    rs = duer_mempool_malloc(size);
+    if (rs) {
+        DUER_MEMCPY(rs, ptr, size < chunk->size ? size : chunk->size);
+        duer_mempool_free(ptr);
+    }
+
+    return rs;
+}
+
+DUER_INT_IMPL duer_status_t duer_mempool_get_stats(duer_mempool_stats_t* stats) {
+    int i;
+
+    if (stats == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    if (!duer_mempool_lock()) {
+        return DUER_ERR_FAILED;
+    }
+
+    DUER_MEMCPY(stats, &s_duer_mempool.stats, sizeof(*stats));
+    duer_mempool_unlock();
+
+    for (i = 0; i < DUER_MEMPOOL_CLASS_NUM; i++) {
+        stats->classes[i].size = s_duer_mempool_sizes[i];
+    }
+
+    return DUER_OK;
+}
+
+DUER_INT_IMPL void duer_mempool_usage(void) {
+    duer_mempool_stats_t stats;
+    int i;
+
+    if (duer_mempool_get_stats(&stats) != DUER_OK) {
+        return;
+    }
+
+    for (i = 0; i < DUER_MEMPOOL_CLASS_NUM; i++) {
+        DUER_LOGI("duer_mempool_usage: size = %d, hits = %d, misses = %d, in_use = %d, "
+                  "high_water = %d, slabs = %d", stats.classes[i].size,
+                  stats.classes[i].hits, stats.classes[i].misses, stats.classes[i].in_use,
+                  stats.classes[i].high_water, stats.classes[i].slabs);
+    }
+
+    DUER_LOGI("duer_mempool_usage: large_counts = %d, large_total = %d",
+              stats.large_counts, stats.large_total);
+}
+
+#define DUER_RAW_MALLOC(_s)         duer_mempool_malloc(_s)
+#define DUER_RAW_REALLOC(_p, _s)    duer_mempool_realloc(_p, _s)
+#define DUER_RAW_FREE(_p)           duer_mempool_free(_p)
+
+#else/*DUER_MEMORY_POOL*/
+
+#define DUER_RAW_MALLOC(_s)         s_duer_memory.f_malloc(s_duer_memory.context, _s)
+#define DUER_RAW_REALLOC(_p, _s)    s_duer_memory.f_realloc(s_duer_memory.context, _p, _s)
+#define DUER_RAW_FREE(_p)           s_duer_memory.f_free(s_duer_memory.context, _p)
+
+#endif/*DUER_MEMORY_POOL*/
+
 #ifdef DUER_MEMORY_USAGE
 
+/*
+ * The counters are updated from several threads(CA events, socket events,
+ * voice events and timers), so use the atomic builtins instead of a lock.
+ */
+#define DUER_ATOMIC_ADD(_p, _v)     __atomic_add_fetch(_p, _v, __ATOMIC_RELAXED)
+#define DUER_ATOMIC_SUB(_p, _v)     __atomic_sub_fetch(_p, _v, __ATOMIC_RELAXED)
+#define DUER_ATOMIC_LOAD(_p)        __atomic_load_n(_p, __ATOMIC_ACQUIRE)
+#define DUER_ATOMIC_STORE(_p, _v)   __atomic_store_n(_p, _v, __ATOMIC_RELEASE)
+#define DUER_ATOMIC_CAS(_p, _e, _d) \
+    __atomic_compare_exchange_n(_p, _e, _d, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+#ifdef DUER_MEMORY_PROFILE
+// the low 16 bits of the mask keep the index of the call site
+#define DUER_MEM_HDR_MASK        (0xFEDC0000)
+#define DUER_MEM_HDR_MAGIC(_m)   ((_m) & 0xFFFF0000)
+#define DUER_MEM_HDR_SITE(_m)    ((_m) & 0x0000FFFF)
+#else
 #define DUER_MEM_HDR_MASK        (0xFEDCBA98)
+#define DUER_MEM_HDR_MAGIC(_m)   (_m)
+#endif
 
 #define DUER_MEMORY_HEADER   \
     duer_u32_t   mask; \
@@ -55,16 +361,180 @@ typedef struct _baidu_ca_memory_debug_s {
     char        data[];
 } duer_memdbg_t;
 
-DUER_LOC_IMPL void* duer_memdbg_acquire(duer_memdbg_t* ptr, duer_size_t size) {
+DUER_LOC_IMPL void duer_memdbg_update_max(duer_size_t* max, duer_size_t value) {
+    duer_size_t old = DUER_ATOMIC_LOAD(max);
+
+    while (old < value && !DUER_ATOMIC_CAS(max, &old, value)) {
+        // old is reloaded by the failed CAS
+    }
+}
+
+#ifdef DUER_MEMORY_PROFILE
+
+#if DUER_MEMPROF_SITES > 0xFFFF
+#error "DUER_MEMPROF_SITES should be less than 65536"
+#endif
+
+typedef struct _baidu_ca_memory_site_s {
+    const char* file;
+    duer_u32_t  line;
+    duer_size_t live_bytes;
+    duer_u32_t  live_counts;
+    duer_size_t peak_bytes;
+    duer_u32_t  allocs;
+    duer_u32_t  frees;
+} duer_memsite_t;
+
+/*
+ * Open addressing table, the slot is claimed by CAS on the file pointer,
+ * then the line is published, it's never removed. The last slot collects
+ * the allocations when the table is full.
+ */
+DUER_LOC_IMPL duer_memsite_t s_duer_memsites[DUER_MEMPROF_SITES];
+
+DUER_LOC_IMPL const char s_duer_memsite_unknown[] = "<unknown>";
+DUER_LOC_IMPL const char s_duer_memsite_overflow[] = "<overflow>";
+
+DUER_LOC_IMPL duer_u32_t duer_memsite_lookup(const char* file, duer_u32_t line) {
+    duer_u32_t capacity = DUER_MEMPROF_SITES - 1;
+    duer_u32_t index;
+    duer_u32_t i;
+
+    if (file == NULL) {
+        file = s_duer_memsite_unknown;
+        line = 1;
+    }
+
+    index = ((duer_u32_t)(duer_size_t)file * 31 + line) % capacity;
+
+    for (i = 0; i < capacity; i++) {
+        duer_memsite_t* site = &s_duer_memsites[index];
+        const char* owner = DUER_ATOMIC_LOAD(&site->file);
+
+        if (owner == NULL) {
+            const char* expected = NULL;
+            if (DUER_ATOMIC_CAS(&site->file, &expected, file)) {
+                DUER_ATOMIC_STORE(&site->line, line);
+                return index;
+            }
+            owner = expected;
+        }
+
+        if (owner == file) {
+            duer_u32_t l;
+            // the owner may not publish the line yet
+            while ((l = DUER_ATOMIC_LOAD(&site->line)) == 0) {
+            }
+            if (l == line) {
+                return index;
+            }
+        }
+
+        index = (index + 1) % capacity;
+    }
+
+    index = capacity;
+    if (DUER_ATOMIC_LOAD(&s_duer_memsites[index].file) == NULL) {
+        DUER_ATOMIC_STORE(&s_duer_memsites[index].file, s_duer_memsite_overflow);
+    }
+
+    return index;
+}
+
+DUER_LOC_IMPL void duer_memsite_acquire(duer_u32_t index, duer_size_t size) {
+    duer_memsite_t* site = &s_duer_memsites[index];
+    duer_size_t live = DUER_ATOMIC_ADD(&site->live_bytes, size);
+
+    DUER_ATOMIC_ADD(&site->live_counts, 1);
+    DUER_ATOMIC_ADD(&site->allocs, 1);
+    duer_memdbg_update_max(&site->peak_bytes, live);
+}
+
+DUER_LOC_IMPL void duer_memsite_release(duer_u32_t index, duer_size_t size) {
+    duer_memsite_t* site = &s_duer_memsites[index];
+
+    DUER_ATOMIC_SUB(&site->live_bytes, size);
+    DUER_ATOMIC_SUB(&site->live_counts, 1);
+    DUER_ATOMIC_ADD(&site->frees, 1);
+}
+
+DUER_INT_IMPL int duer_memprof_snapshot(duer_memprof_site_t* sites, int max) {
+    int counts = 0;
+    int i;
+    int j;
+
+    if (sites == NULL || max <= 0) {
+        return 0;
+    }
+
+    for (i = 0; i < DUER_MEMPROF_SITES; i++) {
+        duer_memsite_t* site = &s_duer_memsites[i];
+        duer_memprof_site_t item;
+
+        item.file = DUER_ATOMIC_LOAD(&site->file);
+        if (item.file == NULL) {
+            continue;
+        }
+
+        item.line = DUER_ATOMIC_LOAD(&site->line);
+        item.live_bytes = DUER_ATOMIC_LOAD(&site->live_bytes);
+        item.live_counts = DUER_ATOMIC_LOAD(&site->live_counts);
+        item.peak_bytes = DUER_ATOMIC_LOAD(&site->peak_bytes);
+        item.allocs = DUER_ATOMIC_LOAD(&site->allocs);
+        item.frees = DUER_ATOMIC_LOAD(&site->frees);
+
+        // insertion sort by live bytes, keep the top max items
+        for (j = counts; j > 0 && sites[j - 1].live_bytes < item.live_bytes; j--) {
+            if (j < max) {
+                sites[j] = sites[j - 1];
+            }
+        }
+
+        if (j < max) {
+            sites[j] = item;
+            if (counts < max) {
+                counts++;
+            }
+        }
+    }
+
+    return counts;
+}
+
+DUER_INT_IMPL void duer_memprof_dump(int top) {
+    duer_memprof_site_t sites[DUER_MEMPROF_DUMP_MAX];
+    int counts;
+    int i;
+
+    if (top > DUER_MEMPROF_DUMP_MAX) {
+        top = DUER_MEMPROF_DUMP_MAX;
+    }
+
+    counts = duer_memprof_snapshot(sites, top);
+
+    duer_memdbg_usage();
+    for (i = 0; i < counts; i++) {
+        DUER_LOGI("duer_memprof: %s:%d, live = %d(%d), peak = %d, allocs = %d, frees = %d",
+                  sites[i].file, sites[i].line, sites[i].live_bytes, sites[i].live_counts,
+                  sites[i].peak_bytes, sites[i].allocs, sites[i].frees);
+    }
+}
+
+#endif/*DUER_MEMORY_PROFILE*/
+
+DUER_LOC_IMPL void* duer_memdbg_acquire(duer_memdbg_t* ptr, duer_size_t size,
+                                        const char* file, duer_u32_t line) {
     if (ptr) {
         ptr->mask = DUER_MEM_HDR_MASK;
         ptr->size = size - sizeof(duer_memhdr_t);
-        s_duer_memory.alloc_counts++;
-        s_duer_memory.alloc_size += ptr->size;
-
-        if (s_duer_memory.max_size < s_duer_memory.alloc_size) {
-            s_duer_memory.max_size = s_duer_memory.alloc_size;
-        }
+#ifdef DUER_MEMORY_PROFILE
+        duer_u32_t site = duer_memsite_lookup(file, line);
+        ptr->mask |= site;
+        duer_memsite_acquire(site, ptr->size);
+#endif
+        DUER_ATOMIC_ADD(&s_duer_memory.alloc_counts, 1);
+        duer_memdbg_update_max(&s_duer_memory.max_size,
+                               DUER_ATOMIC_ADD(&s_duer_memory.alloc_size, ptr->size));
     }
 
     return ptr ? ptr->data : NULL;
@@ -72,18 +542,24 @@ DUER_LOC_IMPL void* duer_memdbg_acquire(duer_memdbg_t* ptr, duer_size_t size) {
 
 DUER_LOC_IMPL void duer_memdbg_release(duer_memdbg_t* p) {
     if (p) {
-        if (p->mask != DUER_MEM_HDR_MASK) {
+        if (DUER_MEM_HDR_MAGIC(p->mask) != DUER_MEM_HDR_MASK) {
             DUER_LOGE("The memory <%x> has been trampled!!!", p->data);
+            return;
         }
 
-        s_duer_memory.alloc_counts--;
-        s_duer_memory.alloc_size -= p->size;
+#ifdef DUER_MEMORY_PROFILE
+        duer_memsite_release(DUER_MEM_HDR_SITE(p->mask), p->size);
+#endif
+        DUER_ATOMIC_SUB(&s_duer_memory.alloc_counts, 1);
+        DUER_ATOMIC_SUB(&s_duer_memory.alloc_size, p->size);
     }
 }
 
 DUER_INT_IMPL void duer_memdbg_usage() {
     DUER_LOGI("duer_memdbg_usage: alloc_counts = %d, alloc_size = %d, max_size = %d",
-             s_duer_memory.alloc_counts, s_duer_memory.alloc_size, s_duer_memory.max_size);
+             DUER_ATOMIC_LOAD(&s_duer_memory.alloc_counts),
+             DUER_ATOMIC_LOAD(&s_duer_memory.alloc_size),
+             DUER_ATOMIC_LOAD(&s_duer_memory.max_size));
 }
 
 #endif/*DUER_MEMORY_USAGE*/
@@ -103,68 +579,102 @@ DUER_EXT_IMPL void baidu_ca_memory_init(duer_context context,
     baidu_json_InitHooks(&hooks);
 }
 
-DUER_INT_IMPL void* duer_malloc(duer_size_t size) {
+DUER_LOC_IMPL void* duer_malloc_internal(duer_size_t size, const char* file,
+                                         duer_u32_t line) {
     void* rs = NULL;
 
     if (s_duer_memory.f_malloc) {
 #ifdef DUER_MEMORY_USAGE
         size += sizeof(duer_memhdr_t);
 #endif
-        rs = s_duer_memory.f_malloc(s_duer_memory.context, size);
+        rs = DUER_RAW_MALLOC(size);
 #ifdef DUER_MEMORY_USAGE
-        rs = duer_memdbg_acquire(rs, size);
+        rs = duer_memdbg_acquire(rs, size, file, line);
 #endif
     }
 
     return rs;
 }
 
-DUER_INT_IMPL void* duer_realloc(void* ptr, duer_size_t size) {
+DUER_LOC_IMPL void* duer_realloc_internal(void* ptr, duer_size_t size,
+                                          const char* file, duer_u32_t line) {
     void* rs = NULL;
 
     if (s_duer_memory.f_realloc || (s_duer_memory.f_malloc && s_duer_memory.f_free)) {
 #ifdef DUER_MEMORY_USAGE
-        ptr = DUER_MEM_CONVERT(ptr);
+        duer_memdbg_t* old = DUER_MEM_CONVERT(ptr);
+        duer_size_t old_size = old ? old->size + sizeof(duer_memhdr_t) : 0;
+#ifdef DUER_MEMORY_PROFILE
+        const char* old_file = NULL;
+        duer_u32_t old_line = 0;
+        if (old && DUER_MEM_HDR_MAGIC(old->mask) == DUER_MEM_HDR_MASK) {
+            old_file = s_duer_memsites[DUER_MEM_HDR_SITE(old->mask)].file;
+            old_line = s_duer_memsites[DUER_MEM_HDR_SITE(old->mask)].line;
+        }
+#endif
+        ptr = old;
         size += sizeof(duer_memhdr_t);
         duer_memdbg_release(ptr);
 #endif
 
+#ifdef DUER_MEMORY_POOL
+        rs = DUER_RAW_REALLOC(ptr, size);
+#else
         if (s_duer_memory.f_realloc) {
-            rs = s_duer_memory.f_realloc(s_duer_memory.context, ptr, size);
+            rs = DUER_RAW_REALLOC(ptr, size);
         } else if (s_duer_memory.f_malloc && s_duer_memory.f_free) {
-            rs = duer_malloc(size);
+            rs = DUER_RAW_MALLOC(size);
 
             if (rs) {
                 DUER_MEMCPY(rs, ptr, size);
+                DUER_RAW_FREE(ptr);
             }
-
-            duer_free(ptr);
         } else {
             // do nothing
         }
+#endif
 
 #ifdef DUER_MEMORY_USAGE
-        rs = duer_memdbg_acquire(rs, size);
+        if (rs == NULL && ptr) {
+            // the old memory is still valid, account it back
+#ifdef DUER_MEMORY_PROFILE
+            duer_memdbg_acquire(ptr, old_size, old_file, old_line);
+#else
+            duer_memdbg_acquire(ptr, old_size, file, line);
+#endif
+        } else {
+            rs = duer_memdbg_acquire(rs, size, file, line);
+        }
 #endif
     }
 
     return rs;
 }
 
+DUER_INT_IMPL void* duer_malloc(duer_size_t size) {
+    return duer_malloc_internal(size, NULL, 0);
+}
+
+DUER_INT_IMPL void* duer_realloc(void* ptr, duer_size_t size) {
+    return duer_realloc_internal(ptr, size, NULL, 0);
+}
+
 DUER_INT_IMPL void duer_free(void* ptr) {
     if (s_duer_memory.f_free) {
 #ifdef DUER_MEMORY_USAGE
         ptr = DUER_MEM_CONVERT(ptr);
         duer_memdbg_release(ptr);
 #endif
-        s_duer_memory.f_free(s_duer_memory.context, ptr);
+        DUER_RAW_FREE(ptr);
     }
 }
 
 DUER_INT_IMPL void* duer_malloc_ext(duer_size_t size, const char* file,
                                   duer_u32_t line) {
-    void* rs = duer_malloc(size);
+    void* rs = duer_malloc_internal(size, file, line);
+#ifdef DUER_MEMORY_DEBUG
     DUER_LOGI("duer_malloc_ext: file:%s, line:%d, addr = %x, size = %d", file, line, rs, size);
+#endif
 
     if (rs) {
         DUER_MEMSET(rs, 0, size);
@@ -175,13 +685,17 @@ DUER_INT_IMPL void* duer_malloc_ext(duer_size_t size, const char* file,
 
 DUER_INT_IMPL void* duer_realloc_ext(void* ptr, duer_size_t size, const char* file,
                                    duer_u32_t line) {
-    void* rs = duer_realloc(ptr, size);
+    void* rs = duer_realloc_internal(ptr, size, file, line);
+#ifdef DUER_MEMORY_DEBUG
     DUER_LOGI("duer_realloc_ext: file:%s, line:%d, new_addr = %x, old_addr = %x, size = %d",
                                     file, line, rs, ptr, size);
+#endif
     return rs;
 }
 
 DUER_INT_IMPL void duer_free_ext(void* ptr, const char* file, duer_u32_t line) {
+#ifdef DUER_MEMORY_DEBUG
     DUER_LOGI("duer_free_ext: file:%s, line:%d, addr = %x", file, line, ptr);
+#endif
     duer_free(ptr);
 }
@@ -29,7 +29,13 @@ DUER_INT void duer_memdbg_usage();
 #define DUER_MEMDBG_USAGE(...)
 #endif
 
-#ifdef DUER_MEMORY_DEBUG
+#ifdef DUER_MEMORY_PROFILE
+#define DUER_MEMPROF_DUMP(_n)        duer_memprof_dump(_n)
+#else
+#define DUER_MEMPROF_DUMP(...)
+#endif
+
+#if defined(DUER_MEMORY_DEBUG) || defined(DUER_MEMORY_PROFILE)
 #define DUER_MALLOC(_s)          duer_malloc_ext(_s, __FILE__, __LINE__)
 #define DUER_REALLOC(_p, _s)     duer_realloc_ext(_p, _s, __FILE__, __LINE__)
 #define DUER_FREE(_p)            duer_free_ext(_p, __FILE__, __LINE__)
@@ -37,10 +43,33 @@ DUER_INT void duer_memdbg_usage();
 #define DUER_MALLOC(_s)          duer_malloc(_s)
 #define DUER_REALLOC(_p, _s)     duer_realloc(_p, _s)
 #define DUER_FREE(_p)            duer_free(_p)
-#endif/*DUER_MEMORY_DEBUG*/
+#endif/*DUER_MEMORY_DEBUG || DUER_MEMORY_PROFILE*/
 
 #define DUER_CALLOC(_s, _n)      DUER_MALLOC((_s) * (_n))
 
+#ifdef DUER_MEMORY_POOL
+#define DUER_MEMPOOL_USAGE(...)      duer_mempool_usage()
+#else
+#define DUER_MEMPOOL_USAGE(...)
+#endif
+
+/*
+ * The size classes served by the memory pool are 16, 32, 64, 128, 256 bytes,
+ * the chunks are carved from the slabs with DUER_MEMPOOL_SLAB_SIZE bytes.
+ *
+ * NOTE: the slabs are never returned to f_malloc, a freed chunk only goes back
+ * to the free list of its class. So the pool keeps the high water of every
+ * class for the life of the process, about
+ * (high_water * (size + 8) / DUER_MEMPOOL_SLAB_SIZE + 1) slabs per class,
+ * see duer_mempool_get_stats. Lower DUER_MEMPOOL_SLAB_SIZE, or leave the pool
+ * off, when a burst of small allocations should not pin the heap.
+ */
+#define DUER_MEMPOOL_CLASS_NUM       (5)
+
+#ifndef DUER_MEMPOOL_SLAB_SIZE
+#define DUER_MEMPOOL_SLAB_SIZE       (2048)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -123,6 +152,80 @@ DUER_INT void* duer_realloc_ext(void* ptr, duer_size_t size, const char* file,
  */
 DUER_INT void duer_free_ext(void* ptr, const char* file, duer_u32_t line);
 
+#ifdef DUER_MEMORY_POOL
+
+typedef struct _duer_mempool_class_stats_s {
+    duer_size_t size;           // the chunk size of this class
+    duer_u32_t  hits;           // allocations served by the free list
+    duer_u32_t  misses;         // allocations carved from the slab
+    duer_u32_t  in_use;         // chunks alloced now
+    duer_u32_t  high_water;     // the max value of in_use
+    duer_u32_t  slabs;          // slabs alloced for this class
+} duer_mempool_class_stats_t;
+
+typedef struct _duer_mempool_stats_s {
+    duer_mempool_class_stats_t classes[DUER_MEMPOOL_CLASS_NUM];
+    duer_u32_t  large_counts;   // blocks alloced by f_malloc directly now
+    duer_u32_t  large_total;    // total of the blocks alloced by f_malloc directly
+} duer_mempool_stats_t;
+
+/*
+ * Obtain the statistics of the memory pool
+ *
+ * @Param stats, duer_mempool_stats_t *, out, the statistics
+ * @Return duer_status_t, the operation result
+ */
+DUER_INT duer_status_t duer_mempool_get_stats(duer_mempool_stats_t* stats);
+
+/*
+ * Print the statistics of the memory pool
+ */
+DUER_INT void duer_mempool_usage(void);
+
+#endif/*DUER_MEMORY_POOL*/
+
+#ifdef DUER_MEMORY_PROFILE
+
+/*
+ * The max call sites could be recorded, the extra ones are collected
+ * into the "<overflow>" site.
+ */
+#ifndef DUER_MEMPROF_SITES
+#define DUER_MEMPROF_SITES           (256)
+#endif
+
+#ifndef DUER_MEMPROF_DUMP_MAX
+#define DUER_MEMPROF_DUMP_MAX        (32)
+#endif
+
+typedef struct _duer_memprof_site_s {
+    const char* file;           // the file of the call site, "<unknown>" for duer_malloc
+    duer_u32_t  line;           // the line of the call site
+    duer_size_t live_bytes;     // the bytes alloced and not freed
+    duer_u32_t  live_counts;    // the blocks alloced and not freed
+    duer_size_t peak_bytes;     // the max value of live_bytes
+    duer_u32_t  allocs;         // total allocations, the churn with frees
+    duer_u32_t  frees;          // total frees
+} duer_memprof_site_t;
+
+/*
+ * Obtain the call sites with the most live bytes
+ *
+ * @Param sites, duer_memprof_site_t *, out, the call sites sorted by live bytes
+ * @Param max, int, the capacity of sites
+ * @Return int, the number of the call sites filled
+ */
+DUER_INT int duer_memprof_snapshot(duer_memprof_site_t* sites, int max);
+
+/*
+ * Print the global usage and the top call sites
+ *
+ * @Param top, int, how many call sites will be printed (<= DUER_MEMPROF_DUMP_MAX)
+ */
+DUER_INT void duer_memprof_dump(int top);
+
+#endif/*DUER_MEMORY_PROFILE*/
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,6 +42,19 @@
 #define DUER_BDCAEC_MN_SIZE sizeof(DUER_BDCAEC_MN)
 #define DUER_BDCAEC_LEN_1_SIZE 4
 #define DUER_BDCAEC_LEN_2_SIZE 1
+#define DUER_BDCAEC_HEADER_SIZE (DUER_BDCAEC_MN_SIZE + DUER_BDCAEC_LEN_1_SIZE + DUER_BDCAEC_LEN_2_SIZE)
+#define DUER_AES_BLOCK_SIZE 16
+#define DUER_COAP_TCP_HDR_SIZE 8 // see _baidu_ca_coap_tcp_header_s in lightduer_coap.c
+
+// the frame buffer allocated on connecting, it grows for the larger message
+#ifndef DUER_AES_CBC_FRAME_SIZE
+#define DUER_AES_CBC_FRAME_SIZE (1024 * 2)
+#endif
+
+// the encrypted bytes read from the socket at once
+#ifndef DUER_AES_CBC_RECV_BUFFER
+#define DUER_AES_CBC_RECV_BUFFER (1024)
+#endif
 
 //#define DEV_DEBUG_AES
 #ifdef DEV_DEBUG_AES
@@ -57,6 +70,32 @@ typedef struct _duer_trans_aes_cbc_encrypted_header_s {
     duer_u8_t        raw_data[0];
 } duer_trans_aes_cbc_encrypted_header_t;
 
+/*
+ * The connection context, kept in trans->secure.
+ *
+ * The frames received are decrypted in the receive buffer as the blocks
+ * arrive, and returned as the plain CoAP TCP stream: the inner frames
+ * without the padding.
+ */
+typedef struct _duer_trans_aes_cbc_s {
+    duer_aes_context    aes;
+    unsigned char       iv[DUER_AES_BLOCK_SIZE];        // every message starts from it
+    unsigned char*      frame;                          // the frame to send
+    duer_size_t         frame_size;
+    unsigned char       header[DUER_BDCAEC_HEADER_SIZE];// the frame receiving
+    duer_size_t         header_bytes;
+    duer_size_t         raw_left;       // the raw data not skipped yet
+    duer_size_t         cipher_size;    // the encrypted data of the frame
+    duer_size_t         cipher_left;    // the encrypted data not decrypted yet
+    duer_size_t         plain_size;     // the inner frame size, 0 before it's decrypted
+    unsigned char       rx_iv[DUER_AES_BLOCK_SIZE];     // the CBC chain of the frame receiving
+    duer_size_t         rx_pos;         // the bytes processed in the rx
+    duer_size_t         rx_len;         // the bytes read in the rx
+    duer_size_t         out_pos;        // the plain text in the rx not returned yet
+    duer_size_t         out_end;
+    unsigned char       rx[DUER_AES_CBC_RECV_BUFFER];
+} duer_trans_aes_cbc_t;
+
 // convert the string representation of bindToken to binary format
 // e.g. 8cd34facea95d5491b2cb5fbacacb0f0 -> 0x8cd34facea95d5491b2cb5fbacacb0f0
 static void convert_bindtoken_to_key(char bind_token[32], unsigned char key[16]) {
@@ -68,6 +107,54 @@ static void convert_bindtoken_to_key(char bind_token[32], unsigned char key[16])
     }
 }
 
+static void duer_trans_aes_cbc_destroy(duer_trans_aes_cbc_t *secure)
+{
+    if (secure) {
+        if (secure->aes) {
+            duer_aes_context_destroy(secure->aes);
+        }
+        if (secure->frame) {
+            DUER_FREE(secure->frame);
+        }
+        DUER_FREE(secure);
+    }
+}
+
+static duer_trans_aes_cbc_t *duer_trans_aes_cbc_create(void)
+{
+    duer_trans_aes_cbc_t *secure = DUER_MALLOC(sizeof(*secure));
+
+    if (secure == NULL) {
+        return NULL;
+    }
+
+    DUER_MEMSET(secure, 0, sizeof(*secure));
+    secure->aes = duer_aes_context_init();
+    secure->frame = DUER_MALLOC(DUER_AES_CBC_FRAME_SIZE);
+    if (secure->aes == NULL || secure->frame == NULL) {
+        duer_trans_aes_cbc_destroy(secure);
+        return NULL;
+    }
+    secure->frame_size = DUER_AES_CBC_FRAME_SIZE;
+
+    return secure;
+}
+
+/*
+ * Start a new stream, drop what's left of the previous connection
+ */
+static void duer_trans_aes_cbc_reset(duer_trans_aes_cbc_t *secure)
+{
+    secure->header_bytes = 0;
+    secure->raw_left = 0;
+    secure->cipher_left = 0;
+    secure->plain_size = 0;
+    secure->rx_pos = 0;
+    secure->rx_len = 0;
+    secure->out_pos = 0;
+    secure->out_end = 0;
+}
+
 duer_status_t duer_trans_aes_cbc_encrypted_connect(duer_trans_ptr trans,
                                            const duer_addr_t *addr)
 {
@@ -77,15 +164,13 @@ duer_status_t duer_trans_aes_cbc_encrypted_connect(duer_trans_ptr trans,
     rs = duer_trans_wrapper_connect(trans, addr);
 
     if (rs == DUER_OK) {
-        duer_aes_context ptr = (duer_aes_context)trans->secure;
-        if (ptr) {
-            duer_aes_context_destroy(ptr);
-            trans->secure = NULL;
-            ptr = NULL;
+        duer_trans_aes_cbc_t *secure = (duer_trans_aes_cbc_t *)trans->secure;
+        // the buffers are kept for the reconnection
+        if (secure == NULL) {
+            secure = duer_trans_aes_cbc_create();
         }
-        ptr = duer_aes_context_init();
         do {
-            if (ptr == NULL) {
+            if (secure == NULL) {
                 DUER_LOGE("aes context init failed!");
                 rs = DUER_ERR_TRANS_INTERNAL_ERROR;
                 break;
@@ -93,26 +178,26 @@ duer_status_t duer_trans_aes_cbc_encrypted_connect(duer_trans_ptr trans,
             unsigned char key[16];
             DUER_LOGV("str_key: %s", trans->cert);
             convert_bindtoken_to_key(trans->cert, key);
-            rs = duer_aes_setkey(ptr, key, sizeof(key) * 8);
+            rs = duer_aes_setkey(secure->aes, key, sizeof(key) * 8);
             if (rs != DUER_OK) {
                 DUER_LOGE("duer_aes_setkey failed! rs:%d", rs);
                 rs = DUER_ERR_TRANS_INTERNAL_ERROR;
                 break;
             }
-            unsigned char iv[16];
-            DUER_MEMSET(iv, 0, sizeof(iv));//TODO how to get the IV
-            rs = duer_aes_setiv(ptr, iv);
+            DUER_MEMSET(secure->iv, 0, sizeof(secure->iv));//TODO how to get the IV
+            rs = duer_aes_setiv(secure->aes, secure->iv);
             if (rs != DUER_OK) {
                 DUER_LOGE("duer_aes_setiv failed, rs:%d!", rs);
                 rs = DUER_ERR_TRANS_INTERNAL_ERROR;
                 break;
             }
-            trans->secure = ptr;
+            duer_trans_aes_cbc_reset(secure);
+            trans->secure = secure;
         } while (0);
 
         if (rs != DUER_OK) {
-            duer_aes_context_destroy(ptr);
-            ptr = NULL;
+            duer_trans_aes_cbc_destroy(secure);
+            trans->secure = NULL;
             duer_trans_wrapper_close(trans);
         }
     }
@@ -125,8 +210,21 @@ duer_status_t duer_trans_aes_cbc_encrypted_send(duer_trans_ptr trans,
                                         duer_size_t size,
                                         const duer_addr_t* addr)
 {
-    duer_aes_context ptr = trans ? (duer_aes_context)trans->secure : NULL;
-    if (ptr == NULL) {
+    duer_iovec_t iov;
+
+    iov.base = data;
+    iov.len = size;
+
+    return duer_trans_aes_cbc_encrypted_sendv(trans, &iov, 1, addr);
+}
+
+duer_status_t duer_trans_aes_cbc_encrypted_sendv(duer_trans_ptr trans,
+                                        const duer_iovec_t* iov,
+                                        duer_size_t iovcnt,
+                                        const duer_addr_t* addr)
+{
+    duer_trans_aes_cbc_t *secure = trans ? (duer_trans_aes_cbc_t *)trans->secure : NULL;
+    if (secure == NULL || iov == NULL) {
         DUER_LOGE("invalid paramter");
         return DUER_ERR_TRANS_INTERNAL_ERROR;
     }
@@ -138,75 +236,60 @@ duer_status_t duer_trans_aes_cbc_encrypted_send(duer_trans_ptr trans,
     */
 
     unsigned char *output = NULL;
-    unsigned char *input = NULL;
     duer_status_t rs;
+    duer_size_t key_info_len = strlen(trans->key_info);
+    duer_size_t size = duer_trans_iov_size(iov, iovcnt);
     duer_size_t header_len = 0;
     duer_size_t output_len = 0;
     duer_trans_aes_cbc_encrypted_header_t *p_header = NULL;
 
-    duer_size_t padding_len = size % 16;
+    duer_size_t padding_len = size % DUER_AES_BLOCK_SIZE;
     if (padding_len != 0) {
-        padding_len = 16 - padding_len;
-        input = DUER_MALLOC(size + padding_len);
-        if (input == NULL) {
-            DUER_LOGE("malloc input failed!");
-            rs = DUER_ERR_MEMORY_OVERLOW;
-            goto exit;
-        }
-        DUER_MEMSET(input, 0, size + padding_len);
-        DUER_MEMCPY(input, data, size);
+        padding_len = DUER_AES_BLOCK_SIZE - padding_len;
     }
 
-    header_len = DUER_BDCAEC_MN_SIZE + DUER_BDCAEC_LEN_1_SIZE + DUER_BDCAEC_LEN_2_SIZE
-                             + strlen(trans->key_info);
+    header_len = DUER_BDCAEC_HEADER_SIZE + key_info_len;
     output_len = header_len + size + padding_len;
-    output = DUER_MALLOC(output_len);
-    if (output == NULL) {
-        DUER_LOGE("malloc output failed!");
-        rs = DUER_ERR_MEMORY_OVERLOW;
-        goto exit;
-    }
 
-    DUER_MEMSET(output, 0, size);
+    if (output_len > secure->frame_size) {
+        // the content isn't kept, no need to realloc
+        DUER_FREE(secure->frame);
+        secure->frame = DUER_MALLOC(output_len);
+        if (secure->frame == NULL) {
+            DUER_LOGE("malloc output failed!");
+            secure->frame_size = 0;
+            return DUER_ERR_MEMORY_OVERLOW;
+        }
+        secure->frame_size = output_len;
+    }
+    output = secure->frame;
 
     p_header = (duer_trans_aes_cbc_encrypted_header_t*)output;
     p_header->magic_num = duer_htonl(DUER_BDCAEC_MN);
     p_header->msg_size = duer_htonl(output_len - DUER_BDCAEC_MN_SIZE - DUER_BDCAEC_LEN_1_SIZE);
-    p_header->raw_data_size = strlen(trans->key_info);
+    p_header->raw_data_size = key_info_len;
 #ifdef DEV_DEBUG_AES
     DUER_AES_PRINT("lightduer_net_trans_encrypted.c, output_len:%lu\n", output_len);
-    unsigned int *magic_nu = (unsigned int*)output;
-    DUER_AES_PRINT("lightduer_net_trans_encrypted.c, magic_num:0x%x \n", duer_htonl(*magic_nu));
-    unsigned int *msg_len = (unsigned int*)(output + 4);
-    DUER_AES_PRINT("lightduer_net_trans_encrypted.c, msg_len:%d\n", duer_htonl(*msg_len));
-    unsigned char *raw_len = output + 8;
-    DUER_AES_PRINT("lightduer_net_trans_encrypted.c, raw_len:%d\n", *raw_len);
+    DUER_AES_PRINT("lightduer_net_trans_encrypted.c, raw_len:%d\n", key_info_len);
     DUER_AES_PRINT("lightduer_net_trans_encrypted.c, encrypted_data_len:%d\n",
-            duer_htonl(*msg_len) - 1 - *raw_len);
+            size + padding_len);
 #endif
-    DUER_MEMCPY(p_header->raw_data, trans->key_info, strlen(trans->key_info));
-    if (input) {
-        rs = duer_aes_cbc_encrypt(ptr, size + padding_len, input, output + header_len);
-    } else {
-        rs = duer_aes_cbc_encrypt(ptr, size, data, output + header_len);
-    }
+    DUER_MEMCPY(p_header->raw_data, trans->key_info, key_info_len);
+
+    // gather the plain text into its place in the frame, and encrypt it there
+    duer_trans_iov_copy(output + header_len, iov, iovcnt);
+    DUER_MEMSET(output + header_len + size, 0, padding_len);
+    rs = duer_aes_cbc_encrypt(secure->aes, size + padding_len,
+                              output + header_len, output + header_len);
 
     if (rs < 0) {
         DUER_LOGW("encrypt failed!!rs:%d", rs);
-        goto exit;
+        return rs;
     }
 
     rs = duer_trans_wrapper_send(trans, output, output_len, addr);
-    DUER_LOGI("after send: rs:%d", rs);
-exit:
-    if (output) {
-        DUER_FREE(output);
-        output = NULL;
-    }
-    if (input) {
-        DUER_FREE(input);
-        input = NULL;
-    }
+    DUER_LOGV("after send: rs:%d", rs);
+
     return rs;
 }
 
@@ -217,160 +300,176 @@ duer_status_t duer_trans_aes_cbc_encrypted_set_read_timeout(duer_trans_ptr trans
     return DUER_ERR_FAILED;
 }
 
+/*
+ * Parse the frames in the rx buffer, up to the next plain text decrypted
+ *
+ * @Param secure, in, the connection context
+ * @Return duer_status_t, DUER_OK if the rx buffer is used up,
+ *         or DUER_ERR_TRANS_INTERNAL_ERROR if the stream is broken
+ */
+static duer_status_t duer_trans_aes_cbc_parse(duer_trans_aes_cbc_t *secure)
+{
+    duer_trans_aes_cbc_encrypted_header_t *p_header = NULL;
+    duer_size_t length = 0;
+    duer_size_t msg_size = 0;
+    duer_u32_t inner_size = 0;
+    duer_status_t rs = DUER_OK;
+
+    while (secure->rx_pos < secure->rx_len && secure->out_pos == secure->out_end) {
+        length = secure->rx_len - secure->rx_pos;
+
+        if (secure->header_bytes < DUER_BDCAEC_HEADER_SIZE) {
+            if (length > DUER_BDCAEC_HEADER_SIZE - secure->header_bytes) {
+                length = DUER_BDCAEC_HEADER_SIZE - secure->header_bytes;
+            }
+            DUER_MEMCPY(secure->header + secure->header_bytes, secure->rx + secure->rx_pos, length);
+            secure->header_bytes += length;
+            secure->rx_pos += length;
+
+            if (secure->header_bytes < DUER_BDCAEC_HEADER_SIZE) {
+                break;
+            }
+
+            p_header = (duer_trans_aes_cbc_encrypted_header_t *)secure->header;
+            msg_size = duer_htonl(p_header->msg_size);
+            secure->raw_left = p_header->raw_data_size;
+            if (duer_htonl(p_header->magic_num) != DUER_BDCAEC_MN
+                    || msg_size < DUER_BDCAEC_LEN_2_SIZE + secure->raw_left + DUER_AES_BLOCK_SIZE
+                    || (msg_size - DUER_BDCAEC_LEN_2_SIZE - secure->raw_left)
+                        % DUER_AES_BLOCK_SIZE != 0) {
+                DUER_LOGE("wrong frame header: magic = %x, size = %d, raw = %d",
+                          duer_htonl(p_header->magic_num), msg_size, secure->raw_left);
+                rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+                break;
+            }
+            secure->cipher_size = msg_size - DUER_BDCAEC_LEN_2_SIZE - secure->raw_left;
+            secure->cipher_left = secure->cipher_size;
+            secure->plain_size = 0;
+            DUER_MEMCPY(secure->rx_iv, secure->iv, sizeof(secure->rx_iv));
+        } else if (secure->raw_left > 0) {
+            if (length > secure->raw_left) {
+                length = secure->raw_left;
+            }
+            secure->raw_left -= length;
+            secure->rx_pos += length;
+        } else {
+            // decrypt the whole blocks in place, the partial one waits for the rest
+            if (length > secure->cipher_left) {
+                length = secure->cipher_left;
+            }
+            length -= length % DUER_AES_BLOCK_SIZE;
+            if (length == 0) {
+                break;
+            }
+
+            rs = duer_aes_cbc_decrypt_update(secure->aes, length, secure->rx_iv,
+                                             secure->rx + secure->rx_pos,
+                                             secure->rx + secure->rx_pos);
+            if (rs < 0) {
+                DUER_LOGE("decrypted failed! rs:%d", rs);
+                rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+                break;
+            }
+
+            msg_size = secure->cipher_size - secure->cipher_left; // decrypted before
+            if (msg_size == 0) {
+                // the inner CoAP TCP frame header, the rest is the padding
+                DUER_MEMCPY(&inner_size, secure->rx + secure->rx_pos + 4, sizeof(inner_size));
+                secure->plain_size = DUER_COAP_TCP_HDR_SIZE + duer_htonl(inner_size);
+                if (secure->plain_size > secure->cipher_size) {
+                    DUER_LOGE("wrong inner frame: size = %d, encrypted = %d",
+                              secure->plain_size, secure->cipher_size);
+                    rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+                    break;
+                }
+            }
+
+            secure->out_pos = secure->rx_pos;
+            secure->out_end = secure->rx_pos;
+            if (msg_size < secure->plain_size) {
+                secure->out_end += length < secure->plain_size - msg_size
+                        ? length : secure->plain_size - msg_size;
+            }
+            secure->rx_pos += length;
+            secure->cipher_left -= length;
+            if (secure->cipher_left == 0) {
+                secure->header_bytes = 0;
+            }
+        }
+    }
+
+    return rs;
+}
+
 duer_status_t duer_trans_aes_cbc_encrypted_recv(duer_trans_ptr trans,
                                         void* data,
                                         duer_size_t size,
                                         duer_addr_t* addr)
 {
-    duer_status_t rs = DUER_ERR_TRANS_INTERNAL_ERROR;
-    duer_size_t need_to_read = size;
-    if (size == DUER_SIZEOF_TCPHEADER) {
-        DUER_LOGI("current trans->received_header_bytes: %d [mostly 0]", trans->received_header_bytes);
-        if (trans->received_header_bytes == DUER_SIZEOF_TCPHEADER) {//all header already received
-            DUER_MEMCPY(data, trans->received_header, size);
-            rs = size;
-            return rs;
-        } else if (trans->received_header_bytes < DUER_SIZEOF_TCPHEADER) {//part header received
-            need_to_read -= trans->received_header_bytes;
-        } else {
-            DUER_LOGE("wrong received_header_bytes(%d) value[0-%d]!!",
-                    trans->received_header_bytes, DUER_SIZEOF_TCPHEADER);
-            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
-            return rs;
+    duer_trans_aes_cbc_t *secure = trans ? (duer_trans_aes_cbc_t *)trans->secure : NULL;
+    duer_status_t rs = DUER_OK;
+    duer_size_t received = 0;
+    duer_size_t length = 0;
+    duer_bool drained = DUER_FALSE;
+
+    if (secure == NULL || data == NULL) {
+        DUER_LOGE("invalid paramter");
+        return DUER_ERR_TRANS_INTERNAL_ERROR;
+    }
+
+    while (received < size) {
+        if (secure->out_pos < secure->out_end) {
+            length = secure->out_end - secure->out_pos;
+            if (length > size - received) {
+                length = size - received;
+            }
+            DUER_MEMCPY((unsigned char *)data + received, secure->rx + secure->out_pos, length);
+            secure->out_pos += length;
+            received += length;
+            continue;
         }
-    } else if (size >= DUER_MIN_BODY_SIZE && size <= DUER_MAX_BODY_SIZE) {
-        DUER_LOGI("current trans->received_body_bytes: %d [mostly 0]", trans->received_body_bytes);
-        if (trans->received_body_bytes < size) { // trans->received_body_bytes should less than size
-            need_to_read -= trans->received_body_bytes;
-        } else {
-            DUER_LOGE("wrong received_body_bytes(%d) value[%d-%d]!!",
-                    trans->received_body_bytes, DUER_MIN_BODY_SIZE, DUER_MAX_BODY_SIZE);
-            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+
+        rs = duer_trans_aes_cbc_parse(secure);
+        if (rs < 0) {
+            duer_trans_aes_cbc_reset(secure);
             return rs;
         }
-    } else {
-        DUER_LOGE("wrong size try to receive, header[%d], body[%d-%d]!!",
-                DUER_SIZEOF_TCPHEADER, DUER_MIN_BODY_SIZE, DUER_MAX_BODY_SIZE);
-        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
-        return rs;
-    }
-    rs = duer_trans_wrapper_recv(trans, data, need_to_read, addr);
-    if (rs <= 0) {
-        if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
-            DUER_LOGW("recv error! rs:%d, size:%d", rs, size);
+        if (secure->out_pos < secure->out_end) {
+            continue;
         }
-        goto exit;
-    }
 
-    DUER_LOGI("received size:%d [mostly %d]", rs, size);
-    if (size == DUER_SIZEOF_TCPHEADER) { //header
-        if (rs == need_to_read) { // all header info got
-            DUER_MEMCPY(trans->received_header + trans->received_header_bytes,
-                        data, need_to_read);//cached the received data
-            trans->received_header_bytes = size;
-            DUER_MEMCPY(data, trans->received_header, size);
-            rs = size;
-
-            duer_trans_aes_cbc_encrypted_header_t *p_header
-                    = (duer_trans_aes_cbc_encrypted_header_t*)data;
-            unsigned int magic_num = duer_htonl(p_header->magic_num);
-            unsigned int length = duer_htonl(p_header->msg_size);
-#ifdef DEV_DEBUG_AES
-            unsigned int *p_magic_num = (unsigned int*)data;
-            DUER_AES_PRINT("magic_number: %x\n", duer_htonl(*p_magic_num));
-            unsigned int *p_length = (unsigned int*)(data + 4);
-            DUER_AES_PRINT("outer_length:%u\n", duer_htonl(*p_length));
-#endif
-            if (magic_num == DUER_BDCAEC_MN) {//AES-encrypted method used, update the magic number
-                p_header->magic_num = duer_htonl(DUER_COAP_TCP_HDR);
-                DUER_MEMCPY(trans->received_header, data, size);
-            }
-        } else {//part header info received
-            DUER_LOGW("got only part of header info, rarely case happened!rs:%d < need_to_read:%d",
-                      rs, need_to_read);
-            //cached the received data
-            DUER_MEMCPY(trans->received_header + trans->received_header_bytes,
-                        data, rs);
-            trans->received_header_bytes += rs;
-            rs = DUER_ERR_TRANS_WOULD_BLOCK; // notify the caller to try again
-            goto exit;
+        // the transport has no more for now
+        if (drained && received > 0) {
+            break;
         }
-    } else { //body
-        if (rs != need_to_read) {
-            DUER_LOGE("receive part body info, rarely case happened! rs:%d, need_to_read: %d",
-                       rs, need_to_read);
-            DUER_MEMCPY(trans->received_body + trans->received_body_bytes,
-                        data, rs);
-            trans->received_body_bytes += rs;
-            rs = DUER_ERR_TRANS_WOULD_BLOCK; // notify the caller to try again
-            goto exit;
-        } else {
-            duer_aes_context ptr = trans ? (duer_aes_context)trans->secure : NULL;
-            if (ptr == NULL) {
-                DUER_LOGE("aes_context is NULL");
-                rs = DUER_ERR_TRANS_INTERNAL_ERROR;
-                goto exit;
-            }
 
-            //all body info got
-            if (need_to_read != size) { // partly received before rarely happen
-                DUER_LOGW("rarely happen case!!!");
-                DUER_MEMCPY(trans->received_body + trans->received_body_bytes,
-                        data, need_to_read);
-                DUER_MEMCPY(data, trans->received_body, size);
-                rs = size;
-            }
-            //clear cached info, ? need to reset the buffer content after handle
-            trans->received_header_bytes = 0;
-            trans->received_body_bytes = 0;
-
-            // begin to parse the received body
-            unsigned char *p_raw_data_len = (unsigned char*)data;
-            unsigned int raw_data_len = *p_raw_data_len;
-            unsigned int encrypted_msg_len = size -1 - raw_data_len;
-            unsigned char *output = (unsigned char *)trans->received_body;
-#ifdef DEV_DEBUG_AES
-            DUER_AES_PRINT("raw_data_len: %x \n", raw_data_len);
-            DUER_AES_PRINT("encrypted_msg_len: %x \n", encrypted_msg_len);
-            //unsigned char *raw_data = (unsigned char*)(data + 1);
-            //DUER_AES_PRINT("raw_data:%s \n", raw_data);
-#endif
-            rs = duer_aes_cbc_decrypt(ptr, encrypted_msg_len,
-                        (const unsigned char*)data + 1 + raw_data_len,
-                        output);
-            if (rs < 0) {
-                DUER_LOGE("decrypted failed! rs:%d", rs);
-                rs = DUER_ERR_TRANS_INTERNAL_ERROR;
-                output = NULL;
-                goto exit;
-            }
-            unsigned int *p_length = (unsigned int*)(output + 4);
-            unsigned int length = duer_htonl(*p_length);
-#ifdef DEV_DEBUG_AES
-            unsigned int *p_magic_num = (unsigned int*)output;
-            unsigned int magic_num = duer_htonl(*p_magic_num);
-            DUER_AES_PRINT("coap magic_number: %x\n", magic_num);
-            DUER_AES_PRINT("coap_length:%u\n", length);
-#endif
-            DUER_MEMSET(data, 0, size);
-            DUER_MEMCPY(data, output + 8, length);
-            if (rs == 0) {
-                rs = length;
+        // keep the partial block, and read for the rest
+        length = secure->rx_len - secure->rx_pos;
+        if (length > 0 && secure->rx_pos > 0) {
+            DUER_MEMMOVE(secure->rx, secure->rx + secure->rx_pos, length);
+        }
+        secure->rx_pos = 0;
+        secure->rx_len = length;
+
+        rs = duer_trans_wrapper_recv(trans, secure->rx + length, sizeof(secure->rx) - length, addr);
+        if (rs <= 0) {
+            if (rs < 0 && rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+                DUER_LOGW("recv error! rs:%d, size:%d", rs, size);
             }
-            output = NULL;
+            break;
         }
+        drained = rs < sizeof(secure->rx) - length ? DUER_TRUE : DUER_FALSE;
+        secure->rx_len += rs;
     }
 
-exit:
-
-    return rs;
+    return received > 0 ? received : rs;
 }
 
 duer_status_t duer_trans_aes_cbc_encrypted_close(duer_trans_ptr trans)
 {
-    duer_aes_context ptr = trans ? (duer_aes_context)trans->secure : NULL;
-    if (ptr) {
-        duer_aes_context_destroy(ptr);
+    duer_trans_aes_cbc_t *secure = trans ? (duer_trans_aes_cbc_t *)trans->secure : NULL;
+    if (secure) {
+        duer_trans_aes_cbc_destroy(secure);
         trans->secure = NULL;
     }
     return duer_trans_wrapper_close(trans);
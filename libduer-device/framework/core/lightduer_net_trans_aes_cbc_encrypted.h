@@ -51,6 +51,21 @@ DUER_INT duer_status_t duer_trans_aes_cbc_encrypted_send(duer_trans_ptr trans,
                                                  duer_size_t size,
                                                  const duer_addr_t* addr);
 
+/*
+ * Send the segments in order as one message, they are copied straight
+ * into the frame and encrypted there.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Param iov, in, the segments will be sent
+ * @Param iovcnt, in, the segments count
+ * @Param addr, in, the target address infomations
+ * @Return duer_status_t, the operation result
+ */
+DUER_INT duer_status_t duer_trans_aes_cbc_encrypted_sendv(duer_trans_ptr trans,
+                                                          const duer_iovec_t* iov,
+                                                          duer_size_t iovcnt,
+                                                          const duer_addr_t* addr);
+
 /*
  * Set the timeout for receiving data.
  *
@@ -62,14 +77,14 @@ DUER_INT duer_status_t duer_trans_aes_cbc_encrypted_set_read_timeout(duer_trans_
                                                              duer_u32_t timeout);
 
 /*
- * Receive data.
+ * Receive data, the frames are decrypted as the bytes arrive, and returned
+ * as the plain CoAP TCP stream.
  *
  * @Param hdlr, in, the context for the transport
  * @Param data, out, the data will be read
  * @Param size, in, the data size
  * @Param addr, out, the target address infomations
- * @Return duer_status_t, the operation result
- *  Note, the return size maybe different with the @size, because the BDCAEC used
+ * @Return duer_status_t, the bytes received, or the error
  */
 DUER_INT duer_status_t duer_trans_aes_cbc_encrypted_recv(duer_trans_ptr trans,
                                                  void* data,
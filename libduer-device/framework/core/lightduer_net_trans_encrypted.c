@@ -27,6 +27,7 @@
 #include MBEDTLS_CONFIG_FILE
 #endif
 #include "mbedtls/ssl.h"
+#include "mbedtls/platform.h"
 #include "mbedtls/entropy.h"
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/timing.h"
@@ -39,6 +40,7 @@
 #include "lightduer_net_transport.h"
 #include "lightduer_random.h"
 #include "lightduer_memory.h"
+#include "lightduer_mutex.h"
 #include "lightduer_log.h"
 
 
@@ -48,6 +50,37 @@
 #define HANDSHAKE_TIMEOUT_MIN       (1000)
 #define HANDSHAKE_TIMEOUT_MAX       (4000)
 
+// offer the session of the last connection to the same host, the server
+// resumes it by the session id or the session ticket, without the RSA key
+// exchange and the certificate
+#ifndef DUER_TLS_SESSION_RESUMPTION
+#define DUER_TLS_SESSION_RESUMPTION (1)
+#endif
+
+// the largest session saved through the platform hook, the ticket included
+#ifndef DUER_TLS_SESSION_SAVE_MAX
+#define DUER_TLS_SESSION_SAVE_MAX   (1024)
+#endif
+
+// the largest records by default, see duer_trans_set_record_size, the
+// received one is negotiated by the max_fragment_length, 0 for the largest
+#ifndef DUER_TLS_RECORD_IN_SIZE
+#define DUER_TLS_RECORD_IN_SIZE     (0)
+#endif
+
+#ifndef DUER_TLS_RECORD_OUT_SIZE
+#define DUER_TLS_RECORD_OUT_SIZE    (0)
+#endif
+
+// free the record buffers while the connection is idle, see
+// duer_trans_release_idle, they are allocated again by the next read or write
+#ifndef DUER_TLS_RELEASE_IDLE_BUFFERS
+#define DUER_TLS_RELEASE_IDLE_BUFFERS (1)
+#endif
+
+#define DUER_TLS_SESSION_VERSION    (1)
+#define DUER_TLS_SESSION_FIXED_SIZE (102)
+
 // Suppress Compiler warning Function declared never referenced
 #define SUPPRESS_WARNING(func) (void)(func)
 
@@ -57,19 +90,71 @@ typedef enum _baidu_ca_trans_status_enum {
     DUER_TRANS_ST_HANDSHAKED,
 } duer_trans_status_e;
 
-typedef struct _duer_trans_encrypted_s {
+/*
+ * The TLS client configuration shared by the connections with the same CA
+ * chain and transport. It's kept when the last connection closed, for the
+ * reconnection, and freed when the other CA chain is loaded.
+ */
+typedef struct _duer_trans_config_s {
+    duer_u32_t                      refs;
+    duer_u32_t                      cert_hash;
+    duer_size_t                     cert_len;
+    const duer_u8_t*                cert;       // the copy of the CA chain, after the struct
+    duer_u8_t                       transport;
 #ifndef MBEDTLS_DRBG_ALT
     mbedtls_entropy_context         entropy;
     mbedtls_ctr_drbg_context        ctr_drbg;
 #endif
     mbedtls_x509_crt                cacert;
-    mbedtls_ssl_context             ssl;
     mbedtls_ssl_config              ssl_conf;
+    struct _duer_trans_config_s*    next;
+} duer_trans_config_t, *duer_trans_config_ptr;
+
+typedef struct _duer_trans_encrypted_s {
+    duer_trans_config_ptr           config;
+    mbedtls_ssl_context             ssl;
     mbedtls_timing_delay_context    timer;
 
     duer_u8_t                        status;
+    duer_u32_t                       peer;      // the key of the session cached
+    duer_bool                        offered;   // the session cached is offered
+
+    /*
+     * The message blocked in the middle of the writes, the peer may have its
+     * head already, so it's finished before anything else is written
+     */
+    duer_u8_t*                       pending;
+    duer_size_t                      pending_size;
+    duer_size_t                      pending_sent;
 } duer_trans_encrypted_t, *duer_trans_encrypted_ptr;
 
+typedef struct _duer_trans_session_s {
+    duer_u32_t                       peer;      // 0 if it's empty
+    mbedtls_ssl_session              session;
+} duer_trans_session_t;
+
+#if defined(MBEDTLS_ECP_C)
+// the ECDHE curves by preference, the default of mbedtls prefers the larger
+DUER_LOC_IMPL const mbedtls_ecp_group_id s_duer_tls_curves[] = {
+#if defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED)
+    MBEDTLS_ECP_DP_SECP256R1,
+#endif
+#if defined(MBEDTLS_ECP_DP_SECP384R1_ENABLED)
+    MBEDTLS_ECP_DP_SECP384R1,
+#endif
+    MBEDTLS_ECP_DP_NONE,
+};
+#endif
+
+DUER_LOC_IMPL duer_mutex_t s_config_mutex = NULL;
+DUER_LOC_IMPL duer_trans_config_ptr s_configs = NULL;
+
+DUER_LOC_IMPL duer_mutex_t s_session_mutex = NULL;
+DUER_LOC_IMPL duer_trans_session_t s_session;
+DUER_LOC_IMPL duer_bool s_session_loaded = DUER_FALSE;
+DUER_LOC_IMPL duer_tls_session_save_f s_session_save = NULL;
+DUER_LOC_IMPL duer_tls_session_load_f s_session_load = NULL;
+
 DUER_LOC_IMPL duer_status_t duer_trans_mbedtls2status(int status) {
     duer_status_t rs = status;
 
@@ -134,6 +219,11 @@ DUER_LOC_IMPL int duer_trans_encrypted_wrap_recv_timeout(void* ctx,
         unsigned char* buf, size_t len, uint32_t timeout) {
     duer_status_t rs = DUER_ERR_FAILED;
     duer_trans_ptr trans = (duer_trans_ptr)ctx;
+    // the configuration shared has no read timeout, the DTLS handshake has
+    if (timeout == 0) {
+        timeout = trans->read_timeout;
+    }
+
     DUER_LOGV("duer_trans_encrypted_wrap_recv_timeout: timeout = %d", timeout);
     rs = duer_trans_wrapper_recv_timeout(trans, buf, len, timeout, NULL);
 
@@ -213,49 +303,476 @@ DUER_LOC_IMPL int duer_trans_encrypted_get_delay(void* data) {
     return 0;
 }
 
-DUER_LOC_IMPL duer_trans_encrypted_ptr duer_trans_get_context(duer_trans_ptr trans) {
-    duer_trans_encrypted_ptr ptr = NULL;
-    int rs = 0;
-    duer_bool use_read_timeout = 0;
-    DUER_LOGV("==> duer_trans_get_context: trans = %p", trans);
+DUER_LOC_IMPL void duer_trans_encrypted_lock(duer_mutex_t* mutex) {
+    if (!*mutex) {
+        *mutex = duer_mutex_create();
+    }
 
-    if (!trans) {
-        goto exit;
+    if (*mutex) {
+        duer_mutex_lock(*mutex);
     }
+}
 
-    ptr = (duer_trans_encrypted_ptr)trans->secure;
+DUER_LOC_IMPL void duer_trans_encrypted_unlock(duer_mutex_t* mutex) {
+    if (*mutex) {
+        duer_mutex_unlock(*mutex);
+    }
+}
 
-    if (ptr) {
+/*
+ * FNV-1a, continue the hash with the data
+ */
+DUER_LOC_IMPL duer_u32_t duer_trans_encrypted_hash(duer_u32_t hash, const void* data,
+        duer_size_t size) {
+    const duer_u8_t* p = (const duer_u8_t*)data;
+    duer_size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * The key of the session cached, the hash of the host and the port
+ */
+DUER_LOC_IMPL duer_u32_t duer_trans_session_peer(const duer_addr_t* addr) {
+    duer_u32_t hash = 2166136261u;
+    const char* host = addr ? (const char*)addr->host : NULL;
+    duer_u8_t port[2];
+    duer_size_t size = 0;
+
+    if (!host) {
+        return 0;
+    }
+
+    while (size < addr->host_size && host[size] != '\0') {
+        size++;
+    }
+
+    port[0] = (duer_u8_t)(addr->port & 0xff);
+    port[1] = (duer_u8_t)((addr->port >> 8) & 0xff);
+    hash = duer_trans_encrypted_hash(hash, host, size);
+    hash = duer_trans_encrypted_hash(hash, port, sizeof(port));
+
+    return hash ? hash : 1;
+}
+
+DUER_LOC_IMPL unsigned char* duer_trans_session_put(unsigned char* p, duer_u32_t value,
+        int bytes) {
+    while (bytes-- > 0) {
+        *p++ = (unsigned char)(value >> (bytes * 8));
+    }
+
+    return p;
+}
+
+DUER_LOC_IMPL const unsigned char* duer_trans_session_get(const unsigned char* p,
+        duer_u32_t* value, int bytes) {
+    *value = 0;
+
+    while (bytes-- > 0) {
+        *value = (*value << 8) | *p++;
+    }
+
+    return p;
+}
+
+/*
+ * Encode the session to be saved by the platform, in big endian:
+ *   version(1) peer(4) ciphersuite(2) compression(1) id_len(1) id(32)
+ *   master(48) verify_result(4) mfl_code(1) trunc_hmac(1)
+ *   encrypt_then_mac(1) ticket_lifetime(4) ticket_len(2) ticket
+ *
+ * @Return int, the bytes encoded, 0 if the buf is too small
+ */
+DUER_LOC_IMPL int duer_trans_session_encode(const duer_trans_session_t* cache,
+        unsigned char* buf, duer_size_t size) {
+    const mbedtls_ssl_session* session = &cache->session;
+    unsigned char* p = buf;
+    duer_u32_t ticket_len = 0;
+    duer_u32_t value = 0;
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    ticket_len = session->ticket ? session->ticket_len : 0;
+#endif
+
+    if (size < DUER_TLS_SESSION_FIXED_SIZE + ticket_len || ticket_len > 0xffff) {
+        return 0;
+    }
+
+    p = duer_trans_session_put(p, DUER_TLS_SESSION_VERSION, 1);
+    p = duer_trans_session_put(p, cache->peer, 4);
+    p = duer_trans_session_put(p, session->ciphersuite, 2);
+    p = duer_trans_session_put(p, session->compression, 1);
+    p = duer_trans_session_put(p, session->id_len, 1);
+    DUER_MEMCPY(p, session->id, sizeof(session->id));
+    p += sizeof(session->id);
+    DUER_MEMCPY(p, session->master, sizeof(session->master));
+    p += sizeof(session->master);
+    p = duer_trans_session_put(p, session->verify_result, 4);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    value = session->mfl_code;
+#endif
+    p = duer_trans_session_put(p, value, 1);
+    value = 0;
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+    value = session->trunc_hmac;
+#endif
+    p = duer_trans_session_put(p, value, 1);
+    value = 0;
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    value = session->encrypt_then_mac;
+#endif
+    p = duer_trans_session_put(p, value, 1);
+    value = 0;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    value = session->ticket_lifetime;
+#endif
+    p = duer_trans_session_put(p, value, 4);
+    p = duer_trans_session_put(p, ticket_len, 2);
+
+    if (ticket_len > 0) {
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        DUER_MEMCPY(p, session->ticket, ticket_len);
+        p += ticket_len;
+#endif
+    }
+
+    return p - buf;
+}
+
+DUER_LOC_IMPL duer_status_t duer_trans_session_decode(const unsigned char* buf,
+        duer_size_t size, duer_trans_session_t* cache) {
+    mbedtls_ssl_session* session = &cache->session;
+    const unsigned char* p = buf;
+    duer_u32_t peer = 0;
+    duer_u32_t value = 0;
+
+    if (size < DUER_TLS_SESSION_FIXED_SIZE || buf[0] != DUER_TLS_SESSION_VERSION) {
+        return DUER_ERR_FAILED;
+    }
+
+    // the ticket length is the last field of the fixed part
+    p = duer_trans_session_get(buf + DUER_TLS_SESSION_FIXED_SIZE - 2, &value, 2);
+
+    if (size != DUER_TLS_SESSION_FIXED_SIZE + value
+            || buf[1 + 4 + 2 + 1] > sizeof(session->id)) {
+        return DUER_ERR_FAILED;
+    }
+
+#if !defined(MBEDTLS_SSL_SESSION_TICKETS) || !defined(MBEDTLS_SSL_CLI_C)
+    if (value > 0) {
+        return DUER_ERR_FAILED;
+    }
+#endif
+
+    mbedtls_ssl_session_free(session);
+    p = duer_trans_session_get(buf + 1, &peer, 4);
+    p = duer_trans_session_get(p, &value, 2);
+    session->ciphersuite = value;
+    p = duer_trans_session_get(p, &value, 1);
+    session->compression = value;
+    p = duer_trans_session_get(p, &value, 1);
+    session->id_len = value;
+    DUER_MEMCPY(session->id, p, sizeof(session->id));
+    p += sizeof(session->id);
+    DUER_MEMCPY(session->master, p, sizeof(session->master));
+    p += sizeof(session->master);
+    p = duer_trans_session_get(p, &session->verify_result, 4);
+    p = duer_trans_session_get(p, &value, 1);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    session->mfl_code = value;
+#endif
+    p = duer_trans_session_get(p, &value, 1);
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+    session->trunc_hmac = value;
+#endif
+    p = duer_trans_session_get(p, &value, 1);
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    session->encrypt_then_mac = value;
+#endif
+    p = duer_trans_session_get(p, &value, 4);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    session->ticket_lifetime = value;
+#endif
+    p = duer_trans_session_get(p, &value, 2);
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    if (value > 0) {
+        session->ticket = mbedtls_calloc(1, value);
+
+        if (!session->ticket) {
+            mbedtls_ssl_session_free(session);
+            return DUER_ERR_MEMORY_OVERLOW;
+        }
+
+        DUER_MEMCPY(session->ticket, p, value);
+        session->ticket_len = value;
+    }
+#endif
+
+    cache->peer = peer;
+
+    return DUER_OK;
+}
+
+/*
+ * Load the session saved by the platform, only once, with the lock held.
+ */
+DUER_LOC_IMPL void duer_trans_session_load(void) {
+    unsigned char* buf = NULL;
+    duer_status_t rs;
+
+    if (s_session_loaded || !s_session_load) {
+        return;
+    }
+
+    s_session_loaded = DUER_TRUE;
+    buf = (unsigned char*)DUER_MALLOC(DUER_TLS_SESSION_SAVE_MAX);
+
+    if (!buf) {
+        return;
+    }
+
+    rs = s_session_load(buf, DUER_TLS_SESSION_SAVE_MAX);
+
+    if (rs > 0 && duer_trans_session_decode(buf, rs, &s_session) != DUER_OK) {
+        DUER_LOGW("the TLS session saved is invalid, size = %d", rs);
+    }
+
+    DUER_FREE(buf);
+}
+
+/*
+ * Offer the session cached for the addr on the connection not handshaked.
+ */
+DUER_LOC_IMPL void duer_trans_session_offer(duer_trans_encrypted_ptr ptr,
+        const duer_addr_t* addr) {
+    int rs;
+
+    ptr->peer = duer_trans_session_peer(addr);
+
+    if (!DUER_TLS_SESSION_RESUMPTION || ptr->peer == 0) {
+        return;
+    }
+
+    duer_trans_encrypted_lock(&s_session_mutex);
+    duer_trans_session_load();
+
+    if (s_session.peer == ptr->peer) {
+        rs = mbedtls_ssl_set_session(&ptr->ssl, &s_session.session);
+
+        if (rs == 0) {
+            ptr->offered = DUER_TRUE;
+        } else {
+            DUER_LOGW("mbedtls_ssl_set_session failed: %d", rs);
+        }
+    }
+
+    duer_trans_encrypted_unlock(&s_session_mutex);
+}
+
+/*
+ * Cache the session handshaked, and save it through the platform hook when
+ * it's changed.
+ */
+DUER_LOC_IMPL void duer_trans_session_store(duer_trans_encrypted_ptr ptr) {
+    mbedtls_ssl_session session;
+    unsigned char* buf = NULL;
+    duer_bool resumed = DUER_FALSE;
+    duer_bool changed = DUER_TRUE;
+    int size = 0;
+    int rs;
+
+    if (!DUER_TLS_SESSION_RESUMPTION || ptr->peer == 0) {
+        return;
+    }
+
+    mbedtls_ssl_session_init(&session);
+    rs = mbedtls_ssl_get_session(&ptr->ssl, &session);
+
+    if (rs != 0) {
+        DUER_LOGW("mbedtls_ssl_get_session failed: %d", rs);
         goto exit;
     }
 
-    ptr = (duer_trans_encrypted_ptr)DUER_MALLOC(sizeof(duer_trans_encrypted_t));
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    // the certificate has been verified on the full handshake, the session
+    // resumed doesn't need it
+    if (session.peer_cert) {
+        mbedtls_x509_crt_free(session.peer_cert);
+        mbedtls_free(session.peer_cert);
+        session.peer_cert = NULL;
+    }
+#endif
 
-    if (!ptr) {
+    duer_trans_encrypted_lock(&s_session_mutex);
+
+    if (s_session.peer == ptr->peer) {
+        resumed = ptr->offered
+                  && DUER_MEMCMP(s_session.session.master, session.master,
+                                 sizeof(session.master)) == 0;
+        changed = !resumed
+                  || s_session.session.id_len != session.id_len
+                  || DUER_MEMCMP(s_session.session.id, session.id, session.id_len) != 0;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+        // the server may issue the new ticket on the session resumed
+        changed = changed
+                  || s_session.session.ticket_len != session.ticket_len
+                  || (session.ticket_len > 0
+                      && DUER_MEMCMP(s_session.session.ticket, session.ticket,
+                                     session.ticket_len) != 0);
+#endif
+    }
+
+    if (changed) {
+        mbedtls_ssl_session_free(&s_session.session);
+        s_session.session = session;
+        s_session.peer = ptr->peer;
+        mbedtls_ssl_session_init(&session);
+
+        if (s_session_save) {
+            buf = (unsigned char*)DUER_MALLOC(DUER_TLS_SESSION_SAVE_MAX);
+
+            if (buf) {
+                size = duer_trans_session_encode(&s_session, buf,
+                                                 DUER_TLS_SESSION_SAVE_MAX);
+            }
+        }
+    }
+
+    duer_trans_encrypted_unlock(&s_session_mutex);
+    DUER_LOGI("TLS handshaked, session %s", resumed ? "resumed" : "negotiated");
+
+    if (size > 0) {
+        rs = s_session_save(buf, size);
+
+        if (rs < DUER_OK) {
+            DUER_LOGW("save the TLS session failed: %d", rs);
+        }
+    }
+
+exit:
+    if (buf) {
+        DUER_FREE(buf);
+    }
+
+    mbedtls_ssl_session_free(&session);
+}
+
+/*
+ * Drop the session cached for the peer, the handshake offered it failed.
+ */
+DUER_LOC_IMPL void duer_trans_session_drop(duer_u32_t peer) {
+    duer_bool dropped = DUER_FALSE;
+
+    duer_trans_encrypted_lock(&s_session_mutex);
+
+    if (s_session.peer != 0 && (peer == 0 || s_session.peer == peer)) {
+        mbedtls_ssl_session_free(&s_session.session);
+        s_session.peer = 0;
+        dropped = DUER_TRUE;
+    }
+
+    duer_trans_encrypted_unlock(&s_session_mutex);
+
+    if (dropped && s_session_save) {
+        s_session_save(NULL, 0);
+    }
+}
+
+DUER_EXT_IMPL void baidu_ca_tls_session_init(duer_tls_session_save_f f_save,
+        duer_tls_session_load_f f_load) {
+    duer_trans_encrypted_lock(&s_session_mutex);
+    s_session_save = f_save;
+    s_session_load = f_load;
+    s_session_loaded = DUER_FALSE;
+    duer_trans_encrypted_unlock(&s_session_mutex);
+}
+
+DUER_INT_IMPL void duer_trans_encrypted_forget_session(void) {
+    duer_trans_session_drop(0);
+}
+
+/*
+ * The read timeout is the transport's, it may be set after connected.
+ */
+DUER_LOC_IMPL void duer_trans_encrypted_set_bio(duer_trans_ptr trans,
+        duer_trans_encrypted_ptr ptr) {
+    duer_bool use_read_timeout = trans->read_timeout != DUER_READ_FOREVER;
+
+    mbedtls_ssl_set_bio(&ptr->ssl, trans,
+                        duer_trans_encrypted_wrap_send, duer_trans_encrypted_wrap_recv,
+                        use_read_timeout ? duer_trans_encrypted_wrap_recv_timeout : NULL);
+}
+
+#ifndef MBEDTLS_DRBG_ALT
+/*
+ * The DRBG is shared by the connections, which may handshake on the
+ * different threads.
+ */
+DUER_LOC_IMPL int duer_trans_config_random(void* ctx, unsigned char* output,
+        size_t len) {
+    int rs;
+
+    duer_trans_encrypted_lock(&s_config_mutex);
+    rs = mbedtls_ctr_drbg_random(ctx, output, len);
+    duer_trans_encrypted_unlock(&s_config_mutex);
+
+    return rs;
+}
+#endif
+
+DUER_LOC_IMPL void duer_trans_config_free(duer_trans_config_ptr config) {
+    mbedtls_ssl_config_free(&config->ssl_conf);
+    mbedtls_x509_crt_free(&config->cacert);
+#ifndef MBEDTLS_DRBG_ALT
+    mbedtls_ctr_drbg_free(&config->ctr_drbg);
+    mbedtls_entropy_free(&config->entropy);
+#endif
+    DUER_FREE(config);
+}
+
+/*
+ * Build the configuration from the CA chain of the transport: seed the DRBG,
+ * parse the certificates into DER, and setup the ssl_config.
+ */
+DUER_LOC_IMPL duer_trans_config_ptr duer_trans_config_create(duer_trans_ptr trans) {
+    duer_trans_config_ptr config = NULL;
+    int rs = 0;
+
+    config = (duer_trans_config_ptr)DUER_MALLOC(sizeof(duer_trans_config_t) + trans->cert_len);
+
+    if (!config) {
         goto exit;
     }
 
-    DUER_MEMSET(ptr, 0, sizeof(duer_trans_encrypted_t));
+    DUER_MEMSET(config, 0, sizeof(duer_trans_config_t));
+    // matched by duer_trans_config_acquire, the transport's chain may be gone by then
+    config->cert = (const duer_u8_t*)(config + 1);
+    config->cert_len = trans->cert_len;
+    DUER_MEMCPY((duer_u8_t*)(config + 1), trans->cert, trans->cert_len);
     /*
-     * 0. Initialize the RNG and the session data
+     * 0. Initialize the RNG
      */
-    mbedtls_ssl_init(&ptr->ssl);
-    mbedtls_ssl_config_init(&ptr->ssl_conf);
-    mbedtls_x509_crt_init(&ptr->cacert);
+    mbedtls_ssl_config_init(&config->ssl_conf);
+    mbedtls_x509_crt_init(&config->cacert);
 #ifndef MBEDTLS_DRBG_ALT
-    mbedtls_ctr_drbg_init(&ptr->ctr_drbg);
-    mbedtls_entropy_init(&ptr->entropy);
+    mbedtls_ctr_drbg_init(&config->ctr_drbg);
+    mbedtls_entropy_init(&config->entropy);
     SUPPRESS_WARNING(duer_trans_encrypted_poll);
-    rs = mbedtls_entropy_add_source(&ptr->entropy, duer_trans_encrypted_poll, NULL, 128, 1);
+    rs = mbedtls_entropy_add_source(&config->entropy, duer_trans_encrypted_poll, NULL, 128, 1);
 
     if (rs != 0) {
         DUER_LOGE("mbedtls_entropy_add_source failed: %d", rs);
         goto error;
     }
 
-    rs = mbedtls_ctr_drbg_seed(&ptr->ctr_drbg,
+    rs = mbedtls_ctr_drbg_seed(&config->ctr_drbg,
                                mbedtls_entropy_func,
-                               &ptr->entropy,
+                               &config->entropy,
                                (const unsigned char*)(DRBG_PERS_CLIENT),
                                sizeof(DRBG_PERS_CLIENT));
 
@@ -268,7 +785,7 @@ DUER_LOC_IMPL duer_trans_encrypted_ptr duer_trans_get_context(duer_trans_ptr tra
     /*
      * 1. Load certificates
      */
-    rs = mbedtls_x509_crt_parse(&ptr->cacert,
+    rs = mbedtls_x509_crt_parse(&config->cacert,
                                 (const unsigned char*)trans->cert,
                                 trans->cert_len);
 
@@ -280,7 +797,7 @@ DUER_LOC_IMPL duer_trans_encrypted_ptr duer_trans_get_context(duer_trans_ptr tra
     /*
      * 2. Setup stuff
      */
-    rs = mbedtls_ssl_config_defaults(&ptr->ssl_conf,
+    rs = mbedtls_ssl_config_defaults(&config->ssl_conf,
                                      MBEDTLS_SSL_IS_CLIENT,
                                      trans->addr.type == DUER_PROTO_UDP
                                      ? MBEDTLS_SSL_TRANSPORT_DATAGRAM
@@ -295,22 +812,202 @@ DUER_LOC_IMPL duer_trans_encrypted_ptr duer_trans_get_context(duer_trans_ptr tra
     /* OPTIONAL is usually a bad choice for security, but makes interop easier
      * in this simplified example, in which the ca chain is hardcoded.
      * Production code should set a proper ca chain and use REQUIRED. */
-    mbedtls_ssl_conf_authmode(&ptr->ssl_conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+    mbedtls_ssl_conf_authmode(&config->ssl_conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
     //mbedtls_ssl_conf_authmode(&ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
-    mbedtls_ssl_conf_ca_chain(&ptr->ssl_conf, &ptr->cacert, NULL);
+    mbedtls_ssl_conf_ca_chain(&config->ssl_conf, &config->cacert, NULL);
+#if defined(MBEDTLS_ECP_C)
+    mbedtls_ssl_conf_curves(&config->ssl_conf, s_duer_tls_curves);
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&config->ssl_conf, DUER_TLS_SESSION_RESUMPTION
+                                     ? MBEDTLS_SSL_SESSION_TICKETS_ENABLED
+                                     : MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+#endif
 #ifndef MBEDTLS_DRBG_ALT
-    mbedtls_ssl_conf_rng(&ptr->ssl_conf, mbedtls_ctr_drbg_random, &ptr->ctr_drbg);
+    mbedtls_ssl_conf_rng(&config->ssl_conf, duer_trans_config_random, &config->ctr_drbg);
 #else
-    mbedtls_ssl_conf_rng(&ptr->ssl_conf, mbedtls_ctr_drbg_random, NULL);
+    mbedtls_ssl_conf_rng(&config->ssl_conf, mbedtls_ctr_drbg_random, NULL);
 #endif
-    //config-option it by user
-    //mbedtls_ssl_conf_read_timeout(&_ssl_conf, REPORT_NET_RECEIVE_TIMEOUT);
+    // the read timeout is the transport's, see duer_trans_encrypted_wrap_recv_timeout
 #if defined(DUER_MBEDTLS_DEBUG) && (DUER_MBEDTLS_DEBUG > 0)
     SUPPRESS_WARNING(duer_trans_encrypted_wrap_debug);
-    mbedtls_ssl_conf_dbg(&ptr->ssl_conf, duer_trans_encrypted_wrap_debug, NULL);
+    mbedtls_ssl_conf_dbg(&config->ssl_conf, duer_trans_encrypted_wrap_debug, NULL);
     mbedtls_debug_set_threshold(DUER_MBEDTLS_DEBUG);
 #endif
-    rs = mbedtls_ssl_setup(&ptr->ssl, &ptr->ssl_conf);
+    mbedtls_ssl_conf_handshake_timeout(&config->ssl_conf, HANDSHAKE_TIMEOUT_MIN,
+                                       HANDSHAKE_TIMEOUT_MAX);
+exit:
+    return config;
+error:
+
+    if (config) {
+        duer_trans_config_free(config);
+        config = NULL;
+    }
+
+    goto exit;
+}
+
+/*
+ * Free the configurations no connection uses, with the lock held.
+ */
+DUER_LOC_IMPL void duer_trans_config_free_unused(void) {
+    duer_trans_config_ptr* link = &s_configs;
+    duer_trans_config_ptr config = NULL;
+
+    while (*link) {
+        config = *link;
+
+        if (config->refs == 0) {
+            *link = config->next;
+            duer_trans_config_free(config);
+        } else {
+            link = &config->next;
+        }
+    }
+}
+
+/*
+ * Obtain the configuration for the CA chain and the transport, build it if
+ * it's not there.
+ */
+DUER_LOC_IMPL duer_trans_config_ptr duer_trans_config_acquire(duer_trans_ptr trans) {
+    duer_trans_config_ptr config = NULL;
+    duer_u32_t cert_hash = duer_trans_encrypted_hash(2166136261u, trans->cert,
+                                                     trans->cert_len);
+    duer_u8_t transport = trans->addr.type == DUER_PROTO_UDP
+                          ? MBEDTLS_SSL_TRANSPORT_DATAGRAM
+                          : MBEDTLS_SSL_TRANSPORT_STREAM;
+
+    duer_trans_encrypted_lock(&s_config_mutex);
+
+    for (config = s_configs; config; config = config->next) {
+        // the hash only skips the compare, a collision mustn't share the trust anchors
+        if (config->cert_hash == cert_hash && config->cert_len == trans->cert_len
+                && config->transport == transport
+                && DUER_MEMCMP(config->cert, trans->cert, trans->cert_len) == 0) {
+            config->refs++;
+            goto exit;
+        }
+    }
+
+    // the other CA chain is loaded, the ones not used are not needed any more
+    duer_trans_config_free_unused();
+    config = duer_trans_config_create(trans);
+
+    if (config) {
+        config->refs = 1;
+        config->cert_hash = cert_hash;
+        config->transport = transport;
+        config->next = s_configs;
+        s_configs = config;
+    }
+
+exit:
+    duer_trans_encrypted_unlock(&s_config_mutex);
+    return config;
+}
+
+DUER_LOC_IMPL void duer_trans_config_release(duer_trans_config_ptr config) {
+    duer_trans_encrypted_lock(&s_config_mutex);
+
+    if (config->refs > 0) {
+        config->refs--;
+    }
+
+    duer_trans_encrypted_unlock(&s_config_mutex);
+}
+
+DUER_INT_IMPL void duer_trans_encrypted_free_configs(void) {
+    duer_trans_encrypted_lock(&s_config_mutex);
+    duer_trans_config_free_unused();
+    duer_trans_encrypted_unlock(&s_config_mutex);
+}
+
+/*
+ * Apply the record sizes of the transport to the new connection
+ */
+DUER_LOC_IMPL void duer_trans_encrypted_set_record_len(duer_trans_ptr trans,
+                                             duer_trans_encrypted_ptr ptr) {
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH)
+    duer_size_t in_size = trans->record_in ? trans->record_in : DUER_TLS_RECORD_IN_SIZE;
+    duer_size_t out_size = trans->record_out ? trans->record_out : DUER_TLS_RECORD_OUT_SIZE;
+    unsigned char mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+    int rs;
+
+    switch (in_size) {
+    case 512:
+        mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_512;
+        break;
+    case 1024:
+        mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+        break;
+    case 2048:
+        mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+        break;
+    case 4096:
+        mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+        break;
+    default:
+        // the largest by default
+        break;
+    }
+
+    if (out_size > MBEDTLS_SSL_MAX_CONTENT_LEN) {
+        out_size = MBEDTLS_SSL_MAX_CONTENT_LEN;
+    }
+
+    rs = mbedtls_ssl_set_record_len(&ptr->ssl, mfl_code, out_size);
+
+    if (rs != 0) {
+        DUER_LOGW("record size %d/%d not supported: -0x%04x, the default used",
+                  in_size, out_size, -rs);
+    }
+#endif
+}
+
+/*
+ * Free the record buffers if nothing in flight
+ */
+DUER_LOC_IMPL void duer_trans_encrypted_release_buffers(duer_trans_encrypted_ptr ptr) {
+#if defined(MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH) && DUER_TLS_RELEASE_IDLE_BUFFERS
+    SUPPRESS_WARNING(mbedtls_ssl_release_buffers(&ptr->ssl));
+#endif
+}
+
+DUER_LOC_IMPL duer_trans_encrypted_ptr duer_trans_get_context(duer_trans_ptr trans) {
+    duer_trans_encrypted_ptr ptr = NULL;
+    int rs = 0;
+    DUER_LOGV("==> duer_trans_get_context: trans = %p", trans);
+
+    if (!trans) {
+        goto exit;
+    }
+
+    ptr = (duer_trans_encrypted_ptr)trans->secure;
+
+    if (ptr) {
+        goto exit;
+    }
+
+    ptr = (duer_trans_encrypted_ptr)DUER_MALLOC(sizeof(duer_trans_encrypted_t));
+
+    if (!ptr) {
+        goto exit;
+    }
+
+    DUER_MEMSET(ptr, 0, sizeof(duer_trans_encrypted_t));
+    mbedtls_ssl_init(&ptr->ssl);
+    ptr->config = duer_trans_config_acquire(trans);
+
+    if (!ptr->config) {
+        goto error;
+    }
+
+    /*
+     * Only the session data is by the connection
+     */
+    rs = mbedtls_ssl_setup(&ptr->ssl, &ptr->config->ssl_conf);
 
     if (rs != 0) {
         DUER_LOGE("mbedtls_ssl_setup failed: %d", rs);
@@ -324,21 +1021,12 @@ DUER_LOC_IMPL duer_trans_encrypted_ptr duer_trans_get_context(duer_trans_ptr tra
         goto error;
     }
 
-    use_read_timeout = trans->read_timeout != DUER_READ_FOREVER;
-    mbedtls_ssl_set_bio(&ptr->ssl, trans,
-                        duer_trans_encrypted_wrap_send, duer_trans_encrypted_wrap_recv,
-                        use_read_timeout ? duer_trans_encrypted_wrap_recv_timeout : NULL);
+    duer_trans_encrypted_set_record_len(trans, ptr);
+    duer_trans_encrypted_set_bio(trans, ptr);
     mbedtls_ssl_set_timer_cb(&ptr->ssl,
                              &ptr->timer,
                              duer_trans_encrypted_set_delay,
                              duer_trans_encrypted_get_delay);
-
-    if (use_read_timeout) {
-        mbedtls_ssl_conf_read_timeout(&ptr->ssl_conf, trans->read_timeout);
-    }
-
-    mbedtls_ssl_conf_handshake_timeout(&ptr->ssl_conf, HANDSHAKE_TIMEOUT_MIN,
-                                       HANDSHAKE_TIMEOUT_MAX);
     ptr->status = DUER_TRANS_ST_DISCONNECTED;
     trans->secure = ptr;
 exit:
@@ -347,6 +1035,12 @@ exit:
 error:
 
     if (ptr) {
+        mbedtls_ssl_free(&ptr->ssl);
+
+        if (ptr->config) {
+            duer_trans_config_release(ptr->config);
+        }
+
         DUER_FREE(ptr);
         ptr = NULL;
     }
@@ -369,6 +1063,12 @@ DUER_LOC_IMPL duer_status_t duer_trans_encrypted_handshake(duer_trans_ptr trans)
 
     if (rs == DUER_OK) {
         ptr->status = DUER_TRANS_ST_HANDSHAKED;
+        duer_trans_session_store(ptr);
+        duer_trans_encrypted_release_buffers(ptr);
+    } else if (rs != DUER_ERR_TRANS_WOULD_BLOCK && ptr->offered) {
+        // the server may keep failing on the session, run the full one next time
+        duer_trans_session_drop(ptr->peer);
+        ptr->offered = DUER_FALSE;
     }
 
 exit:
@@ -464,6 +1164,10 @@ DUER_INT_IMPL duer_status_t duer_trans_encrypted_connect(duer_trans_ptr trans,
     }
 
     if (ptr->status == DUER_TRANS_ST_DISCONNECTED) {
+        if (ptr->peer == 0) {
+            duer_trans_session_offer(ptr, addr);
+        }
+
         rs = duer_trans_encrypted_do_connect(trans, addr);
 
         if (rs < DUER_OK) {
@@ -477,11 +1181,44 @@ exit:
     return rs;
 }
 
+/*
+ * Write the rest of the message blocked, mbedtls requires the same data to be
+ * given again after it returned WANT_WRITE/WANT_READ
+ */
+DUER_LOC_IMPL duer_status_t duer_trans_encrypted_flush(duer_trans_encrypted_ptr ptr) {
+    int rs = 0;
+
+    while (ptr->pending_sent < ptr->pending_size) {
+        rs = mbedtls_ssl_write(&(ptr->ssl), ptr->pending + ptr->pending_sent,
+                               ptr->pending_size - ptr->pending_sent);
+
+        if (rs <= 0) {
+            return duer_trans_mbedtls2status(rs);
+        }
+
+        ptr->pending_sent += rs;
+    }
+
+    return DUER_OK;
+}
+
+DUER_LOC_IMPL void duer_trans_encrypted_drop_pending(duer_trans_encrypted_ptr ptr) {
+    if (ptr->pending) {
+        DUER_FREE(ptr->pending);
+        ptr->pending = NULL;
+    }
+
+    ptr->pending_size = 0;
+    ptr->pending_sent = 0;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_encrypted_send(duer_trans_ptr trans,
         const void* data,
         duer_size_t size,
         const duer_addr_t* addr) {
     duer_trans_encrypted_ptr ptr = trans ? (duer_trans_encrypted_ptr)trans->secure : NULL;
+    duer_size_t sent = 0;
+    duer_bool same = DUER_FALSE;
     int rs = DUER_ERR_FAILED;
     DUER_LOGV("==> duer_trans_encrypted_send: trans = %p, size:%d", trans, size);
     rs = duer_trans_encrypted_prepare(trans);
@@ -491,9 +1228,98 @@ DUER_INT_IMPL duer_status_t duer_trans_encrypted_send(duer_trans_ptr trans,
         goto exit;
     }
 
-    rs = mbedtls_ssl_write(&(ptr->ssl), (const unsigned char*)data, size);
+    if (ptr->pending) {
+        // resumed by DUER_TEVT_SEND_RDY, the caller sends the message again
+        rs = duer_trans_encrypted_flush(ptr);
+
+        if (rs < DUER_OK) {
+            goto exit;
+        }
+
+        same = size == ptr->pending_size && DUER_MEMCMP(data, ptr->pending, size) == 0;
+        duer_trans_encrypted_drop_pending(ptr);
+
+        if (same) {
+            rs = (int)size;
+            goto exit;
+        }
+    }
+
+    // one record holds the max fragment at most, write all of them
+    while (sent < size) {
+        rs = mbedtls_ssl_write(&(ptr->ssl), (const unsigned char*)data + sent, size - sent);
+
+        if (rs <= 0) {
+            break;
+        }
+
+        sent += rs;
+    }
+
+    if (sent == size) {
+        rs = (int)sent;
+        goto exit;
+    }
+
     rs = duer_trans_mbedtls2status(rs);
+
+    if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+        if (sent > 0) {
+            // the peer has the head of the message, the stream can't go on
+            DUER_LOGE("message written partly: %d/%d, rs = %d", sent, size, rs);
+            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+        }
+        goto exit;
+    }
+
+    // a record may be encrypted and blocked even nothing sent, keep the message
+    // to write the same data again, and don't block the caller's thread
+    ptr->pending = (duer_u8_t*)DUER_MALLOC(size);
+
+    if (ptr->pending == NULL) {
+        DUER_LOGE("keep the message blocked failed: %d/%d", sent, size);
+        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+        goto exit;
+    }
+
+    DUER_MEMCPY(ptr->pending, data, size);
+    ptr->pending_size = size;
+    ptr->pending_sent = sent;
+exit:
     DUER_LOGV("<== duer_trans_encrypted_send: rs = %d", rs);
+    return rs;
+}
+
+DUER_INT_IMPL duer_status_t duer_trans_encrypted_sendv(duer_trans_ptr trans,
+        const duer_iovec_t* iov,
+        duer_size_t iovcnt,
+        const duer_addr_t* addr) {
+    void* buf = NULL;
+    duer_size_t size = 0;
+    int rs = DUER_ERR_FAILED;
+
+    if (!iov || iovcnt == 0) {
+        goto exit;
+    }
+
+    if (iovcnt == 1) {
+        rs = duer_trans_encrypted_send(trans, iov[0].base, iov[0].len, addr);
+        goto exit;
+    }
+
+    // the record layer encrypts the contiguous plain text, writing the
+    // segments one by one costs one record each, so gather them here
+    size = duer_trans_iov_size(iov, iovcnt);
+    buf = DUER_MALLOC(size);
+
+    if (!buf) {
+        rs = DUER_ERR_MEMORY_OVERLOW;
+        goto exit;
+    }
+
+    duer_trans_iov_copy(buf, iov, iovcnt);
+    rs = duer_trans_encrypted_send(trans, buf, size, addr);
+    DUER_FREE(buf);
 exit:
     return rs;
 }
@@ -527,28 +1353,41 @@ DUER_INT_IMPL duer_status_t duer_trans_encrypted_close(duer_trans_ptr trans) {
         mbedtls_ssl_close_notify(&ptr->ssl);
         mbedtls_ssl_session_reset(&ptr->ssl);
         duer_trans_wrapper_close(trans);
-        mbedtls_x509_crt_free(&ptr->cacert);
         mbedtls_ssl_free(&ptr->ssl);
-        mbedtls_ssl_config_free(&ptr->ssl_conf);
-#ifndef MBEDTLS_DRBG_ALT
-        mbedtls_ctr_drbg_free(&ptr->ctr_drbg);
-        mbedtls_entropy_free(&ptr->entropy);
-#endif
+        duer_trans_config_release(ptr->config);
+        duer_trans_encrypted_drop_pending(ptr);
         DUER_FREE(ptr);
+        trans->secure = NULL;
     }
 
     DUER_LOGV("<== duer_trans_encrypted_close");
     return DUER_OK;
 }
 
+DUER_INT_IMPL duer_status_t duer_trans_encrypted_release_idle(duer_trans_ptr trans) {
+    duer_trans_encrypted_ptr ptr = trans ? (duer_trans_encrypted_ptr)trans->secure : NULL;
+
+    if (ptr && ptr->status == DUER_TRANS_ST_HANDSHAKED) {
+        // nothing else writes the rest if the message is not sent again
+        if (ptr->pending && duer_trans_encrypted_flush(ptr) == DUER_OK) {
+            duer_trans_encrypted_drop_pending(ptr);
+        }
+
+        if (ptr->pending == NULL) {
+            duer_trans_encrypted_release_buffers(ptr);
+        }
+    }
+
+    return DUER_OK;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_encrypted_set_read_timeout(
     duer_trans_ptr trans, duer_u32_t timeout) {
     duer_trans_encrypted_ptr ptr = trans ? (duer_trans_encrypted_ptr)trans->secure : NULL;
 
     if (ptr) {
-        if (timeout != DUER_READ_FOREVER) {
-            mbedtls_ssl_conf_read_timeout(&ptr->ssl_conf, timeout);
-        }
+        // the trans->read_timeout is used, see duer_trans_encrypted_wrap_recv_timeout
+        duer_trans_encrypted_set_bio(trans, ptr);
         return DUER_OK;
     }
 
@@ -26,6 +26,35 @@
 extern "C" {
 #endif
 
+/*
+ * The TLS session kept by the platform, to resume it after the reboot.
+ * See the detail in @{link baidu_ca_tls_session_init}
+ */
+typedef duer_status_t (*duer_tls_session_save_f)(const void* data, duer_size_t size);
+typedef duer_status_t (*duer_tls_session_load_f)(void* data, duer_size_t size);
+
+/*
+ * Set the functions keep the TLS session in the persistent storage, it's
+ * optional, the session is only kept in memory if it's not set
+ *
+ * @Param f_save, in, the function save the session, the size 0 erases it
+ * @Param f_load, in, the function load the session saved into data, at most
+ *        size bytes, returns the bytes loaded
+ */
+DUER_EXT void baidu_ca_tls_session_init(duer_tls_session_save_f f_save,
+                                        duer_tls_session_load_f f_load);
+
+/*
+ * Drop the TLS session cached, the next connection runs the full handshake.
+ */
+DUER_INT void duer_trans_encrypted_forget_session(void);
+
+/*
+ * Free the TLS configurations (the CA chain, the DRBG and the ssl_config)
+ * kept for the reconnection, the ones in use are kept.
+ */
+DUER_INT void duer_trans_encrypted_free_configs(void);
+
 /*
  * Connect to the host.
  *
@@ -37,7 +66,9 @@ DUER_INT duer_status_t duer_trans_encrypted_connect(duer_trans_ptr trans,
                                                     const duer_addr_t* addr);
 
 /*
- * Send data.
+ * Send data. If it's blocked in the middle, the rest is kept and
+ * DUER_ERR_TRANS_WOULD_BLOCK returned, send the same data again on the
+ * DUER_TEVT_SEND_RDY to finish it.
  *
  * @Param hdlr, in, the context for the transport
  * @Param data, in, the data will be sent
@@ -60,6 +91,20 @@ DUER_INT duer_status_t duer_trans_encrypted_send(duer_trans_ptr trans,
 DUER_INT duer_status_t duer_trans_encrypted_set_read_timeout(duer_trans_ptr trans,
                                                              duer_u32_t timeout);
 
+/*
+ * Send the segments in order as one message.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Param iov, in, the segments will be sent
+ * @Param iovcnt, in, the segments count
+ * @Param addr, in, the target address infomations
+ * @Return duer_status_t, the total bytes sent, or the error
+ */
+DUER_INT duer_status_t duer_trans_encrypted_sendv(duer_trans_ptr trans,
+                                                  const duer_iovec_t* iov,
+                                                  duer_size_t iovcnt,
+                                                  const duer_addr_t* addr);
+
 /*
  * Receive data.
  *
@@ -82,6 +127,15 @@ DUER_INT duer_status_t duer_trans_encrypted_recv(duer_trans_ptr trans,
  */
 DUER_INT duer_status_t duer_trans_encrypted_close(duer_trans_ptr trans);
 
+/*
+ * Free the TLS record buffers if nothing is pending in them, called when
+ * the connection has been idle for a while.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Return duer_status_t, the operation result
+ */
+DUER_INT duer_status_t duer_trans_encrypted_release_idle(duer_trans_ptr trans);
+
 #ifdef __cplusplus
 }
 #endif
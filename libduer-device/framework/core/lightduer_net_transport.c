@@ -19,6 +19,7 @@
 
 #include "lightduer_net_transport.h"
 #include "lightduer_lib.h"
+#include "lightduer_memory.h"
 
 typedef struct _baidu_ca_transport_t {
     duer_soc_create_f        f_create;
@@ -26,6 +27,7 @@ typedef struct _baidu_ca_transport_t {
     duer_soc_recv_f          f_recv;
     duer_soc_recv_timeout_f  f_recv_timeout;
     duer_soc_send_f          f_send;
+    duer_soc_sendv_f         f_sendv;
     duer_soc_close_f         f_close;
     duer_soc_destroy_f       f_destroy;
 } duer_transport_t;
@@ -48,6 +50,34 @@ DUER_EXT_IMPL void baidu_ca_transport_init(duer_soc_create_f f_create,
     s_duer_transport.f_destroy = f_destroy;
 }
 
+DUER_INT_IMPL duer_size_t duer_trans_iov_size(const duer_iovec_t* iov, duer_size_t iovcnt) {
+    duer_size_t size = 0;
+    duer_size_t i;
+
+    for (i = 0; iov && i < iovcnt; i++) {
+        size += iov[i].len;
+    }
+
+    return size;
+}
+
+DUER_INT_IMPL duer_size_t duer_trans_iov_copy(void* dst, const duer_iovec_t* iov,
+                                              duer_size_t iovcnt) {
+    duer_size_t size = 0;
+    duer_size_t i;
+
+    for (i = 0; iov && i < iovcnt; i++) {
+        DUER_MEMCPY((duer_u8_t*)dst + size, iov[i].base, iov[i].len);
+        size += iov[i].len;
+    }
+
+    return size;
+}
+
+DUER_EXT_IMPL void baidu_ca_transport_sendv_init(duer_soc_sendv_f f_sendv) {
+    s_duer_transport.f_sendv = f_sendv;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_wrapper_create(duer_trans_ptr trans) {
     if (trans && s_duer_transport.f_create) {
         trans->ctx = s_duer_transport.f_create(trans->transevt_callback);
@@ -80,6 +110,44 @@ DUER_INT_IMPL duer_status_t duer_trans_wrapper_send(duer_trans_ptr trans,
     return rs;
 }
 
+DUER_INT_IMPL duer_status_t duer_trans_wrapper_sendv(duer_trans_ptr trans,
+                                                  const duer_iovec_t* iov,
+                                                  duer_size_t iovcnt,
+                                                  const duer_addr_t* addr) {
+    duer_status_t rs = DUER_ERR_FAILED;
+    void* buf = NULL;
+    duer_size_t size = 0;
+
+    if (!trans || !iov || iovcnt == 0) {
+        goto exit;
+    }
+
+    if (s_duer_transport.f_sendv) {
+        rs = s_duer_transport.f_sendv(trans->ctx, iov, iovcnt, addr);
+        goto exit;
+    }
+
+    if (iovcnt == 1) {
+        rs = duer_trans_wrapper_send(trans, iov[0].base, iov[0].len, addr);
+        goto exit;
+    }
+
+    // no scatter/gather from the platform, gather them for one send
+    size = duer_trans_iov_size(iov, iovcnt);
+    buf = DUER_MALLOC(size);
+
+    if (!buf) {
+        rs = DUER_ERR_MEMORY_OVERLOW;
+        goto exit;
+    }
+
+    duer_trans_iov_copy(buf, iov, iovcnt);
+    rs = duer_trans_wrapper_send(trans, buf, size, addr);
+    DUER_FREE(buf);
+exit:
+    return rs;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_wrapper_recv(duer_trans_ptr trans,
                                                  void* data,
                                                  duer_size_t size,
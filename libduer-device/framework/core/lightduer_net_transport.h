@@ -35,13 +35,13 @@ typedef void*          duer_socket_t;
  */
 typedef void* duer_trans_handler;
 
-#define DUER_SIZEOF_TCPHEADER    8        // more info _baidu_ca_coap_tcp_header_s lightduer_coap.c
-#ifdef NET_TRANS_ENCRYPTED_BY_AES_CBC
-#define DUER_MIN_BODY_SIZE       (16 + 1) // see http://agroup.baidu.com/duersh/md/article/475516
-#else
-#define DUER_MIN_BODY_SIZE       (0)
-#endif
-#define DUER_MAX_BODY_SIZE       2048     // body longest value
+/*
+ * One segment of the data sent by the scatter/gather send.
+ */
+typedef struct _duer_iovec_s {
+    const void*         base;
+    duer_size_t         len;
+} duer_iovec_t;
 
 typedef struct _duer_trans_s {
     duer_socket_t       ctx;
@@ -50,14 +50,10 @@ typedef struct _duer_trans_s {
     void*               cert;
     duer_size_t         cert_len;
     duer_u32_t          read_timeout;
+    duer_u16_t          record_in;  // the largest record received, 0 for the default
+    duer_u16_t          record_out; // the largest record sent, 0 for the default
     duer_addr_t         addr;
     const void          *key_info;
-#ifdef NET_TRANS_ENCRYPTED_BY_AES_CBC
-    unsigned char       received_header[DUER_SIZEOF_TCPHEADER]; // header info
-    duer_size_t         received_header_bytes; // received header bytes[0-DUER_SIZEOF_TCPHEADER]
-    unsigned char       received_body[DUER_MAX_BODY_SIZE]; // body [0-DUER_MAX_BODY_SIZE]
-    duer_size_t         received_body_bytes; // received body bytes
-#endif
 } duer_trans_t, *duer_trans_ptr;
 
 /*
@@ -71,6 +67,10 @@ typedef duer_status_t (*duer_soc_send_f)(duer_socket_t sock,
                                          const void* data,
                                          duer_size_t size,
                                          const duer_addr_t* addr);
+typedef duer_status_t (*duer_soc_sendv_f)(duer_socket_t sock,
+                                          const duer_iovec_t* iov,
+                                          duer_size_t iovcnt,
+                                          const duer_addr_t* addr);
 typedef duer_status_t (*duer_soc_recv_f)(duer_socket_t sock,
                                          void* data,
                                          duer_size_t size,
@@ -102,6 +102,28 @@ DUER_EXT void baidu_ca_transport_init(duer_soc_create_f f_create,
                                       duer_soc_close_f f_close,
                                       duer_soc_destroy_f f_destroy);
 
+/*
+ * Set the scatter/gather send function, it's optional, the segments are
+ * gathered and sent by the f_send if it's not set
+ *
+ * @Param f_sendv, in, the function send the segments in order as one message,
+ *        returns the total bytes sent
+ */
+DUER_EXT void baidu_ca_transport_sendv_init(duer_soc_sendv_f f_sendv);
+
+/*
+ * The total bytes of the segments.
+ */
+DUER_INT duer_size_t duer_trans_iov_size(const duer_iovec_t* iov, duer_size_t iovcnt);
+
+/*
+ * Copy the segments in order to the dst, which should be large enough.
+ *
+ * @Return duer_size_t, the bytes copied
+ */
+DUER_INT duer_size_t duer_trans_iov_copy(void* dst, const duer_iovec_t* iov,
+                                         duer_size_t iovcnt);
+
 /*
  * Create the socket context.
  *
@@ -134,6 +156,20 @@ DUER_INT duer_status_t duer_trans_wrapper_send(duer_trans_ptr trans,
                                                duer_size_t size,
                                                const duer_addr_t* addr);
 
+/*
+ * Send the segments in order as one message.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Param iov, in, the segments will be sent
+ * @Param iovcnt, in, the segments count
+ * @Param addr, in, the target address infomations
+ * @Return duer_status_t, the total bytes sent, or the error
+ */
+DUER_INT duer_status_t duer_trans_wrapper_sendv(duer_trans_ptr trans,
+                                                const duer_iovec_t* iov,
+                                                duer_size_t iovcnt,
+                                                const duer_addr_t* addr);
+
 /*
  * Receive data.
  *
@@ -37,6 +37,7 @@ enum _baidu_ca_trans_type_enum {
 typedef struct _duer_transport_callbacks {
     duer_status_t (*f_connect)(duer_trans_ptr, const duer_addr_t*);
     duer_status_t (*f_send)(duer_trans_ptr, const void*, duer_size_t, const duer_addr_t*);
+    duer_status_t (*f_sendv)(duer_trans_ptr, const duer_iovec_t*, duer_size_t, const duer_addr_t*);
     duer_status_t (*f_recv)(duer_trans_ptr, void*, duer_size_t, duer_addr_t*);
     duer_status_t (*f_close)(duer_trans_ptr);
 } duer_trans_cbs;
@@ -46,6 +47,7 @@ const DUER_LOC duer_trans_cbs s_duer_trans_callbacks[DUER_TRANS_TOTAL] = {
     {
         duer_trans_wrapper_connect,
         duer_trans_wrapper_send,
+        duer_trans_wrapper_sendv,
         duer_trans_wrapper_recv,
         duer_trans_wrapper_close
     },
@@ -54,6 +56,7 @@ const DUER_LOC duer_trans_cbs s_duer_trans_callbacks[DUER_TRANS_TOTAL] = {
     {
         duer_trans_encrypted_connect,
         duer_trans_encrypted_send,
+        duer_trans_encrypted_sendv,
         duer_trans_encrypted_recv,
         duer_trans_encrypted_close
     },
@@ -62,6 +65,7 @@ const DUER_LOC duer_trans_cbs s_duer_trans_callbacks[DUER_TRANS_TOTAL] = {
     {
         duer_trans_aes_cbc_encrypted_connect,
         duer_trans_aes_cbc_encrypted_send,
+        duer_trans_aes_cbc_encrypted_sendv,
         duer_trans_aes_cbc_encrypted_recv,
         duer_trans_aes_cbc_encrypted_close
     },
@@ -144,6 +148,26 @@ DUER_INT_IMPL duer_status_t duer_trans_set_read_timeout(duer_trans_handler hdlr,
     return DUER_ERR_FAILED;
 }
 
+DUER_INT_IMPL duer_status_t duer_trans_set_record_size(duer_trans_handler hdlr,
+                                                    duer_size_t in_size,
+                                                    duer_size_t out_size) {
+    duer_trans_ptr trans = (duer_trans_ptr)hdlr;
+
+    if (trans == NULL
+            || (in_size != 0 && in_size != 512 && in_size != 1024
+                && in_size != 2048 && in_size != 4096)
+            || (out_size != 0 && out_size < 512) || out_size > 0xffff) {
+        DUER_LOGE("Param error: trans = %p, in_size = %d, out_size = %d",
+                  trans, in_size, out_size);
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    trans->record_in = (duer_u16_t)in_size;
+    trans->record_out = (duer_u16_t)out_size;
+
+    return DUER_OK;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_connect(duer_trans_handler hdlr,
                                             const duer_addr_t* addr) {
     duer_status_t rs = DUER_ERR_FAILED;
@@ -177,6 +201,21 @@ DUER_INT_IMPL duer_status_t duer_trans_send(duer_trans_handler hdlr,
     return rs;
 }
 
+DUER_INT_IMPL duer_status_t duer_trans_sendv(duer_trans_handler hdlr,
+                                          const duer_iovec_t* iov,
+                                          duer_size_t iovcnt,
+                                          const duer_addr_t* addr) {
+    duer_status_t rs = DUER_ERR_FAILED;
+    duer_trans_ptr trans = (duer_trans_ptr)hdlr;
+    const duer_trans_cbs* cbs = duer_trans_get_callbacks(trans);
+
+    if (cbs) {
+        rs = cbs->f_sendv(trans, iov, iovcnt, addr);
+    }
+
+    return rs;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_recv(duer_trans_handler hdlr,
                                          void* data,
                                          duer_size_t size,
@@ -204,6 +243,22 @@ DUER_INT_IMPL duer_status_t duer_trans_close(duer_trans_handler hdlr) {
     return rs;
 }
 
+DUER_INT_IMPL duer_status_t duer_trans_release_idle(duer_trans_handler hdlr) {
+    duer_trans_ptr trans = (duer_trans_ptr)hdlr;
+
+    if (trans == NULL) {
+        return DUER_ERR_FAILED;
+    }
+
+#ifndef NET_TRANS_ENCRYPTED_BY_AES_CBC
+    if (duer_trans_is_encrypted(trans)) {
+        return duer_trans_encrypted_release_idle(trans);
+    }
+#endif
+
+    return DUER_OK;
+}
+
 DUER_INT_IMPL duer_status_t duer_trans_release(duer_trans_handler hdlr) {
     duer_trans_ptr trans = (duer_trans_ptr)hdlr;
 
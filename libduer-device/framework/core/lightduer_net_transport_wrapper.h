@@ -57,6 +57,20 @@ DUER_INT duer_status_t duer_trans_set_pk(duer_trans_handler hdlr,
 DUER_INT duer_status_t duer_trans_set_read_timeout(duer_trans_handler hdlr,
                                                    duer_u32_t timeout);
 
+/*
+ * Set the largest records of the encrypted transport, it takes effect
+ * on the next connect. The smaller records hold less RAM by connection.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Param in_size, in, the largest record received, negotiated with the server
+ *        by the TLS max_fragment_length, 512, 1024, 2048, 4096 or 0 for the default
+ * @Param out_size, in, the largest record sent, 512 at least or 0 for the default
+ * @Return duer_status_t, the operation result
+ */
+DUER_INT duer_status_t duer_trans_set_record_size(duer_trans_handler hdlr,
+                                                  duer_size_t in_size,
+                                                  duer_size_t out_size);
+
 /*
  * Connect to the host.
  *
@@ -81,6 +95,21 @@ DUER_INT duer_status_t duer_trans_send(duer_trans_handler hdlr,
                                        duer_size_t size,
                                        const duer_addr_t* addr);
 
+/*
+ * Send the segments in order as one message, without gathering them
+ * into one buffer first if the platform supports scatter/gather.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Param iov, in, the segments will be sent
+ * @Param iovcnt, in, the segments count
+ * @Param addr, in, the target address infomations
+ * @Return duer_status_t, the total bytes sent, or the error
+ */
+DUER_INT duer_status_t duer_trans_sendv(duer_trans_handler hdlr,
+                                        const duer_iovec_t* iov,
+                                        duer_size_t iovcnt,
+                                        const duer_addr_t* addr);
+
 /*
  * Receive data.
  *
@@ -103,6 +132,14 @@ DUER_INT duer_status_t duer_trans_recv(duer_trans_handler hdlr,
  */
 DUER_INT duer_status_t duer_trans_close(duer_trans_handler hdlr);
 
+/*
+ * Free the buffers kept for the transfer, the connection has been idle.
+ *
+ * @Param hdlr, in, the context for the transport
+ * @Return duer_status_t, the operation result
+ */
+DUER_INT duer_status_t duer_trans_release_idle(duer_trans_handler hdlr);
+
 /*
  * Release the handler.
  *
@@ -24,12 +24,15 @@ MODULE_PATH := $(BASE_DIR)/framework
 
 LOCAL_MODULE := framework
 
-LOCAL_STATIC_LIBRARIES := cjson mbedtls
+LOCAL_STATIC_LIBRARIES := cjson mbedtls platform
 
 LOCAL_SRC_FILES := \
     $(wildcard $(MODULE_PATH)/core/*.c) \
     $(wildcard $(MODULE_PATH)/utils/*.c)
 
+# the mbedtls structures should be the same as the library built
+LOCAL_CDEFS := MBEDTLS_CONFIG_FILE=\"baidu_ca_mbedtls_config.h\"
+
 LOCAL_INCLUDES := \
     $(MODULE_PATH)/include \
     $(MODULE_PATH)/core \
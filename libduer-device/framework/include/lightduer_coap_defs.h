@@ -101,12 +101,18 @@ typedef struct _duer_message_s {
 
     duer_u16_t path_len;
     duer_u16_t query_len;
-    duer_u16_t payload_len;
+    duer_size_t payload_len;
 
     duer_u8_t* token;
     duer_u8_t* path;
     duer_u8_t* query;
     duer_u8_t* payload;
+
+    // the blockwise transfer, the payload is one block of the whole
+    duer_u8_t  block_more;      // more blocks follow
+    duer_size_t block_offset;   // the offset of the payload in the whole
+
+    duer_u16_t content_format;  // the Content-Format option, 0 if none (text/plain not sent)
 } duer_msg_t;
 
 /*
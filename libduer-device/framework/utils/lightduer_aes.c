@@ -32,7 +32,8 @@
 #endif
 
 typedef struct _duer_aes_context {
-    mbedtls_aes_context mbedctx; // used by the mbedtls aes algorithm
+    mbedtls_aes_context mbedctx; // used by the mbedtls aes algorithm, the encryption key schedule
+    mbedtls_aes_context mbedctx_dec; // the decryption key schedule
     unsigned char key[32]; // the key use in the algorithm, max size is 32bytes
     unsigned int keybits; // the length of the key, only 128, 192, 256 supported
     unsigned char iv[16]; // the initial vector, it's 16bytes
@@ -49,6 +50,7 @@ duer_aes_context duer_aes_context_init(void)
     DUER_MEMSET(aes_context->iv, 0, sizeof(aes_context->iv));
     aes_context->keybits = 0;
     mbedtls_aes_init(&aes_context->mbedctx);
+    mbedtls_aes_init(&aes_context->mbedctx_dec);
     return aes_context;
 }
 
@@ -67,6 +69,14 @@ int duer_aes_setkey(duer_aes_context ctx,
     duer_aes_context_t* aes_context = (duer_aes_context_t*)ctx;
     DUER_MEMCPY(aes_context->key, key, keybits / 8);
     aes_context->keybits = keybits;
+
+    // expand the key once, not for every message
+    if (mbedtls_aes_setkey_enc(&aes_context->mbedctx, key, keybits) != 0
+            || mbedtls_aes_setkey_dec(&aes_context->mbedctx_dec, key, keybits) != 0) {
+        DUER_LOGW("set key fail!!");
+        aes_context->keybits = 0;
+        return DUER_ERR_FAILED;
+    }
     return DUER_OK;
 }
 
@@ -113,16 +123,8 @@ int duer_aes_cbc_encrypt(duer_aes_context ctx,
     }
     DUER_AES_PRINT("\n");
 #endif
-    int res = 0;
-    do {
-        //TODO if this needed every time??
-        res = mbedtls_aes_setkey_enc(&aes_context->mbedctx, aes_context->key, aes_context->keybits);
-        if (res) {
-            break;
-        }
-        res = mbedtls_aes_crypt_cbc(&aes_context->mbedctx, MBEDTLS_AES_ENCRYPT,
+    int res = mbedtls_aes_crypt_cbc(&aes_context->mbedctx, MBEDTLS_AES_ENCRYPT,
                                     length, iv, input, output);
-    } while(0);
 
     if (res != 0) {
         DUER_LOGW("encrypt fail!!res:%d", res);
@@ -152,6 +154,21 @@ int duer_aes_cbc_decrypt(duer_aes_context ctx,
 
     unsigned char iv[16];
     DUER_MEMCPY(iv, aes_context->iv, sizeof(iv));
+
+    return duer_aes_cbc_decrypt_update(ctx, length, iv, input, output);
+}
+
+int duer_aes_cbc_decrypt_update(duer_aes_context ctx,
+                                size_t length,
+                                unsigned char iv[16],
+                                const unsigned char* input,
+                                unsigned char* output)
+{
+    if (ctx == NULL) {
+        DUER_LOGW("ctx is NULL!");
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+    duer_aes_context_t* aes_context = (duer_aes_context_t*)ctx;
 #ifdef LIGHTDUER_AES_DEBUG
     DUER_AES_PRINT("key:\n");
     for (int i = 0; i < (aes_context->keybits / 8); ++i) {
@@ -159,7 +176,7 @@ int duer_aes_cbc_decrypt(duer_aes_context ctx,
     }
     DUER_AES_PRINT("\n");
     DUER_AES_PRINT("iv:\n");
-    for (int i = 0; i < sizeof(iv); ++i) {
+    for (int i = 0; i < 16; ++i) {
         DUER_AES_PRINT(" %x", (unsigned char)iv[i]);
     }
     DUER_AES_PRINT("\n");
@@ -169,16 +186,8 @@ int duer_aes_cbc_decrypt(duer_aes_context ctx,
     }
     DUER_AES_PRINT("\n");
 #endif
-    int res = 0;
-    do {
-        //TODO if this needed every time??
-        res = mbedtls_aes_setkey_dec(&aes_context->mbedctx, aes_context->key, aes_context->keybits);
-        if (res) {
-            break;
-        }
-        res = mbedtls_aes_crypt_cbc(&aes_context->mbedctx, MBEDTLS_AES_DECRYPT,
+    int res = mbedtls_aes_crypt_cbc(&aes_context->mbedctx_dec, MBEDTLS_AES_DECRYPT,
                                     length, iv, input, output);
-    } while(0);
 
     if (res != 0) {
         DUER_LOGW("decrypt faild!! res:%d", res);
@@ -204,6 +213,7 @@ int duer_aes_context_destroy(duer_aes_context ctx)
     duer_aes_context_t* aes_context = (duer_aes_context_t*)ctx;
 
     mbedtls_aes_free(&aes_context->mbedctx);
+    mbedtls_aes_free(&aes_context->mbedctx_dec);
     DUER_FREE(aes_context);
     return DUER_OK;
 }
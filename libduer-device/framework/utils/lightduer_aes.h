@@ -79,6 +79,22 @@ int duer_aes_cbc_decrypt(duer_aes_context ctx,
                          const unsigned char* input,
                          unsigned char* output);
 
+/*
+ *decrypt the input info as one part of the message, the CBC chain starts from
+ *the @iv, and it's updated to continue with the next part
+ *@param ctx, got from duer_aes_context_init
+ *@param length, the length of the input, should be multiple of 16
+ *@param iv, in & out, the iv for this part, 16 bytes
+ *@param input, the content will be decrypted
+ *#param output, the decrypted content, it could be the @input
+ *@return, DUER_OK on success, or other error code
+ */
+int duer_aes_cbc_decrypt_update(duer_aes_context ctx,
+                                size_t length,
+                                unsigned char iv[16],
+                                const unsigned char* input,
+                                unsigned char* output);
+
 /*
  *destroy the context
  *@param ctx, got from duer_aes_context_init
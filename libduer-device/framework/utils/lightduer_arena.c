@@ -0,0 +1,138 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_arena.c
+ * Desc: Provide the bump-pointer arena, for the memory with the same lifetime,
+ *       such as the temporaries for processing one directive.
+ */
+
+#include "lightduer_arena.h"
+#include "lightduer_memory.h"
+#include "lightduer_lib.h"
+
+#define DUER_ARENA_ALIGN        (8)
+#define DUER_ARENA_ROUND(_s)    (((_s) + DUER_ARENA_ALIGN - 1) & ~(DUER_ARENA_ALIGN - 1))
+
+typedef struct _duer_arena_block_s {
+    struct _duer_arena_block_s *_next;
+    char                       *_cursor;
+    char                       *_end;
+} duer_arena_block_t;
+
+typedef struct _duer_arena_s {
+    duer_arena_block_t  *_current;
+    duer_size_t         _used;
+    duer_arena_block_t  _first;     // the data of the first block follows the arena
+} duer_arena_t;
+
+#define DUER_ARENA_HDR_SIZE     DUER_ARENA_ROUND(sizeof(duer_arena_t))
+#define DUER_ARENA_BLOCK_SIZE   DUER_ARENA_ROUND(sizeof(duer_arena_block_t))
+
+static void duer_arena_block_init(duer_arena_block_t *block, char *data, duer_size_t size)
+{
+    block->_next = NULL;
+    block->_cursor = data;
+    block->_end = data + size;
+}
+
+duer_arena_handler duer_arena_create(duer_size_t size)
+{
+    duer_arena_t *arena = NULL;
+
+    size = DUER_ARENA_ROUND(size);
+    arena = (duer_arena_t *)DUER_MALLOC(DUER_ARENA_HDR_SIZE + size);
+    if (arena) {
+        arena->_current = &arena->_first;
+        arena->_used = 0;
+        duer_arena_block_init(&arena->_first, (char *)arena + DUER_ARENA_HDR_SIZE, size);
+    }
+    return (duer_arena_handler)arena;
+}
+
+void *duer_arena_alloc(duer_arena_handler arena, duer_size_t size)
+{
+    duer_arena_t *p = (duer_arena_t *)arena;
+    duer_arena_block_t *block = NULL;
+    duer_size_t capacity = 0;
+    void *rs = NULL;
+
+    if (p == NULL || size == 0) {
+        return NULL;
+    }
+
+    size = DUER_ARENA_ROUND(size);
+    block = p->_current;
+
+    if ((duer_size_t)(block->_end - block->_cursor) < size) {
+        // grow by the size of the first block at least
+        capacity = p->_first._end - ((char *)p + DUER_ARENA_HDR_SIZE);
+        if (capacity < size) {
+            capacity = size;
+        }
+
+        block = (duer_arena_block_t *)DUER_MALLOC(DUER_ARENA_BLOCK_SIZE + capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        duer_arena_block_init(block, (char *)block + DUER_ARENA_BLOCK_SIZE, capacity);
+        p->_current->_next = block;
+        p->_current = block;
+    }
+
+    rs = block->_cursor;
+    block->_cursor += size;
+    p->_used += size;
+
+    return rs;
+}
+
+void duer_arena_reset(duer_arena_handler arena)
+{
+    duer_arena_t *p = (duer_arena_t *)arena;
+    duer_arena_block_t *block = NULL;
+    duer_arena_block_t *next = NULL;
+
+    if (p == NULL) {
+        return;
+    }
+
+    block = p->_first._next;
+    while (block) {
+        next = block->_next;
+        DUER_FREE(block);
+        block = next;
+    }
+
+    p->_first._next = NULL;
+    p->_first._cursor = (char *)p + DUER_ARENA_HDR_SIZE;
+    p->_current = &p->_first;
+    p->_used = 0;
+}
+
+duer_size_t duer_arena_used(duer_arena_handler arena)
+{
+    duer_arena_t *p = (duer_arena_t *)arena;
+    return p ? p->_used : 0;
+}
+
+void duer_arena_destroy(duer_arena_handler arena)
+{
+    if (arena) {
+        duer_arena_reset(arena);
+        DUER_FREE(arena);
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_arena.h
+ * Desc: Provide the bump-pointer arena, for the memory with the same lifetime,
+ *       such as the temporaries for processing one directive.
+ */
+
+#ifndef BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_ARENA_H
+#define BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_ARENA_H
+
+#include "lightduer_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *duer_arena_handler;
+
+/*
+ * Create the arena
+ *
+ * @Param size, duer_size_t, the size of the first block, it's kept until destroy
+ * @Return duer_arena_handler, the created arena, NULL if failed
+ */
+duer_arena_handler duer_arena_create(duer_size_t size);
+
+/*
+ * Alloc memory from the arena, it can't be freed separately,
+ * a new block is alloced when the current one is exhausted.
+ *
+ * @Param arena, duer_arena_handler, the arena
+ * @Param size, duer_size_t, the expected size
+ * @Return void *, the alloced memory, NULL if failed
+ */
+void *duer_arena_alloc(duer_arena_handler arena, duer_size_t size);
+
+/*
+ * Release all the memory alloced from the arena,
+ * the extra blocks are freed, only the first block is kept.
+ *
+ * @Param arena, duer_arena_handler, the arena
+ */
+void duer_arena_reset(duer_arena_handler arena);
+
+/*
+ * Obtain the bytes alloced from the arena since the last reset
+ *
+ * @Param arena, duer_arena_handler, the arena
+ * @Return duer_size_t, the alloced bytes
+ */
+duer_size_t duer_arena_used(duer_arena_handler arena);
+
+/*
+ * Destroy the arena
+ *
+ * @Param arena, duer_arena_handler, the arena
+ */
+void duer_arena_destroy(duer_arena_handler arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/*BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_ARENA_H*/
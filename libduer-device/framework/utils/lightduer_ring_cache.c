@@ -0,0 +1,122 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_ring_cache.c
+ * Desc: Provide the bounded Cache util in the Queue, based on the ring buffer.
+ */
+
+#include "lightduer_ring_cache.h"
+#include "lightduer_memory.h"
+#include "lightduer_lib.h"
+
+typedef struct _duer_rcache_s {
+    size_t                  _capacity;
+    size_t                  _head;
+    size_t                  _length;
+    size_t                  _dropped;
+    duer_rcache_policy_t    _policy;
+    duer_rcache_drop_f      _f_drop;
+    void *                  _items[];
+} duer_rcache_t;
+
+duer_rcache_handler duer_rcache_create(size_t capacity,
+                                       duer_rcache_policy_t policy,
+                                       duer_rcache_drop_f f_drop)
+{
+    duer_rcache_t *cache = NULL;
+
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    cache = (duer_rcache_t *)DUER_MALLOC(sizeof(duer_rcache_t) + capacity * sizeof(void *));
+    if (cache) {
+        DUER_MEMSET(cache, 0, sizeof(duer_rcache_t));
+        cache->_capacity = capacity;
+        cache->_policy = policy;
+        cache->_f_drop = f_drop;
+    }
+    return (duer_rcache_handler)cache;
+}
+
+int duer_rcache_push(duer_rcache_handler cache, void *data)
+{
+    duer_rcache_t *p = (duer_rcache_t *)cache;
+    void *dropped = NULL;
+
+    if (p == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    if (p->_length == p->_capacity) {
+        if (p->_policy != DUER_RCACHE_DROP_OLDEST) {
+            return DUER_ERR_TRANS_WOULD_BLOCK;
+        }
+
+        dropped = duer_rcache_pop(cache);
+        p->_dropped++;
+        if (p->_f_drop) {
+            p->_f_drop(dropped);
+        }
+    }
+
+    p->_items[(p->_head + p->_length) % p->_capacity] = data;
+    p->_length++;
+
+    return DUER_OK;
+}
+
+size_t duer_rcache_length(duer_rcache_handler cache)
+{
+    duer_rcache_t *p = (duer_rcache_t *)cache;
+    return (p != NULL) ? p->_length : 0;
+}
+
+size_t duer_rcache_dropped(duer_rcache_handler cache)
+{
+    duer_rcache_t *p = (duer_rcache_t *)cache;
+    return (p != NULL) ? p->_dropped : 0;
+}
+
+void *duer_rcache_top(duer_rcache_handler cache)
+{
+    duer_rcache_t *p = (duer_rcache_t *)cache;
+    return p != NULL && p->_length > 0 ? p->_items[p->_head] : NULL;
+}
+
+void *duer_rcache_pop(duer_rcache_handler cache)
+{
+    duer_rcache_t *p = (duer_rcache_t *)cache;
+    void *rs = NULL;
+
+    if (p && p->_length > 0) {
+        rs = p->_items[p->_head];
+        p->_items[p->_head] = NULL;
+        if (++p->_head == p->_capacity) {
+            p->_head = 0;
+        }
+        p->_length--;
+    }
+
+    return rs;
+}
+
+void duer_rcache_destroy(duer_rcache_handler cache)
+{
+    if (cache) {
+        DUER_FREE(cache);
+    }
+}
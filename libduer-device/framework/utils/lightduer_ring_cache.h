@@ -0,0 +1,85 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_ring_cache.h
+ * Desc: Provide the bounded Cache util in the Queue, based on the ring buffer.
+ *       It has the same usage as duer_qcache, but never allocs after created.
+ */
+
+#ifndef BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_RING_CACHE_H
+#define BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_RING_CACHE_H
+
+#include "lightduer_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *duer_rcache_handler;
+
+typedef enum _duer_rcache_policy_enum {
+    DUER_RCACHE_REJECT,         // push returns DUER_ERR_TRANS_WOULD_BLOCK when full
+    DUER_RCACHE_DROP_OLDEST,    // the oldest data is dropped to make room
+} duer_rcache_policy_t;
+
+/*
+ * Called with the data dropped by DUER_RCACHE_DROP_OLDEST,
+ * the owner should release it.
+ */
+typedef void (*duer_rcache_drop_f)(void *data);
+
+/*
+ * Create the ring cache
+ *
+ * @Param capacity, size_t, the max number of data could be cached
+ * @Param policy, duer_rcache_policy_t, what to do when push into the full cache
+ * @Param f_drop, duer_rcache_drop_f, release the dropped data, could be NULL
+ * @Return duer_rcache_handler, the created cache, NULL if failed
+ */
+duer_rcache_handler duer_rcache_create(size_t capacity,
+                                       duer_rcache_policy_t policy,
+                                       duer_rcache_drop_f f_drop);
+
+/*
+ * Push the data to the tail
+ *
+ * @Return int, DUER_OK on success,
+ *              DUER_ERR_TRANS_WOULD_BLOCK if full with DUER_RCACHE_REJECT,
+ *              DUER_ERR_INVALID_PARAMETER if the cache is NULL
+ */
+int duer_rcache_push(duer_rcache_handler cache, void *data);
+
+void *duer_rcache_top(duer_rcache_handler cache);
+
+void *duer_rcache_pop(duer_rcache_handler cache);
+
+size_t duer_rcache_length(duer_rcache_handler cache);
+
+/*
+ * Obtain how many data dropped by DUER_RCACHE_DROP_OLDEST
+ */
+size_t duer_rcache_dropped(duer_rcache_handler cache);
+
+/*
+ * Destroy the cache, the cached data are not released
+ */
+void duer_rcache_destroy(duer_rcache_handler cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/*BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_RING_CACHE_H*/
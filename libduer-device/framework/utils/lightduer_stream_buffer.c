@@ -0,0 +1,161 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_stream_buffer.c
+ * Desc: Provide the receive buffer of a byte stream.
+ */
+
+#include "lightduer_stream_buffer.h"
+#include "lightduer_memory.h"
+#include "lightduer_lib.h"
+
+typedef struct _duer_sbuf_s {
+    duer_u8_t *     _data;
+    duer_size_t     _capacity;
+    duer_size_t     _size;      // the initial size
+    duer_size_t     _max;
+    duer_size_t     _head;      // where to read
+    duer_size_t     _tail;      // where to write
+} duer_sbuf_t;
+
+duer_sbuf_handler duer_sbuf_create(duer_size_t size, duer_size_t max)
+{
+    duer_sbuf_t *p = NULL;
+
+    if (size == 0 || max < size) {
+        return NULL;
+    }
+
+    p = (duer_sbuf_t *)DUER_MALLOC(sizeof(duer_sbuf_t));
+    if (p) {
+        DUER_MEMSET(p, 0, sizeof(duer_sbuf_t));
+        p->_size = size;
+        p->_max = max;
+    }
+    return (duer_sbuf_handler)p;
+}
+
+void *duer_sbuf_reserve(duer_sbuf_handler buf, duer_size_t size, duer_size_t *room)
+{
+    duer_sbuf_t *p = (duer_sbuf_t *)buf;
+    duer_size_t length = 0;
+    duer_size_t capacity = 0;
+    duer_u8_t *data = NULL;
+
+    if (p == NULL || room == NULL) {
+        return NULL;
+    }
+
+    length = p->_tail - p->_head;
+    if (p->_data == NULL || p->_capacity - p->_tail < size) {
+        capacity = p->_capacity > 0 ? p->_capacity : p->_size;
+        while (capacity - length < size && capacity < p->_max) {
+            capacity = capacity * 2 < p->_max ? capacity * 2 : p->_max;
+        }
+        if (capacity - length < size) {
+            return NULL;
+        }
+
+        if (capacity != p->_capacity) {
+            data = (duer_u8_t *)DUER_MALLOC(capacity);
+            if (data == NULL) {
+                return NULL;
+            }
+            if (length > 0) {
+                DUER_MEMCPY(data, p->_data + p->_head, length);
+            }
+            if (p->_data) {
+                DUER_FREE(p->_data);
+            }
+            p->_data = data;
+            p->_capacity = capacity;
+        } else if (length > 0) {
+            // move the partial message to the front
+            DUER_MEMMOVE(p->_data, p->_data + p->_head, length);
+        }
+        p->_head = 0;
+        p->_tail = length;
+    }
+
+    *room = p->_capacity - p->_tail;
+    return p->_data + p->_tail;
+}
+
+void duer_sbuf_commit(duer_sbuf_handler buf, duer_size_t size)
+{
+    duer_sbuf_t *p = (duer_sbuf_t *)buf;
+
+    if (p && p->_data && size <= p->_capacity - p->_tail) {
+        p->_tail += size;
+    }
+}
+
+void *duer_sbuf_data(duer_sbuf_handler buf, duer_size_t *size)
+{
+    duer_sbuf_t *p = (duer_sbuf_t *)buf;
+    duer_size_t length = p ? p->_tail - p->_head : 0;
+
+    if (size) {
+        *size = length;
+    }
+    return length > 0 ? p->_data + p->_head : NULL;
+}
+
+void duer_sbuf_consume(duer_sbuf_handler buf, duer_size_t size)
+{
+    duer_sbuf_t *p = (duer_sbuf_t *)buf;
+
+    if (p == NULL) {
+        return;
+    }
+
+    if (size >= p->_tail - p->_head) {
+        p->_head = 0;
+        p->_tail = 0;
+        // give back the memory grown for a large message
+        if (p->_capacity > p->_size) {
+            DUER_FREE(p->_data);
+            p->_data = NULL;
+            p->_capacity = 0;
+        }
+    } else {
+        p->_head += size;
+    }
+}
+
+duer_size_t duer_sbuf_length(duer_sbuf_handler buf)
+{
+    duer_sbuf_t *p = (duer_sbuf_t *)buf;
+
+    return p ? p->_tail - p->_head : 0;
+}
+
+void duer_sbuf_reset(duer_sbuf_handler buf)
+{
+    duer_sbuf_consume(buf, (duer_size_t)-1);
+}
+
+void duer_sbuf_destroy(duer_sbuf_handler buf)
+{
+    duer_sbuf_t *p = (duer_sbuf_t *)buf;
+
+    if (p) {
+        if (p->_data) {
+            DUER_FREE(p->_data);
+        }
+        DUER_FREE(p);
+    }
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_stream_buffer.h
+ * Desc: Provide the receive buffer of a byte stream. The data is written to
+ *       the tail and read from the head, the unread bytes are kept contiguous,
+ *       so a message could be parsed in place, and only its partial tail is
+ *       moved to the front when the room runs out. It grows on demand.
+ */
+
+#ifndef BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_STREAM_BUFFER_H
+#define BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_STREAM_BUFFER_H
+
+#include "lightduer_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *duer_sbuf_handler;
+
+/*
+ * Create the stream buffer, the memory is alloced on the first reserve
+ *
+ * @Param size, duer_size_t, the initial size, it's shrinked back to when empty
+ * @Param max, duer_size_t, the size it could grow to
+ * @Return duer_sbuf_handler, the created buffer, NULL if failed
+ */
+duer_sbuf_handler duer_sbuf_create(duer_size_t size, duer_size_t max);
+
+/*
+ * Obtain the room at the tail for writing, at least the expected bytes
+ *
+ * @Param buf, duer_sbuf_handler, the buffer
+ * @Param size, duer_size_t, the expected bytes
+ * @Param room, duer_size_t *, out, the bytes could be written, maybe more than expected
+ * @Return void *, where to write, NULL if it can't grow enough
+ */
+void *duer_sbuf_reserve(duer_sbuf_handler buf, duer_size_t size, duer_size_t *room);
+
+/*
+ * Append the bytes written to the reserved room
+ */
+void duer_sbuf_commit(duer_sbuf_handler buf, duer_size_t size);
+
+/*
+ * Obtain the unread bytes
+ *
+ * @Param buf, duer_sbuf_handler, the buffer
+ * @Param size, duer_size_t *, out, the length of the unread bytes
+ * @Return void *, the unread bytes, NULL if empty
+ */
+void *duer_sbuf_data(duer_sbuf_handler buf, duer_size_t *size);
+
+/*
+ * Drop the bytes read from the head
+ */
+void duer_sbuf_consume(duer_sbuf_handler buf, duer_size_t size);
+
+/*
+ * Obtain the length of the unread bytes
+ */
+duer_size_t duer_sbuf_length(duer_sbuf_handler buf);
+
+/*
+ * Drop all the unread bytes, such as the connection is reset
+ */
+void duer_sbuf_reset(duer_sbuf_handler buf);
+
+/*
+ * Destroy the buffer
+ */
+void duer_sbuf_destroy(duer_sbuf_handler buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/*BAIDU_DUER_LIGHTDUER_COMMON_LIGHTDUER_STREAM_BUFFER_H*/
@@ -24,6 +24,7 @@
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
 #include "lwip/dns.h"
+#include "lightduer_dns.h"
 #include "lightduer_log.h"
 #include "lightduer_http_client.h"
 #include "lightduer_memory.h"
@@ -52,6 +53,30 @@ static int socket_open(int socket_handle)
     return fd;
 }
 
+/*
+ * Resolve the IPv4 address with the shared resolver (cached)
+ *
+ * @Return int, 0 if resolved
+ */
+static int socket_resolve_cached(const char *host, struct sockaddr_in *sock_info)
+{
+    duer_dns_result_t result;
+    size_t i = 0;
+
+    if (duer_dns_resolve(host, &result) != DUER_OK) {
+        return -1;
+    }
+
+    for (i = 0; i < result.count; ++i) {
+        if (result.addrs[i].family == DUER_DNS_INET) {
+            memcpy(&sock_info->sin_addr.s_addr, result.addrs[i].addr, 4);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
 static int socket_connect(int socket_handle, const char *host, const int port)
 {
     int ret;
@@ -92,26 +117,32 @@ static int socket_connect(int socket_handle, const char *host, const int port)
 
     memset(&sock_info, 0, sizeof(struct sockaddr_in));
 
-    hp = gethostbyname(host);
-    if (!hp) {
-        DUER_LOGE("HTTP OPS: DNS failed");
+    if (socket_resolve_cached(host, &sock_info) == 0) {
+        DUER_LOGI("HTTP OPS: DNS lookup succeeded. IP = %s", inet_ntoa(sock_info.sin_addr));
     } else {
-        ip4_addr = (struct ip4_addr *)hp->h_addr;
-        if (ip4_addr) {
+        // no name server added or answered, ask the system
+        hp = gethostbyname(host);
+        if (!hp) {
+            DUER_LOGE("HTTP OPS: DNS failed");
+            return -1;
+        } else {
+            ip4_addr = (struct ip4_addr *)hp->h_addr;
+            if (ip4_addr) {
 #if defined(DUER_PLATFORM_ESPRESSIF) || defined(TARGET_UNO_91H)
-            DUER_LOGI("HTTP OPS: DNS lookup succeeded. IP = %s", inet_ntoa(*ip4_addr));
+                DUER_LOGI("HTTP OPS: DNS lookup succeeded. IP = %s", inet_ntoa(*ip4_addr));
 #endif
+            }
         }
-    }
-    sock_info.sin_family = AF_INET;
 #if defined(DUER_PLATFORM_ESPRESSIF) || defined(TARGET_UNO_91H)
-    sock_info.sin_addr.s_addr = inet_addr(inet_ntoa(*ip4_addr));
+        sock_info.sin_addr.s_addr = inet_addr(inet_ntoa(*ip4_addr));
 #else
-    /*
-     * The LWIP which provided by mw300 was different from esp32.
-     * We need to adapate to mw300 project
-     */
+        /*
+         * The LWIP which provided by mw300 was different from esp32.
+         * We need to adapate to mw300 project
+         */
 #endif
+    }
+    sock_info.sin_family = AF_INET;
     sock_info.sin_port = htons(port);
 
     http_connect_flag = connect(socket_handle, (struct sockaddr *)&sock_info, sizeof(sock_info));
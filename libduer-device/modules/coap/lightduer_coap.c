@@ -26,8 +26,10 @@
 #include "lightduer_log.h"
 #include "lightduer_hashcode.h"
 #include "lightduer_net_util.h"
+#include "lightduer_stream_buffer.h"
 #include "lightduer_net_transport_wrapper.h"
 #include "lightduer_nsdl_adapter.h"
+#include "lightduer_timestamp.h"
 
 #define DUER_COAP_TCP_HDR  (0xbeefdead)
 
@@ -35,84 +37,289 @@
 //Note1: this value should only bigger than the default value
 //Note2: this value setting should follow the value of MBEDTLS_SSL_MAX_CONTENT_LEN
 //in src/iot-baidu-ca/include/baidu_ca_mbedtls_config.h
-//Note3: pay attention to thread stack size which will call the function bca_coap_data_available
 #define DUER_BUFFER_SIZE   (1024 * 2)
 
+// the slots of the hash tables at first, they double when half full
+#define DUER_COAP_SLOTS_MIN (8)
+
+// the receive buffer grows to this size for the large messages,
+// the larger ones are skipped
+#ifndef DUER_COAP_RECV_BUFFER_MAX
+#define DUER_COAP_RECV_BUFFER_MAX  (1024 * 16)
+#endif
+
+// the blockwise transfer (RFC 7959) of the request payloads larger than the
+// threshold, by the block size at most, the server may agree a smaller one
+#ifndef DUER_COAP_BLOCK_THRESHOLD
+#define DUER_COAP_BLOCK_THRESHOLD  (DUER_BUFFER_SIZE)
+#endif
+
+#ifndef DUER_COAP_BLOCK_SIZE
+#define DUER_COAP_BLOCK_SIZE       (1024)
+#endif
+
+// the blocks in flight over TCP once the block size agreed, UDP has one
+#ifndef DUER_COAP_BLOCK_WINDOW
+#define DUER_COAP_BLOCK_WINDOW     (4)
+#endif
+
+// the transfer is given up if nothing from the server by the seconds
+#ifndef DUER_COAP_BLOCK_TIMEOUT
+#define DUER_COAP_BLOCK_TIMEOUT    (30)
+#endif
+
+// the confirmable requests in flight (NSTART of RFC 7252), at most the max,
+// see duer_coap_set_nstart
+#ifndef DUER_COAP_NSTART
+#define DUER_COAP_NSTART           (4)
+#endif
+
+#ifndef DUER_COAP_NSTART_MAX
+#define DUER_COAP_NSTART_MAX       (16)
+#endif
+
+// the request is given up if not answered by the seconds
+#ifndef DUER_COAP_INFLIGHT_TIMEOUT
+#define DUER_COAP_INFLIGHT_TIMEOUT (30)
+#endif
+
+#define DUER_COAP_BLOCK_SZX_MAX    (6)     // 1024 bytes, 7 is reserved
+#define DUER_COAP_BLOCK_DISABLED   (0xff)  // the server doesn't take the Block1
+#define DUER_COAP_TOKEN_MAX        (8)
+
+typedef enum _duer_coap_block_state_enum {
+    DUER_COAP_BLOCK_IDLE,
+    DUER_COAP_BLOCK_SENDING,    // the Block1 requests going out
+    DUER_COAP_BLOCK_DONE,       // the final response received
+    DUER_COAP_BLOCK_FALLBACK,   // the server refused the Block1, send it whole
+    DUER_COAP_BLOCK_FAILED,     // no response in time
+} duer_coap_block_state_e;
+
+/*
+ * The blockwise transfer of the connection. The Block1 payload is sent from
+ * the message of duer_coap_send directly, the Block2 payload is passed to
+ * f_result block by block, neither is buffered whole.
+ */
+typedef struct _baidu_ca_coap_block_s {
+    duer_u8_t           state;      // the Block1 transfer, SEE duer_coap_block_state_e
+    duer_u8_t           szx;        // the Block1 block size
+    duer_u8_t           msg_type;   // the request kept for the following blocks
+    duer_u8_t           msg_code;   // 0 if no request kept
+    duer_u8_t           token_len;
+    duer_u8_t           token[DUER_COAP_TOKEN_MAX];
+    duer_u16_t          path_len;
+    duer_u16_t          query_len;
+    duer_u8_t*          options;    // the path and the query of the request
+    duer_size_t         options_size;
+    const duer_msg_t*   msg;        // the Block1 message, not owned
+    const duer_u8_t*    payload;
+    duer_size_t         size;
+    duer_size_t         sent;       // the Block1 bytes sent
+    duer_size_t         acked;      // the Block1 bytes the server continued
+    duer_bool           receiving;  // the Block2 transfer in progress
+    duer_u8_t           rx_szx;     // the Block2 block size
+    duer_size_t         rx_total;   // the Size2 of the response, 0 if unknown
+    duer_size_t         received;   // the Block2 bytes passed to f_result
+    duer_size_t         requested;  // the Block2 bytes requested
+    duer_u32_t          timestamp;  // the last progress, by seconds
+} duer_coap_block_t;
+
+/*
+ * The confirmable request in flight, till its ACK or response comes
+ */
+typedef struct _baidu_ca_coap_inflight_s {
+    duer_u16_t          msg_id;
+    duer_u8_t           token_len;
+    duer_u8_t           token[DUER_COAP_TOKEN_MAX];
+    duer_bool           answered;
+    duer_u32_t          timestamp;  // sent, by seconds
+    duer_msg_t*         held;       // the answer come before the earlier ones'
+} duer_coap_inflight_t;
+
 typedef struct _baidu_ca_coap_tcp_header_s {
     duer_u32_t       mask;
     duer_u32_t       size;
 } duer_coap_hdr_t;
 
+/*
+ * The slot of the dynamic resources table, by the path hashcode,
+ * the path is NULL if the slot is empty
+ */
 typedef struct _baidu_ca_dynres_s {
-    duer_u32_t                  key;
-    duer_notify_f               f_res;
-    struct _baidu_ca_dynres_s* next;
+    duer_u32_t          key;
+    duer_size_t         path_len;
+    char*               path;
+    duer_notify_f       f_res;
 } duer_dynres_t;
 
 typedef struct _baidu_ca_coap_s {
     duer_status_t        retval;
     duer_trans_handler   trans;
     struct nsdl_s*      nsdl;
-    duer_dynres_t*       list;
+    duer_dynres_t*       res_slots; // the dynamic resources, open addressing
+    duer_size_t          res_size;  // the slots, power of 2
+    duer_size_t          res_count; // the resources
     duer_coap_result_f   f_result;
     duer_context         context;
     duer_addr_t          remote;
     const void*          key_info;
+    duer_sbuf_handler    recv_buf;  // the received bytes not processed yet
+    duer_size_t          recv_skip; // the bytes of the too large message to skip
+    duer_transevt_func   f_transevt;
+    duer_coap_block_t    block;
+    duer_u8_t            block_szx;        // the block size of the connection
+    duer_bool            block_negotiated; // the server has answered a block
+    // the confirmable requests by the order sent, a ring
+    duer_coap_inflight_t inflight[DUER_COAP_NSTART_MAX];
+    duer_size_t          inflight_head;
+    duer_size_t          inflight_count;
+    duer_size_t          nstart;
 } duer_coap_t, *duer_coap_ptr;
 
+/*
+ * The slot of the table from the nsdl handle to the CoAP context,
+ * the nsdl is NULL if the slot is empty
+ */
 typedef struct _baidu_ca_nsdl_map_s {
-    duer_coap_ptr                 coap;
-    struct _baidu_ca_nsdl_map_s* next;
+    struct nsdl_s*      nsdl;
+    duer_coap_ptr       coap;
 } duer_nsdl_map_t;
 
 DUER_LOC_IMPL duer_nsdl_map_t* s_duer_nsdl_map = NULL;
+DUER_LOC_IMPL duer_size_t s_duer_nsdl_size = 0;
+DUER_LOC_IMPL duer_size_t s_duer_nsdl_count = 0;
 
-DUER_LOC const duer_dynres_t* duer_coap_dynamic_resource_find(duer_coap_ptr coap, duer_u32_t key);
+DUER_LOC const duer_dynres_t* duer_coap_dynamic_resource_find(duer_coap_ptr coap,
+                                                              const char* path,
+                                                              duer_size_t len);
 
-DUER_LOC_IMPL void duer_coap_nsdl_add(duer_coap_ptr coap) {
-    duer_nsdl_map_t* item = (duer_nsdl_map_t*)DUER_MALLOC(sizeof(duer_nsdl_map_t));
+/*
+ * Whether the entry at the slot j, whose home slot is home, can fill the hole,
+ * for the backward shift deletion of the linear probing
+ */
+DUER_LOC_IMPL duer_bool duer_coap_slot_movable(duer_size_t home, duer_size_t hole,
+                                               duer_size_t j) {
+    if (hole <= j) {
+        return home <= hole || home > j;
+    }
+
+    return home <= hole && home > j;
+}
 
-    if (item) {
-        item->coap = coap;
-        item->next = s_duer_nsdl_map;
-        s_duer_nsdl_map = item;
+DUER_LOC_IMPL duer_size_t duer_coap_nsdl_slot(struct nsdl_s* nsdl, duer_size_t size) {
+    // the low bits of the pointer are aligned
+    return (duer_size_t)((((duer_size_t)nsdl >> 4) * 2654435761u) & (size - 1));
+}
+
+DUER_LOC_IMPL void duer_coap_nsdl_put(duer_nsdl_map_t* map, duer_size_t size,
+                                      struct nsdl_s* nsdl, duer_coap_ptr coap) {
+    duer_size_t i = duer_coap_nsdl_slot(nsdl, size);
+
+    while (map[i].nsdl) {
+        i = (i + 1) & (size - 1);
     }
+
+    map[i].nsdl = nsdl;
+    map[i].coap = coap;
 }
 
-DUER_LOC_IMPL void duer_coap_nsdl_del(duer_coap_ptr coap) {
-    duer_nsdl_map_t* item = s_duer_nsdl_map;
-    duer_nsdl_map_t* p = NULL;
-
-    while (item) {
-        if (item->coap == coap) {
-            if (p) {
-                p->next = item->next;
-            } else {
-                s_duer_nsdl_map = item->next;
+DUER_LOC_IMPL void duer_coap_nsdl_add(duer_coap_ptr coap) {
+    duer_nsdl_map_t* map = NULL;
+    duer_size_t size = s_duer_nsdl_size;
+    duer_size_t i;
+
+    if (!coap || !coap->nsdl) {
+        return;
+    }
+
+    if ((s_duer_nsdl_count + 1) * 2 > s_duer_nsdl_size) {
+        size = s_duer_nsdl_size ? s_duer_nsdl_size * 2 : DUER_COAP_SLOTS_MIN;
+        map = (duer_nsdl_map_t*)DUER_MALLOC(size * sizeof(duer_nsdl_map_t));
+
+        if (!map) {
+            DUER_LOGE("duer_coap_nsdl_add: alloc failed");
+            return;
+        }
+
+        DUER_MEMSET(map, 0, size * sizeof(duer_nsdl_map_t));
+
+        for (i = 0; i < s_duer_nsdl_size; i++) {
+            if (s_duer_nsdl_map[i].nsdl) {
+                duer_coap_nsdl_put(map, size, s_duer_nsdl_map[i].nsdl, s_duer_nsdl_map[i].coap);
             }
-            break;
         }
 
-        p = item;
-        item = item->next;
+        if (s_duer_nsdl_map) {
+            DUER_FREE(s_duer_nsdl_map);
+        }
+
+        s_duer_nsdl_map = map;
+        s_duer_nsdl_size = size;
+    }
+
+    duer_coap_nsdl_put(s_duer_nsdl_map, s_duer_nsdl_size, coap->nsdl, coap);
+    s_duer_nsdl_count++;
+}
+
+DUER_LOC_IMPL void duer_coap_nsdl_del(duer_coap_ptr coap) {
+    duer_size_t mask = s_duer_nsdl_size - 1;
+    duer_size_t hole;
+    duer_size_t i;
+    duer_size_t j;
+
+    if (!coap || !coap->nsdl || !s_duer_nsdl_map) {
+        return;
+    }
+
+    i = duer_coap_nsdl_slot(coap->nsdl, s_duer_nsdl_size);
+
+    while (s_duer_nsdl_map[i].nsdl && s_duer_nsdl_map[i].coap != coap) {
+        i = (i + 1) & mask;
+    }
+
+    if (!s_duer_nsdl_map[i].nsdl) {
+        return;
+    }
+
+    // shift the following entries back, no tombstone left
+    hole = i;
+
+    for (j = (i + 1) & mask; s_duer_nsdl_map[j].nsdl; j = (j + 1) & mask) {
+        if (duer_coap_slot_movable(duer_coap_nsdl_slot(s_duer_nsdl_map[j].nsdl, s_duer_nsdl_size),
+                                   hole, j)) {
+            s_duer_nsdl_map[hole] = s_duer_nsdl_map[j];
+            hole = j;
+        }
     }
 
-    if (item) {
-        DUER_FREE(item);
+    s_duer_nsdl_map[hole].nsdl = NULL;
+    s_duer_nsdl_map[hole].coap = NULL;
+
+    if (--s_duer_nsdl_count == 0) {
+        DUER_FREE(s_duer_nsdl_map);
+        s_duer_nsdl_map = NULL;
+        s_duer_nsdl_size = 0;
     }
 }
 
 DUER_LOC_IMPL duer_coap_ptr duer_coap_nsdl_get(struct nsdl_s* nsdl) {
-    duer_nsdl_map_t* item = s_duer_nsdl_map;
+    duer_size_t i;
 
-    while (item) {
-        if (item->coap && item->coap->nsdl == nsdl) {
-            break;
+    if (!nsdl || !s_duer_nsdl_map) {
+        return NULL;
+    }
+
+    i = duer_coap_nsdl_slot(nsdl, s_duer_nsdl_size);
+
+    while (s_duer_nsdl_map[i].nsdl) {
+        if (s_duer_nsdl_map[i].nsdl == nsdl) {
+            return s_duer_nsdl_map[i].coap;
         }
-        item = item->next;
+
+        i = (i + 1) & (s_duer_nsdl_size - 1);
     }
 
-    return item ? item->coap : NULL;
+    return NULL;
 }
 
 DUER_LOC_IMPL uint8_t duer_coap_dyn_res_callback(struct nsdl_s* handle,
@@ -123,9 +330,8 @@ DUER_LOC_IMPL uint8_t duer_coap_dyn_res_callback(struct nsdl_s* handle,
     duer_status_t rs = DUER_ERR_FAILED;
 
     if (coap && hdr) {
-        duer_u32_t key = duer_hashcode((char*)hdr->uri_path_ptr, hdr->uri_path_len,
-                                     (duer_u32_t)coap);
-        const duer_dynres_t* res = duer_coap_dynamic_resource_find(coap, key);
+        const duer_dynres_t* res = duer_coap_dynamic_resource_find(coap,
+                                   (const char*)hdr->uri_path_ptr, hdr->uri_path_len);
 
         if (res) {
             duer_msg_t msg;
@@ -140,35 +346,609 @@ DUER_LOC_IMPL uint8_t duer_coap_dyn_res_callback(struct nsdl_s* handle,
     return rs;
 }
 
+DUER_LOC_IMPL duer_u32_t duer_coap_block_now(void) {
+    return duer_timestamp() / 1000;
+}
+
+DUER_LOC_IMPL duer_u8_t duer_coap_block_szx(duer_size_t size) {
+    duer_u8_t szx = 0;
+
+    while (szx < DUER_COAP_BLOCK_SZX_MAX && (duer_size_t)(32 << szx) <= size) {
+        szx++;
+    }
+
+    return szx;
+}
+
+DUER_LOC_IMPL duer_u8_t duer_coap_block_value_szx(duer_s32_t value) {
+    duer_u8_t szx = DUER_COAP_BLOCK_SZX(value);
+
+    return szx > DUER_COAP_BLOCK_SZX_MAX ? DUER_COAP_BLOCK_SZX_MAX : szx;
+}
+
+/*
+ * The bytes in flight, UDP goes block by block as RFC 7959 does, TCP opens
+ * the window once the server has agreed the block size
+ */
+DUER_LOC_IMPL duer_size_t duer_coap_block_window(duer_coap_ptr coap, duer_u8_t szx) {
+    duer_size_t window = 1;
+
+    if (coap->remote.type == DUER_PROTO_TCP && coap->block_negotiated
+            && DUER_COAP_BLOCK_WINDOW > 1) {
+        window = DUER_COAP_BLOCK_WINDOW;
+    }
+
+    return window << (szx + 4);
+}
+
+DUER_LOC_IMPL void duer_coap_block_reset(duer_coap_ptr coap) {
+    duer_coap_block_t* block = &coap->block;
+
+    block->state = DUER_COAP_BLOCK_IDLE;
+    block->msg_code = 0;
+    block->msg = NULL;
+    block->receiving = DUER_FALSE;
+    coap->block_szx = duer_coap_block_szx(DUER_COAP_BLOCK_SIZE);
+    coap->block_negotiated = DUER_FALSE;
+}
+
+/*
+ * The engine sends the message blocked again, to go on with the blocks, to
+ * complete, or as the window has room
+ */
+DUER_LOC_IMPL void duer_coap_send_ready(duer_coap_ptr coap) {
+    if (coap->f_transevt) {
+        coap->f_transevt(DUER_TEVT_SEND_RDY);
+    }
+}
+
+/*
+ * Keep the request, the following blocks repeat its header
+ */
+DUER_LOC_IMPL duer_status_t duer_coap_block_keep(duer_coap_ptr coap, const duer_msg_t* msg) {
+    duer_coap_block_t* block = &coap->block;
+    duer_size_t size = msg->path_len + msg->query_len;
+    duer_u8_t* options = NULL;
+
+    if (size > block->options_size) {
+        options = DUER_MALLOC(size);
+
+        if (!options) {
+            block->msg_code = 0;
+            return DUER_ERR_MEMORY_OVERLOW;
+        }
+
+        if (block->options) {
+            DUER_FREE(block->options);
+        }
+
+        block->options = options;
+        block->options_size = size;
+    }
+
+    if (msg->path_len > 0) {
+        DUER_MEMCPY(block->options, msg->path, msg->path_len);
+    }
+
+    if (msg->query_len > 0) {
+        DUER_MEMCPY(block->options + msg->path_len, msg->query, msg->query_len);
+    }
+
+    block->path_len = msg->path_len;
+    block->query_len = msg->query_len;
+    block->msg_type = msg->msg_type;
+    block->msg_code = msg->msg_code;
+    block->token_len = msg->token_len < DUER_COAP_TOKEN_MAX ? msg->token_len : DUER_COAP_TOKEN_MAX;
+    DUER_MEMCPY(block->token, msg->token, block->token_len);
+    block->receiving = DUER_FALSE;
+
+    return DUER_OK;
+}
+
+DUER_LOC_IMPL duer_bool duer_coap_block_match(duer_coap_ptr coap, const sn_coap_hdr_s* hdr) {
+    const duer_coap_block_t* block = &coap->block;
+
+    return block->msg_code != 0 && block->token_len > 0 && hdr->token_len == block->token_len
+           && DUER_MEMCMP(hdr->token_ptr, block->token, block->token_len) == 0;
+}
+
+/*
+ * Send the kept request with the block options
+ */
+DUER_LOC_IMPL duer_status_t duer_coap_block_request(duer_coap_ptr coap,
+                                                    const duer_u8_t* payload, duer_size_t size,
+                                                    duer_s32_t block1, duer_s32_t block2,
+                                                    duer_u32_t size1) {
+    duer_coap_block_t* block = &coap->block;
+    sn_coap_hdr_s coap_hdr;
+    sn_coap_options_list_s opt_list;
+    sn_nsdl_addr_s addr;
+    duer_msg_t msg;
+
+    DUER_MEMSET(&msg, 0, sizeof(msg));
+    msg.msg_type = block->msg_type;
+    msg.msg_code = block->msg_code;
+    msg.token_len = block->token_len;
+    msg.token = block->token;
+    msg.path_len = block->path_len;
+    msg.path = block->options;
+    msg.query_len = block->query_len;
+    msg.query = block->options + block->path_len;
+    msg.payload_len = size;
+    msg.payload = (duer_u8_t*)payload;
+
+    duer_nsdl_address_set(&addr, &(coap->remote));
+    duer_nsdl_header_set(&coap_hdr, &opt_list, &msg);
+    duer_nsdl_block_set(&coap_hdr, &opt_list, block1, block2, size1);
+    coap->retval = DUER_ERR_FAILED;
+    sn_nsdl_send_coap_message(coap->nsdl, &addr, &coap_hdr);
+
+    if (coap->retval < 0 && coap->retval != DUER_ERR_TRANS_WOULD_BLOCK) {
+        DUER_LOGW("duer_coap_block_request: sent = %d", coap->retval);
+    }
+
+    return coap->retval < 0 ? coap->retval : DUER_OK;
+}
+
+DUER_LOC_IMPL duer_bool duer_coap_block_wanted(duer_coap_ptr coap, const duer_msg_t* msg) {
+    const duer_coap_block_t* block = &coap->block;
+
+    if (block->msg == msg && block->payload == msg->payload && block->size == msg->payload_len) {
+        return DUER_TRUE;
+    }
+
+    return msg->payload_len > DUER_COAP_BLOCK_THRESHOLD && msg->token_len > 0
+           && !DUER_MESSAGE_IS_RESPONSE(msg->msg_code)
+           && coap->block_szx != DUER_COAP_BLOCK_DISABLED;
+}
+
+/*
+ * Give up the transfer the server hasn't answered by DUER_COAP_BLOCK_TIMEOUT
+ *
+ * @Param coap, in, the CoAP context
+ * @Param now, in, the current time, by seconds
+ */
+DUER_LOC_IMPL void duer_coap_block_expire(duer_coap_ptr coap, duer_u32_t now) {
+    duer_coap_block_t* block = &coap->block;
+
+    if (now - block->timestamp <= DUER_COAP_BLOCK_TIMEOUT) {
+        return;
+    }
+
+    if (block->state == DUER_COAP_BLOCK_SENDING) {
+        DUER_LOGW("duer_coap_block_expire: the Block1 timeout, %d sent", block->sent);
+
+        if (!coap->block_negotiated) {
+            // the server never answered the blocks, try it whole
+            block->state = DUER_COAP_BLOCK_FALLBACK;
+            coap->block_szx = DUER_COAP_BLOCK_DISABLED;
+        } else {
+            block->state = DUER_COAP_BLOCK_FAILED;
+        }
+
+        duer_coap_send_ready(coap);
+    }
+
+    if (block->receiving) {
+        DUER_LOGW("duer_coap_block_expire: the Block2 timeout, %d received", block->received);
+        block->receiving = DUER_FALSE;
+    }
+}
+
+/*
+ * Send the Block1 requests of the message as the window allows
+ *
+ * @Return duer_status_t, DUER_OK if the final response received,
+ *         DUER_ERR_TRANS_WOULD_BLOCK if in progress, else the error
+ */
+DUER_LOC_IMPL duer_status_t duer_coap_block_send(duer_coap_ptr coap, const duer_msg_t* msg) {
+    duer_coap_block_t* block = &coap->block;
+    duer_status_t rs = DUER_ERR_TRANS_WOULD_BLOCK;
+    duer_size_t len;
+    duer_size_t size;
+    duer_bool more;
+
+    if (block->msg != msg || block->payload != msg->payload || block->size != msg->payload_len) {
+        // the previous message is gone, if not done
+        rs = duer_coap_block_keep(coap, msg);
+
+        if (rs < DUER_OK) {
+            goto exit;
+        }
+
+        block->msg = msg;
+        block->payload = msg->payload;
+        block->size = msg->payload_len;
+        block->state = DUER_COAP_BLOCK_SENDING;
+        block->szx = coap->block_szx;
+        block->sent = 0;
+        block->acked = 0;
+        block->timestamp = duer_coap_block_now();
+        rs = DUER_ERR_TRANS_WOULD_BLOCK;
+    } else {
+        duer_coap_block_expire(coap, duer_coap_block_now());
+    }
+
+    if (block->state == DUER_COAP_BLOCK_FALLBACK) {
+        // sent whole by the caller, see duer_coap_send
+        goto exit;
+    }
+
+    if (block->state == DUER_COAP_BLOCK_DONE || block->state == DUER_COAP_BLOCK_FAILED) {
+        rs = block->state == DUER_COAP_BLOCK_DONE ? DUER_OK : DUER_ERR_TRANS_TIMEOUT;
+        block->state = DUER_COAP_BLOCK_IDLE;
+        block->msg = NULL;
+        goto exit;
+    }
+
+    size = 16 << block->szx;
+
+    while (block->sent < block->size
+            && block->sent - block->acked < duer_coap_block_window(coap, block->szx)) {
+        len = block->size - block->sent < size ? block->size - block->sent : size;
+        more = block->sent + len < block->size;
+        rs = duer_coap_block_request(coap, block->payload + block->sent, len,
+                                     DUER_COAP_BLOCK_VALUE(block->sent >> (block->szx + 4),
+                                                           more, block->szx),
+                                     -1, block->sent == 0 ? block->size : 0);
+
+        if (rs < DUER_OK) {
+            goto exit;
+        }
+
+        block->sent += len;
+    }
+
+    rs = DUER_ERR_TRANS_WOULD_BLOCK;
+exit:
+    return rs;
+}
+
+/*
+ * Request the following blocks of the Block2 response as the window allows
+ */
+DUER_LOC_IMPL void duer_coap_block_continue(duer_coap_ptr coap) {
+    duer_coap_block_t* block = &coap->block;
+    duer_size_t window;
+
+    if (!block->receiving) {
+        return;
+    }
+
+    // without the Size2, one block at a time not to ask beyond the end
+    window = block->rx_total > 0 ? duer_coap_block_window(coap, block->rx_szx)
+             : ((duer_size_t)16 << block->rx_szx);
+
+    while (block->requested < block->received + window
+            && (block->rx_total == 0 || block->requested < block->rx_total)) {
+        if (duer_coap_block_request(coap, NULL, 0, -1,
+                                    DUER_COAP_BLOCK_VALUE(block->requested >> (block->rx_szx + 4),
+                                                          0, block->rx_szx),
+                                    0) < DUER_OK) {
+            break;
+        }
+
+        block->requested += 16 << block->rx_szx;
+    }
+}
+
+/*
+ * The block of the Block2 response
+ *
+ * @Return duer_bool, pass it to f_result or not
+ */
+DUER_LOC_IMPL duer_bool duer_coap_block_receive(duer_coap_ptr coap, const sn_coap_hdr_s* hdr,
+                                                duer_s32_t value) {
+    duer_coap_block_t* block = &coap->block;
+    duer_size_t offset = DUER_COAP_BLOCK_OFFSET(value);
+    duer_u8_t szx = duer_coap_block_value_szx(value);
+
+    if (offset == 0) {
+        block->receiving = DUER_TRUE;
+        block->received = 0;
+        block->requested = 0;
+        block->rx_szx = coap->block_szx < szx ? coap->block_szx : szx;
+        block->rx_total = hdr->options_list_ptr->use_size2 ? hdr->options_list_ptr->size2 : 0;
+    } else if (!block->receiving || offset != block->received) {
+        DUER_LOGD("duer_coap_block_receive: drop the block at %d, expected %d",
+                  offset, block->received);
+        return DUER_FALSE;
+    }
+
+    block->received = offset + hdr->payload_len;
+    block->timestamp = duer_coap_block_now();
+
+    if (!DUER_COAP_BLOCK_MORE(value)) {
+        block->receiving = DUER_FALSE;
+    } else if (szx < block->rx_szx) {
+        // the server sends the smaller blocks, ask again from here by its size
+        block->rx_szx = szx;
+        block->requested = block->received;
+    }
+
+    if (block->requested < block->received) {
+        block->requested = block->received;
+    }
+
+    return DUER_TRUE;
+}
+
+/*
+ * Handle the response of the blockwise transfer
+ *
+ * @Return duer_bool, pass it to f_result or not, the 2.31 Continue of the
+ *         Block1 isn't, nor the answer to the blocks given up
+ */
+DUER_LOC_IMPL duer_bool duer_coap_block_response(duer_coap_ptr coap, const sn_coap_hdr_s* hdr) {
+    duer_coap_block_t* block = &coap->block;
+    duer_s32_t value;
+    duer_size_t end;
+    duer_u8_t szx;
+
+    if (!duer_coap_block_match(coap, hdr)) {
+        if (duer_nsdl_block_get(hdr, DUER_TRUE) >= 0) {
+            DUER_LOGW("duer_coap_block_response: the Block2 of the request not kept");
+        }
+
+        return DUER_TRUE;
+    }
+
+    if (block->state == DUER_COAP_BLOCK_SENDING) {
+        value = duer_nsdl_block_get(hdr, DUER_FALSE);
+        szx = value < 0 ? block->szx : duer_coap_block_value_szx(value);
+        block->timestamp = duer_coap_block_now();
+
+        if (hdr->msg_code == COAP_MSG_CODE_RESPONSE_CONTINUE && value >= 0) {
+            end = (DUER_COAP_BLOCK_NUM(value) + 1) << (block->szx + 4);
+
+            if (end > block->acked) {
+                block->acked = end < block->sent ? end : block->sent;
+            }
+
+            if (szx < block->szx) {
+                // the server asks the smaller blocks, go on from what it has
+                block->szx = szx;
+                block->sent = block->acked;
+            }
+
+            coap->block_szx = block->szx;
+            coap->block_negotiated = DUER_TRUE;
+            duer_coap_send_ready(coap);
+            return DUER_FALSE;
+        }
+
+        if (hdr->msg_code == COAP_MSG_CODE_RESPONSE_REQUEST_ENTITY_TOO_LARGE && szx < block->szx) {
+            // start over by the block size the server takes
+            block->szx = szx;
+            block->sent = 0;
+            block->acked = 0;
+            coap->block_szx = szx;
+            duer_coap_send_ready(coap);
+            return DUER_FALSE;
+        }
+
+        if (block->acked == 0 && (hdr->msg_code == COAP_MSG_CODE_RESPONSE_BAD_OPTION
+                                  || hdr->msg_code == COAP_MSG_CODE_RESPONSE_NOT_IMPLEMENTED)) {
+            DUER_LOGW("duer_coap_block_response: the server doesn't take Block1");
+            block->state = DUER_COAP_BLOCK_FALLBACK;
+            coap->block_szx = DUER_COAP_BLOCK_DISABLED;
+            duer_coap_send_ready(coap);
+            return DUER_FALSE;
+        }
+
+        block->state = DUER_COAP_BLOCK_DONE;
+        coap->block_negotiated = DUER_TRUE;
+        duer_coap_send_ready(coap);
+    }
+
+    value = duer_nsdl_block_get(hdr, DUER_TRUE);
+
+    if (value >= 0) {
+        return duer_coap_block_receive(coap, hdr, value);
+    }
+
+    return DUER_TRUE;
+}
+
+DUER_LOC_IMPL duer_coap_inflight_t* duer_coap_inflight_at(duer_coap_ptr coap, duer_size_t i) {
+    return &coap->inflight[(coap->inflight_head + i) % DUER_COAP_NSTART_MAX];
+}
+
+DUER_LOC_IMPL duer_bool duer_coap_inflight_wanted(const duer_msg_t* msg) {
+    return msg->msg_type == DUER_MSG_TYPE_CONFIRMABLE && msg->msg_code != 0
+           && !DUER_MESSAGE_IS_RESPONSE(msg->msg_code);
+}
+
+/*
+ * Track the confirmable request sent
+ */
+DUER_LOC_IMPL void duer_coap_inflight_add(duer_coap_ptr coap, const sn_coap_hdr_s* hdr) {
+    duer_coap_inflight_t* p = duer_coap_inflight_at(coap, coap->inflight_count);
+
+    p->msg_id = hdr->msg_id;
+    p->token_len = hdr->token_len < DUER_COAP_TOKEN_MAX ? hdr->token_len : DUER_COAP_TOKEN_MAX;
+    if (p->token_len > 0) {
+        DUER_MEMCPY(p->token, hdr->token_ptr, p->token_len);
+    }
+    p->timestamp = duer_coap_block_now();
+    p->answered = DUER_FALSE;
+    p->held = NULL;
+    coap->inflight_count++;
+}
+
+/*
+ * Find the request the message answers, by the ACK message ID or the token
+ *
+ * @Return duer_s32_t, the order in the requests in flight, -1 if none
+ */
+DUER_LOC_IMPL duer_s32_t duer_coap_inflight_find(duer_coap_ptr coap, const duer_msg_t* msg) {
+    const duer_coap_inflight_t* p = NULL;
+    duer_size_t i;
+
+    for (i = 0; i < coap->inflight_count; i++) {
+        p = duer_coap_inflight_at(coap, i);
+
+        if (p->answered) {
+            continue;
+        }
+
+        if (msg->msg_type == DUER_MSG_TYPE_ACKNOWLEDGEMENT) {
+            if (msg->msg_id == p->msg_id) {
+                return (duer_s32_t)i;
+            }
+        } else if (msg->token_len > 0 && msg->token_len == p->token_len
+                   && DUER_MEMCMP(msg->token, p->token, p->token_len) == 0) {
+            return (duer_s32_t)i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Keep the answer till the earlier requests are answered,
+ * the token, path, query and payload are copied after the header
+ */
+DUER_LOC_IMPL duer_status_t duer_coap_inflight_hold(duer_coap_ptr coap, duer_size_t i,
+                                                   const duer_msg_t* msg) {
+    duer_coap_inflight_t* p = duer_coap_inflight_at(coap, i);
+    duer_msg_t* held = NULL;
+    duer_u8_t* data = NULL;
+
+    held = DUER_MALLOC(sizeof(*held) + msg->token_len + msg->path_len + msg->query_len
+                       + msg->payload_len);
+    if (!held) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    *held = *msg;
+    data = (duer_u8_t*)(held + 1);
+
+    held->token = data;
+    DUER_MEMCPY(data, msg->token, msg->token_len);
+    data += msg->token_len;
+
+    held->path = data;
+    DUER_MEMCPY(data, msg->path, msg->path_len);
+    data += msg->path_len;
+
+    held->query = data;
+    DUER_MEMCPY(data, msg->query, msg->query_len);
+    data += msg->query_len;
+
+    held->payload = data;
+    DUER_MEMCPY(data, msg->payload, msg->payload_len);
+
+    p->answered = DUER_TRUE;
+    p->held = held;
+
+    return DUER_OK;
+}
+
+/*
+ * Remove the oldest request, and pass the answers held after it in order
+ */
+DUER_LOC_IMPL void duer_coap_inflight_pop(duer_coap_ptr coap) {
+    duer_coap_inflight_t* p = NULL;
+    duer_msg_t* held = NULL;
+    duer_bool full = coap->inflight_count >= coap->nstart;
+    duer_bool answered = DUER_FALSE;
+
+    do {
+        coap->inflight_head = (coap->inflight_head + 1) % DUER_COAP_NSTART_MAX;
+        coap->inflight_count--;
+
+        if (held) {
+            if (coap->f_result) {
+                coap->f_result(coap->context, coap, held, &coap->remote);
+            }
+
+            DUER_FREE(held);
+            held = NULL;
+        }
+
+        answered = DUER_FALSE;
+
+        if (coap->inflight_count > 0) {
+            p = duer_coap_inflight_at(coap, 0);
+            answered = p->answered;
+            held = p->held;
+            p->held = NULL;
+        }
+    } while (answered);
+
+    if (full && coap->inflight_count < coap->nstart) {
+        duer_coap_send_ready(coap);
+    }
+}
+
+/*
+ * Give up the oldest requests not answered by DUER_COAP_INFLIGHT_TIMEOUT
+ *
+ * @Param coap, in, the CoAP context
+ * @Param now, in, the current time, by seconds
+ */
+DUER_LOC_IMPL void duer_coap_inflight_expire(duer_coap_ptr coap, duer_u32_t now) {
+    const duer_coap_inflight_t* p = NULL;
+
+    while (coap->inflight_count > 0) {
+        p = duer_coap_inflight_at(coap, 0);
+
+        if (now - p->timestamp <= DUER_COAP_INFLIGHT_TIMEOUT) {
+            break;
+        }
+
+        DUER_LOGW("duer_coap_inflight_expire: no answer to the message %d", p->msg_id);
+        duer_coap_inflight_pop(coap);
+    }
+}
+
+DUER_LOC_IMPL void duer_coap_inflight_clear(duer_coap_ptr coap) {
+    duer_coap_inflight_t* p = NULL;
+
+    while (coap->inflight_count > 0) {
+        p = duer_coap_inflight_at(coap, 0);
+
+        if (p->held) {
+            DUER_FREE(p->held);
+            p->held = NULL;
+        }
+
+        coap->inflight_head = (coap->inflight_head + 1) % DUER_COAP_NSTART_MAX;
+        coap->inflight_count--;
+    }
+
+    coap->inflight_head = 0;
+}
+
 DUER_LOC_IMPL uint8_t duer_coap_nsdl_tx(struct nsdl_s* nsdl, sn_nsdl_capab_e cap,
                                       uint8_t* data, uint16_t size, sn_nsdl_addr_s* addr) {
     duer_coap_ptr coap = duer_coap_nsdl_get(nsdl);
     uint8_t rs = 0;
     duer_addr_t addr_in;
-    uint8_t* temp = NULL;
+    duer_coap_hdr_t hdr;
+    duer_iovec_t iov[2];
+    duer_size_t iovcnt = 0;
 
     if (!coap) {
         goto error;
     }
 
     if (coap->remote.type == DUER_PROTO_TCP) {
-        temp = DUER_MALLOC(sizeof(duer_coap_hdr_t) + size);
-
-        if (!temp) {
-            DUER_LOGW("duer_coap_nsdl_tx: memory overflow!!!");
-            goto error;
-        }
-
-        duer_coap_hdr_t* ptr = (duer_coap_hdr_t*)temp;
-        ptr->mask = duer_htonl(DUER_COAP_TCP_HDR);
-        ptr->size = duer_htonl(size);
-        DUER_MEMCPY(++ptr, data, size);
-        data = temp;
-        size += sizeof(duer_coap_hdr_t);
+        // the frame header goes out in front of the packet, not copied into it
+        hdr.mask = duer_htonl(DUER_COAP_TCP_HDR);
+        hdr.size = duer_htonl(size);
+        iov[iovcnt].base = &hdr;
+        iov[iovcnt].len = sizeof(hdr);
+        iovcnt++;
     }
 
+    iov[iovcnt].base = data;
+    iov[iovcnt].len = size;
+    iovcnt++;
+
     duer_coap_address_set(&addr_in, addr);
-    coap->retval = duer_trans_send(coap->trans, data, size, addr ? &addr_in : NULL);
+    coap->retval = duer_trans_sendv(coap->trans, iov, iovcnt, addr ? &addr_in : NULL);
 
     if (coap->retval < 0) {
         goto error;
@@ -177,11 +957,6 @@ DUER_LOC_IMPL uint8_t duer_coap_nsdl_tx(struct nsdl_s* nsdl, sn_nsdl_capab_e cap
     }
 
 exit:
-
-    if (temp) {
-        DUER_FREE(temp);
-    }
-
     return rs;
 error:
     rs = 0; // return == 0 means fail
@@ -192,15 +967,38 @@ DUER_LOC_IMPL uint8_t duer_coap_nsdl_rx(struct nsdl_s* nsdl, sn_coap_hdr_s* hdr,
                                       sn_nsdl_addr_s* addr) {
     duer_coap_ptr coap = duer_coap_nsdl_get(nsdl);
     uint8_t rs = 0;
+    duer_msg_t msg;
+    duer_addr_t ca_addr;
+    duer_s32_t order = -1;
 
-    if (coap && coap->f_result) {
-        duer_msg_t msg;
-        duer_addr_t ca_addr;
-        duer_coap_header_set(&msg, hdr);
+    if (!coap || !hdr || !duer_coap_block_response(coap, hdr)) {
+        goto exit;
+    }
+
+    duer_coap_header_set(&msg, hdr);
+    order = duer_coap_inflight_find(coap, &msg);
+
+    if (order > 0) {
+        // the earlier requests not answered yet, it comes after them
+        if (!msg.block_more && duer_coap_inflight_hold(coap, order, &msg) == DUER_OK) {
+            goto exit;
+        }
+
+        // the Block2 goes on now, not to wait behind its following blocks
+        duer_coap_inflight_at(coap, order)->answered = DUER_TRUE;
+    }
+
+    if (coap->f_result) {
         duer_coap_address_set(&ca_addr, addr);
         rs = coap->f_result(coap->context, coap, &msg, &ca_addr);
     }
 
+    if (order == 0) {
+        duer_coap_inflight_pop(coap);
+    }
+
+    duer_coap_block_continue(coap);
+exit:
     return rs;
 }
 void* duer_coap_nsdl_alloc(uint16_t size) {
@@ -219,118 +1017,181 @@ DUER_LOC_IMPL const char* duer_coap_convert_path(const char* path) {
     return path;
 }
 
-DUER_LOC_IMPL const duer_dynres_t* duer_coap_dynamic_resource_find(
-    duer_coap_ptr coap, duer_u32_t key) {
+DUER_LOC_IMPL duer_u32_t duer_coap_dynamic_resource_key(duer_coap_ptr coap,
+                                                        const char* path,
+                                                        duer_size_t len) {
+    return duer_hashcode(path, len, (duer_u32_t)coap);
+}
+
+/*
+ * Find the slot of the path, or the empty one it would be put in
+ */
+DUER_LOC_IMPL duer_size_t duer_coap_dynamic_resource_slot(duer_coap_ptr coap, duer_u32_t key,
+                                                          const char* path, duer_size_t len) {
+    duer_size_t mask = coap->res_size - 1;
+    duer_size_t i = key & mask;
+    const duer_dynres_t* p = NULL;
+
+    for (;;) {
+        p = &coap->res_slots[i];
+
+        // the different paths may have the same hashcode
+        if (!p->path || (p->key == key && p->path_len == len
+                         && DUER_MEMCMP(p->path, path, len) == 0)) {
+            return i;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+DUER_LOC_IMPL const duer_dynres_t* duer_coap_dynamic_resource_find(duer_coap_ptr coap,
+                                                                   const char* path,
+                                                                   duer_size_t len) {
     const duer_dynres_t* p = NULL;
 
-    if (coap && (p = coap->list) != NULL) {
-        while (p && (p->key != key)) {
-            p = p->next;
+    if (coap && coap->res_count > 0 && path) {
+        p = &coap->res_slots[duer_coap_dynamic_resource_slot(coap,
+                             duer_coap_dynamic_resource_key(coap, path, len), path, len)];
+    }
+
+    return p && p->path ? p : NULL;
+}
+
+DUER_LOC_IMPL duer_status_t duer_coap_dynamic_resource_grow(duer_coap_ptr coap) {
+    duer_dynres_t* slots = coap->res_slots;
+    duer_size_t size = coap->res_size;
+    duer_size_t new_size = size ? size * 2 : DUER_COAP_SLOTS_MIN;
+    duer_size_t i;
+
+    coap->res_slots = (duer_dynres_t*)DUER_MALLOC(new_size * sizeof(duer_dynres_t));
+
+    if (!coap->res_slots) {
+        coap->res_slots = slots;
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    DUER_MEMSET(coap->res_slots, 0, new_size * sizeof(duer_dynres_t));
+    coap->res_size = new_size;
+
+    for (i = 0; i < size; i++) {
+        if (slots[i].path) {
+            coap->res_slots[duer_coap_dynamic_resource_slot(coap, slots[i].key,
+                            slots[i].path, slots[i].path_len)] = slots[i];
         }
     }
 
-    return p;
+    if (slots) {
+        DUER_FREE(slots);
+    }
+
+    return DUER_OK;
 }
 
 DUER_LOC_IMPL duer_status_t duer_coap_dynamic_resource_add(duer_coap_ptr coap,
         const duer_res_t* res) {
     duer_dynres_t* dynres = NULL;
     duer_u32_t key;
+    duer_size_t len;
     duer_status_t rs = DUER_ERR_FAILED;
     const char* path;
 
-    if (!coap || !res) {
-        goto error;
+    if (!coap || !res || !res->path) {
+        goto exit;
     }
 
     path = duer_coap_convert_path(res->path);
-    key = duer_hashcode(path, DUER_STRLEN(path), (duer_u32_t)coap);
+    len = DUER_STRLEN(path);
 
-    if (duer_coap_dynamic_resource_find(coap, key) != NULL) {
-        goto error;
+    if (duer_coap_dynamic_resource_find(coap, path, len) != NULL) {
+        goto exit;
     }
 
-    dynres = DUER_MALLOC(sizeof(duer_dynres_t));
+    if ((coap->res_count + 1) * 2 > coap->res_size) {
+        rs = duer_coap_dynamic_resource_grow(coap);
 
-    if (!dynres) {
-        goto error;
+        if (rs != DUER_OK) {
+            goto exit;
+        }
     }
 
-    dynres->key = key;
-    dynres->f_res = res->res.f_res;
-    dynres->next = NULL;
+    key = duer_coap_dynamic_resource_key(coap, path, len);
+    dynres = &coap->res_slots[duer_coap_dynamic_resource_slot(coap, key, path, len)];
+    dynres->path = DUER_MALLOC(len + 1);
 
-    if (!coap->list) {
-        coap->list = dynres;
-    } else {
-        dynres->next = coap->list;
-        coap->list = dynres;
+    if (!dynres->path) {
+        rs = DUER_ERR_MEMORY_OVERLOW;
+        goto exit;
     }
 
+    DUER_MEMCPY(dynres->path, path, len + 1);
+    dynres->path_len = len;
+    dynres->key = key;
+    dynres->f_res = res->res.f_res;
+    coap->res_count++;
+
     rs = DUER_OK;
 exit:
     return rs;
-error:
-
-    if (dynres) {
-        DUER_FREE(dynres);
-    }
-
-    goto exit;
 }
 
 DUER_LOC_IMPL duer_status_t duer_coap_dynamic_resource_remove(duer_coap_ptr coap, const char* path) {
-    duer_u32_t key;
     duer_status_t rs = DUER_ERR_FAILED;
-    duer_dynres_t* p = NULL;
-    duer_dynres_t* q = NULL;
+    duer_dynres_t* slots = NULL;
+    duer_size_t mask;
+    duer_size_t len;
+    duer_size_t hole;
+    duer_size_t j;
 
-    if (!coap || !path || !coap->list) {
+    if (!coap || !path || coap->res_count == 0) {
         goto exit;
     }
 
     path = duer_coap_convert_path(path);
-    key = duer_hashcode(path, DUER_STRLEN(path), (duer_u32_t)coap);
-    p = coap->list;
-
-    while (p && p->key != key) {
-        q = p;
-        p = p->next;
-    }
+    len = DUER_STRLEN(path);
+    slots = coap->res_slots;
+    mask = coap->res_size - 1;
+    hole = duer_coap_dynamic_resource_slot(coap,
+            duer_coap_dynamic_resource_key(coap, path, len), path, len);
 
-    if (!p) {
+    if (!slots[hole].path) {
         goto exit;
     }
 
-    if (p == coap->list) {
-        coap->list = p->next;
-    } else {
-        q->next = p->next;
+    DUER_FREE(slots[hole].path);
+
+    // shift the following entries back, no tombstone left
+    for (j = (hole + 1) & mask; slots[j].path; j = (j + 1) & mask) {
+        if (duer_coap_slot_movable(slots[j].key & mask, hole, j)) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
     }
 
-    DUER_FREE(p);
+    DUER_MEMSET(&slots[hole], 0, sizeof(slots[hole]));
+    coap->res_count--;
     rs = DUER_OK;
 exit:
     return rs;
 }
 
 DUER_LOC_IMPL void duer_coap_dynamic_resource_free(duer_coap_ptr coap) {
-    duer_dynres_t* p = NULL;
-    duer_dynres_t* q = NULL;
+    duer_size_t i;
 
-    if (!coap || !coap->list) {
+    if (!coap || !coap->res_slots) {
         return;
     }
 
-    p = coap->list;
-
-    while (p) {
-        q = p;
-        p = p->next;
-        DUER_FREE(q);
+    for (i = 0; i < coap->res_size; i++) {
+        if (coap->res_slots[i].path) {
+            DUER_FREE(coap->res_slots[i].path);
+        }
     }
 
-    coap->list = NULL;
+    DUER_FREE(coap->res_slots);
+    coap->res_slots = NULL;
+    coap->res_size = 0;
+    coap->res_count = 0;
 }
 
 DUER_INT_IMPL duer_status_t duer_coap_resource_add(duer_coap_handler hdlr, const duer_res_t* res) {
@@ -401,7 +1262,16 @@ DUER_INT_IMPL duer_coap_handler duer_coap_acquire(duer_coap_result_f f_result,
         goto error;
     }
 
+    coap->recv_buf = duer_sbuf_create(DUER_BUFFER_SIZE, DUER_COAP_RECV_BUFFER_MAX);
+
+    if (!coap->recv_buf) {
+        goto error;
+    }
+
     duer_coap_nsdl_add(coap);
+    duer_coap_block_reset(coap);
+    coap->nstart = DUER_COAP_NSTART < DUER_COAP_NSTART_MAX ? DUER_COAP_NSTART : DUER_COAP_NSTART_MAX;
+    coap->f_transevt = ctx_socket;
     coap->f_result = f_result;
     coap->context = ctx;
     coap->key_info = key_info;
@@ -427,6 +1297,12 @@ DUER_INT_IMPL duer_status_t duer_coap_connect(duer_coap_handler hdlr,
     duer_trans_set_pk(coap->trans, data, size);
     pAddr = &(coap->remote);
 
+    // a new stream, drop what's left of the previous one
+    duer_sbuf_reset(coap->recv_buf);
+    coap->recv_skip = 0;
+    duer_coap_block_reset(coap);
+    duer_coap_inflight_clear(coap);
+
     if (pAddr->host) {
         DUER_FREE(pAddr->host);
         pAddr->host = NULL;
@@ -464,25 +1340,61 @@ DUER_INT_IMPL duer_status_t duer_coap_send(duer_coap_handler hdlr,
                                         const duer_msg_t* hdr) {
     duer_coap_ptr coap = (duer_coap_ptr)hdlr;
     duer_status_t rs = DUER_ERR_FAILED;
+    sn_coap_hdr_s coap_hdr;
+    sn_nsdl_addr_s addr;
+    sn_coap_options_list_s opt_list;
 
-    if (coap && coap->nsdl) {
-        sn_coap_hdr_s coap_hdr;
-        sn_nsdl_addr_s addr;
-        sn_coap_options_list_s opt_list;
-        duer_nsdl_address_set(&addr, &(coap->remote));
-        duer_nsdl_header_set(&coap_hdr, &opt_list, hdr);
-        coap->retval = DUER_ERR_FAILED;
-        rs = sn_nsdl_send_coap_message(coap->nsdl, &addr, &coap_hdr);
+    if (!coap || !coap->nsdl || !hdr) {
+        goto exit;
+    }
 
-        if (coap->retval <= 0) {
-            if (coap->retval != DUER_ERR_TRANS_WOULD_BLOCK) {
-                DUER_LOGW("duer_coap_nsdl_tx: sent = %d", coap->retval);
-            }
+    if (coap->block.msg == hdr && coap->block.state == DUER_COAP_BLOCK_FALLBACK) {
+        coap->block.state = DUER_COAP_BLOCK_IDLE;
+        coap->block.msg = NULL;
+    }
 
-            rs = coap->retval;
+    if (duer_coap_block_wanted(coap, hdr)) {
+        rs = duer_coap_block_send(coap, hdr);
+        goto exit;
+    }
+
+    if (hdr->payload_len > 0xffff) {
+        DUER_LOGE("duer_coap_send: payload too large, size = %d", hdr->payload_len);
+        rs = DUER_ERR_INVALID_PARAMETER;
+        goto exit;
+    }
+
+    if (duer_coap_inflight_wanted(hdr)) {
+        duer_coap_inflight_expire(coap, duer_coap_block_now());
+
+        if (coap->inflight_count >= coap->nstart) {
+            rs = DUER_ERR_TRANS_WOULD_BLOCK;
+            goto exit;
         }
     }
 
+    // the response may come by Block2, unless another one is coming
+    if (!DUER_MESSAGE_IS_RESPONSE(hdr->msg_code) && hdr->token_len > 0
+            && !coap->block.msg && !coap->block.receiving) {
+        duer_coap_block_keep(coap, hdr);
+    }
+
+    duer_nsdl_address_set(&addr, &(coap->remote));
+    duer_nsdl_header_set(&coap_hdr, &opt_list, hdr);
+    coap->retval = DUER_ERR_FAILED;
+    rs = sn_nsdl_send_coap_message(coap->nsdl, &addr, &coap_hdr);
+
+    if (coap->retval <= 0) {
+        if (coap->retval != DUER_ERR_TRANS_WOULD_BLOCK) {
+            DUER_LOGW("duer_coap_nsdl_tx: sent = %d", coap->retval);
+        }
+
+        rs = coap->retval;
+    } else if (rs == SN_NSDL_SUCCESS && duer_coap_inflight_wanted(hdr)) {
+        duer_coap_inflight_add(coap, &coap_hdr);
+    }
+
+exit:
     return rs;
 }
 
@@ -555,49 +1467,148 @@ DUER_INT_IMPL duer_status_t duer_coap_update_registration(duer_coap_handler hdlr
     return rs;
 }
 
+DUER_LOC_IMPL duer_status_t duer_coap_process(duer_coap_ptr coap, void* data,
+                                            duer_size_t size) {
+    sn_nsdl_addr_s addr;
+    duer_status_t rs;
+
+    duer_nsdl_address_set(&addr, &(coap->remote));
+    rs = sn_nsdl_process_coap(coap->nsdl, data, size, &addr);
+    if (rs < 0) {
+        DUER_LOGW("invalid coap message!!");
+    }
+
+    return rs;
+}
+
 /*
- * Receive the CoAP message
+ * Process all the complete messages in the receive buffer,
+ * the partial one is kept for the next read
+ *
+ * @Param coap, in, the CoAP context
+ * @Param rs, in, out, the result of the last message processed
+ * @Return duer_size_t, the bytes expected to complete the next message,
+ *         0 if the stream is broken
+ */
+DUER_LOC_IMPL duer_size_t duer_coap_process_stream(duer_coap_ptr coap, duer_status_t* rs) {
+    duer_coap_hdr_t value;
+    duer_u8_t* data = NULL;
+    duer_size_t length = 0;
+
+    for (;;) {
+        data = duer_sbuf_data(coap->recv_buf, &length);
+
+        if (coap->recv_skip > 0) {
+            length = length < coap->recv_skip ? length : coap->recv_skip;
+            duer_sbuf_consume(coap->recv_buf, length);
+            coap->recv_skip -= length;
+
+            if (coap->recv_skip > 0) {
+                return coap->recv_skip < DUER_BUFFER_SIZE ? coap->recv_skip : DUER_BUFFER_SIZE;
+            }
+
+            continue;
+        }
+
+        if (length < sizeof(value)) {
+            return sizeof(value) - length;
+        }
+
+        DUER_MEMCPY(&value, data, sizeof(value));
+        value.mask = duer_htonl(value.mask);
+        value.size = duer_htonl(value.size);
+
+        if (value.mask != DUER_COAP_TCP_HDR) {
+            DUER_LOGE("duer_coap_recv: lost the message boundary, mask = %x", value.mask);
+            duer_sbuf_reset(coap->recv_buf);
+            *rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+            return 0;
+        }
+
+        if (value.size > DUER_COAP_RECV_BUFFER_MAX - sizeof(value)) {
+            DUER_LOGW("duer_coap_recv: skip the too large message, size = %d", value.size);
+            coap->recv_skip = sizeof(value) + value.size;
+            continue;
+        }
+
+        if (length < sizeof(value) + value.size) {
+            return sizeof(value) + value.size - length;
+        }
+
+        *rs = duer_coap_process(coap, data + sizeof(value), value.size);
+        duer_sbuf_consume(coap->recv_buf, sizeof(value) + value.size);
+    }
+}
+
+/*
+ * Receive the CoAP messages
+ *
+ * For TCP, it reads into the receive buffer until the transport would block,
+ * and processes every complete message in it.
  *
  * @Param hdlr, in, the CoAP context
- * @Param data, in, the receive buffer
- * @Param size, in, the receive buffer size
- * @Return duer_status_t, the result
+ * @Return duer_status_t, the result of the last message processed,
+ *         or DUER_ERR_TRANS_WOULD_BLOCK if no message completed
  */
-DUER_LOC_IMPL duer_status_t duer_coap_recv(duer_coap_handler hdlr, void* data,
-                                        duer_size_t size) {
+DUER_LOC_IMPL duer_status_t duer_coap_recv(duer_coap_handler hdlr) {
     duer_status_t rs = DUER_ERR_FAILED;
+    duer_status_t result = DUER_ERR_TRANS_WOULD_BLOCK;
     duer_coap_ptr coap = (duer_coap_ptr)hdlr;
+    duer_size_t expected = DUER_BUFFER_SIZE;
+    duer_size_t room = 0;
+    void* data = NULL;
 
-    if (coap) {
-        if (coap->remote.type == DUER_PROTO_TCP) {
-            duer_coap_hdr_t value = {0, 0};
-            rs = duer_trans_recv(coap->trans, &value, sizeof(value), NULL);
-            value.mask = duer_htonl(value.mask);
-            value.size = duer_htonl(value.size);
-
-            //TODO(leliang)if recv size is smaller than sizeof(value), then enter an unknown situation
-            if (rs != sizeof(value) || value.mask != DUER_COAP_TCP_HDR
-                    || value.size > size) {
-                if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
-                    DUER_LOGI("duer_coap_recv: get header error rs = %d, mask = %x, size = %d",
-                              rs, value.mask, value.size);
-                }
-                goto exit;
-            }
+    if (!coap || !coap->recv_buf) {
+        goto exit;
+    }
+
+    if (coap->remote.type != DUER_PROTO_TCP) {
+        // one datagram is one message
+        data = duer_sbuf_reserve(coap->recv_buf, DUER_BUFFER_SIZE, &room);
+        rs = data ? duer_trans_recv(coap->trans, data, room, NULL) : DUER_ERR_MEMORY_OVERLOW;
+
+        if (rs > 0) {
+            rs = duer_coap_process(coap, data, rs);
+        }
 
-            size = value.size;
+        goto exit;
+    }
+
+    for (;;) {
+        // read for the whole message at least, and the following ones if they're there
+        data = duer_sbuf_reserve(coap->recv_buf,
+                                 expected > DUER_BUFFER_SIZE ? expected : DUER_BUFFER_SIZE,
+                                 &room);
+
+        if (!data) {
+            rs = DUER_ERR_MEMORY_OVERLOW;
+            break;
         }
 
-        rs = duer_trans_recv(coap->trans, data, size, NULL);
+        rs = duer_trans_recv(coap->trans, data, room, NULL);
 
-        if (rs > 0) {
-            sn_nsdl_addr_s addr;
-            duer_nsdl_address_set(&addr, &(coap->remote));
-            rs = sn_nsdl_process_coap(coap->nsdl, data, rs, &addr);
-            if (rs < 0) {
-                DUER_LOGW("invalid coap message!!");
-            }
+        if (rs <= 0) {
+            break;
         }
+
+        duer_sbuf_commit(coap->recv_buf, rs);
+        expected = duer_coap_process_stream(coap, &result);
+
+        if (expected == 0) {
+            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+            break;
+        }
+
+        // a short read is not the end: the TLS transport returns one record
+        // per call, and the next may be in the socket already, which the
+        // edge-triggered reactor won't report again
+    }
+
+    if (result != DUER_ERR_TRANS_WOULD_BLOCK) {
+        rs = result;
+    } else if (rs == 0) {
+        // the peer closed the stream
+        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
     }
 
 exit:
@@ -610,17 +1621,7 @@ exit:
 }
 
 DUER_INT_IMPL duer_status_t duer_coap_data_available(duer_coap_handler hdlr) {
-    duer_status_t rs = DUER_ERR_FAILED;
-    duer_coap_ptr coap = (duer_coap_ptr)hdlr;
-    char data[DUER_BUFFER_SIZE];
-
-    if (!coap) {
-        goto exit;
-    }
-
-    rs = duer_coap_recv(coap, data, sizeof(data));
-exit:
-    return rs;
+    return duer_coap_recv(hdlr);
 }
 
 DUER_INT_IMPL duer_status_t duer_coap_exec(duer_coap_handler hdlr,
@@ -629,6 +1630,8 @@ DUER_INT_IMPL duer_status_t duer_coap_exec(duer_coap_handler hdlr,
 
     if (coap) {
         sn_nsdl_exec(coap->nsdl, timestamp);
+        duer_coap_block_expire(coap, timestamp);
+        duer_coap_inflight_expire(coap, timestamp);
     }
 
     return DUER_ERR_FAILED;
@@ -656,6 +1659,18 @@ DUER_INT_IMPL duer_status_t duer_coap_release(duer_coap_handler hdlr) {
             DUER_FREE(pAddr->host);
         }
 
+        if (coap->recv_buf) {
+            duer_sbuf_destroy(coap->recv_buf);
+            coap->recv_buf = NULL;
+        }
+
+        if (coap->block.options) {
+            DUER_FREE(coap->block.options);
+            coap->block.options = NULL;
+        }
+
+        duer_coap_inflight_clear(coap);
+
         duer_coap_dynamic_resource_free(coap);
         DUER_FREE(coap);
         coap = NULL;
@@ -664,8 +1679,31 @@ DUER_INT_IMPL duer_status_t duer_coap_release(duer_coap_handler hdlr) {
     return DUER_OK;
 }
 
+DUER_INT_IMPL duer_status_t duer_coap_set_nstart(duer_coap_handler hdlr, duer_size_t nstart) {
+    duer_coap_ptr coap = (duer_coap_ptr)hdlr;
+    duer_bool full = DUER_FALSE;
+
+    if (!coap || nstart == 0 || nstart > DUER_COAP_NSTART_MAX) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    full = coap->inflight_count >= coap->nstart;
+    coap->nstart = nstart;
+
+    if (full && coap->inflight_count < coap->nstart) {
+        duer_coap_send_ready(coap);
+    }
+
+    return DUER_OK;
+}
+
 DUER_INT_IMPL duer_status_t duer_coap_set_read_timeout(duer_coap_handler hdlr,
         duer_u32_t timeout) {
     duer_coap_ptr coap = (duer_coap_ptr)hdlr;
     return duer_trans_set_read_timeout(coap ? coap->trans : NULL, timeout);
 }
+
+DUER_INT_IMPL duer_status_t duer_coap_release_idle(duer_coap_handler hdlr) {
+    duer_coap_ptr coap = (duer_coap_ptr)hdlr;
+    return duer_trans_release_idle(coap ? coap->trans : NULL);
+}
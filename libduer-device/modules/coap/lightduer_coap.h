@@ -28,6 +28,18 @@
 
 #define DUER_COAP_MESSAGE_ID_INVALID     (0)
 
+/*
+ * The Block1/Block2 option value of RFC 7959, (num << 4) | (more << 3) | szx,
+ * the block size is 16 << szx
+ */
+#define DUER_COAP_BLOCK_VALUE(_num, _more, _szx) \
+    ((duer_s32_t)(((_num) << 4) | ((_more) ? 0x08 : 0) | (_szx)))
+#define DUER_COAP_BLOCK_NUM(_value)      ((duer_u32_t)(_value) >> 4)
+#define DUER_COAP_BLOCK_MORE(_value)     (((_value) & 0x08) ? 1 : 0)
+#define DUER_COAP_BLOCK_SZX(_value)      ((_value) & 0x07)
+#define DUER_COAP_BLOCK_OFFSET(_value) \
+    ((duer_size_t)DUER_COAP_BLOCK_NUM(_value) << (DUER_COAP_BLOCK_SZX(_value) + 4))
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -127,6 +139,18 @@ DUER_INT duer_status_t duer_coap_update_registration(duer_coap_handler coap,
 /*
  * Send the CoAP message
  *
+ * The request payload larger than DUER_COAP_BLOCK_THRESHOLD is sent by
+ * Block1, a few blocks at a time from the msg->payload, so the msg should
+ * be kept and sent again until it returns other than
+ * DUER_ERR_TRANS_WOULD_BLOCK, the transport event DUER_TEVT_SEND_RDY tells
+ * when to. The response comes to f_result as the others, and if it has
+ * Block2, block by block with msg->block_offset and msg->block_more.
+ *
+ * The confirmable requests in flight are DUER_COAP_NSTART at most, the
+ * following one returns DUER_ERR_TRANS_WOULD_BLOCK till the earliest is
+ * answered. Their answers (the ACK or the response by the token) come to
+ * f_result in the order they were sent.
+ *
  * @Param hdlr, in, the CoAP context
  * @Param msg, in, the CoAP message
  * @Return duer_status_t, the result
@@ -158,6 +182,15 @@ DUER_INT duer_status_t duer_coap_exec(duer_coap_handler hdlr, duer_u32_t timesta
  */
 DUER_INT duer_status_t duer_coap_release(duer_coap_handler coap);
 
+/*
+ * Set the confirmable requests in flight at most (NSTART of RFC 7252)
+ *
+ * @Param hdlr, in, the CoAP context
+ * @Param nstart, in, 1 to DUER_COAP_NSTART_MAX, DUER_COAP_NSTART by default
+ * @Return duer_status_t, the result
+ */
+DUER_INT duer_status_t duer_coap_set_nstart(duer_coap_handler coap, duer_size_t nstart);
+
 /*
  * Set read timeout
  *
@@ -167,6 +200,14 @@ DUER_INT duer_status_t duer_coap_release(duer_coap_handler coap);
  */
 DUER_INT duer_status_t duer_coap_set_read_timeout(duer_coap_handler coap, duer_u32_t timeout);
 
+/*
+ * Free the buffers of the transport, the connection has been idle
+ *
+ * @Param hdlr, in, the CoAP context
+ * @Return duer_status_t, the result
+ */
+DUER_INT duer_status_t duer_coap_release_idle(duer_coap_handler coap);
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,6 +33,18 @@ DUER_INT_IMPL void duer_nsdl_address_set(sn_nsdl_addr_s* target,
     }
 }
 
+DUER_LOC_IMPL void duer_nsdl_options_init(sn_coap_options_list_s* opt) {
+    DUER_MEMSET(opt, 0, sizeof(sn_coap_options_list_s));
+#if MBED_CLIENT_C_VERSION > 29999
+    opt->max_age = COAP_OPTION_MAX_AGE_DEFAULT;
+    opt->uri_port = COAP_OPTION_URI_PORT_NONE;
+    opt->observe = COAP_OBSERVE_NONE;
+    opt->accept = COAP_CT_NONE;
+    opt->block2 = COAP_OPTION_BLOCK_NONE;
+    opt->block1 = COAP_OPTION_BLOCK_NONE;
+#endif
+}
+
 DUER_INT_IMPL void duer_nsdl_header_set(sn_coap_hdr_s* target,
                                       sn_coap_options_list_s* opt,
                                       const duer_msg_t* source) {
@@ -48,19 +60,13 @@ DUER_INT_IMPL void duer_nsdl_header_set(sn_coap_hdr_s* target,
         target->uri_path_len = source->path_len;
         target->uri_path_ptr = source->path;
 #if MBED_CLIENT_C_VERSION > 29999
-        target->content_format = COAP_CT_NONE;
+        target->content_format = source->content_format > 0
+                                 ? (sn_coap_content_format_e)source->content_format
+                                 : COAP_CT_NONE;
 #endif
 
         if (opt && source->query != NULL && source->query_len > 0) {
-            DUER_MEMSET(opt, 0, sizeof(sn_coap_options_list_s));
-#if MBED_CLIENT_C_VERSION > 29999
-            opt->max_age = COAP_OPTION_MAX_AGE_DEFAULT;
-            opt->uri_port = COAP_OPTION_URI_PORT_NONE;
-            opt->observe = COAP_OBSERVE_NONE;
-            opt->accept = COAP_CT_NONE;
-            opt->block2 = COAP_OPTION_BLOCK_NONE;
-            opt->block1 = COAP_OPTION_BLOCK_NONE;
-#endif
+            duer_nsdl_options_init(opt);
             opt->uri_query_len = source->query_len;
             opt->uri_query_ptr = source->query;
             target->options_list_ptr = opt;
@@ -68,6 +74,38 @@ DUER_INT_IMPL void duer_nsdl_header_set(sn_coap_hdr_s* target,
     }
 }
 
+DUER_INT_IMPL void duer_nsdl_block_set(sn_coap_hdr_s* target, sn_coap_options_list_s* opt,
+                                       duer_s32_t block1, duer_s32_t block2, duer_u32_t size1) {
+    if (!target || (!target->options_list_ptr && !opt)) {
+        return;
+    }
+
+    if (!target->options_list_ptr) {
+        duer_nsdl_options_init(opt);
+        target->options_list_ptr = opt;
+    }
+
+    opt = target->options_list_ptr;
+    opt->block1 = block1 < 0 ? COAP_OPTION_BLOCK_NONE : block1;
+    opt->block2 = block2 < 0 ? COAP_OPTION_BLOCK_NONE : block2;
+    opt->use_size1 = size1 > 0;
+    opt->size1 = size1;
+}
+
+DUER_INT_IMPL duer_s32_t duer_nsdl_block_get(const sn_coap_hdr_s* source, duer_bool block2) {
+    const sn_coap_options_list_s* opt = source ? source->options_list_ptr : NULL;
+
+    if (!opt) {
+        return -1;
+    }
+
+    if (block2) {
+        return opt->block2 == COAP_OPTION_BLOCK_NONE ? -1 : opt->block2;
+    }
+
+    return opt->block1 == COAP_OPTION_BLOCK_NONE ? -1 : opt->block1;
+}
+
 DUER_INT void duer_coap_address_set(duer_addr_t* target,
                                   const sn_nsdl_addr_s* source) {
     if (target && source) {
@@ -91,11 +129,23 @@ DUER_INT void duer_coap_header_set(duer_msg_t* target,
         target->token_len = source->token_len;
         target->path_len = source->uri_path_len;
         target->path = source->uri_path_ptr;
+#if MBED_CLIENT_C_VERSION > 29999
+        target->content_format = source->content_format > 0 ? source->content_format : 0;
+#endif
         sn_coap_options_list_s* opt = source->options_list_ptr;
 
         if (opt != NULL && opt->uri_query_ptr != NULL && opt->uri_query_len > 0) {
             target->query_len = opt->uri_query_len;
             target->query = opt->uri_query_ptr;
         }
+
+        // the block of the response payload, or of the request payload
+        duer_s32_t block = duer_nsdl_block_get(source,
+                                               source->msg_code > COAP_MSG_CODE_REQUEST_DELETE);
+
+        if (block >= 0) {
+            target->block_more = DUER_COAP_BLOCK_MORE(block);
+            target->block_offset = DUER_COAP_BLOCK_OFFSET(block);
+        }
     }
 }
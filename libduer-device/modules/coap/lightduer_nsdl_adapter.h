@@ -51,6 +51,27 @@ DUER_INT void duer_nsdl_header_set(sn_coap_hdr_s* target,
                                  sn_coap_options_list_s* opt,
                                  const duer_msg_t* source);
 
+/*
+ * Set the Block1 and Block2 options of the nsdl CoAP header
+ *
+ * @Param target, in, the nsdl header, set by duer_nsdl_header_set
+ * @Param opt, in, the CoAP options, used if the header has none
+ * @Param block1, in, the Block1 value, (num << 4) | (more << 3) | szx, < 0 if not used
+ * @Param block2, in, the Block2 value, < 0 if not used
+ * @Param size1, in, the Size1 value, the whole payload size, 0 if not used
+ */
+DUER_INT void duer_nsdl_block_set(sn_coap_hdr_s* target, sn_coap_options_list_s* opt,
+                                  duer_s32_t block1, duer_s32_t block2, duer_u32_t size1);
+
+/*
+ * Get the Block1 or Block2 option of the nsdl CoAP header
+ *
+ * @Param source, in, the nsdl header
+ * @Param block2, in, DUER_TRUE for Block2, else Block1
+ * @Return duer_s32_t, the option value, < 0 if not present
+ */
+DUER_INT duer_s32_t duer_nsdl_block_get(const sn_coap_hdr_s* source, duer_bool block2);
+
 /*
  * Set the CoAP address from nsdl
  *
@@ -28,6 +28,7 @@ LOCAL_SRC_FILES := $(wildcard $(MODULE_PATH)/*.c)
 
 LOCAL_STATIC_LIBRARIES := cjson framework coap platform
 
-LOCAL_INCLUDES := $(MODULE_PATH)
+LOCAL_INCLUDES := $(MODULE_PATH) \
+                  $(BASE_DIR)/modules/OTA/Zliblite
 
 include $(BUILD_STATIC_LIB)
@@ -23,6 +23,8 @@
 #include "lightduer_coap_trace.h"
 #include "lightduer_coap.h"
 #include "lightduer_ca_conf.h"
+#include "lightduer_dns.h"
+#include "lightduer_net_trans_encrypted.h"
 #include "lightduer_mutex.h"
 #include "lightduer_memory.h"
 #include "lightduer_log.h"
@@ -211,8 +213,7 @@ DUER_LOC_IMPL duer_status_t duer_engine_coap_handler(duer_context ctx,
 
     return rs;
 }
-//unused function
-/*
+#if defined(DUER_UDP_REPORTER)
 DUER_LOC_IMPL duer_bool baidu_ca_match_address(const duer_addr_t* l,
         const duer_addr_t* r) {
     if (l) {
@@ -233,7 +234,7 @@ DUER_LOC_IMPL duer_bool baidu_ca_match_address(const duer_addr_t* l,
 
     return DUER_FALSE;
 }
-*/
+#endif
 
 #if defined(DUER_LWM2M_REGISTER)
 DUER_LOC_IMPL duer_status_t baidu_ca_register(baidu_ca_t* ctx)
@@ -631,6 +632,9 @@ DUER_EXT_IMPL duer_status_t baidu_ca_load_configuration(duer_handler hdlr, const
     }
     addr_len = DUER_STRLEN(addr);
 
+    // resolved in background while starting, the connect finds it cached
+    duer_dns_prefetch(addr);
+
 #if defined(DUER_LWM2M_REGISTER)
     ctx->addr_reg.host = addr;
     ctx->addr_reg.host_size = addr_len;
@@ -898,11 +902,34 @@ exit:
     return rs;
 }
 
+#if defined(DUER_UDP_REPORTER)
+/*
+ * Merge the results of reading the two contexts: an error of either one
+ * is reported, else more is pending if either one made progress.
+ */
+DUER_LOC_IMPL duer_status_t baidu_ca_merge_available(duer_status_t sr, duer_status_t rpt)
+{
+    if (sr < DUER_OK && sr != DUER_ERR_TRANS_WOULD_BLOCK) {
+        return sr;
+    }
+
+    if (rpt < DUER_OK && rpt != DUER_ERR_TRANS_WOULD_BLOCK) {
+        return rpt;
+    }
+
+    return sr >= DUER_OK ? sr : rpt;
+}
+#endif
+
 DUER_EXT_IMPL duer_status_t baidu_ca_data_available(duer_handler hdlr,
                                                     const duer_addr_t* addr)
 {
     baidu_ca_t* ctx = (baidu_ca_t*)hdlr;
     duer_status_t rs = DUER_ERR_FAILED;
+#if defined(DUER_UDP_REPORTER)
+    duer_status_t rpt = DUER_ERR_FAILED;
+    duer_bool sr_read = DUER_FALSE;
+#endif
     DUER_LOGV("==> baidu_ca_data_available");
 
     if (ctx->state >= DUER_ST_SR_INITIALIZED
@@ -912,6 +939,9 @@ DUER_EXT_IMPL duer_status_t baidu_ca_data_available(duer_handler hdlr,
        ) {
         DUER_LOGV("    ctx->sr matched: %p", addr);
         rs = duer_coap_data_available(ctx->sr);
+#if defined(DUER_UDP_REPORTER)
+        sr_read = DUER_TRUE;
+#endif
     }
 
 #if defined(DUER_UDP_REPORTER)
@@ -920,8 +950,10 @@ DUER_EXT_IMPL duer_status_t baidu_ca_data_available(duer_handler hdlr,
                                                   || baidu_ca_match_address(&(ctx->addr_rpt), addr))) {
         duer_mutex_lock(ctx->mutex);
         DUER_LOGV("    ctx->rpt matched: %p", addr);
-        rs = duer_coap_data_available(ctx->rpt);
+        rpt = duer_coap_data_available(ctx->rpt);
         duer_mutex_unlock(ctx->mutex);
+        // the caller reads again until would block, don't hide the progress of sr
+        rs = sr_read ? baidu_ca_merge_available(rs, rpt) : rpt;
     }
 
 #endif
@@ -938,6 +970,24 @@ DUER_EXT_IMPL duer_status_t baidu_ca_data_available(duer_handler hdlr,
     return rs;
 }
 
+DUER_EXT_IMPL duer_status_t baidu_ca_release_idle(duer_handler hdlr)
+{
+    baidu_ca_t* ctx = (baidu_ca_t*)hdlr;
+
+    if (ctx == NULL || ctx->state < DUER_ST_STARTED) {
+        return DUER_ERR_FAILED;
+    }
+
+    duer_coap_release_idle(ctx->sr);
+#if defined(DUER_UDP_REPORTER)
+    duer_mutex_lock(ctx->mutex);
+    duer_coap_release_idle(ctx->rpt);
+    duer_mutex_unlock(ctx->mutex);
+#endif
+
+    return DUER_OK;
+}
+
 DUER_EXT duer_status_t baidu_ca_exec(duer_handler hdlr)
 {
     baidu_ca_t* ctx = (baidu_ca_t*)hdlr;
@@ -1008,6 +1058,7 @@ DUER_EXT_IMPL duer_status_t baidu_ca_release(duer_handler hdlr)
         }
 
         baidu_ca_stop(ctx);
+        duer_trans_encrypted_free_configs();
 
         if (ctx->report_query) {
             DUER_FREE(ctx->report_query);
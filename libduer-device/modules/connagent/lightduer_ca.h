@@ -149,6 +149,14 @@ DUER_EXT duer_status_t baidu_ca_send_data(duer_handler hdlr,
 DUER_EXT duer_status_t baidu_ca_data_available(duer_handler hdlr,
                                                const duer_addr_t* addr);
 
+/*
+ * Free the transport buffers while nothing is sent or received
+ *
+ * @Param hdlr, in, the handler will be operated
+ * @Return duer_status_t, in, the operation result
+ */
+DUER_EXT duer_status_t baidu_ca_release_idle(duer_handler hdlr);
+
 /*
  * Execute the cached CoAP data, such as blockwise, resending...
  *
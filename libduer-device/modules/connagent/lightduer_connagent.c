@@ -42,6 +42,7 @@ static duer_event_callback g_event_callback = NULL;
 static duer_events_handler g_events_handler = NULL;
 
 static int duer_events_call_internal(duer_events_func func, int what, void *object);
+static int duer_events_call_urgent(duer_events_func func, int what, void *object);
 
 static char* g_event_name[] = {
     "DUER_EVT_CREATE",
@@ -87,7 +88,7 @@ static void duer_engine_notify_callback(int event, int status, int what, void *o
         } else if (status == DUER_ERR_TRANS_WOULD_BLOCK) {
             DUER_LOGI("will start latter(DUER_ERR_TRANS_WOULD_BLOCK)");
         } else if (status == DUER_ERR_CONNECT_TIMEOUT) {
-            int rs = duer_events_call_internal(duer_engine_start, 0, NULL);
+            int rs = duer_events_call_urgent(duer_engine_start, 0, NULL);
             if (rs != DUER_OK) {
                 DUER_LOGW("retry connect fail!!");
             }
@@ -163,6 +164,32 @@ static int duer_events_call_internal(duer_events_func func, int what, void *obje
     return DUER_ERR_FAILED;
 }
 
+/*
+ * For the connection control and the responses,
+ * they shouldn't wait behind the queued data sending.
+ */
+static int duer_events_call_urgent(duer_events_func func, int what, void *object)
+{
+    if (g_events_handler) {
+        return duer_events_call_with_priority(g_events_handler, DUER_EVENTS_PRIORITY_URGENT,
+                                              func, what, object);
+    }
+    return DUER_ERR_FAILED;
+}
+
+/*
+ * For the send and the data available, the handler drains until would block,
+ * so the calls while one is pending could be folded.
+ */
+static int duer_events_call_coalesced_internal(duer_events_priority_t priority,
+                                               duer_events_func func)
+{
+    if (g_events_handler) {
+        return duer_events_call_coalesced(g_events_handler, priority, func, 0, NULL);
+    }
+    return DUER_ERR_FAILED;
+}
+
 void duer_initialize()
 {
     baidu_ca_adapter_initialize();
@@ -195,7 +222,7 @@ int duer_start(const void *data, size_t size)
     }
     DUER_MEMCPY(profile, data, size);
     DUER_LOGD("use the profile to start engine");
-    int rs = duer_events_call_internal(duer_engine_start, (int)size, profile);
+    int rs = duer_events_call_urgent(duer_engine_start, (int)size, profile);
     if (rs != DUER_OK) {
         DUER_FREE(profile);
     }
@@ -275,7 +302,13 @@ add_fail:
 
 int duer_data_send(void)
 {
-    return duer_events_call_internal(duer_engine_send, 0, NULL);
+    return duer_events_call_coalesced_internal(DUER_EVENTS_PRIORITY_NORMAL, duer_engine_send);
+}
+
+int duer_data_idle(void)
+{
+    return duer_events_call_coalesced_internal(DUER_EVENTS_PRIORITY_NORMAL,
+                                               duer_engine_release_idle);
 }
 
 int duer_data_report(const baidu_json *data)
@@ -287,23 +320,43 @@ int duer_data_report(const baidu_json *data)
     return rs;
 }
 
+int duer_set_report_batch(duer_u32_t linger, duer_size_t max_bytes)
+{
+    int rs = duer_engine_set_report_batch(linger, max_bytes);
+    // the open batch is closed when disabled
+    if (rs == DUER_OK && linger == 0 && duer_engine_qcache_length() > 0) {
+        duer_data_send();
+    }
+    return rs;
+}
+
+int duer_set_report_deflate(duer_bool enable)
+{
+#ifdef DUER_REPORT_DEFLATE
+    return duer_events_call_internal(duer_engine_set_report_deflate, enable, NULL);
+#else
+    return DUER_ERR_FAILED;
+#endif
+}
+
 int duer_response(const duer_msg_t *msg, int msg_code, const void *data, duer_size_t size)
 {
     int rs = duer_engine_enqueue_response(msg, msg_code, data, size);
     if (rs == DUER_OK) {
-        duer_data_send();
+        duer_events_call_coalesced_internal(DUER_EVENTS_PRIORITY_URGENT, duer_engine_send);
     }
     return rs;
 }
 
 int duer_data_available()
 {
-    return duer_events_call_internal(duer_engine_data_available, 0, NULL);
+    return duer_events_call_coalesced_internal(DUER_EVENTS_PRIORITY_URGENT,
+                                               duer_engine_data_available);
 }
 
 int duer_stop()
 {
-    return duer_events_call_internal(duer_engine_stop, 0, NULL);
+    return duer_events_call_urgent(duer_engine_stop, 0, NULL);
 }
 
 int duer_finalize(void)
@@ -88,10 +88,36 @@ int duer_data_available(void);
  * Send data to server.
  *
  * @param data, const baidu_json *, the data point values.
- * @return int, the report data result, success return DUER_OK, failed return DUER_ERR_FAILED.
+ * @return int, the report data result, success return DUER_OK,
+ *              DUER_ERR_TRANS_WOULD_BLOCK if too many data waiting to send, retry later,
+ *              failed return DUER_ERR_FAILED.
  */
 int duer_data_report(const baidu_json *data);
 
+/**
+ * Batch the reports into one message, for the products reporting many small data.
+ * The reports within the linger are sent together as {"data":[...]},
+ * in the order reported, a report alone is sent as before.
+ *
+ * @param linger, duer_u32_t, the milliseconds a report waits for the following ones,
+ *                0 to disable (the default).
+ * @param max_bytes, duer_size_t, the payload of one message at most.
+ * @return int, success return DUER_OK,
+ *              DUER_ERR_INVALID_PARAMETER if the linger set but the max_bytes is 0.
+ */
+int duer_set_report_batch(duer_u32_t linger, duer_size_t max_bytes);
+
+/**
+ * Compress the report payloads by deflate with a dictionary of the DCS events,
+ * sent with the Content-Format 65001, see lightduer_report_deflate.h.
+ * A payload not compressed smaller is sent as is.
+ *
+ * @param enable, duer_bool, DUER_TRUE to compress, DUER_FALSE (the default) not.
+ * @return int, success return DUER_OK,
+ *              failed return DUER_ERR_FAILED, or built without DUER_REPORT_DEFLATE.
+ */
+int duer_set_report_deflate(duer_bool enable);
+
 /**
  * Response the request from Origin Server.
  *
@@ -99,7 +125,9 @@ int duer_data_report(const baidu_json *data);
  * @param msg_code, int, the message code, see in @{link duer_msg_code_e}.
  * @param data, const void *, the payload data.
  * @param size, size_t, the payload size.
- * @return int, the send response result, success return DUER_OK, failed return DUER_ERR_FAILED.
+ * @return int, the send response result, success return DUER_OK,
+ *              DUER_ERR_TRANS_WOULD_BLOCK if too many data waiting to send,
+ *              failed return DUER_ERR_FAILED.
  */
 int duer_response(const duer_msg_t *msg, int msg_code, const void *data, duer_size_t size);
 
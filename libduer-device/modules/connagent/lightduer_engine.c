@@ -22,13 +22,15 @@
 #include "lightduer_engine.h"
 #include "lightduer_log.h"
 #include "lightduer_timers.h"
-#include "lightduer_queue_cache.h"
+#include "lightduer_ring_cache.h"
 #include "lightduer_connagent.h"
 #include "lightduer_ca.h"
 #include "lightduer_memory.h"
 #include "lightduer_mutex.h"
+#include "lightduer_report_deflate.h"
 
 extern int duer_data_send(void);
+extern int duer_data_idle(void);
 static void duer_engine_notify(int event, int status, int what, void *object);
 static void duer_engine_clear_data(void);
 
@@ -38,12 +40,63 @@ static duer_handler g_handler = NULL;
 static duer_engine_notify_func g_notify_func = NULL;
 static duer_timer_handler g_timer = NULL;
 
-static duer_qcache_handler g_qcache_handler = NULL;
+/*
+ * The messages waiting to send, it's bounded so a disconnected device won't
+ * run out of memory, the report returns DUER_ERR_TRANS_WOULD_BLOCK when full.
+ */
+#ifndef DUER_ENGINE_QCACHE_CAPACITY
+#define DUER_ENGINE_QCACHE_CAPACITY (32)
+#endif
+
+/*
+ * The responses waiting to send, they are sent ahead of the reports
+ * so a directive isn't answered behind the voice upload.
+ */
+#ifndef DUER_ENGINE_RESPONSE_CAPACITY
+#define DUER_ENGINE_RESPONSE_CAPACITY   (8)
+#endif
+
+static duer_rcache_handler g_qcache_handler = NULL;
+static duer_rcache_handler g_response_handler = NULL;
+// the queue whose first message would block, it's sent again before any other
+static duer_rcache_handler g_blocked = NULL;
 static duer_mutex_t g_qcache_mutex = NULL;
 
+/*
+ * The reports batched into one message, off until duer_engine_set_report_batch.
+ * The last report queued stays open for the linger, the following reports are
+ * merged into its payload as {"data":[...]} until it reaches the bytes, and
+ * it's not sent while open. A report alone is still sent as {"data":...}.
+ */
+#define DUER_ENGINE_BATCH_HEAD      "{\"data\":"
+
+static duer_timer_handler g_batch_timer = NULL;
+static duer_u32_t g_batch_linger = 0;
+static duer_size_t g_batch_bytes = 0;
+static duer_msg_t *g_batch = NULL;      // the open batch, guarded by g_qcache_mutex
+static duer_size_t g_batch_count = 0;
+
+#ifdef DUER_REPORT_DEFLATE
+/*
+ * The report payloads compressed before sent, off until duer_engine_set_report_deflate,
+ * only touched in the engine's events.
+ */
+static duer_bool g_deflate = DUER_FALSE;
+#endif
+
 #define DUER_KEEPALIVE_INTERVAL (55 * 1000)
 #define DUER_START_TIMEOUT (1 * 1000)
 
+/*
+ * The transport buffers are freed when nothing is sent or received for the
+ * interval, restarted by each send and receive.
+ */
+#ifndef DUER_ENGINE_IDLE_INTERVAL
+#define DUER_ENGINE_IDLE_INTERVAL (1 * 1000)
+#endif
+
+static duer_timer_handler g_idle_timer = NULL;
+
 static void duer_timer_expired(void *param)
 {
     //TODO(leliang) should move the complicated operations out here.
@@ -63,6 +116,28 @@ static void duer_timer_expired(void *param)
     }
 }
 
+static void duer_batch_expired(void *param)
+{
+    duer_mutex_lock(g_qcache_mutex);
+    g_batch = NULL;
+    duer_mutex_unlock(g_qcache_mutex);
+
+    duer_data_send();
+}
+
+static void duer_idle_expired(void *param)
+{
+    // run the release in the engine's events, with the send and receive
+    duer_data_idle();
+}
+
+static void duer_engine_restart_idle(void)
+{
+    if (g_idle_timer != NULL) {
+        duer_timer_start(g_idle_timer, DUER_ENGINE_IDLE_INTERVAL);
+    }
+}
+
 static void duer_engine_notify(int event, int status, int what, void *object)
 {
     if (g_notify_func) {
@@ -114,7 +189,12 @@ void duer_engine_create(int what, void *object)
         g_handler = baidu_ca_acquire(duer_transport_notify);
     }
     if (g_qcache_handler == NULL) {
-        g_qcache_handler = duer_qcache_create();
+        g_qcache_handler = duer_rcache_create(DUER_ENGINE_QCACHE_CAPACITY,
+                                              DUER_RCACHE_REJECT, NULL);
+    }
+    if (g_response_handler == NULL) {
+        g_response_handler = duer_rcache_create(DUER_ENGINE_RESPONSE_CAPACITY,
+                                                DUER_RCACHE_REJECT, NULL);
     }
     if (g_qcache_mutex == NULL) {
         if ((g_qcache_mutex = duer_mutex_create()) == NULL) {
@@ -124,6 +204,12 @@ void duer_engine_create(int what, void *object)
     if (g_timer == NULL) {
         g_timer = duer_timer_acquire(duer_timer_expired, NULL, DUER_TIMER_ONCE);
     }
+    if (g_batch_timer == NULL) {
+        g_batch_timer = duer_timer_acquire(duer_batch_expired, NULL, DUER_TIMER_ONCE);
+    }
+    if (g_idle_timer == NULL) {
+        g_idle_timer = duer_timer_acquire(duer_idle_expired, NULL, DUER_TIMER_ONCE);
+    }
     // now this message will notity twice, see duer_initialize and duer_engine_start
     // TODO need fix this
     DUER_NOTIFY_ONLY(DUER_EVT_CREATE, DUER_OK);
@@ -168,6 +254,8 @@ void duer_engine_start(int what, void *object)
 
     if (g_timer != NULL) {
         if (status == DUER_OK) {
+            // the connect may need several rounds, don't carry the backoff to the next start
+            start_timeout = DUER_START_TIMEOUT;
             duer_timer_start(g_timer, DUER_KEEPALIVE_INTERVAL);
         } else if (status == DUER_ERR_TRANS_WOULD_BLOCK) {
             duer_timer_start(g_timer, start_timeout);
@@ -205,7 +293,11 @@ void duer_engine_data_available(int what, void *object)
 
         is_started = baidu_ca_is_started(g_handler);
 
-        rs = baidu_ca_data_available(g_handler, NULL);
+        // the calls are coalesced, so read all the received data until would block
+        do {
+            rs = baidu_ca_data_available(g_handler, NULL);
+        } while (is_started == DUER_TRUE && rs >= DUER_OK);
+
         if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
             status = DUER_ERR_TRANS_WOULD_BLOCK;
         } else if (rs < DUER_OK) {
@@ -214,6 +306,7 @@ void duer_engine_data_available(int what, void *object)
     } while (0);
 
     if (is_started == DUER_TRUE) {
+        duer_engine_restart_idle();
         DUER_NOTIFY_ONLY(DUER_EVT_DATA_AVAILABLE, status);
     } else {
         if (status == DUER_OK && g_timer != NULL) {
@@ -249,18 +342,120 @@ void duer_engine_clear_data()
     duer_msg_t *msg;
 
     duer_mutex_lock(g_qcache_mutex);
-    while ((msg = duer_qcache_pop(g_qcache_handler)) != NULL) {
+    g_batch = NULL;
+    g_blocked = NULL;
+    while ((msg = duer_rcache_pop(g_response_handler)) != NULL) {
+        duer_engine_release_data(msg);
+    }
+    while ((msg = duer_rcache_pop(g_qcache_handler)) != NULL) {
         duer_engine_release_data(msg);
     }
     duer_mutex_unlock(g_qcache_mutex);
 }
 
+/*
+ * Merge the report into the open batch, called with g_qcache_mutex locked,
+ * {"data":X} + {"data":Y} => {"data":[X,Y]}, {"data":[X,Y]} + {"data":Z} => {"data":[X,Y,Z]}
+ *
+ * @Param content, const char *, the report printed as {"data":...}
+ * @Param len, duer_size_t, the length of the content
+ * @Return int, DUER_OK if merged, DUER_ERR_FAILED if it would exceed the bytes
+ */
+static int duer_engine_batch_append(const char *content, duer_size_t len)
+{
+    const duer_size_t head = sizeof(DUER_ENGINE_BATCH_HEAD) - 1;
+    duer_size_t size = g_batch->payload_len;
+    duer_size_t data_len = len - head - 1;
+    duer_size_t grown = size + data_len + (g_batch_count == 1 ? 3 : 1);
+    char *payload = NULL;
+
+    if (len <= head + 1 || grown > g_batch_bytes) {
+        return DUER_ERR_FAILED;
+    }
+
+    payload = (char *)DUER_REALLOC(g_batch->payload, grown + 1);
+    if (payload == NULL) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    if (g_batch_count == 1) {
+        DUER_MEMMOVE(payload + head + 1, payload + head, size - head - 1);
+        payload[head] = '[';
+    } else {
+        size -= 2;  // the "]}"
+    }
+
+    payload[size++] = ',';
+    DUER_MEMCPY(payload + size, content + head, data_len);
+    size += data_len;
+    payload[size++] = ']';
+    payload[size++] = '}';
+    payload[size] = '\0';
+
+    g_batch->payload = (duer_u8_t *)payload;
+    g_batch->payload_len = size;
+    g_batch_count++;
+
+    return DUER_OK;
+}
+
+/*
+ * Merge the report into the open batch if any, the batch is closed
+ * if the report doesn't fit, so the report will open the next one.
+ *
+ * @Param closed, duer_bool *, out, set if the open batch is closed, the
+ *        caller should send it, its linger timer is stopped
+ * @Return int, DUER_OK if merged
+ */
+static int duer_engine_batch_merge(const char *content, duer_size_t len, duer_bool *closed)
+{
+    int rs = DUER_ERR_FAILED;
+
+    *closed = DUER_FALSE;
+
+    duer_mutex_lock(g_qcache_mutex);
+    if (g_batch != NULL) {
+        rs = duer_engine_batch_append(content, len);
+        if (rs != DUER_OK) {
+            g_batch = NULL;
+            *closed = DUER_TRUE;
+        }
+    }
+    duer_mutex_unlock(g_qcache_mutex);
+
+    if (*closed && g_batch_timer != NULL) {
+        duer_timer_stop(g_batch_timer);
+    }
+
+    return rs;
+}
+
+int duer_engine_set_report_batch(duer_u32_t linger, duer_size_t bytes)
+{
+    if (linger > 0 && bytes == 0) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    duer_mutex_lock(g_qcache_mutex);
+    g_batch_linger = linger;
+    g_batch_bytes = bytes;
+    if (linger == 0) {
+        g_batch = NULL;
+    }
+    duer_mutex_unlock(g_qcache_mutex);
+
+    return DUER_OK;
+}
+
 int duer_engine_enqueue_report_data(const baidu_json *data)
 {
     int rs = DUER_ERR_INVALID_PARAMETER;
     char *content = NULL;
+    duer_size_t content_len = 0;
     baidu_json *payload = NULL;
     duer_msg_t *msg = NULL;
+    duer_bool opened = DUER_FALSE;
+    duer_bool closed = DUER_FALSE;
 
     do {
         if (data == NULL || g_qcache_handler == NULL || g_handler == NULL) {
@@ -277,6 +472,18 @@ int duer_engine_enqueue_report_data(const baidu_json *data)
         content = baidu_json_PrintUnformatted(payload);
         DUER_LOGD("enqueue content:%s", content);
         baidu_json_Delete(payload);
+        if (content == NULL) {
+            rs = DUER_ERR_MEMORY_OVERLOW;
+            break;
+        }
+        content_len = DUER_STRLEN(content);
+
+        if (duer_engine_batch_merge(content, content_len, &closed) == DUER_OK) {
+            baidu_json_release(content);
+            content = NULL;
+            rs = DUER_OK;
+            break;
+        }
 
         msg = baidu_ca_build_report_message(g_handler, DUER_FALSE);
         if (msg == NULL) {
@@ -285,15 +492,35 @@ int duer_engine_enqueue_report_data(const baidu_json *data)
         }
 
         msg->payload = (duer_u8_t*)content;
-        msg->payload_len = DUER_STRLEN(content);
+        msg->payload_len = content_len;
 
         duer_mutex_lock(g_qcache_mutex);
-        rs = duer_qcache_push(g_qcache_handler, msg);
+        rs = duer_rcache_push(g_qcache_handler, msg);
+        if (rs == DUER_OK && g_batch_linger > 0 && g_batch_timer != NULL
+                && content_len < g_batch_bytes) {
+            g_batch = msg;
+            g_batch_count = 1;
+            opened = DUER_TRUE;
+        }
         duer_mutex_unlock(g_qcache_mutex);
+
+        if (opened) {
+            duer_timer_start(g_batch_timer, g_batch_linger);
+        }
     } while (0);
 
-    if (rs < 0) {
+    if (closed) {
+        // nothing else sends the closed batch, the caller only sends the first one queued
+        duer_data_send();
+    }
+
+    if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+        DUER_LOGW("Report queue is full(%d), try later", DUER_ENGINE_QCACHE_CAPACITY);
+    } else if (rs < 0) {
         DUER_LOGE("Report failed: rs = %d", rs);
+    }
+
+    if (rs < 0) {
         if (msg) {
             duer_engine_release_data(msg);
         } else if (content) {
@@ -311,7 +538,7 @@ int duer_engine_enqueue_response(const duer_msg_t *req, int msg_code, const void
     duer_msg_t *msg = NULL;
 
     do {
-        if (req == NULL || g_handler == NULL) {
+        if (req == NULL || g_handler == NULL || g_response_handler == NULL) {
             break;
         }
 
@@ -334,12 +561,17 @@ int duer_engine_enqueue_response(const duer_msg_t *req, int msg_code, const void
         msg->payload_len = size;
 
         duer_mutex_lock(g_qcache_mutex);
-        rs = duer_qcache_push(g_qcache_handler, msg);
+        rs = duer_rcache_push(g_response_handler, msg);
         duer_mutex_unlock(g_qcache_mutex);
     } while (0);
 
-    if (rs < 0) {
+    if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+        DUER_LOGW("Response queue is full(%d), try later", DUER_ENGINE_RESPONSE_CAPACITY);
+    } else if (rs < 0) {
         DUER_LOGE("Response failed: rs = %d", rs);
+    }
+
+    if (rs < 0) {
         if (msg) {
             duer_engine_release_data(msg);
         } else if (content) {
@@ -350,10 +582,45 @@ int duer_engine_enqueue_response(const duer_msg_t *req, int msg_code, const void
     return rs;
 }
 
+#ifdef DUER_REPORT_DEFLATE
+void duer_engine_set_report_deflate(int what, void *object)
+{
+    if (what) {
+        g_deflate = duer_report_deflate_init() == DUER_OK;
+    } else {
+        g_deflate = DUER_FALSE;
+        duer_report_deflate_release();
+    }
+}
+
+/*
+ * Compress the report not sent yet, it's kept as is if not smaller
+ */
+static void duer_engine_deflate_data(duer_msg_t *msg)
+{
+    duer_u8_t *data = NULL;
+    duer_size_t size = 0;
+
+    if (!g_deflate || DUER_MESSAGE_IS_RESPONSE(msg->msg_code)
+            || msg->content_format != 0 || msg->payload == NULL) {
+        return;
+    }
+
+    if (duer_report_deflate(msg->payload, msg->payload_len, &data, &size) == DUER_OK) {
+        DUER_LOGD("report deflated: %d => %d", msg->payload_len, size);
+        baidu_json_release(msg->payload);
+        msg->payload = data;
+        msg->payload_len = size;
+        msg->content_format = DUER_CT_JSON_DEFLATE_DICT;
+    }
+}
+#endif
+
 void duer_engine_send(int what, void *object)
 {
     duer_status_t rs = DUER_OK;
     int status = DUER_OK;
+    duer_rcache_handler queue = NULL;
     duer_msg_t *msg = NULL;
 
     do {
@@ -366,33 +633,75 @@ void duer_engine_send(int what, void *object)
             duer_timer_stop(g_timer);
         }
 
-        duer_mutex_lock(g_qcache_mutex);
-        msg = duer_qcache_top(g_qcache_handler);
-        duer_mutex_unlock(g_qcache_mutex);
-        if (msg == NULL) {
-            break;
-        }
-
-        rs = baidu_ca_send_data(g_handler, msg, NULL);
-        if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
-            status = DUER_ERR_TRANS_WOULD_BLOCK;
-        } else if (rs < DUER_OK) {
-            status = DUER_ERR_FAILED;
-        } else {
-            if (g_timer != NULL) {
-                duer_timer_start(g_timer, DUER_KEEPALIVE_INTERVAL);
-            }
-            DUER_LOGI("data sent: %s", DUER_STRING_OUTPUT((const char *)msg->payload));
-            duer_engine_release_data(msg);
+        // the calls are coalesced, so send all the queued data until would block,
+        // the responses first, but the message blocked is finished before any other,
+        // the transport has kept the part of it not sent
+        while (status == DUER_OK) {
             duer_mutex_lock(g_qcache_mutex);
-            duer_qcache_pop(g_qcache_handler);
+            queue = g_blocked;
+            if (queue == NULL) {
+                queue = duer_rcache_length(g_response_handler) > 0
+                        ? g_response_handler : g_qcache_handler;
+            }
+            msg = duer_rcache_top(queue);
+            if (msg == g_batch) {
+                // still open, sent when closed
+                msg = NULL;
+            }
             duer_mutex_unlock(g_qcache_mutex);
+            if (msg == NULL) {
+                break;
+            }
+
+#ifdef DUER_REPORT_DEFLATE
+            duer_engine_deflate_data(msg);
+#endif
+            rs = baidu_ca_send_data(g_handler, msg, NULL);
+            g_blocked = rs == DUER_ERR_TRANS_WOULD_BLOCK ? queue : NULL;
+            if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+                status = DUER_ERR_TRANS_WOULD_BLOCK;
+            } else if (rs < DUER_OK) {
+                status = DUER_ERR_FAILED;
+            } else {
+                if (g_timer != NULL) {
+                    duer_timer_start(g_timer, DUER_KEEPALIVE_INTERVAL);
+                }
+                if (msg->content_format == 0) {
+                    DUER_LOGI("data sent: %s", DUER_STRING_OUTPUT((const char *)msg->payload));
+                } else {
+                    DUER_LOGI("data sent: %d bytes, format %d", msg->payload_len,
+                              msg->content_format);
+                }
+                duer_engine_release_data(msg);
+                duer_mutex_lock(g_qcache_mutex);
+                duer_rcache_pop(queue);
+                duer_mutex_unlock(g_qcache_mutex);
+            }
         }
+
+        duer_engine_restart_idle();
     } while (0);
 
     duer_engine_notify(DUER_EVT_SEND_DATA, status, what, object);
 }
 
+void duer_engine_release_idle(int what, void *object)
+{
+    int len = 0;
+
+    if (!baidu_ca_is_started(g_handler)) {
+        return;
+    }
+
+    duer_mutex_lock(g_qcache_mutex);
+    len = duer_rcache_length(g_qcache_handler) + duer_rcache_length(g_response_handler);
+    duer_mutex_unlock(g_qcache_mutex);
+
+    if (len == 0) {
+        baidu_ca_release_idle(g_handler);
+    }
+}
+
 void duer_engine_stop(int what, void *object)
 {
     duer_status_t rs = DUER_OK;
@@ -422,12 +731,22 @@ void duer_engine_destroy(int what, void *object)
         duer_timer_release(g_timer);
         g_timer = NULL;
     }
+    if (g_batch_timer != NULL) {
+        duer_timer_release(g_batch_timer);
+        g_batch_timer = NULL;
+    }
+    if (g_idle_timer != NULL) {
+        duer_timer_release(g_idle_timer);
+        g_idle_timer = NULL;
+    }
     if (g_qcache_handler != NULL) {
         duer_engine_clear_data();
         duer_mutex_lock(g_qcache_mutex);
-        duer_qcache_destroy(g_qcache_handler);
+        duer_rcache_destroy(g_qcache_handler);
+        duer_rcache_destroy(g_response_handler);
         duer_mutex_unlock(g_qcache_mutex);
         g_qcache_handler = NULL;
+        g_response_handler = NULL;
     }
     if (g_qcache_mutex != NULL) {
         duer_mutex_destroy(g_qcache_mutex);
@@ -437,6 +756,9 @@ void duer_engine_destroy(int what, void *object)
         baidu_ca_release(g_handler);
         g_handler = NULL;
     }
+#ifdef DUER_REPORT_DEFLATE
+    duer_engine_set_report_deflate(DUER_FALSE, NULL);
+#endif
 
     DUER_NOTIFY_ONLY(DUER_EVT_DESTROY, DUER_OK);
 }
@@ -450,7 +772,11 @@ int duer_engine_qcache_length()
     }
 
     duer_mutex_lock(g_qcache_mutex);
-    len =  duer_qcache_length(g_qcache_handler);
+    len =  duer_rcache_length(g_qcache_handler);
+    if (g_batch != NULL) {
+        // the open batch is not ready to send
+        len--;
+    }
     duer_mutex_unlock(g_qcache_mutex);
 
     return len;
@@ -54,8 +54,32 @@ void duer_engine_data_available(int what, void *object);
 
 int duer_engine_enqueue_report_data(const baidu_json *data);
 
+/*
+ * Batch the reports queued within the linger into one message
+ *
+ * @Param linger, duer_u32_t, the milliseconds a report waits for the following ones, 0 to disable
+ * @Param bytes, duer_size_t, the payload of one batch at most
+ * @Return int, DUER_OK on success, DUER_ERR_INVALID_PARAMETER if the bytes is 0
+ */
+int duer_engine_set_report_batch(duer_u32_t linger, duer_size_t bytes);
+
+#ifdef DUER_REPORT_DEFLATE
+/*
+ * Compress the report payloads or not, called in the engine's events
+ *
+ * @Param what, int, non zero to compress
+ */
+void duer_engine_set_report_deflate(int what, void *object);
+#endif
+
 void duer_engine_send(int what, void *object);
 
+/*
+ * Free the transport buffers if nothing is queued, called in the engine's
+ * events when the connection has been idle
+ */
+void duer_engine_release_idle(int what, void *object);
+
 void duer_engine_stop(int what, void *object);
 
 void duer_engine_destroy(int what, void *object);
@@ -0,0 +1,261 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_report_deflate.c
+ * Desc: The report payloads compressed by the raw deflate with a preset dictionary.
+ */
+
+#ifdef DUER_REPORT_DEFLATE
+
+#include "lightduer_report_deflate.h"
+#include "zlib.h"
+#include "lightduer_lib.h"
+#include "lightduer_log.h"
+#include "lightduer_memory.h"
+
+/*
+ * The deflate takes (1 << (wbits + 2)) + (1 << (mem_level + 9)) bytes,
+ * 16KB + 8KB by default. The window should hold the dictionary and
+ * a payload with the client context, the matches reach back the window
+ * less 262 bytes.
+ */
+#ifndef DUER_REPORT_DEFLATE_WBITS
+#define DUER_REPORT_DEFLATE_WBITS       (12)
+#endif
+
+#ifndef DUER_REPORT_DEFLATE_MEM_LEVEL
+#define DUER_REPORT_DEFLATE_MEM_LEVEL   (4)
+#endif
+
+#ifndef DUER_REPORT_DEFLATE_LEVEL
+#define DUER_REPORT_DEFLATE_LEVEL       (6)
+#endif
+
+// the receiver takes the largest window, any sender's window is fine
+#define DUER_REPORT_INFLATE_WBITS       (15)
+
+/*
+ * The dictionary, as the engine prints the DCS events.
+ * The strings most used are at the end, so the distances to them are short.
+ */
+static const char s_dictionary[] =
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.system\","
+    "\"name\":\"ExceptionEncountered\"},\"payload\":{\"unparsedDirective\":\"\","
+    "\"error\":{\"type\":\"UNEXPECTED_INFORMATION_RECEIVED\",\"message\":\"\"}}}"
+    "\"UNSUPPORTED_OPERATION\"\"INTERNAL_ERROR\""
+    "\"name\":\"UserInactivityReport\"},\"payload\":{\"inactiveTimeInSeconds\":"
+    "\"name\":\"SynchronizeState\"},\"payload\":{}}"
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.alerts\","
+    "\"name\":\"SetAlertSucceeded\"\"SetAlertFailed\"\"DeleteAlertSucceeded\""
+    "\"DeleteAlertFailed\"\"AlertStarted\"\"AlertStopped\""
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.playback_controller\","
+    "\"name\":\"PlayCommandIssued\"\"PauseCommandIssued\"\"NextCommandIssued\""
+    "\"PreviousCommandIssued\""
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.speaker_controller\","
+    "\"name\":\"VolumeChanged\"\"MuteChanged\"},\"payload\":{\"volume\":50,\"mute\":false}}"
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_output\","
+    "\"name\":\"SpeechStarted\"\"SpeechFinished\""
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.audio_player\","
+    "\"name\":\"PlaybackStarted\"\"PlaybackFinished\"\"PlaybackNearlyFinished\""
+    "\"PlaybackStopped\"\"PlaybackPaused\"\"PlaybackResumed\"\"PlaybackQueueCleared\""
+    "\"PLAYING\"\"PAUSED\"\"STOPPED\"\"BUFFER_UNDERRUN\""
+    "\"name\":\"ListenTimedOut\"},\"payload\":{}}}}"
+    "{\"data\":{\"clientContext\":["
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.alerts\","
+    "\"name\":\"AlertsState\"},\"payload\":{\"allAlerts\":{}}},"
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.audio_player\","
+    "\"name\":\"PlaybackState\"},\"payload\":{\"token\":\"\",\"offsetInMilliseconds\":0,"
+    "\"playerActivity\":\"FINISHED\"}},"
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.speaker_controller\","
+    "\"name\":\"VolumeState\"},\"payload\":{\"volume\":50,\"muted\":false}},"
+    "{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_output\","
+    "\"name\":\"SpeechState\"},\"payload\":{\"token\":\"\",\"offsetInMilliseconds\":0,"
+    "\"playerActivity\":\"FINISHED\"}}],"
+    "\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.voice_input\","
+    "\"name\":\"ListenStarted\",\"dialogRequestId\":\"\"},"
+    "\"payload\":{\"format\":\"AUDIO_L16_RATE_16000_CHANNELS_1\"}}}}"
+    "{\"data\":{\"event\":{\"header\":{\"namespace\":\"ai.dueros.device_interface.";
+
+static z_stream *s_deflate = NULL;
+
+static voidpf duer_report_zalloc(voidpf opaque, uInt items, uInt size)
+{
+    return DUER_MALLOC(items * size);
+}
+
+static void duer_report_zfree(voidpf opaque, voidpf address)
+{
+    DUER_FREE(address);
+}
+
+duer_status_t duer_report_deflate_init(void)
+{
+    int rs = Z_OK;
+
+    if (s_deflate != NULL) {
+        return DUER_OK;
+    }
+
+    s_deflate = (z_stream *)DUER_MALLOC(sizeof(z_stream));
+    if (s_deflate == NULL) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    DUER_MEMSET(s_deflate, 0, sizeof(z_stream));
+    s_deflate->zalloc = duer_report_zalloc;
+    s_deflate->zfree = duer_report_zfree;
+
+    rs = deflateInit2(s_deflate, DUER_REPORT_DEFLATE_LEVEL, Z_DEFLATED,
+                      -DUER_REPORT_DEFLATE_WBITS, DUER_REPORT_DEFLATE_MEM_LEVEL,
+                      Z_DEFAULT_STRATEGY);
+    if (rs != Z_OK) {
+        DUER_LOGE("deflateInit2 failed: %d", rs);
+        DUER_FREE(s_deflate);
+        s_deflate = NULL;
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    return DUER_OK;
+}
+
+duer_status_t duer_report_deflate(const void *data, duer_size_t size,
+                                  duer_u8_t **out, duer_size_t *out_size)
+{
+    duer_status_t status = DUER_ERR_FAILED;
+    duer_u8_t *buf = NULL;
+    uLong bound = 0;
+    int rs = Z_OK;
+
+    if (s_deflate == NULL || data == NULL || size == 0 || out == NULL || out_size == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    bound = deflateBound(s_deflate, size);
+    buf = (duer_u8_t *)DUER_MALLOC(bound);
+    if (buf == NULL) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    deflateReset(s_deflate);
+    rs = deflateSetDictionary(s_deflate, (const Bytef *)s_dictionary, sizeof(s_dictionary) - 1);
+    if (rs != Z_OK) {
+        DUER_LOGE("deflateSetDictionary failed: %d", rs);
+        goto exit;
+    }
+
+    s_deflate->next_in = (z_const Bytef *)data;
+    s_deflate->avail_in = size;
+    s_deflate->next_out = buf;
+    s_deflate->avail_out = bound;
+
+    rs = deflate(s_deflate, Z_FINISH);
+    if (rs != Z_STREAM_END) {
+        DUER_LOGE("deflate failed: %d", rs);
+        goto exit;
+    }
+
+    if (s_deflate->total_out >= size) {
+        goto exit;
+    }
+
+    *out = buf;
+    *out_size = s_deflate->total_out;
+    buf = NULL;
+    status = DUER_OK;
+
+exit:
+    if (buf != NULL) {
+        DUER_FREE(buf);
+    }
+
+    return status;
+}
+
+void duer_report_deflate_release(void)
+{
+    if (s_deflate != NULL) {
+        deflateEnd(s_deflate);
+        DUER_FREE(s_deflate);
+        s_deflate = NULL;
+    }
+}
+
+duer_status_t duer_report_inflate(const void *data, duer_size_t size,
+                                  duer_u8_t **out, duer_size_t *out_size)
+{
+    duer_status_t status = DUER_ERR_FAILED;
+    z_stream stream;
+    duer_u8_t *buf = NULL;
+    duer_u8_t *grown = NULL;
+    duer_size_t cap = size * 4 + 64;
+    int rs = Z_OK;
+
+    if (data == NULL || size == 0 || out == NULL || out_size == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    DUER_MEMSET(&stream, 0, sizeof(stream));
+    stream.zalloc = duer_report_zalloc;
+    stream.zfree = duer_report_zfree;
+    if (inflateInit2(&stream, -DUER_REPORT_INFLATE_WBITS) != Z_OK) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+
+    rs = inflateSetDictionary(&stream, (const Bytef *)s_dictionary, sizeof(s_dictionary) - 1);
+    if (rs != Z_OK) {
+        DUER_LOGE("inflateSetDictionary failed: %d", rs);
+        goto exit;
+    }
+
+    stream.next_in = (z_const Bytef *)data;
+    stream.avail_in = size;
+
+    do {
+        // one byte left for the '\0'
+        grown = (duer_u8_t *)DUER_REALLOC(buf, cap + 1);
+        if (grown == NULL) {
+            status = DUER_ERR_MEMORY_OVERLOW;
+            goto exit;
+        }
+        buf = grown;
+        stream.next_out = buf + stream.total_out;
+        stream.avail_out = cap - stream.total_out;
+
+        rs = inflate(&stream, Z_FINISH);
+        cap <<= 1;
+    } while (rs == Z_BUF_ERROR && stream.avail_out == 0);
+
+    if (rs != Z_STREAM_END) {
+        DUER_LOGW("inflate failed: %d", rs);
+        goto exit;
+    }
+
+    buf[stream.total_out] = '\0';
+    *out = buf;
+    *out_size = stream.total_out;
+    buf = NULL;
+    status = DUER_OK;
+
+exit:
+    inflateEnd(&stream);
+    if (buf != NULL) {
+        DUER_FREE(buf);
+    }
+
+    return status;
+}
+
+#endif/*DUER_REPORT_DEFLATE*/
@@ -0,0 +1,85 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/**
+ * File: lightduer_report_deflate.h
+ * Desc: The report payloads compressed by the raw deflate (RFC 1951) with
+ *       a preset dictionary of the DCS events, by the Zliblite of the OTA.
+ *
+ *       The compressed payload is sent with the Content-Format
+ *       DUER_CT_JSON_DEFLATE_DICT. The receiver inflates it as raw deflate
+ *       (windowBits -15 for zlib) with the same dictionary set before, see
+ *       duer_report_inflate. The dictionary is part of the format, changing
+ *       it needs a new Content-Format.
+ */
+
+#ifndef BAIDU_DUER_LIGHTDUER_CONNAGENT_LIGHTDUER_REPORT_DEFLATE_H
+#define BAIDU_DUER_LIGHTDUER_CONNAGENT_LIGHTDUER_REPORT_DEFLATE_H
+
+#include "lightduer_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The Content-Format of the JSON deflated with the dictionary,
+ * in the experimental range of RFC 7252
+ */
+#define DUER_CT_JSON_DEFLATE_DICT   (65001)
+
+/*
+ * Prepare the compressor, it's kept until duer_report_deflate_release
+ *
+ * @Return duer_status_t, DUER_OK on success, or DUER_ERR_MEMORY_OVERLOW
+ */
+duer_status_t duer_report_deflate_init(void);
+
+/*
+ * Compress the payload
+ *
+ * @Param data, const void *, the payload
+ * @Param size, duer_size_t, the size of the payload
+ * @Param out, duer_u8_t **, the compressed, released by DUER_FREE
+ * @Param out_size, duer_size_t *, the size of the compressed
+ * @Return duer_status_t, DUER_OK on success,
+ *                        DUER_ERR_FAILED if not compressed smaller, the payload should be sent as is
+ */
+duer_status_t duer_report_deflate(const void *data, duer_size_t size,
+                                  duer_u8_t **out, duer_size_t *out_size);
+
+/*
+ * Release the compressor
+ */
+void duer_report_deflate_release(void);
+
+/*
+ * Decompress the payload, for the receiver (a local test server, or the tests)
+ *
+ * @Param data, const void *, the compressed
+ * @Param size, duer_size_t, the size of the compressed
+ * @Param out, duer_u8_t **, the payload terminated by '\0', released by DUER_FREE
+ * @Param out_size, duer_size_t *, the size of the payload, the '\0' not included
+ * @Return duer_status_t, DUER_OK on success,
+ *                        DUER_ERR_FAILED if not the deflated with the dictionary
+ */
+duer_status_t duer_report_inflate(const void *data, duer_size_t size,
+                                  duer_u8_t **out, duer_size_t *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/*BAIDU_DUER_LIGHTDUER_CONNAGENT_LIGHTDUER_REPORT_DEFLATE_H*/
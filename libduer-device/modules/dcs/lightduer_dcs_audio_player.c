@@ -124,11 +124,18 @@ static void duer_empty_play_queue()
     }
 }
 
-int duer_dcs_report_play_event(duer_dcs_audio_event_t type)
+/*
+ * Report the play event, built by the allocator if any (the arena of the directive),
+ * or the heap if NULL
+ */
+static int duer_report_play_event(duer_dcs_audio_event_t type,
+                                  const baidu_json_Allocator *allocator)
 {
     baidu_json *data = NULL;
     baidu_json *event = NULL;
     baidu_json *payload = NULL;
+    baidu_json *token = NULL;
+    baidu_json *offset = NULL;
     int rs = DUER_OK;
 
     if ((int)type < 0 || type >= sizeof(s_event_name_tab) / sizeof(s_event_name_tab[0])) {
@@ -143,21 +150,22 @@ int duer_dcs_report_play_event(duer_dcs_audio_event_t type)
         goto RET;
     }
 
-    data = baidu_json_CreateObject();
+    data = baidu_json_CreateObjectWithAllocator(allocator);
     if (data == NULL) {
         rs = DUER_ERR_FAILED;
         goto RET;
     }
 
-    event = duer_create_dcs_event("ai.dueros.device_interface.audio_player",
-                                  s_event_name_tab[type],
-                                  NULL);
+    event = duer_create_dcs_event_with_allocator("ai.dueros.device_interface.audio_player",
+                                                 s_event_name_tab[type],
+                                                 NULL,
+                                                 allocator);
     if (event == NULL) {
         rs = DUER_ERR_FAILED;
         goto RET;
     }
 
-    baidu_json_AddItemToObject(data, "event", event);
+    baidu_json_AddItemToObjectCS(data, "event", event);
 
     if (type != DCS_PLAY_QUEUE_CLEARED) {
         payload = baidu_json_GetObjectItem(event, "payload");
@@ -165,21 +173,38 @@ int duer_dcs_report_play_event(duer_dcs_audio_event_t type)
             rs = DUER_ERR_FAILED;
             goto RET;
         }
-        baidu_json_AddStringToObject(payload, "token", s_latest_token);
-        baidu_json_AddNumberToObject(payload, "offsetInMilliseconds", 0);
+
+        token = baidu_json_CreateStringWithAllocator(s_latest_token, allocator);
+        if (!token) {
+            rs = DUER_ERR_FAILED;
+            goto RET;
+        }
+        baidu_json_AddItemToObjectCS(payload, "token", token);
+
+        offset = baidu_json_CreateNumberWithAllocator(0, allocator);
+        if (!offset) {
+            rs = DUER_ERR_FAILED;
+            goto RET;
+        }
+        baidu_json_AddItemToObjectCS(payload, "offsetInMilliseconds", offset);
     }
 
     rs = duer_data_report(data);
 
 RET:
-    if (data) {
+    if (data && !allocator) {
         baidu_json_Delete(data);
     }
 
     return rs;
 }
 
-static void duer_start_audio_play()
+int duer_dcs_report_play_event(duer_dcs_audio_event_t type)
+{
+    return duer_report_play_event(type, NULL);
+}
+
+static void duer_start_audio_play(const baidu_json_Allocator *allocator)
 {
     play_item_t *first_item = NULL;
 
@@ -203,11 +228,12 @@ static void duer_start_audio_play()
     }
     s_latest_token = duer_strdup_internal(first_item->token);
 
-    duer_dcs_report_play_event(DCS_PLAY_STARTTED);
+    duer_report_play_event(DCS_PLAY_STARTTED, allocator);
     duer_dcs_audio_play_handler(first_item->url);
 }
 
-static void duer_replace_play_queue(const char *url, const char *token)
+static void duer_replace_play_queue(const char *url, const char *token,
+                                    const baidu_json_Allocator *allocator)
 {
     play_item_t *item = NULL;
 
@@ -220,12 +246,13 @@ static void duer_replace_play_queue(const char *url, const char *token)
     duer_empty_play_queue();
     item = duer_create_play_item(url, token);
     duer_qcache_push(s_play_queue, item);
-    duer_start_audio_play();
+    duer_start_audio_play(allocator);
 
     duer_mutex_unlock(s_queue_lock);
 }
 
-static void duer_enqueue_play_item(const char *url, const char *token)
+static void duer_enqueue_play_item(const char *url, const char *token,
+                                   const baidu_json_Allocator *allocator)
 {
     play_item_t *item = NULL;
 
@@ -236,13 +263,14 @@ static void duer_enqueue_play_item(const char *url, const char *token)
     duer_qcache_push(s_play_queue, item);
 
     if (s_play_state == FINISHED) {
-        duer_start_audio_play();
+        duer_start_audio_play(allocator);
     }
 
     duer_mutex_unlock(s_queue_lock);
 }
 
-static void duer_replace_enqueued_item(const char *url, const char *token)
+static void duer_replace_enqueued_item(const char *url, const char *token,
+                                       const baidu_json_Allocator *allocator)
 {
     play_item_t *item = NULL;
 
@@ -256,7 +284,7 @@ static void duer_replace_enqueued_item(const char *url, const char *token)
     duer_qcache_push(s_play_queue, item);
 
     if (s_play_state == FINISHED) {
-        duer_start_audio_play();
+        duer_start_audio_play(allocator);
     }
 
     duer_mutex_unlock(s_queue_lock);
@@ -271,6 +299,8 @@ static duer_status_t duer_audio_play_cb(const baidu_json *directive)
     baidu_json *audio_item = NULL;
     duer_status_t ret = DUER_OK;
     baidu_json *behavior = NULL;
+    baidu_json_Allocator arena;
+    const baidu_json_Allocator *allocator = NULL;
 
     DUER_LOGV("Enter");
 
@@ -309,12 +339,15 @@ static duer_status_t duer_audio_play_cb(const baidu_json *directive)
     DUER_LOGI("token: %s", token->valuestring);
     DUER_LOGI("behavior: %s", behavior->valuestring);
 
+    // the PlaybackStarted reported is built in the arena of the directive
+    allocator = duer_dcs_directive_allocator(directive, &arena);
+
     if (strcmp(behavior->valuestring, "REPLACE_ALL") == 0) {
-        duer_replace_play_queue(url->valuestring, token->valuestring);
+        duer_replace_play_queue(url->valuestring, token->valuestring, allocator);
     } else if (strcmp(behavior->valuestring, "ENQUEUE") == 0) {
-        duer_enqueue_play_item(url->valuestring, token->valuestring);
+        duer_enqueue_play_item(url->valuestring, token->valuestring, allocator);
     } else if (strcmp(behavior->valuestring, "REPLACE_ENQUEUED") == 0) {
-        duer_replace_enqueued_item(url->valuestring, token->valuestring);
+        duer_replace_enqueued_item(url->valuestring, token->valuestring, allocator);
     } else {
         DUER_LOGE("Invalid playBehavior\n");
         ret = DUER_MSG_RSP_BAD_REQUEST;
@@ -331,6 +364,7 @@ static duer_status_t duer_queue_clear_cb(const baidu_json *directive)
     baidu_json *behavior = NULL;
     duer_status_t ret = DUER_OK;
     play_item_t *item = NULL;
+    baidu_json_Allocator allocator;
 
     DUER_LOGV("Enter");
 
@@ -354,14 +388,16 @@ static duer_status_t duer_queue_clear_cb(const baidu_json *directive)
         duer_empty_play_queue();
         duer_qcache_push(s_play_queue, item);
         duer_mutex_unlock(s_queue_lock);
-        duer_dcs_report_play_event(DCS_PLAY_QUEUE_CLEARED);
+        duer_report_play_event(DCS_PLAY_QUEUE_CLEARED,
+                               duer_dcs_directive_allocator(directive, &allocator));
     } else if (strcmp(behavior->valuestring, "CLEAR_ALL") == 0) {
         duer_dcs_audio_stop_handler();
         s_play_state = STOPPED;
         duer_mutex_lock(s_queue_lock);
         duer_empty_play_queue();
         duer_mutex_unlock(s_queue_lock);
-        duer_dcs_report_play_event(DCS_PLAY_QUEUE_CLEARED);
+        duer_report_play_event(DCS_PLAY_QUEUE_CLEARED,
+                               duer_dcs_directive_allocator(directive, &allocator));
     } else {
         DUER_LOGE("Invalid clearBehavior\n");
         ret = DUER_MSG_RSP_BAD_REQUEST;
@@ -402,7 +438,7 @@ void duer_resume_audio_internal()
     if (s_play_offset == 0) {
         // This audio had not been played
         duer_mutex_lock(s_queue_lock);
-        duer_start_audio_play();
+        duer_start_audio_play(NULL);
         duer_mutex_unlock(s_queue_lock);
     } else {
         duer_mutex_lock(s_queue_lock);
@@ -435,7 +471,7 @@ void duer_dcs_audio_on_finished()
     item = duer_qcache_pop(s_play_queue);
     duer_destroy_play_item(item);
 
-    duer_start_audio_play();
+    duer_start_audio_play(NULL);
     duer_mutex_unlock(s_queue_lock);
 }
 
@@ -25,45 +25,68 @@
 
 static volatile int s_dialog_req_id = 0;
 
-baidu_json *duer_create_dcs_event(const char *namespace, const char *name, const char *msg_id)
+baidu_json *duer_create_dcs_event_with_allocator(const char *namespace,
+                                                const char *name,
+                                                const char *msg_id,
+                                                const baidu_json_Allocator *allocator)
 {
     baidu_json *event = NULL;
     baidu_json *header = NULL;
     baidu_json *payload = NULL;
+    baidu_json *value = NULL;
 
-    event = baidu_json_CreateObject();
+    event = baidu_json_CreateObjectWithAllocator(allocator);
     if (event == NULL) {
         goto error_out;
     }
 
-    header = baidu_json_CreateObject();
+    header = baidu_json_CreateObjectWithAllocator(allocator);
     if (header == NULL) {
         goto error_out;
     }
+    baidu_json_AddItemToObjectCS(event, "header", header);
+
+    value = baidu_json_CreateStringWithAllocator(namespace, allocator);
+    if (value == NULL) {
+        goto error_out;
+    }
+    baidu_json_AddItemToObjectCS(header, "namespace", value);
+
+    value = baidu_json_CreateStringWithAllocator(name, allocator);
+    if (value == NULL) {
+        goto error_out;
+    }
+    baidu_json_AddItemToObjectCS(header, "name", value);
 
-    baidu_json_AddStringToObject(header, "namespace", namespace);
-    baidu_json_AddStringToObject(header, "name", name);
     if (msg_id) {
-        baidu_json_AddStringToObject(header, "messageId", msg_id);
+        value = baidu_json_CreateStringWithAllocator(msg_id, allocator);
+        if (value == NULL) {
+            goto error_out;
+        }
+        baidu_json_AddItemToObjectCS(header, "messageId", value);
     }
-    baidu_json_AddItemToObject(event, "header", header);
 
-    payload = baidu_json_CreateObject();
+    payload = baidu_json_CreateObjectWithAllocator(allocator);
     if (payload == NULL) {
        goto error_out;
     }
 
-    baidu_json_AddItemToObject(event, "payload", payload);
+    baidu_json_AddItemToObjectCS(event, "payload", payload);
 
     return event;
 
 error_out:
-    if (event) {
+    if (event && !allocator) {
         baidu_json_Delete(event);
     }
     return NULL;
 }
 
+baidu_json *duer_create_dcs_event(const char *namespace, const char *name, const char *msg_id)
+{
+    return duer_create_dcs_event_with_allocator(namespace, name, msg_id, NULL);
+}
+
 int duer_get_request_id_internal()
 {
     return s_dialog_req_id++;
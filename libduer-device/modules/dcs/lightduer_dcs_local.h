@@ -216,6 +216,25 @@ bool duer_is_multiple_round_dialogue(void);
  */
 baidu_json *duer_create_dcs_event(const char *namespace, const char *name, const char *msg_id);
 
+/**
+ * DESC:
+ * Used to create dcs event with the memory from the allocator.
+ *
+ * @PARAM[in] namespace: the namespace of the event need to report.
+ * @PARAM[in] name: the name the event need to report.
+ * @PARAM[in] msg_id: the message_id of the event,
+ *                    it could be NULL if the event don't have message_id.
+ * @PARAM[in] allocator: the allocator, such as duer_dcs_directive_allocator gives,
+ *                       the event is released together with it, don't delete it;
+ *                       NULL to create it by the heap.
+ *
+ * @RETURN: pinter of the created dcs event if success, or NULL if failed.
+ */
+baidu_json *duer_create_dcs_event_with_allocator(const char *namespace,
+                                                const char *name,
+                                                const char *msg_id,
+                                                const baidu_json_Allocator *allocator);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,10 +30,107 @@
 #include "lightduer_lib.h"
 #include "lightduer_ca.h"
 #include "lightduer_mutex.h"
+#include "lightduer_arena.h"
+
+/*
+ * The payload copy, the parsed tree and the handler temporaries of one
+ * directive are alloced from the arena, and released at once after routed.
+ * The arena is owned by the directive being routed: the handler gets its
+ * memory by the directive, checked under the lock, so the other threads
+ * (and the handler after it returned) get NULL instead of the memory reset.
+ */
+#ifndef DUER_DCS_ARENA_SIZE
+#define DUER_DCS_ARENA_SIZE     (2048)
+#endif
 
 static size_t s_directive_count = 0;
 static duer_directive_list *s_dcs_directive_list = NULL;
 static duer_mutex_t s_dcs_router_lock;
+static duer_arena_handler s_dcs_arena = NULL;
+static bool s_dcs_arena_busy = false;
+static const baidu_json *s_dcs_arena_owner = NULL;
+
+static duer_arena_handler duer_dcs_arena_acquire(void)
+{
+    duer_arena_handler arena = NULL;
+
+    duer_mutex_lock(s_dcs_router_lock);
+    if (s_dcs_arena && !s_dcs_arena_busy) {
+        s_dcs_arena_busy = true;
+        arena = s_dcs_arena;
+    }
+    duer_mutex_unlock(s_dcs_router_lock);
+
+    return arena;
+}
+
+static void duer_dcs_arena_release(duer_arena_handler arena)
+{
+    DUER_LOGD("directive arena used: %d", duer_arena_used(arena));
+    duer_arena_reset(arena);
+
+    duer_mutex_lock(s_dcs_router_lock);
+    s_dcs_arena_busy = false;
+    s_dcs_arena_owner = NULL;
+    duer_mutex_unlock(s_dcs_router_lock);
+}
+
+static void duer_dcs_arena_own(const baidu_json *directive)
+{
+    duer_mutex_lock(s_dcs_router_lock);
+    s_dcs_arena_owner = directive;
+    duer_mutex_unlock(s_dcs_router_lock);
+}
+
+static void *duer_dcs_arena_alloc_cb(void *ctx, size_t size)
+{
+    return duer_arena_alloc(ctx, size);
+}
+
+void *duer_dcs_directive_alloc(const baidu_json *directive, size_t size)
+{
+    void *ptr = NULL;
+
+    if (!directive || !s_dcs_router_lock) {
+        return NULL;
+    }
+
+    duer_mutex_lock(s_dcs_router_lock);
+    if (s_dcs_arena_busy && s_dcs_arena_owner == directive) {
+        ptr = duer_arena_alloc(s_dcs_arena, size);
+    }
+    duer_mutex_unlock(s_dcs_router_lock);
+
+    return ptr;
+}
+
+static void *duer_dcs_directive_alloc_cb(void *ctx, size_t size)
+{
+    return duer_dcs_directive_alloc((const baidu_json *)ctx, size);
+}
+
+const baidu_json_Allocator *duer_dcs_directive_allocator(const baidu_json *directive,
+                                                         baidu_json_Allocator *allocator)
+{
+    bool owned = false;
+
+    if (!directive || !allocator || !s_dcs_router_lock) {
+        return NULL;
+    }
+
+    duer_mutex_lock(s_dcs_router_lock);
+    owned = s_dcs_arena_busy && s_dcs_arena_owner == directive;
+    duer_mutex_unlock(s_dcs_router_lock);
+
+    if (!owned) {
+        return NULL;
+    }
+
+    allocator->ctx = (void *)directive;
+    allocator->alloc_fn = duer_dcs_directive_alloc_cb;
+
+    return allocator;
+}
 
 void duer_add_dcs_directive(const duer_directive_list *directive, size_t count)
 {
@@ -85,6 +182,8 @@ duer_status_t duer_dcs_router(duer_context ctx, duer_msg_t* msg, duer_addr_t* ad
     baidu_json *name = NULL;
     baidu_json *header = NULL;
     baidu_json *directive = NULL;
+    duer_arena_handler arena = NULL;
+    baidu_json_Allocator allocator;
 
     DUER_LOGV("Enter");
 
@@ -98,7 +197,12 @@ duer_status_t duer_dcs_router(duer_context ctx, duer_msg_t* msg, duer_addr_t* ad
         goto RET;
     }
 
-    payload = (char *)DUER_MALLOC(msg->payload_len + 1);
+    arena = duer_dcs_arena_acquire();
+    if (arena) {
+        payload = (char *)duer_arena_alloc(arena, msg->payload_len + 1);
+    } else {
+        payload = (char *)DUER_MALLOC(msg->payload_len + 1);
+    }
     if (!payload) {
         DUER_LOGE("Memory not enough\n");
         rs = DUER_ERR_FAILED;
@@ -110,7 +214,13 @@ duer_status_t duer_dcs_router(duer_context ctx, duer_msg_t* msg, duer_addr_t* ad
 
     DUER_LOGI("payload: %s", payload);
 
-    value = baidu_json_Parse(payload);
+    if (arena) {
+        allocator.ctx = arena;
+        allocator.alloc_fn = duer_dcs_arena_alloc_cb;
+        value = baidu_json_ParseWithAllocator(payload, &allocator);
+    } else {
+        value = baidu_json_Parse(payload);
+    }
     if (value == NULL) {
         DUER_LOGE("Failed to parse payload");
         rs = DUER_ERR_FAILED;
@@ -152,6 +262,10 @@ duer_status_t duer_dcs_router(duer_context ctx, duer_msg_t* msg, duer_addr_t* ad
         goto RET;
     }
 
+    if (arena) {
+        duer_dcs_arena_own(directive);
+    }
+
     rs = handler(directive);
 
 RET:
@@ -167,6 +281,11 @@ RET:
         }
     }
 
+    if (arena) {
+        duer_dcs_arena_release(arena);
+        return rs;
+    }
+
     if (payload) {
         DUER_FREE(payload);
     }
@@ -190,6 +309,13 @@ void duer_dcs_framework_init()
         s_dcs_router_lock = duer_mutex_create();
     }
 
+    if (!s_dcs_arena) {
+        s_dcs_arena = duer_arena_create(DUER_DCS_ARENA_SIZE);
+        if (!s_dcs_arena) {
+            DUER_LOGW("Failed to create the directive arena, use the heap instead");
+        }
+    }
+
     duer_declare_sys_interface_internal();
 }
 
@@ -45,6 +45,32 @@ typedef struct {
  */
 void duer_add_dcs_directive(const duer_directive_list *directive, size_t count);
 
+/**
+ * Alloc temporary memory in the directive handler, it's from the arena of the
+ * directive and released together with it after the handler returned,
+ * so don't free it, and don't keep it after the handler returned.
+ *
+ * @param directive: the directive passed to the handler.
+ * @param size: the expected size.
+ * @return the memory, NULL if failed, or the directive isn't being routed in the arena
+ *         (the arena was busy, or the handler has returned), use the heap then.
+ */
+void *duer_dcs_directive_alloc(const baidu_json *directive, size_t size);
+
+/**
+ * Obtain the allocator of the directive's arena, for the baidu_json items built
+ * in the directive handler, such as the events reported. The items are released
+ * together with the directive: add them by baidu_json_AddItemToObjectCS, and
+ * don't call baidu_json_Delete on them.
+ *
+ * @param directive: the directive passed to the handler.
+ * @param allocator: the allocator to fill.
+ * @return the allocator filled, NULL if the directive isn't being routed in the arena,
+ *         the items should be created by the heap then.
+ */
+const baidu_json_Allocator *duer_dcs_directive_allocator(const baidu_json *directive,
+                                                         baidu_json_Allocator *allocator);
+
 #ifdef __cplusplus
 }
 #endif
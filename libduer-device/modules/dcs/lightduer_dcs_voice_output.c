@@ -39,11 +39,16 @@ static const char* const s_player_activity[MAX_PLAY_STATE] = {"PLAYING", "FINISH
 
 static volatile int s_play_state = FINISHED;
 
-static int duer_report_speech_event(const char *name)
+/*
+ * Report the speech event, built by the allocator if any (the arena of the directive),
+ * or the heap if NULL
+ */
+static int duer_report_speech_event(const char *name, const baidu_json_Allocator *allocator)
 {
     baidu_json *data = NULL;
     baidu_json *event = NULL;
     baidu_json *payload = NULL;
+    baidu_json *token = NULL;
     int rs = DUER_OK;
 
     if (!s_latest_token) {
@@ -52,46 +57,53 @@ static int duer_report_speech_event(const char *name)
         goto RET;
     }
 
-    data = baidu_json_CreateObject();
+    data = baidu_json_CreateObjectWithAllocator(allocator);
     if (data == NULL) {
         rs = DUER_ERR_FAILED;
         goto RET;
     }
 
-    event = duer_create_dcs_event("ai.dueros.device_interface.voice_output",
-                                  name,
-                                  NULL);
+    event = duer_create_dcs_event_with_allocator("ai.dueros.device_interface.voice_output",
+                                                 name,
+                                                 NULL,
+                                                 allocator);
     if (event == NULL) {
         rs = DUER_ERR_FAILED;
         goto RET;
     }
 
-    baidu_json_AddItemToObject(data, "event", event);
+    baidu_json_AddItemToObjectCS(data, "event", event);
     payload = baidu_json_GetObjectItem(event, "payload");
     if (!payload) {
         rs = DUER_ERR_FAILED;
         goto RET;
     }
-    baidu_json_AddStringToObject(payload, "token", s_latest_token);
+
+    token = baidu_json_CreateStringWithAllocator(s_latest_token, allocator);
+    if (!token) {
+        rs = DUER_ERR_FAILED;
+        goto RET;
+    }
+    baidu_json_AddItemToObjectCS(payload, "token", token);
 
     duer_data_report(data);
 
 RET:
-    if (data) {
+    if (data && !allocator) {
         baidu_json_Delete(data);
     }
 
     return rs;
 }
 
-static int duer_report_speech_started_event()
+static int duer_report_speech_started_event(const baidu_json_Allocator *allocator)
 {
-    return duer_report_speech_event("SpeechStarted");
+    return duer_report_speech_event("SpeechStarted", allocator);
 }
 
 static int duer_report_speech_finished_event()
 {
-    return duer_report_speech_event("SpeechFinished");
+    return duer_report_speech_event("SpeechFinished", NULL);
 }
 
 void duer_dcs_speech_on_finished()
@@ -116,6 +128,7 @@ static duer_status_t duer_speak_cb(const baidu_json *directive)
     baidu_json *payload = NULL;
     baidu_json *url = NULL;
     baidu_json *token = NULL;
+    baidu_json_Allocator allocator;
 
     DUER_LOGV("Entry");
 
@@ -144,7 +157,7 @@ static duer_status_t duer_speak_cb(const baidu_json *directive)
 
     // Pause audio player
     duer_pause_audio_internal();
-    duer_report_speech_started_event();
+    duer_report_speech_started_event(duer_dcs_directive_allocator(directive, &allocator));
 
     duer_dcs_speak_handler(url->valuestring);
 
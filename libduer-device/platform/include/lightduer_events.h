@@ -39,12 +39,102 @@ typedef struct _duer_event_status_message_s {
 
 typedef void *duer_events_handler;
 
+typedef enum _duer_events_priority_enum {
+    DUER_EVENTS_PRIORITY_NORMAL,
+    DUER_EVENTS_PRIORITY_URGENT,    // handled before the normal ones
+    DUER_EVENTS_PRIORITY_TOTAL
+} duer_events_priority_t;
+
 duer_events_handler duer_events_create(const char *name, size_t stack_size, size_t queue_length);
 
 int duer_events_call(duer_events_handler handler, duer_events_func func, int what, void *object);
 
+/*
+ * Same as duer_events_call, but the urgent messages are handled before the normal ones.
+ * The normal ones still get a turn after a run of the urgent ones, so they won't starve.
+ *
+ * @Param handler, duer_events_handler, the events handler
+ * @Param priority, duer_events_priority_t, the priority of the message
+ * @Param func, duer_events_func, the callback
+ * @Param what, int, the first argument of the callback
+ * @Param object, void *, the second argument of the callback
+ * @Return int, DUER_OK on success, or other error code
+ */
+int duer_events_call_with_priority(duer_events_handler handler, duer_events_priority_t priority,
+                                   duer_events_func func, int what, void *object);
+
+/*
+ * The (func, priority) could be coalesced per events handler
+ */
+#define DUER_EVENTS_COALESCE_KEYS   (8)
+
+/*
+ * Same as duer_events_call_with_priority, but it's folded if the same func with
+ * the same priority is still pending, the what and object of the folded one are dropped.
+ * So the func should do all the available work each time, such as send until would block.
+ * When all the DUER_EVENTS_COALESCE_KEYS are used, the others are not coalesced.
+ *
+ * @Return int, DUER_OK on success(posted or folded), or other error code
+ */
+int duer_events_call_coalesced(duer_events_handler handler, duer_events_priority_t priority,
+                               duer_events_func func, int what, void *object);
+
 void duer_events_destroy(duer_events_handler handler);
 
+/*
+ * The histogram bucket i counts the durations in [2^(i-1), 2^i) us,
+ * bucket 0 counts the ones under 1us, the last one counts all the longer.
+ */
+#define DUER_EVENTS_HIST_BUCKETS    (20)
+
+/*
+ * The callbacks tracked per events handler,
+ * the ones exceed it are accounted in the last entry with func = NULL.
+ */
+#define DUER_EVENTS_STATS_FUNCS     (16)
+
+typedef struct _duer_events_func_stats_s {
+    duer_events_func    func;
+    duer_u32_t          count;
+    duer_u32_t          wait_max;   // the max time in the queue, us
+    duer_u32_t          exec_max;   // the max time of the callback, us
+    duer_u32_t          folded;     // the calls folded by duer_events_call_coalesced
+    duer_u32_t          wait_hist[DUER_EVENTS_HIST_BUCKETS];
+    duer_u32_t          exec_hist[DUER_EVENTS_HIST_BUCKETS];
+} duer_events_func_stats_t;
+
+typedef struct _duer_events_stats_s {
+    size_t                      depth;      // the messages waiting now
+    size_t                      max_depth;  // the max messages waiting since created
+    size_t                      folded;     // the calls folded by duer_events_call_coalesced
+    size_t                      func_count; // the valid entries in funcs
+    duer_events_func_stats_t    funcs[DUER_EVENTS_STATS_FUNCS];
+} duer_events_stats_t;
+
+/*
+ * Obtain the statistics of the events handler, such as "lightduer_ca".
+ * The statistics are published under the lock of the handler once the
+ * messages taken by the task are handled, and copied under the same lock,
+ * so the snapshot is consistent, but misses the batch in progress.
+ * Only the linux port supports it now.
+ *
+ * @Param name, const char *, the name of the events handler
+ * @Param stats, duer_events_stats_t *, the statistics output
+ * @Return int, DUER_OK on success, DUER_ERR_FAILED if not found
+ */
+int duer_events_get_stats(const char *name, duer_events_stats_t *stats);
+
+/*
+ * Estimate the percentile from the histogram.
+ *
+ * @Param hist, const duer_u32_t *, the DUER_EVENTS_HIST_BUCKETS buckets
+ * @Param percent, int, such as 50, 99
+ * @Param max, duer_u32_t, the max recorded with the histogram, such as wait_max
+ * @Return duer_u32_t, the upper bound of the bucket reaching the percentile,
+ *         but no more than the max, us
+ */
+duer_u32_t duer_events_hist_percentile(const duer_u32_t *hist, int percent, duer_u32_t max);
+
 #ifdef __cplusplus
 }
 #endif
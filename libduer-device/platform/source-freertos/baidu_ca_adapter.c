@@ -23,6 +23,7 @@
 #include "baidu_ca_adapter_internal.h"
 #include "lightduer_memory.h"
 #include "lightduer_debug.h"
+#include "lightduer_dns.h"
 #include "lightduer_timestamp.h"
 #include "lightduer_sleep.h"
 #include "lightduer_net_transport.h"
@@ -69,5 +70,8 @@ void baidu_ca_adapter_initialize()
     baidu_ca_timestamp_init(duer_timestamp_obtain);
 
     baidu_ca_sleep_init(duer_sleep_impl);
+
+    // the name servers are added by the application with duer_dns_add_server
+    duer_dns_initialize();
 }
 
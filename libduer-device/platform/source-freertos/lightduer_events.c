@@ -29,6 +29,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #if defined(DUER_PLATFORM_MARVELL)
 #define QueueHandle_t       xQueueHandle
@@ -37,10 +38,17 @@
 
 #define QUEUE_WAIT_FOREVER  (0x7fffffff)
 
+/*
+ * The max urgent messages handled in a row when there are normal ones waiting,
+ * so a flood of urgent messages won't starve the others.
+ */
+#define DUER_EVENTS_URGENT_BURST    (8)
+
 typedef struct _duer_events_struct {
-    TaskHandle_t    _task;
-    QueueHandle_t   _queue;
-    char *          _name;
+    TaskHandle_t        _task;
+    QueueHandle_t       _queues[DUER_EVENTS_PRIORITY_TOTAL];
+    SemaphoreHandle_t   _ready;     // counts the messages in all the queues
+    char *              _name;
 } duer_events_t;
 
 typedef struct _duer_queue_message_s {
@@ -54,14 +62,38 @@ static long duer_events_timestamp()
     return xTaskGetTickCount() * (1000 / configTICK_RATE_HZ);
 }
 
+/*
+ * Receive the next message to handle, the urgent one first,
+ * but let a normal one go after DUER_EVENTS_URGENT_BURST urgent ones.
+ */
+static portBASE_TYPE duer_events_next(duer_events_t *events, duer_eq_message *message,
+                                      int *urgent_run)
+{
+    QueueHandle_t normal = events->_queues[DUER_EVENTS_PRIORITY_NORMAL];
+    QueueHandle_t urgent = events->_queues[DUER_EVENTS_PRIORITY_URGENT];
+
+    if ((*urgent_run < DUER_EVENTS_URGENT_BURST || uxQueueMessagesWaiting(normal) == 0)
+            && pdTRUE == xQueueReceive(urgent, message, 0)) {
+        (*urgent_run)++;
+        return pdTRUE;
+    }
+
+    *urgent_run = 0;
+
+    return xQueueReceive(normal, message, 0);
+}
+
 static void duer_events_task(void *context)
 {
     duer_events_t *events = (duer_events_t *)context;
     long runtime = 0;
+    int urgent_run = 0;
     duer_eq_message message;
 
     do {
-        if (pdTRUE == xQueueReceive(events->_queue, &message, QUEUE_WAIT_FOREVER)) {
+        // one count is given for each message sent, so one is there once taken
+        if (pdTRUE == xSemaphoreTake(events->_ready, QUEUE_WAIT_FOREVER)
+                && pdTRUE == duer_events_next(events, &message, &urgent_run)) {
             if (message._callback) {
                 runtime = duer_events_timestamp();
                 DUER_LOGD("[%s] <== event begin = %p", events->_name, message._callback);
@@ -100,12 +132,22 @@ duer_events_handler duer_events_create(const char *name, size_t stack_size, size
             DUER_MEMCPY(events->_name, name, DUER_STRLEN(name) + 1);
         }
 
-        events->_queue = xQueueCreate(queue_length, sizeof(duer_eq_message));
-        if (events->_queue == NULL) {
+        events->_queues[DUER_EVENTS_PRIORITY_NORMAL] =
+                xQueueCreate(queue_length, sizeof(duer_eq_message));
+        events->_queues[DUER_EVENTS_PRIORITY_URGENT] =
+                xQueueCreate(queue_length, sizeof(duer_eq_message));
+        if (events->_queues[DUER_EVENTS_PRIORITY_NORMAL] == NULL
+                || events->_queues[DUER_EVENTS_PRIORITY_URGENT] == NULL) {
             DUER_LOGE("[%s] Create the queue failed!", events->_name);
             break;
         }
 
+        events->_ready = xSemaphoreCreateCounting(queue_length * DUER_EVENTS_PRIORITY_TOTAL, 0);
+        if (events->_ready == NULL) {
+            DUER_LOGE("[%s] Create the semaphore failed!", events->_name);
+            break;
+        }
+
         xTaskCreate(&duer_events_task, name, stack_size / sizeof(portSTACK_TYPE), events, duer_priority_get(duer_priority_get_task_id(name)), &(events->_task));
         if (events->_task == NULL) {
             DUER_LOGE("[%s] Create the queue failed!", events->_name);
@@ -124,12 +166,18 @@ duer_events_handler duer_events_create(const char *name, size_t stack_size, size
 }
 
 int duer_events_call(duer_events_handler handler, duer_events_func func, int what, void *object)
+{
+    return duer_events_call_with_priority(handler, DUER_EVENTS_PRIORITY_NORMAL, func, what, object);
+}
+
+int duer_events_call_with_priority(duer_events_handler handler, duer_events_priority_t priority,
+                                   duer_events_func func, int what, void *object)
 {
     int rs = DUER_ERR_FAILED;
     duer_events_t *events = (duer_events_t *)handler;
 
     do {
-        if (events == NULL || events->_queue == NULL) {
+        if (events == NULL || events->_ready == NULL || priority >= DUER_EVENTS_PRIORITY_TOTAL) {
             break;
         }
 
@@ -138,9 +186,11 @@ int duer_events_call(duer_events_handler handler, duer_events_func func, int wha
         message._what = what;
         message._data = object;
 
-        if (pdTRUE != xQueueSend(events->_queue, &message, 0)) {
+        // each priority has its own queue, so the urgent ones keep their order
+        if (pdTRUE != xQueueSend(events->_queues[priority], &message, 0)) {
             break;
         }
+        xSemaphoreGive(events->_ready);
 
         rs = DUER_OK;
     } while (0);
@@ -152,9 +202,17 @@ int duer_events_call(duer_events_handler handler, duer_events_func func, int wha
     return rs;
 }
 
+int duer_events_call_coalesced(duer_events_handler handler, duer_events_priority_t priority,
+                               duer_events_func func, int what, void *object)
+{
+    // not folded here, the func is expected to handle the duplicated calls
+    return duer_events_call_with_priority(handler, priority, func, what, object);
+}
+
 void duer_events_destroy(duer_events_handler handler)
 {
     duer_events_t *events = (duer_events_t *)handler;
+    int i = 0;
 
     if (events) {
         if (events->_task) {
@@ -162,9 +220,16 @@ void duer_events_destroy(duer_events_handler handler)
             events->_task = NULL;
         }
 
-        if (events->_queue) {
-            vQueueDelete(events->_queue);
-            events->_queue = NULL;
+        for (i = 0; i < DUER_EVENTS_PRIORITY_TOTAL; i++) {
+            if (events->_queues[i]) {
+                vQueueDelete(events->_queues[i]);
+                events->_queues[i] = NULL;
+            }
+        }
+
+        if (events->_ready) {
+            vSemaphoreDelete(events->_ready);
+            events->_ready = NULL;
         }
 
         if (events->_name) {
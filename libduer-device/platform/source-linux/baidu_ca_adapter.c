@@ -21,12 +21,14 @@
 
 #include "lightduer_adapter.h"
 
-#include <sys/time.h>  // gettimeofday  get time in micro-second
+#include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "baidu_ca_adapter_internal.h"
 
 #include "lightduer_debug.h"
+#include "lightduer_dns.h"
 #include "lightduer_log.h"
 #include "lightduer_memory.h"
 #include "lightduer_net_transport.h"
@@ -35,21 +37,45 @@
 #include "lightduer_random.h"
 #include "lightduer_random_impl.h"
 
+#define DUER_RESOLV_CONF    "/etc/resolv.conf"
+#define DUER_DNS_PORT       (53)
+
+// in ms as the other ports, the monotonic clock isn't moved by NTP
 static duer_u32_t duer_timestamp_obtain()
 {
-    DUER_LOGV("duer_timestamp_obtain");
-    struct timeval tv;
-    int ret = gettimeofday(&tv, NULL);
+    struct timespec ts;
+    int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
     if (ret) {
-        perror("gettimeofday error");
+        perror("clock_gettime error");
         return 0;
     }
-    unsigned long long time_in_microseconds = tv.tv_sec * 1000000 + tv.tv_usec;
-    return (duer_u32_t)time_in_microseconds;// NOTE: only last for 71min on 32bit system
+    return (duer_u32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
 }
 
 static void duer_sleep_impl(duer_u32_t ms) {
-    usleep(ms);
+    usleep(ms * 1000);
+}
+
+static void duer_dns_load_servers()
+{
+    char line[128];
+    char ip[64];
+    FILE *fp = fopen(DUER_RESOLV_CONF, "r");
+
+    if (fp == NULL) {
+        DUER_LOGW("open %s failed", DUER_RESOLV_CONF);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        // the IPv6 servers are skipped
+        if (sscanf(line, " nameserver %63s", ip) == 1
+                && duer_dns_add_server(ip, DUER_DNS_PORT) == DUER_OK) {
+            DUER_LOGI("name server: %s", ip);
+        }
+    }
+
+    fclose(fp);
 }
 
 void baidu_ca_adapter_initialize()
@@ -79,9 +105,14 @@ void baidu_ca_adapter_initialize()
         bcasoc_close,
         bcasoc_destroy);
 
+    baidu_ca_transport_sendv_init(bcasoc_sendv);
+
     baidu_ca_timestamp_init(duer_timestamp_obtain);
 
     baidu_ca_sleep_init(duer_sleep_impl);
     duer_random_init(duer_random_impl);
+
+    duer_dns_initialize();
+    duer_dns_load_servers();
 }
 
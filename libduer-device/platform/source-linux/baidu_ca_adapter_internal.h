@@ -52,6 +52,8 @@ extern duer_status_t bcasoc_connect(duer_socket_t ctx, const duer_addr_t *addr);
 
 extern duer_status_t bcasoc_send(duer_socket_t ctx, const void *data, duer_size_t size, const duer_addr_t *addr);
 
+extern duer_status_t bcasoc_sendv(duer_socket_t ctx, const duer_iovec_t *iov, duer_size_t iovcnt, const duer_addr_t *addr);
+
 extern duer_status_t bcasoc_recv(duer_socket_t ctx, void *data, duer_size_t size, duer_addr_t *addr);
 
 extern duer_status_t bcasoc_recv_timeout(duer_socket_t ctx, void *data, duer_size_t size, duer_u32_t timeout, duer_addr_t *addr);
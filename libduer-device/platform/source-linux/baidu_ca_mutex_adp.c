@@ -36,7 +36,7 @@ duer_mutex_t create_mutex(void)
     }
     int ret = pthread_mutex_init(p_mutex, NULL); // use the default attribute to initialize the mutex
     if (ret) {
-        free(p_mutex);
+        DUER_FREE(p_mutex);
         p_mutex = NULL;
         DUER_LOGW("pthread_mutex_init fail!, ret:%d", ret);
         return NULL;
@@ -91,7 +91,7 @@ duer_status_t delete_mutex_lock(duer_mutex_t mutex)
 
     p_mutex = (pthread_mutex_t*)mutex;
     pthread_mutex_destroy(p_mutex);
-    free(p_mutex);
+    DUER_FREE(p_mutex);
 
     return DUER_OK;
 }
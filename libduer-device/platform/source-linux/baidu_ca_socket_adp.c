@@ -16,53 +16,124 @@
 //
 // File: baidu_ca_socket_adp.c
 // Auth: Zhang Leliang (zhangleliang@baidu.com)
-// Desc: Adapt the socket function to esp32.
+// Desc: Adapt the socket function to linux, readiness is reported by one
+//       epoll reactor thread shared by all the sockets.
 
 
 #include "baidu_ca_adapter_internal.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
-#include <fcntl.h>
-#include <netdb.h>
 #include <netinet/in.h>
 #include <pthread.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "lightduer_connagent.h"
-#include "lightduer_events.h"
+#include "lightduer_dns.h"
 #include "lightduer_lib.h"
 #include "lightduer_log.h"
 #include "lightduer_memory.h"
-#include "lightduer_priority_conf.h"
-#include "lightduer_timers.h"
 
-#define TASK_STACK_SIZE (1024 * 4)
+// the events fetched by one epoll_wait
+#define BCASOC_EVENTS_MAX       (16)
 
-#ifndef NON_BLOCKING
-#define NON_BLOCKING    (0)
-#endif
+// the send blocks at most this long (ms) for the socket to become writable
+#define BCASOC_SEND_TIMEOUT     (10 * 1000)
+
+// the addresses of one host raced by the connect
+#define BCASOC_ADDRS_MAX        (8)
 
-extern duer_handler my_handler;
+// the segments one bcasoc_sendv takes
+#define BCASOC_IOV_MAX          (8)
+
+#ifndef DUER_CONNECT_TIMEOUT
+// the connect fails if no address of the host connected in this time (ms)
+#define DUER_CONNECT_TIMEOUT        (10 * 1000)
+#endif
 
-#if defined(NON_BLOCKING) && (NON_BLOCKING == 1)
-#define MSG_FLAG        (MSG_DONTWAIT)
-#else
-#define MSG_FLAG        (0)
+#ifndef DUER_CONNECT_ATTEMPT_DELAY
+// start the next address if the previous one hasn't connected in this time (ms),
+// the value recommended by RFC 8305 (Happy Eyeballs)
+#define DUER_CONNECT_ATTEMPT_DELAY  (250)
 #endif
 
+typedef enum _bcasoc_state_e {
+    BCASOC_ST_IDLE,
+    BCASOC_ST_RESOLVING,    // waiting for the resolver, then connecting
+    BCASOC_ST_CONNECTING,
+    BCASOC_ST_CONNECTED,
+    BCASOC_ST_FAILED,       // reported to the next bcasoc_connect
+} bcasoc_state_e;
+
+typedef union _bcasoc_sockaddr_u {
+    struct sockaddr     sa;
+    struct sockaddr_in  in;
+    struct sockaddr_in6 in6;
+} bcasoc_sockaddr_t;
+
+struct _bcasoc_s;
+
+/*
+ * The context of one lookup in flight, freed by its callback
+ */
+typedef struct _bcasoc_lookup_s {
+    struct _bcasoc_s   *soc;        // NULL if the socket is closed before the answer
+    pthread_t           caller;     // the thread of bcasoc_connect
+    duer_u16_t          port;
+} bcasoc_lookup_t;
+
+/*
+ * One address of the host, it's also the epoll data of the fd connected to it
+ */
+typedef struct _bcasoc_attempt_s {
+    struct _bcasoc_s   *soc;
+    bcasoc_sockaddr_t   addr;
+    socklen_t           addr_len;
+    int                 fd;         // -1 if not started or closed
+} bcasoc_attempt_t;
+
 typedef struct _bcasoc_s
 {
     int fd;
-    duer_timer_handler  _timer;
+    duer_transevt_func  _callback;
+    unsigned int        _rd_seq;    // bumped by the reactor on each read edge
+    unsigned int        _wr_seq;    // bumped by the reactor on each write edge
+    bcasoc_state_e      _state;
+    int                 _type;      // SOCK_STREAM or SOCK_DGRAM
+    bcasoc_attempt_t    _attempts[BCASOC_ADDRS_MAX];
+    int                 _count;     // the resolved addresses
+    int                 _started;   // the attempts started, in the order of _attempts
+    int                 _running;   // the attempts in flight
+    bcasoc_lookup_t    *_lookup;    // the lookup in flight, BCASOC_ST_RESOLVING
+    unsigned long long  _next_attempt;
+    unsigned long long  _deadline;
+    struct _bcasoc_s   *_next;      // in the connecting list of the reactor
 } bcasoc_t;
 
-static duer_events_handler  g_lightduer_events = NULL;
-static pthread_mutex_t    g_mutex;
+typedef struct _bcasoc_reactor_s {
+    int                 _epfd;
+    int                 _wakefd;    // eventfd, kicks the reactor out of epoll_wait
+    pthread_t           _thread;
+    pthread_cond_t      _cond;      // broadcast after each round of events
+    unsigned int        _round;
+    duer_bool           _polling;   // the reactor is (or just was) in epoll_wait
+    bcasoc_t           *_connecting;
+} bcasoc_reactor_t;
+
+typedef struct _bcasoc_notify_s {
+    duer_transevt_func  func;
+    duer_transevt_e     event;
+} bcasoc_notify_t;
+
+static bcasoc_reactor_t s_reactor = {-1, -1};
+static pthread_mutex_t  g_mutex;
 
 static void bcasoc_lock() {
         pthread_mutex_lock(&g_mutex);
@@ -72,145 +143,614 @@ static void bcasoc_unlock() {
         pthread_mutex_unlock(&g_mutex);
 }
 
-static unsigned int bcasoc_parse_ip(const duer_addr_t *addr)
+static unsigned long long bcasoc_now(void)
 {
-    unsigned int rs = 0;
+    struct timespec ts;
 
-    if (addr && addr->host) {
-        DUER_LOGV("bcasoc_parse_ip: ip = %s", addr->host);
-        struct hostent *hp = gethostbyname(addr->host);
-        if (!hp) {
-            DUER_LOGE("DNS failed!!!");
-        } else {
-            struct in_addr* ip4_addr;
-            if (hp->h_addrtype == AF_INET) {
-                ip4_addr = (struct in_addr*)hp->h_addr_list[0];
-                DUER_LOGI("DNS lookup succeeded. IP=%s", inet_ntoa(*ip4_addr));
-            } else if (hp->h_addrtype == AF_INET6) {
-                DUER_LOGE("ipv6 address got");
-            } else {
-                DUER_LOGE("other type(%d) address got", hp->h_addrtype);
-            }
-            if (ip4_addr) {
-                rs = htonl(ip4_addr->s_addr);
-            }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static void bcasoc_attempt_add(bcasoc_t *soc, int family, const void *ip_addr, duer_u16_t port)
+{
+    bcasoc_attempt_t *attempt = &soc->_attempts[soc->_count++];
+    char ip[INET6_ADDRSTRLEN];
+
+    DUER_MEMSET(&attempt->addr, 0, sizeof(attempt->addr));
+    if (family == AF_INET) {
+        attempt->addr.in.sin_family = AF_INET;
+        attempt->addr.in.sin_port = htons(port);
+        DUER_MEMCPY(&attempt->addr.in.sin_addr, ip_addr, sizeof(attempt->addr.in.sin_addr));
+        attempt->addr_len = sizeof(attempt->addr.in);
+    } else {
+        attempt->addr.in6.sin6_family = AF_INET6;
+        attempt->addr.in6.sin6_port = htons(port);
+        DUER_MEMCPY(&attempt->addr.in6.sin6_addr, ip_addr, sizeof(attempt->addr.in6.sin6_addr));
+        attempt->addr_len = sizeof(attempt->addr.in6);
+    }
+    attempt->fd = -1;
+    attempt->soc = soc;
+
+    inet_ntop(family, ip_addr, ip, sizeof(ip));
+    DUER_LOGI("DNS lookup succeeded. IP=%s", ip);
+}
+
+static void bcasoc_attempt_close(bcasoc_attempt_t *attempt)
+{
+    if (attempt->fd != -1) {
+        epoll_ctl(s_reactor._epfd, EPOLL_CTL_DEL, attempt->fd, NULL);
+        close(attempt->fd);
+        attempt->fd = -1;
+    }
+}
+
+static void bcasoc_unlink(bcasoc_t *soc)
+{
+    bcasoc_t **pp = &s_reactor._connecting;
+
+    while (*pp != NULL) {
+        if (*pp == soc) {
+            *pp = soc->_next;
+            break;
         }
+        pp = &(*pp)->_next;
     }
+    soc->_next = NULL;
+}
 
-    DUER_LOGV("bcasoc_parse_ip: rs = 0x%08x", rs);
+/*
+ * Stop all the attempts, should be called with the lock
+ */
+static void bcasoc_reset(bcasoc_t *soc, bcasoc_state_e state)
+{
+    int i = 0;
 
-    return rs;
+    for (i = 0; i < soc->_count; ++i) {
+        bcasoc_attempt_close(&soc->_attempts[i]);
+    }
+    if (soc->_state == BCASOC_ST_CONNECTING) {
+        bcasoc_unlink(soc);
+    }
+    soc->fd = -1;
+    soc->_running = 0;
+    soc->_state = state;
 }
 
-static void bcasoc_check_data(int what, void *object)
+/*
+ * The attempt won the race, close the others, should be called with the lock
+ *
+ * @Param registered, the attempt fd is in the epoll already
+ */
+static duer_status_t bcasoc_connected(bcasoc_t *soc, bcasoc_attempt_t *winner, duer_bool registered)
 {
-    bcasoc_t *soc = (bcasoc_t *)object;
-    int rs = 0;
+    struct epoll_event event;
+    int i = 0;
+
+    for (i = 0; i < soc->_count; ++i) {
+        if (&soc->_attempts[i] != winner) {
+            bcasoc_attempt_close(&soc->_attempts[i]);
+        }
+    }
+
+    // edge triggered, the reader drains the socket until it would block
+    DUER_MEMSET(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = winner;
+    if (epoll_ctl(s_reactor._epfd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                  winner->fd, &event) < 0) {
+        DUER_LOGE("register to the reactor failed %d:%s", errno, strerror(errno));
+        if (!registered) {
+            close(winner->fd);
+            winner->fd = -1;
+        }
+        bcasoc_reset(soc, BCASOC_ST_FAILED);
+        return DUER_ERR_TRANS_INTERNAL_ERROR;
+    }
+
+    bcasoc_unlink(soc);
+    soc->fd = winner->fd;
+    soc->_running = 0;
+    soc->_state = BCASOC_ST_CONNECTED;
+
+    return DUER_OK;
+}
+
+/*
+ * Start connecting the next address, should be called with the lock
+ *
+ * @Return duer_status_t, DUER_OK if it connected at once,
+ *         DUER_ERR_TRANS_WOULD_BLOCK if any attempt is in flight,
+ *         or DUER_ERR_TRANS_INTERNAL_ERROR if all the addresses failed
+ */
+static duer_status_t bcasoc_attempt_next(bcasoc_t *soc)
+{
+    bcasoc_attempt_t *attempt = NULL;
+    struct epoll_event event;
     int fd = -1;
 
-    if (!soc || soc->fd == -1) {
-        return;
+    while (soc->_started < soc->_count) {
+        attempt = &soc->_attempts[soc->_started++];
+
+        fd = socket(attempt->addr.sa.sa_family, soc->_type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            DUER_LOGE("socket create failed %d:%s", errno, strerror(errno));
+            continue;
+        }
+
+        if (connect(fd, &attempt->addr.sa, attempt->addr_len) == 0) {
+            attempt->fd = fd;
+            return bcasoc_connected(soc, attempt, DUER_FALSE);
+        }
+
+        if (errno != EINPROGRESS) {
+            DUER_LOGW("connect failed %d:%s", errno, strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        DUER_MEMSET(&event, 0, sizeof(event));
+        event.events = EPOLLOUT | EPOLLET;
+        event.data.ptr = attempt;
+        if (epoll_ctl(s_reactor._epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            DUER_LOGE("register to the reactor failed %d:%s", errno, strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        attempt->fd = fd;
+        soc->_running++;
+        soc->_next_attempt = bcasoc_now() + DUER_CONNECT_ATTEMPT_DELAY;
+
+        return DUER_ERR_TRANS_WOULD_BLOCK;
+    }
+
+    if (soc->_running > 0) {
+        return DUER_ERR_TRANS_WOULD_BLOCK;
+    }
+
+    bcasoc_reset(soc, BCASOC_ST_FAILED);
+
+    return DUER_ERR_TRANS_INTERNAL_ERROR;
+}
+
+/*
+ * The attempt fd became writable or failed, should be called with the lock
+ *
+ * @Return duer_status_t, same as bcasoc_attempt_next
+ */
+static duer_status_t bcasoc_attempt_done(bcasoc_t *soc, bcasoc_attempt_t *attempt, duer_u32_t events)
+{
+    socklen_t len = sizeof(int);
+    int error = 0;
+
+    if (getsockopt(attempt->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+        error = errno;
+    }
+
+    if (error == 0) {
+        if (events & EPOLLOUT) {
+            return bcasoc_connected(soc, attempt, DUER_TRUE);
+        }
+        return DUER_ERR_TRANS_WOULD_BLOCK;
     }
 
+    DUER_LOGW("connect failed %d:%s", error, strerror(error));
+    bcasoc_attempt_close(attempt);
+    soc->_running--;
+
+    // don't wait for the attempt delay, try the next one now
+    return bcasoc_attempt_next(soc);
+}
+
+/*
+ * Start connecting the addresses resolved, should be called with the lock
+ *
+ * @Return duer_status_t, same as bcasoc_attempt_next
+ */
+static duer_status_t bcasoc_start(bcasoc_t *soc)
+{
+    soc->_started = 0;
+    soc->_running = 0;
+    soc->_state = BCASOC_ST_CONNECTING;
+    soc->_next = s_reactor._connecting;
+    s_reactor._connecting = soc;
+
+    return bcasoc_attempt_next(soc);
+}
+
+/*
+ * The answer of the resolver, called directly by bcasoc_resolve if it's
+ * cached, otherwise from the resolver thread, which reports the result
+ * with DUER_TEVT_SEND_RDY unless the connect is still in flight
+ */
+static void bcasoc_resolved(duer_status_t status, const char *host,
+                            const duer_dns_result_t *result, void *ctx)
+{
+    bcasoc_lookup_t *lookup = (bcasoc_lookup_t *)ctx;
+    duer_transevt_func callback = NULL;
+    bcasoc_t *soc = NULL;
+    duer_status_t rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+    duer_size_t i = 0;
+
     bcasoc_lock();
-    // double check, maybe closed before get the lock
-    if (!soc || soc->fd == -1) {
-        return;
+    soc = lookup->soc;
+    if (soc != NULL) {
+        soc->_lookup = NULL;
+        soc->_count = 0;
+        if (status == DUER_OK) {
+            for (i = 0; i < result->count && soc->_count < BCASOC_ADDRS_MAX; ++i) {
+                bcasoc_attempt_add(soc,
+                                   result->addrs[i].family == DUER_DNS_INET ? AF_INET : AF_INET6,
+                                   result->addrs[i].addr, lookup->port);
+            }
+        }
+        if (soc->_count > 0) {
+            rs = bcasoc_start(soc);
+        } else {
+            DUER_LOGE("DNS failed: host = %s, rs = %d", host, status);
+            soc->_state = BCASOC_ST_FAILED;
+        }
+        if (rs != DUER_ERR_TRANS_WOULD_BLOCK
+                && !pthread_equal(pthread_self(), lookup->caller)) {
+            callback = soc->_callback;
+        }
+    }
+    bcasoc_unlock();
+
+    // let the reactor pick up the attempt delay and the deadline
+    if (rs == DUER_ERR_TRANS_WOULD_BLOCK) {
+        eventfd_write(s_reactor._wakefd, 1);
+    }
+
+    DUER_FREE(lookup);
+
+    if (callback) {
+        callback(DUER_TEVT_SEND_RDY);
     }
+}
+
+/*
+ * Resolve the host with the shared resolver, it doesn't block the caller
+ * if the host isn't cached, the IPv6 literal is answered here
+ *
+ * @Return duer_status_t, DUER_OK if answered (the connect is started or failed),
+ *         DUER_ERR_TRANS_WOULD_BLOCK if bcasoc_resolved will be called later,
+ *         or other errors
+ */
+static duer_status_t bcasoc_resolve(bcasoc_t *soc, const duer_addr_t *addr)
+{
+    bcasoc_lookup_t *lookup = NULL;
+    duer_dns_result_t result;
+    duer_status_t rs = DUER_OK;
 
-    fd = soc->fd;
+    if (!addr->host) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
 
-    fd_set fdread, fdex;
-    //struct timeval time = {0, 0};
+    DUER_LOGV("bcasoc_resolve: host = %s", addr->host);
 
-    FD_ZERO(&fdread);
-    FD_ZERO(&fdex);
+    lookup = (bcasoc_lookup_t *)DUER_MALLOC(sizeof(*lookup));
+    if (lookup == NULL) {
+        return DUER_ERR_MEMORY_OVERLOW;
+    }
+    lookup->soc = soc;
+    lookup->caller = pthread_self();
+    lookup->port = addr->port;
 
-    FD_SET(fd, &fdread);
-    FD_SET(fd, &fdex);
+    bcasoc_lock();
+    soc->_lookup = lookup;
+    soc->_deadline = bcasoc_now() + DUER_CONNECT_TIMEOUT;
+    soc->_state = BCASOC_ST_RESOLVING;
+    bcasoc_unlock();
+
+    if (strchr(addr->host, ':') != NULL) {
+        DUER_MEMSET(&result, 0, sizeof(result));
+        if (inet_pton(AF_INET6, addr->host, result.addrs[0].addr) == 1) {
+            result.addrs[0].family = DUER_DNS_INET6;
+            result.count = 1;
+        }
+        bcasoc_resolved(result.count > 0 ? DUER_OK : DUER_ERR_FAILED, addr->host, &result, lookup);
+        return DUER_OK;
+    }
+
+    rs = duer_dns_lookup(addr->host, bcasoc_resolved, lookup);
+    if (rs != DUER_OK && rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+        // not called back
+        DUER_LOGE("DNS lookup failed: host = %s, rs = %d", addr->host, rs);
+        bcasoc_lock();
+        soc->_lookup = NULL;
+        soc->_state = BCASOC_ST_IDLE;
+        bcasoc_unlock();
+        DUER_FREE(lookup);
+    }
+
+    return rs;
+}
+
+static unsigned int bcasoc_notify_add(bcasoc_notify_t *notify, unsigned int count,
+                                      bcasoc_t *soc, duer_transevt_e event)
+{
+    notify[count].func = soc->_callback;
+    notify[count].event = event;
+    return count + 1;
+}
 
-    rs = select(fd + 1, &fdread, NULL, &fdex, NULL);   // wait forever
-    DUER_LOGD("select rs:%d", rs);
-    if (rs > 0) {
-        if (FD_ISSET(fd, &fdread)) {
-            duer_data_available();
-        } else if (FD_ISSET(fd, &fdex)) {
-            DUER_LOGE("exception occurs %d:%s", errno, strerror(errno));
-            rs = -1;
+/*
+ * Get the epoll_wait timeout for the connecting sockets, should be called with the lock
+ */
+static int bcasoc_timeout(unsigned long long now)
+{
+    bcasoc_t *soc = NULL;
+    unsigned long long wake = 0;
+    int timeout = -1;
+
+    for (soc = s_reactor._connecting; soc != NULL; soc = soc->_next) {
+        wake = soc->_deadline;
+        if (soc->_started < soc->_count && soc->_next_attempt < wake) {
+            wake = soc->_next_attempt;
         }
-    } else if (rs == 0) {
-        if (soc->_timer) {
-            duer_timer_start(soc->_timer, 100);
+        wake = wake > now ? wake - now : 0;
+        if (timeout < 0 || wake < (unsigned long long)timeout) {
+            timeout = (int)wake;
         }
     }
 
+    return timeout;
+}
+
+static void *bcasoc_reactor_run(void *arg)
+{
+    struct epoll_event events[BCASOC_EVENTS_MAX];
+    bcasoc_notify_t notify[BCASOC_EVENTS_MAX * 2];
+    bcasoc_attempt_t *attempt = NULL;
+    bcasoc_t *soc = NULL;
+    bcasoc_t *next = NULL;
+    unsigned long long now = 0;
+    unsigned int notify_count = 0;
+    eventfd_t count = 0;
+    int timeout = -1;
+    int err = 0;
+    int rs = 0;
+    int i = 0;
+
+    do {
+        bcasoc_lock();
+        s_reactor._polling = DUER_TRUE;
+        timeout = bcasoc_timeout(bcasoc_now());
+        bcasoc_unlock();
+
+        rs = epoll_wait(s_reactor._epfd, events, BCASOC_EVENTS_MAX, timeout);
+        err = rs < 0 ? errno : 0;
+
+        bcasoc_lock();
+        s_reactor._polling = DUER_FALSE;
+        s_reactor._round++;
+        notify_count = 0;
+        for (i = 0; i < rs; ++i) {
+            attempt = (bcasoc_attempt_t *)events[i].data.ptr;
+            if (attempt == NULL) {
+                eventfd_read(s_reactor._wakefd, &count);
+                continue;
+            }
+            // closed after epoll_wait returned, bcasoc_close is waiting for this round
+            if (attempt->fd == -1) {
+                continue;
+            }
+            soc = attempt->soc;
+            if (soc->_state == BCASOC_ST_CONNECTING) {
+                if (bcasoc_attempt_done(soc, attempt, events[i].events) != DUER_ERR_TRANS_WOULD_BLOCK) {
+                    notify_count = bcasoc_notify_add(notify, notify_count, soc, DUER_TEVT_SEND_RDY);
+                }
+                continue;
+            }
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                __atomic_add_fetch(&soc->_wr_seq, 1, __ATOMIC_RELEASE);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                __atomic_add_fetch(&soc->_rd_seq, 1, __ATOMIC_RELEASE);
+                notify_count = bcasoc_notify_add(notify, notify_count, soc, DUER_TEVT_RECV_RDY);
+            }
+        }
+
+        // the connect deadlines and the attempt delays, the rest are left
+        // to the next round if the notify is full
+        now = bcasoc_now();
+        for (soc = s_reactor._connecting;
+                soc != NULL && notify_count < sizeof(notify) / sizeof(notify[0]); soc = next) {
+            next = soc->_next;
+            if (now >= soc->_deadline) {
+                DUER_LOGW("connect timeout!!!");
+                bcasoc_reset(soc, BCASOC_ST_FAILED);
+            } else if (soc->_started >= soc->_count || now < soc->_next_attempt) {
+                continue;
+            } else if (bcasoc_attempt_next(soc) == DUER_ERR_TRANS_WOULD_BLOCK) {
+                continue;
+            }
+            notify_count = bcasoc_notify_add(notify, notify_count, soc, DUER_TEVT_SEND_RDY);
+        }
+        pthread_cond_broadcast(&s_reactor._cond);
+        bcasoc_unlock();
+
+        if (err != 0 && err != EINTR) {
+            DUER_LOGE("epoll_wait failed %d:%s", err, strerror(err));
+            break;
+        }
+
+        // post to the CA queue, the engine drains the socket until it would block,
+        // or retries the start when the connect completed
+        for (i = 0; i < notify_count; ++i) {
+            if (notify[i].func) {
+                notify[i].func(notify[i].event);
+            } else if (notify[i].event == DUER_TEVT_RECV_RDY) {
+                duer_data_available();
+            }
+        }
+    } while (1);
+
+    return NULL;
+}
+
+/*
+ * Wait for the reactor to report a new edge after *seq was sampled as @seq
+ *
+ * @Param soc, the socket
+ * @Param seq_ptr, &soc->_rd_seq or &soc->_wr_seq
+ * @Param seq, the sampled value, taken before the operation that would block
+ * @Param deadline, the CLOCK_MONOTONIC time to give up
+ * @Return duer_status_t, DUER_OK on the new edge, DUER_ERR_TRANS_TIMEOUT or
+ *         DUER_ERR_TRANS_INTERNAL_ERROR if the socket is closed
+ */
+static duer_status_t bcasoc_wait(bcasoc_t *soc, unsigned int *seq_ptr, unsigned int seq,
+                                 const struct timespec *deadline)
+{
+    duer_status_t rs = DUER_OK;
+
+    bcasoc_lock();
+    while (*seq_ptr == seq && soc->fd != -1) {
+        if (pthread_cond_timedwait(&s_reactor._cond, &g_mutex, deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (soc->fd == -1) {
+        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+    } else if (*seq_ptr == seq) {
+        rs = DUER_ERR_TRANS_TIMEOUT;
+    }
     bcasoc_unlock();
+
+    return rs;
 }
 
-static int bcasoc_events_call(duer_events_func func, int what, void *object)
+static void bcasoc_deadline(struct timespec *deadline, duer_u32_t timeout)
 {
-    if (g_lightduer_events) {
-        return duer_events_call(g_lightduer_events, func, what, object);
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout / 1000;
+    deadline->tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
     }
-    return DUER_ERR_FAILED;
 }
 
-static void bcasoc_timer_expired(void *param)
+static unsigned int bcasoc_seq(unsigned int *seq_ptr)
 {
-    DUER_LOGD("bcasoc_timer_expired");
-    bcasoc_events_call(bcasoc_check_data, 0, param);
+    return __atomic_load_n(seq_ptr, __ATOMIC_ACQUIRE);
 }
 
 void bcasoc_initialize(void)
 {
-    if (g_lightduer_events == NULL) {
-        g_lightduer_events = duer_events_create("lightduer_socket", TASK_STACK_SIZE, 10);
+    pthread_condattr_t attr;
+    struct epoll_event event;
+
+    if (s_reactor._epfd != -1) {
+        return;
     }
 
     pthread_mutex_init(&g_mutex, NULL);
-}
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_reactor._cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    do {
+        s_reactor._epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (s_reactor._epfd < 0) {
+            DUER_LOGE("epoll_create1 failed %d:%s", errno, strerror(errno));
+            break;
+        }
+
+        s_reactor._wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (s_reactor._wakefd < 0) {
+            DUER_LOGE("eventfd failed %d:%s", errno, strerror(errno));
+            break;
+        }
 
+        DUER_MEMSET(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        if (epoll_ctl(s_reactor._epfd, EPOLL_CTL_ADD, s_reactor._wakefd, &event) < 0) {
+            DUER_LOGE("register the eventfd failed %d:%s", errno, strerror(errno));
+            break;
+        }
+
+        if (pthread_create(&s_reactor._thread, NULL, bcasoc_reactor_run, NULL) != 0) {
+            DUER_LOGE("Create the socket reactor failed!!!");
+            break;
+        }
+        pthread_detach(s_reactor._thread);
+
+        return;
+    } while (0);
+
+    if (s_reactor._wakefd >= 0) {
+        close(s_reactor._wakefd);
+        s_reactor._wakefd = -1;
+    }
+    if (s_reactor._epfd >= 0) {
+        close(s_reactor._epfd);
+        s_reactor._epfd = -1;
+    }
+}
 duer_socket_t bcasoc_create(duer_transevt_func context)
 {
     bcasoc_t *soc = DUER_MALLOC(sizeof(bcasoc_t));
     if (soc) {
         DUER_MEMSET(soc, 0, sizeof(bcasoc_t));
         soc->fd = -1;
+        soc->_callback = context;
     }
     return soc;
 }
-
 duer_status_t bcasoc_connect(duer_socket_t ctx, const duer_addr_t *addr)
 {
     int rs = DUER_ERR_FAILED;
     bcasoc_t *soc = (bcasoc_t *)ctx;
+    bcasoc_state_e state = BCASOC_ST_IDLE;
 
     DUER_LOGV("Entry bcasoc_connect ctx = %p", ctx);
 
-    if (soc && addr) {
-        soc->fd = socket(AF_INET, addr->type == DUER_PROTO_TCP ? SOCK_STREAM : SOCK_DGRAM,
-                         addr->type == DUER_PROTO_TCP ? IPPROTO_TCP : IPPROTO_UDP);
-        DUER_LOGV("Result bcasoc_connect fd = %d", soc->fd);
-        if (soc->fd < 0) {
-            DUER_LOGE("socket create failed: %d", soc->fd);
-            return soc->fd;
-        }
+    if (!soc || !addr) {
+        return rs;
+    }
 
-        struct sockaddr_in addr_in;
-        addr_in.sin_family = AF_INET;
-        addr_in.sin_port = htons(addr->port);
-        DUER_LOGV("Result bcasoc_connect: addr = %s", (char *)addr->host);
-        addr_in.sin_addr.s_addr = htonl(bcasoc_parse_ip(addr));
-        rs = connect(soc->fd, (struct sockaddr *)&addr_in, sizeof(addr_in));
+    // the connect is asynchronous, the transport callback gets DUER_TEVT_SEND_RDY
+    // when it's done, and the caller calls it again for the result
+    bcasoc_lock();
+    state = soc->_state;
+    if (state == BCASOC_ST_FAILED) {
+        soc->_state = BCASOC_ST_IDLE;
+    }
+    bcasoc_unlock();
 
-        if (rs >= 0) {
-#if defined(NON_BLOCKING) && (NON_BLOCKING == 1)
-            int flags = fcntl(soc->fd, F_GETFL, 0);
-            fcntl(soc->fd, F_SETFL, flags | O_NONBLOCK);
-#endif
-            soc->_timer = duer_timer_acquire(bcasoc_timer_expired, soc, DUER_TIMER_ONCE);
+    if (state == BCASOC_ST_CONNECTED) {
+        rs = DUER_OK;
+    } else if (state == BCASOC_ST_CONNECTING || state == BCASOC_ST_RESOLVING) {
+        rs = DUER_ERR_TRANS_WOULD_BLOCK;
+    } else if (state == BCASOC_ST_FAILED) {
+        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+    } else if (s_reactor._epfd < 0) {
+        DUER_LOGE("the socket reactor is not initialized");
+    } else {
+        soc->_type = addr->type == DUER_PROTO_TCP ? SOCK_STREAM : SOCK_DGRAM;
+        rs = bcasoc_resolve(soc, addr);
+        if (rs == DUER_OK) {
+            // answered from the cache, the connect is started already
+            bcasoc_lock();
+            state = soc->_state;
+            if (state == BCASOC_ST_FAILED) {
+                // reported now, not by the next call
+                soc->_state = BCASOC_ST_IDLE;
+            }
+            bcasoc_unlock();
 
-            bcasoc_events_call(bcasoc_check_data, 0, (void *)soc);
+            if (state == BCASOC_ST_CONNECTED) {
+                rs = DUER_OK;
+            } else if (state == BCASOC_ST_CONNECTING) {
+                rs = DUER_ERR_TRANS_WOULD_BLOCK;
+            } else {
+                rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+            }
         }
     }
 
@@ -223,27 +763,36 @@ duer_status_t bcasoc_send(duer_socket_t ctx, const void *data, duer_size_t size,
 {
     bcasoc_t *soc = (bcasoc_t *)ctx;
     int rs = DUER_ERR_FAILED;
-    fd_set fdw;
-    struct timeval tv;
+    duer_size_t sent = 0;
+    unsigned int seq = 0;
+    struct timespec deadline;
 
     if (!soc || soc->fd == -1) {
         return rs;
     }
 
-    FD_ZERO(&fdw);
-    FD_SET(soc->fd, &fdw);
-
-    tv.tv_sec = 10;
-    tv.tv_usec = 0;
-
-    rs = select(soc->fd + 1, NULL, &fdw, NULL, &tv);
-    if (FD_ISSET(soc->fd, &fdw)) {
-        rs = send(soc->fd, data, size, MSG_FLAG);
-    } else if (rs == 0) {
-        DUER_LOGW("send timeout!!!");
-        rs = DUER_ERR_TRANS_TIMEOUT;
-    } else if (errno != EINTR) {
-        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+    deadline.tv_sec = 0;
+    while (sent < size) {
+        seq = bcasoc_seq(&soc->_wr_seq);
+        rs = send(soc->fd, (const char *)data + sent, size - sent, MSG_DONTWAIT);
+        if (rs >= 0) {
+            sent += rs;
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+            break;
+        }
+        if (deadline.tv_sec == 0) {
+            bcasoc_deadline(&deadline, BCASOC_SEND_TIMEOUT);
+        }
+        rs = bcasoc_wait(soc, &soc->_wr_seq, seq, &deadline);
+        if (rs == DUER_ERR_TRANS_TIMEOUT) {
+            DUER_LOGW("send timeout!!!");
+        }
+        if (rs < 0) {
+            break;
+        }
     }
 
     DUER_LOGD("Result bcasoc_send rs = %d", rs);
@@ -251,37 +800,95 @@ duer_status_t bcasoc_send(duer_socket_t ctx, const void *data, duer_size_t size,
         DUER_LOGE("write socket error %d:%s", errno, strerror(errno));
     }
 
-    return rs > 0 ? size : rs;
+    return rs >= 0 ? size : rs;
 }
 
-duer_status_t bcasoc_recv(duer_socket_t ctx, void *data, duer_size_t size, duer_addr_t *addr)
+duer_status_t bcasoc_sendv(duer_socket_t ctx, const duer_iovec_t *iov, duer_size_t iovcnt, const duer_addr_t *addr)
 {
     bcasoc_t *soc = (bcasoc_t *)ctx;
     int rs = DUER_ERR_FAILED;
-    fd_set fdr;
-    struct timeval tv;
-
-    if (!soc || soc->fd == -1) {
+    struct iovec vec[BCASOC_IOV_MAX];
+    struct msghdr msg;
+    duer_size_t size = 0;
+    duer_size_t sent = 0;
+    duer_size_t i;
+    unsigned int seq = 0;
+    struct timespec deadline;
+
+    if (!soc || soc->fd == -1 || !iov || iovcnt == 0 || iovcnt > BCASOC_IOV_MAX) {
         return rs;
     }
 
-    FD_ZERO(&fdr);
-    FD_SET(soc->fd, &fdr);
+    for (i = 0; i < iovcnt; i++) {
+        vec[i].iov_base = (void *)iov[i].base;
+        vec[i].iov_len = iov[i].len;
+        size += iov[i].len;
+    }
 
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
+    DUER_MEMSET(&msg, 0, sizeof(msg));
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
 
-    rs = select(soc->fd + 1, &fdr, NULL, NULL, &tv);
-    if (FD_ISSET(soc->fd, &fdr)) {
-        rs = recv(soc->fd, data, size, MSG_FLAG);
-    } else if (rs == 0) {
-        rs = DUER_ERR_TRANS_WOULD_BLOCK;
-    } else if (errno != EINTR) {
-        rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+    deadline.tv_sec = 0;
+    while (sent < size) {
+        seq = bcasoc_seq(&soc->_wr_seq);
+        rs = sendmsg(soc->fd, &msg, MSG_DONTWAIT);
+        if (rs >= 0) {
+            sent += rs;
+            // skip what has been sent of the partial write
+            while (rs > 0 && msg.msg_iovlen > 0) {
+                if ((size_t)rs < msg.msg_iov->iov_len) {
+                    msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + rs;
+                    msg.msg_iov->iov_len -= rs;
+                    rs = 0;
+                } else {
+                    rs -= msg.msg_iov->iov_len;
+                    msg.msg_iov++;
+                    msg.msg_iovlen--;
+                }
+            }
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+            break;
+        }
+        if (deadline.tv_sec == 0) {
+            bcasoc_deadline(&deadline, BCASOC_SEND_TIMEOUT);
+        }
+        rs = bcasoc_wait(soc, &soc->_wr_seq, seq, &deadline);
+        if (rs == DUER_ERR_TRANS_TIMEOUT) {
+            DUER_LOGW("send timeout!!!");
+        }
+        if (rs < 0) {
+            break;
+        }
+    }
+
+    DUER_LOGD("Result bcasoc_sendv rs = %d", rs);
+    if (rs < 0) {
+        DUER_LOGE("write socket error %d:%s", errno, strerror(errno));
     }
 
-    if (rs > 0 ) {
-        bcasoc_timer_expired(soc);
+    return rs >= 0 ? size : rs;
+}
+
+duer_status_t bcasoc_recv(duer_socket_t ctx, void *data, duer_size_t size, duer_addr_t *addr)
+{
+    bcasoc_t *soc = (bcasoc_t *)ctx;
+    int rs = DUER_ERR_FAILED;
+
+    if (!soc || soc->fd == -1) {
+        return rs;
+    }
+
+    rs = recv(soc->fd, data, size, MSG_DONTWAIT);
+    if (rs < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            rs = DUER_ERR_TRANS_WOULD_BLOCK;
+        } else {
+            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+        }
     }
 
     if (rs < 0 && rs != DUER_ERR_TRANS_WOULD_BLOCK) {
@@ -298,47 +905,57 @@ duer_status_t bcasoc_recv_timeout(duer_socket_t ctx, void *data, duer_size_t siz
               addr);
     int rs = DUER_ERR_TRANS_INTERNAL_ERROR;
     bcasoc_t *soc = (bcasoc_t *)ctx;
-    if (soc && soc->fd != -1) {
-        fd_set fdr, fde;
-        struct timeval time = {timeout / 1000, (timeout % 1000) * 1000};
-
-        FD_ZERO(&fdr);
-        FD_SET(soc->fd, &fdr);
+    unsigned int seq = 0;
+    struct timespec deadline;
 
-        FD_ZERO(&fde);
-        FD_SET(soc->fd, &fde);
+    if (soc && soc->fd != -1) {
+        bcasoc_deadline(&deadline, timeout);
+        do {
+            seq = bcasoc_seq(&soc->_rd_seq);
+            rs = bcasoc_recv(soc, data, size, addr);
+            if (rs != DUER_ERR_TRANS_WOULD_BLOCK) {
+                break;
+            }
+            rs = bcasoc_wait(soc, &soc->_rd_seq, seq, &deadline);
+        } while (rs == DUER_OK);
 
-        rs = select(soc->fd + 1, &fdr, NULL, &fde, &time);
-        DUER_LOGV("bcasoc_recv_timeout select: rs = %d", rs);
-        if (rs == 0) {
-            rs = DUER_ERR_TRANS_TIMEOUT;
+        if (rs == DUER_ERR_TRANS_TIMEOUT) {
             DUER_LOGW("recv timeout!!!");
-        } else if (rs < 0 || FD_ISSET(soc->fd, &fde)) {
-            rs = DUER_ERR_TRANS_INTERNAL_ERROR;
+        } else if (rs < 0) {
             DUER_LOGW("recv failed: rs = %d", rs);
-        } else if (FD_ISSET(soc->fd, &fdr)) {
-            rs = bcasoc_recv(soc, data, size, addr);
         }
     }
 
-    DUER_LOGV("bcasoc_recv_timeout: rs = %d, fd = %d", rs, soc->fd);
+    DUER_LOGV("bcasoc_recv_timeout: rs = %d, fd = %d", rs, soc ? soc->fd : -1);
     return rs;
 }
-
 duer_status_t bcasoc_close(duer_socket_t ctx)
 {
     bcasoc_t *soc = (bcasoc_t *)ctx;
+    unsigned int round = 0;
+
     if (soc) {
         bcasoc_lock();
-        if (soc->fd != -1) {
-            close(soc->fd);
-            soc->fd = -1;
+        // the answer in flight is dropped by bcasoc_resolved
+        if (soc->_lookup != NULL) {
+            soc->_lookup->soc = NULL;
+            soc->_lookup = NULL;
         }
-
-        if (soc->_timer) {
-            duer_timer_release(soc->_timer);
-            soc->_timer = NULL;
+        if (soc->fd != -1 || soc->_state == BCASOC_ST_CONNECTING) {
+            bcasoc_reset(soc, BCASOC_ST_IDLE);
+            // wake up the blocked send or recv_timeout
+            pthread_cond_broadcast(&s_reactor._cond);
+            // epoll_wait may have returned this socket already, let the
+            // reactor finish that round before the caller frees the socket
+            if (s_reactor._polling && !pthread_equal(pthread_self(), s_reactor._thread)) {
+                round = s_reactor._round;
+                eventfd_write(s_reactor._wakefd, 1);
+                while (round == s_reactor._round) {
+                    pthread_cond_wait(&s_reactor._cond, &g_mutex);
+                }
+            }
         }
+        soc->_state = BCASOC_ST_IDLE;
         bcasoc_unlock();
     }
     return DUER_OK;
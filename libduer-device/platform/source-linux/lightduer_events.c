@@ -23,7 +23,7 @@
 
 #include <pthread.h>
 #include <stdbool.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "lightduer_connagent.h"
@@ -36,66 +36,365 @@ typedef struct _duer_queue_message_s {
     duer_events_func              _callback;
     int                           _what;
     void *                        _data;
+    duer_u32_t                    _enqueued;    // the timestamp in us
+    struct _duer_eq_coalesce_s*   _key;         // not NULL if posted by duer_events_call_coalesced
     struct _duer_queue_message_s* _pre;
     struct _duer_queue_message_s* _next;
 } duer_eq_message;
 
+/*
+ * The messages are pushed to the head and popped from the tail,
+ * from the tail to the head is linked by _pre.
+ */
+typedef struct _duer_eq_lane_s {
+    duer_eq_message* _head;
+    duer_eq_message* _tail;
+    size_t           _length;
+} duer_eq_lane;
+
+/*
+ * At most one message is pending for a (func, priority) posted by
+ * duer_events_call_coalesced, the _pending is cleared right before it runs.
+ */
+typedef struct _duer_eq_coalesce_s {
+    duer_events_func        _func;
+    duer_events_priority_t  _priority;
+    int                     _pending;
+    duer_u32_t              _folded;
+} duer_eq_coalesce;
+
+/*
+ * The stats of the callbacks run in one drain, kept by the task without
+ * the lock, and added to the events stats once the drain is done.
+ */
+typedef struct _duer_eq_drain_s {
+    size_t                      _count;
+    duer_events_func_stats_t    _funcs[DUER_EVENTS_STATS_FUNCS];
+} duer_eq_drain;
+
+/*
+ * The max urgent messages handled in a row when there are normal ones waiting,
+ * so a flood of urgent messages won't starve the others.
+ */
+#define DUER_EVENTS_URGENT_BURST    (8)
+
 typedef struct _duer_events_struct {
     pthread_t        _task;
     pthread_mutex_t  _mutex;
     pthread_cond_t   _cond;
-    duer_eq_message* _head;
-    duer_eq_message* _tail;
+    duer_eq_lane     _lanes[DUER_EVENTS_PRIORITY_TOTAL];
+    duer_eq_coalesce _coalesce[DUER_EVENTS_COALESCE_KEYS];
+    duer_eq_message* _pool;     // the preallocated messages, queue_length of them
+    duer_eq_message* _pool_end;
+    duer_eq_message* _free;     // the unused messages in the pool, linked by _next
     char *           _name;
     bool             _shutdown;
+    duer_events_stats_t          _stats;
+    duer_eq_drain                _drain;    // only touched by the task
+    struct _duer_events_struct*  _next;     // the created events, for the stats query
 } duer_events_t;
 
-static unsigned long long duer_events_timestamp()
+static duer_events_t *s_events_list = NULL;
+static pthread_mutex_t s_events_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline bool duer_events_is_pooled(duer_events_t *events, duer_eq_message *message)
+{
+    return message >= events->_pool && message < events->_pool_end;
+}
+
+/*
+ * Obtain a message from the pool, fallback to the heap when it's exhausted,
+ * should be called with the events->_mutex locked.
+ */
+static duer_eq_message *duer_events_message_alloc(duer_events_t *events)
+{
+    duer_eq_message *message = events->_free;
+
+    if (message) {
+        events->_free = message->_next;
+        return message;
+    }
+
+    return (duer_eq_message *)DUER_MALLOC(sizeof(duer_eq_message));
+}
+
+/*
+ * Release the messages linked by _pre, the pooled ones are given back to the
+ * pool with only one lock, the others are freed to the heap.
+ */
+static void duer_events_message_release(duer_events_t *events, duer_eq_message *message)
+{
+    duer_eq_message *first = NULL;
+    duer_eq_message *last = NULL;
+    duer_eq_message *pre = NULL;
+
+    for (; message != NULL; message = pre) {
+        pre = message->_pre;
+        if (duer_events_is_pooled(events, message)) {
+            message->_next = first;
+            first = message;
+            if (last == NULL) {
+                last = message;
+            }
+        } else {
+            DUER_FREE(message);
+        }
+    }
+
+    if (first) {
+        pthread_mutex_lock(&events->_mutex);
+        last->_next = events->_free;
+        events->_free = first;
+        pthread_mutex_unlock(&events->_mutex);
+    }
+}
+
+static duer_u32_t duer_events_timestamp()
 {
-    struct timeval tv;
-    int ret = gettimeofday(&tv, NULL);
-    if (ret) {
-        DUER_LOGE("gettimeofday error");
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        DUER_LOGE("clock_gettime error");
         return 0;
     }
-    unsigned long long time_in_microseconds = tv.tv_sec * 1000 + tv.tv_usec / 1000;
-    return time_in_microseconds;
+    // it wraps every ~71 minutes, the differences are still right
+    return (duer_u32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+static inline int duer_events_hist_index(duer_u32_t us)
+{
+    int index = us > 0 ? 32 - __builtin_clz(us) : 0;
+    return index < DUER_EVENTS_HIST_BUCKETS ? index : DUER_EVENTS_HIST_BUCKETS - 1;
+}
+
+/*
+ * Should be called with the events->_mutex locked.
+ */
+static duer_events_func_stats_t *duer_events_func_stats(duer_events_t *events,
+                                                        duer_events_func func)
+{
+    duer_events_stats_t *stats = &events->_stats;
+    size_t i;
+
+    for (i = 0; i < stats->func_count; ++i) {
+        if (stats->funcs[i].func == func) {
+            return &stats->funcs[i];
+        }
+    }
+
+    if (stats->func_count < DUER_EVENTS_STATS_FUNCS - 1) {
+        stats->funcs[stats->func_count].func = func;
+        return &stats->funcs[stats->func_count++];
+    }
+
+    // the others share the last one
+    stats->func_count = DUER_EVENTS_STATS_FUNCS;
+    stats->funcs[DUER_EVENTS_STATS_FUNCS - 1].func = NULL;
+    return &stats->funcs[DUER_EVENTS_STATS_FUNCS - 1];
+}
+
+/*
+ * Add the stats of the drain to the events stats, with one lock,
+ * duer_events_get_stats copies them under the lock, it shouldn't see them torn
+ */
+static void duer_events_publish(duer_events_t *events)
+{
+    duer_eq_drain *drain = &events->_drain;
+    duer_events_func_stats_t *src = NULL;
+    duer_events_func_stats_t *dst = NULL;
+    size_t i;
+    int j;
+
+    if (drain->_count == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&events->_mutex);
+    for (i = 0; i < drain->_count; ++i) {
+        src = &drain->_funcs[i];
+        dst = duer_events_func_stats(events, src->func);
+        dst->count += src->count;
+        for (j = 0; j < DUER_EVENTS_HIST_BUCKETS; ++j) {
+            dst->wait_hist[j] += src->wait_hist[j];
+            dst->exec_hist[j] += src->exec_hist[j];
+        }
+        if (src->wait_max > dst->wait_max) {
+            dst->wait_max = src->wait_max;
+        }
+        if (src->exec_max > dst->exec_max) {
+            dst->exec_max = src->exec_max;
+        }
+    }
+    pthread_mutex_unlock(&events->_mutex);
+
+    drain->_count = 0;
+}
+
+/*
+ * Record the callback in the stats of the drain, without the lock
+ */
+static void duer_events_record(duer_events_t *events, duer_events_func func,
+                               duer_u32_t wait, duer_u32_t exec)
+{
+    duer_eq_drain *drain = &events->_drain;
+    duer_events_func_stats_t *stats = NULL;
+    size_t i;
+
+    for (i = 0; i < drain->_count; ++i) {
+        if (drain->_funcs[i].func == func) {
+            stats = &drain->_funcs[i];
+            break;
+        }
+    }
+
+    if (stats == NULL) {
+        if (drain->_count == DUER_EVENTS_STATS_FUNCS) {
+            duer_events_publish(events);
+        }
+        stats = &drain->_funcs[drain->_count++];
+        DUER_MEMSET(stats, 0, sizeof(*stats));
+        stats->func = func;
+    }
+
+    stats->count++;
+    stats->wait_hist[duer_events_hist_index(wait)]++;
+    stats->exec_hist[duer_events_hist_index(exec)]++;
+    if (wait > stats->wait_max) {
+        stats->wait_max = wait;
+    }
+    if (exec > stats->exec_max) {
+        stats->exec_max = exec;
+    }
+}
+
+static bool duer_events_is_empty(const duer_eq_lane *lanes)
+{
+    int i;
+
+    for (i = 0; i < DUER_EVENTS_PRIORITY_TOTAL; ++i) {
+        if (lanes[i]._tail != NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Move all the messages in the src to the end of the dst.
+ */
+static void duer_events_lane_move(duer_eq_lane *dst, duer_eq_lane *src)
+{
+    if (src->_tail == NULL) {
+        return;
+    }
+
+    if (dst->_tail == NULL) {
+        dst->_tail = src->_tail;
+    } else {
+        dst->_head->_pre = src->_tail;
+    }
+    dst->_head = src->_head;
+    dst->_length += src->_length;
+
+    src->_head = NULL;
+    src->_tail = NULL;
+    src->_length = 0;
+}
+
+/*
+ * Pick the next message to handle, the urgent one first,
+ * but let a normal one go after DUER_EVENTS_URGENT_BURST urgent ones.
+ */
+static duer_eq_message *duer_events_next(duer_eq_lane *lanes, int *urgent_run)
+{
+    duer_eq_lane *lane = NULL;
+    duer_eq_message *message = NULL;
+    bool has_normal = lanes[DUER_EVENTS_PRIORITY_NORMAL]._tail != NULL;
+
+    if (lanes[DUER_EVENTS_PRIORITY_URGENT]._tail != NULL
+            && (!has_normal || *urgent_run < DUER_EVENTS_URGENT_BURST)) {
+        lane = &lanes[DUER_EVENTS_PRIORITY_URGENT];
+        (*urgent_run)++;
+    } else if (has_normal) {
+        lane = &lanes[DUER_EVENTS_PRIORITY_NORMAL];
+        *urgent_run = 0;
+    } else {
+        return NULL;
+    }
+
+    message = lane->_tail;
+    lane->_tail = message->_pre;
+    lane->_length--;
+    if (lane->_tail == NULL) {
+        lane->_head = NULL;
+    }
+
+    return message;
 }
 
 static void* duer_events_task(void* context)
 {
     duer_events_t *events = (duer_events_t *)(context);
-    unsigned long long runtime = 0;
+    duer_u32_t begin = 0;
+    duer_u32_t end = 0;
+    duer_u32_t runtime = 0;
+    duer_eq_lane pending[DUER_EVENTS_PRIORITY_TOTAL];
+    duer_eq_message* done = NULL;
     duer_eq_message* message;
+    int urgent_run = 0;
+    int i;
     DUER_LOGI("duer_events_task");
+    DUER_MEMSET(pending, 0, sizeof(pending));
     do {
         pthread_mutex_lock(&events->_mutex);
-        while (events->_tail == NULL && !events->_shutdown) {
+        while (duer_events_is_empty(events->_lanes) && duer_events_is_empty(pending)
+                && !events->_shutdown) {
             pthread_cond_wait(&events->_cond, &events->_mutex);
         }
         if (events->_shutdown) {
             pthread_mutex_unlock(&events->_mutex);
             pthread_exit(0);
         }
-        message = events->_tail;
-        events->_tail = events->_tail->_pre;
-        if (events->_tail == NULL) {
-            events->_head = NULL;
+        // take all the posted messages
+        for (i = 0; i < DUER_EVENTS_PRIORITY_TOTAL; ++i) {
+            events->_stats.depth -= events->_lanes[i]._length;
+            duer_events_lane_move(&pending[i], &events->_lanes[i]);
         }
         pthread_mutex_unlock(&events->_mutex);
 
-        if (message->_callback) {
-            runtime = duer_events_timestamp();
-            DUER_LOGD("[%s] <== event begin = %p", events->_name, message->_callback);
-            message->_callback(message->_what, message->_data);
-            runtime = duer_events_timestamp() - runtime;
-            if (runtime > 50) {
-                DUER_LOGW("[%s] <== event end = %p, timespent = %ld, message:%p", events->_name, message->_callback, runtime, message);
+        // the end of a callback is the begin of the next one
+        end = duer_events_timestamp();
+        while ((message = duer_events_next(pending, &urgent_run)) != NULL) {
+            if (message->_key) {
+                // the calls after here should post again, this one might miss their data
+                __atomic_store_n(&message->_key->_pending, 0, __ATOMIC_SEQ_CST);
+            }
+            if (message->_callback) {
+                begin = end;
+                DUER_LOGD("[%s] <== event begin = %p", events->_name, message->_callback);
+                message->_callback(message->_what, message->_data);
+                end = duer_events_timestamp();
+                runtime = end - begin;
+                if (runtime > 50000) {
+                    DUER_LOGW("[%s] <== event end = %p, timespent = %u us, message:%p", events->_name, message->_callback, runtime, message);
+                }
+                duer_events_record(events, message->_callback,
+                                   begin - message->_enqueued, runtime);
+            }
+
+            message->_pre = done;
+            done = message;
+
+            // take the new urgent messages before the rest, it's just a hint without lock
+            if (__atomic_load_n(&events->_lanes[DUER_EVENTS_PRIORITY_URGENT]._tail,
+                                __ATOMIC_RELAXED) != NULL) {
+                break;
             }
         }
-        DUER_FREE(message);
-        message = NULL;
 
+        duer_events_publish(events);
+        duer_events_message_release(events, done);
+        done = NULL;
     } while (1);
     return NULL;
 }
@@ -125,8 +424,19 @@ duer_events_handler duer_events_create(const char *name, size_t stack_size, size
 
         pthread_mutex_init(&events->_mutex, NULL);
         pthread_cond_init(&events->_cond, NULL);
-        events->_head = NULL;
-        events->_tail = NULL;
+
+        if (queue_length > 0) {
+            events->_pool = (duer_eq_message *)DUER_MALLOC(sizeof(duer_eq_message) * queue_length);
+            if (events->_pool == NULL) {
+                DUER_LOGE("[%s] Alloc the message pool failed!", name);
+                break;
+            }
+            events->_pool_end = events->_pool + queue_length;
+            for (size_t i = 0; i < queue_length; ++i) {
+                events->_pool[i]._next = events->_free;
+                events->_free = &events->_pool[i];
+            }
+        }
 
         pthread_attr_t attr;
         pthread_attr_init(&attr);
@@ -145,6 +455,11 @@ duer_events_handler duer_events_create(const char *name, size_t stack_size, size
             break;
         }
 
+        pthread_mutex_lock(&s_events_list_mutex);
+        events->_next = s_events_list;
+        s_events_list = events;
+        pthread_mutex_unlock(&s_events_list_mutex);
+
         rs = DUER_OK;
     } while (0);
 
@@ -157,17 +472,66 @@ duer_events_handler duer_events_create(const char *name, size_t stack_size, size
 }
 
 int duer_events_call(duer_events_handler handler, duer_events_func func, int what, void *object)
+{
+    return duer_events_call_with_priority(handler, DUER_EVENTS_PRIORITY_NORMAL, func, what, object);
+}
+
+/*
+ * Find the coalescing key of the (func, priority), add it if not found,
+ * should be called with the events->_mutex locked.
+ *
+ * @Return the key, NULL if all the keys are used
+ */
+static duer_eq_coalesce *duer_events_coalesce_key(duer_events_t *events,
+                                                  duer_events_priority_t priority,
+                                                  duer_events_func func)
+{
+    int i;
+
+    for (i = 0; i < DUER_EVENTS_COALESCE_KEYS; ++i) {
+        duer_eq_coalesce *key = &events->_coalesce[i];
+        if (key->_func == NULL) {
+            key->_func = func;
+            key->_priority = priority;
+            return key;
+        }
+        if (key->_func == func && key->_priority == priority) {
+            return key;
+        }
+    }
+
+    return NULL;
+}
+
+static int duer_events_post(duer_events_t *events, duer_events_priority_t priority,
+                            duer_events_func func, int what, void *object, bool coalesce)
 {
     int rs = DUER_ERR_FAILED;
-    duer_events_t *events = (duer_events_t *)handler;
+    duer_eq_lane *lane = NULL;
+    duer_eq_coalesce *key = NULL;
 
     do {
-        if (events == NULL) {
+        if (events == NULL || priority < 0 || priority >= DUER_EVENTS_PRIORITY_TOTAL) {
             break;
         }
+        lane = &events->_lanes[priority];
         DUER_LOGD("duer_events_call, name:%s, what:%d, obj:%p", events->_name, what, object);
-        duer_eq_message* message = DUER_MALLOC(sizeof(duer_eq_message));
+
+        pthread_mutex_lock(&events->_mutex);
+        if (coalesce && func != NULL) {
+            key = duer_events_coalesce_key(events, priority, func);
+            if (key != NULL && __atomic_load_n(&key->_pending, __ATOMIC_SEQ_CST)) {
+                // the pending one will do the work
+                key->_folded++;
+                events->_stats.folded++;
+                pthread_mutex_unlock(&events->_mutex);
+                return DUER_OK;
+            }
+        }
+
+        duer_eq_message* message = duer_events_message_alloc(events);
         if (message == NULL) {
+            pthread_mutex_unlock(&events->_mutex);
             DUER_LOGE("malloc duer_eq_message fail!!");
             break;
         }
@@ -175,18 +539,27 @@ int duer_events_call(duer_events_handler handler, duer_events_func func, int wha
         message->_what = what;
         message->_data = object;
         message->_pre = NULL;
+        message->_enqueued = duer_events_timestamp();
+        message->_key = key;
+        if (key != NULL) {
+            __atomic_store_n(&key->_pending, 1, __ATOMIC_SEQ_CST);
+        }
 
-        pthread_mutex_lock(&events->_mutex);
-        if (events->_head) {
-            events->_head->_pre = message;
+        bool wakeup = duer_events_is_empty(events->_lanes);
+        if (lane->_head) {
+            lane->_head->_pre = message;
         }
-        message->_next = events->_head;
-        events->_head = message;
-        if (events->_tail == NULL) {
-            events->_tail = message;
+        message->_next = lane->_head;
+        lane->_head = message;
+        if (lane->_tail == NULL) {
+            lane->_tail = message;
+        }
+        lane->_length++;
+        if (++events->_stats.depth > events->_stats.max_depth) {
+            events->_stats.max_depth = events->_stats.depth;
         }
         pthread_mutex_unlock(&events->_mutex);
-        if (events->_tail == message) {
+        if (wakeup) {
             pthread_cond_signal(&events->_cond);
         }
 
@@ -200,6 +573,18 @@ int duer_events_call(duer_events_handler handler, duer_events_func func, int wha
     return rs;
 }
 
+int duer_events_call_with_priority(duer_events_handler handler, duer_events_priority_t priority,
+                                   duer_events_func func, int what, void *object)
+{
+    return duer_events_post((duer_events_t *)handler, priority, func, what, object, false);
+}
+
+int duer_events_call_coalesced(duer_events_handler handler, duer_events_priority_t priority,
+                               duer_events_func func, int what, void *object)
+{
+    return duer_events_post((duer_events_t *)handler, priority, func, what, object, true);
+}
+
 void duer_events_destroy(duer_events_handler handler)
 {
     duer_events_t *events = (duer_events_t *)handler;
@@ -211,15 +596,34 @@ void duer_events_destroy(duer_events_handler handler)
             DUER_LOGI("already destroy!");
             return;
         }
+
+        pthread_mutex_lock(&s_events_list_mutex);
+        duer_events_t **pp = &s_events_list;
+        while (*pp != NULL && *pp != events) {
+            pp = &(*pp)->_next;
+        }
+        if (*pp != NULL) {
+            *pp = events->_next;
+        }
+        pthread_mutex_unlock(&s_events_list_mutex);
         pthread_cond_broadcast(&events->_cond);
         sleep(1);// wait for the thread exit
         pthread_mutex_lock(&events->_mutex);
-        while(events->_head) {
-            duer_eq_message* message = events->_head;
-            events->_head = events->_head->_next;
-            DUER_FREE(message);
+        for (int i = 0; i < DUER_EVENTS_PRIORITY_TOTAL; ++i) {
+            while (events->_lanes[i]._head) {
+                duer_eq_message* message = events->_lanes[i]._head;
+                events->_lanes[i]._head = message->_next;
+                if (!duer_events_is_pooled(events, message)) {
+                    DUER_FREE(message);
+                }
+            }
         }
         pthread_mutex_unlock(&events->_mutex);
+
+        if (events->_pool) {
+            DUER_FREE(events->_pool);
+            events->_pool = NULL;
+        }
         pthread_mutex_destroy(&events->_mutex);
         pthread_cond_destroy(&events->_cond);
 
@@ -231,3 +635,62 @@ void duer_events_destroy(duer_events_handler handler)
         DUER_FREE(events);
     }
 }
+
+int duer_events_get_stats(const char *name, duer_events_stats_t *stats)
+{
+    int rs = DUER_ERR_FAILED;
+    duer_events_t *events = NULL;
+
+    if (name == NULL || stats == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    pthread_mutex_lock(&s_events_list_mutex);
+    for (events = s_events_list; events != NULL; events = events->_next) {
+        if (events->_name != NULL && strcmp(events->_name, name) == 0) {
+            pthread_mutex_lock(&events->_mutex);
+            DUER_MEMCPY(stats, &events->_stats, sizeof(*stats));
+            for (int i = 0; i < DUER_EVENTS_COALESCE_KEYS && events->_coalesce[i]._func; ++i) {
+                for (size_t j = 0; j < stats->func_count; ++j) {
+                    if (stats->funcs[j].func == events->_coalesce[i]._func) {
+                        stats->funcs[j].folded += events->_coalesce[i]._folded;
+                    }
+                }
+            }
+            pthread_mutex_unlock(&events->_mutex);
+            rs = DUER_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_events_list_mutex);
+
+    return rs;
+}
+
+duer_u32_t duer_events_hist_percentile(const duer_u32_t *hist, int percent, duer_u32_t max)
+{
+    duer_u32_t bound = 0;
+    unsigned long long total = 0;
+    unsigned long long sum = 0;
+    int i;
+
+    if (hist == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < DUER_EVENTS_HIST_BUCKETS; ++i) {
+        total += hist[i];
+    }
+
+    for (i = 0; i < DUER_EVENTS_HIST_BUCKETS; ++i) {
+        sum += hist[i];
+        if (total > 0 && sum * 100 >= total * percent) {
+            break;
+        }
+    }
+
+    // the last bucket has no upper bound, and none of the values exceeds the max
+    bound = i < DUER_EVENTS_HIST_BUCKETS - 1 ? (duer_u32_t)1 << i : max;
+
+    return bound < max ? bound : max;
+}
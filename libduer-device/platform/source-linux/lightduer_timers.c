@@ -17,160 +17,442 @@
 // File: lightduer_timers.c
 // Auth: Zhang leliang (zhangleliang @baidu.com)
 // Desc: Provide the timer APIs.
+//
+//       All the timers are driven by one thread with a hierarchical timing wheel
+//       on CLOCK_MONOTONIC, one tick is 1ms. The level 0 has 256 slots, the
+//       levels 1~3 have 64 slots each, so about 18.6 hours could be reached
+//       directly, the longer ones are cascaded again. Start and stop are O(1).
 
 #include "lightduer_timers.h"
 
-#include <assert.h>
-#ifndef __COMPILER_AARCH64__
-#include <signal.h>
-#else
-#include <linux/signal.h>
-#endif
-#include <sys/types.h>
-#ifndef __COMPILER_AARCH64__
+#include <pthread.h>
+#include <stdbool.h>
 #include <time.h>
-#else
-#include <linux/time.h>
-#endif
 
 #include "lightduer_connagent.h"
+#include "lightduer_lib.h"
 #include "lightduer_log.h"
 #include "lightduer_memory.h"
 
-#define DUER_TIMER_DELAY	(100)
+#define DUER_TIMER_L0_BITS      (8)
+#define DUER_TIMER_LN_BITS      (6)
+#define DUER_TIMER_L0_SIZE      (1 << DUER_TIMER_L0_BITS)
+#define DUER_TIMER_LN_SIZE      (1 << DUER_TIMER_LN_BITS)
+#define DUER_TIMER_L0_MASK      (DUER_TIMER_L0_SIZE - 1)
+#define DUER_TIMER_LN_MASK      (DUER_TIMER_LN_SIZE - 1)
+#define DUER_TIMER_LEVELS       (4)
+#define DUER_TIMER_MAX_TICKS    (1ull << (DUER_TIMER_L0_BITS + 3 * DUER_TIMER_LN_BITS))
 
 typedef struct _duer_timers_s {
-    timer_t             _timer;
-    int                 _type;
-    duer_timer_callback _callback;
-    void *              _param;
+    struct _duer_timers_s * _pre;
+    struct _duer_timers_s * _next;
+    unsigned long long      _expires;   // the tick to be expired
+    size_t                  _period;    // the ticks for the DUER_TIMER_PERIODIC
+    duer_u32_t              _generation;// changed by every start/stop
+    int                     _type;
+    bool                    _pending;   // it's in the wheel
+    bool                    _released;  // released in its callback
+    duer_timer_callback     _callback;
+    void *                  _param;
 } duer_timers_t;
 
-static void duer_timer_callback_wrapper(union sigval param)
+// the slot is a circular list, the head is a sentinel
+typedef struct _duer_timer_slot_s {
+    duer_timers_t *         _pre;
+    duer_timers_t *         _next;
+} duer_timer_slot_t;
+
+typedef struct _duer_timer_wheel_s {
+    duer_timer_slot_t   _l0[DUER_TIMER_L0_SIZE];
+    duer_timer_slot_t   _ln[DUER_TIMER_LEVELS - 1][DUER_TIMER_LN_SIZE];
+    unsigned long long  _next_tick; // the next tick to be handled
+    unsigned long long  _wake_tick; // the tick the thread sleeps until
+    size_t              _count;     // the pending timers
+    duer_timers_t *     _running;   // the timer whose callback is running
+    struct timespec     _base;      // the time of the tick 0
+    pthread_t           _thread;
+    pthread_mutex_t     _mutex;
+    pthread_cond_t      _cond;      // wake up the timer thread
+    pthread_cond_t      _done;      // a callback finished
+} duer_timer_wheel_t;
+
+static duer_timer_wheel_t s_wheel;
+static pthread_once_t s_wheel_once = PTHREAD_ONCE_INIT;
+static int s_wheel_status = DUER_ERR_FAILED;
+
+static inline void duer_timer_list_init(duer_timer_slot_t *slot)
+{
+    slot->_pre = slot->_next = (duer_timers_t *)slot;
+}
+
+static inline void duer_timer_list_add(duer_timer_slot_t *slot, duer_timers_t *timer)
+{
+    duer_timers_t *head = (duer_timers_t *)slot;
+
+    timer->_next = head;
+    timer->_pre = slot->_pre;
+    slot->_pre->_next = timer;
+    slot->_pre = timer;
+}
+
+static inline void duer_timer_list_del(duer_timers_t *timer)
+{
+    timer->_pre->_next = timer->_next;
+    timer->_next->_pre = timer->_pre;
+    timer->_pre = timer->_next = NULL;
+}
+
+static long long duer_timer_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec - s_wheel._base.tv_sec) * 1000000000LL
+           + (ts.tv_nsec - s_wheel._base.tv_nsec);
+}
+
+static unsigned long long duer_timer_now_tick(void)
+{
+    return (unsigned long long)(duer_timer_now_ns() / 1000000);
+}
+
+/*
+ * Put the timer into the slot by its expires, should be called with the lock
+ */
+static void duer_timer_wheel_add(duer_timers_t *timer)
 {
+    unsigned long long expires = timer->_expires;
+    unsigned long long delta;
+    duer_timer_slot_t *slot = NULL;
+    int level;
+
+    if (expires < s_wheel._next_tick) {
+        expires = s_wheel._next_tick;
+    }
+
+    delta = expires - s_wheel._next_tick;
+    if (delta >= DUER_TIMER_MAX_TICKS) {
+        // too far away, cascade again later
+        expires = s_wheel._next_tick + DUER_TIMER_MAX_TICKS - 1;
+        delta = DUER_TIMER_MAX_TICKS - 1;
+    }
 
-    assert(param.sival_ptr);
+    if (delta < DUER_TIMER_L0_SIZE) {
+        slot = &s_wheel._l0[expires & DUER_TIMER_L0_MASK];
+    } else {
+        for (level = 1; level < DUER_TIMER_LEVELS; ++level) {
+            if (delta < (1ull << (DUER_TIMER_L0_BITS + level * DUER_TIMER_LN_BITS))) {
+                break;
+            }
+        }
+        slot = &s_wheel._ln[level - 1][(expires >> (DUER_TIMER_L0_BITS + (level - 1) * DUER_TIMER_LN_BITS))
+                                       & DUER_TIMER_LN_MASK];
+    }
 
-    // Which timer expired?
-    duer_timers_t *timer = (duer_timers_t *)(param.sival_ptr);
+    duer_timer_list_add(slot, timer);
+    timer->_pending = true;
+    s_wheel._count++;
+}
 
-    if (timer != NULL && timer->_callback != NULL) {
+static void duer_timer_wheel_del(duer_timers_t *timer)
+{
+    if (timer->_pending) {
+        duer_timer_list_del(timer);
+        timer->_pending = false;
+        s_wheel._count--;
+    }
+}
+
+/*
+ * Move the timers in the upper level slot to the lower levels
+ *
+ * @Return the index of the slot
+ */
+static int duer_timer_cascade(int level, int index)
+{
+    duer_timer_slot_t list;
+    duer_timer_slot_t *slot = &s_wheel._ln[level - 1][index];
+    duer_timers_t *timer = NULL;
+
+    if (slot->_next == (duer_timers_t *)slot) {
+        return index;
+    }
+
+    // take the list out, the timers might be put back into the same slot
+    list._next = slot->_next;
+    list._pre = slot->_pre;
+    list._next->_pre = (duer_timers_t *)&list;
+    list._pre->_next = (duer_timers_t *)&list;
+    duer_timer_list_init(slot);
+
+    while (list._next != (duer_timers_t *)&list) {
+        timer = list._next;
+        duer_timer_list_del(timer);
+        s_wheel._count--;
+        duer_timer_wheel_add(timer);
+    }
+
+    return index;
+}
+
+static void duer_timer_run(duer_timers_t *timer)
+{
+    duer_u32_t generation = timer->_generation;
+
+    s_wheel._running = timer;
+    pthread_mutex_unlock(&s_wheel._mutex);
+
+    if (timer->_callback) {
         timer->_callback(timer->_param);
     }
+
+    pthread_mutex_lock(&s_wheel._mutex);
+    s_wheel._running = NULL;
+
+    if (timer->_released) {
+        DUER_FREE(timer);
+    } else if (timer->_type == DUER_TIMER_PERIODIC && timer->_period > 0
+               && timer->_generation == generation && !timer->_pending) {
+        // not restarted or stopped in the callback, keep the pace
+        timer->_expires += timer->_period;
+        duer_timer_wheel_add(timer);
+    }
+
+    pthread_cond_broadcast(&s_wheel._done);
 }
 
-duer_timer_handler duer_timer_acquire(duer_timer_callback callback, void *param, int type)
+/*
+ * Handle the ticks until now, should be called with the lock
+ */
+static void duer_timer_expire(unsigned long long now)
 {
-    duer_timers_t *handle = NULL;
-    int rs = DUER_ERR_FAILED;
-    int status;
-    DUER_LOGD("duer_timer_acquire, type:%d", type);
-    do {
-        handle = (duer_timers_t *)DUER_MALLOC(sizeof(duer_timers_t));
-        if (handle == NULL) {
-            DUER_LOGE("Memory Overflow!!!");
+    duer_timer_slot_t *slot = NULL;
+    duer_timers_t *timer = NULL;
+    int index;
+    int level;
+
+    while (s_wheel._next_tick <= now) {
+        if (s_wheel._count == 0) {
+            // nothing to do, jump to now
+            s_wheel._next_tick = now + 1;
             break;
         }
 
-        handle->_callback = callback;
-        handle->_param = param;
-        handle->_type = type;
-
-        struct sigevent se;
-        se.sigev_notify = SIGEV_THREAD;
-        se.sigev_value.sival_ptr = handle;
-        se.sigev_notify_function = duer_timer_callback_wrapper;
-        se.sigev_notify_attributes = NULL;
+        index = s_wheel._next_tick & DUER_TIMER_L0_MASK;
+        if (index == 0) {
+            for (level = 1; level < DUER_TIMER_LEVELS; ++level) {
+                int i = (s_wheel._next_tick >> (DUER_TIMER_L0_BITS + (level - 1) * DUER_TIMER_LN_BITS))
+                        & DUER_TIMER_LN_MASK;
+                if (duer_timer_cascade(level, i) != 0) {
+                    break;
+                }
+            }
+        }
 
-        status = timer_create(CLOCK_REALTIME, &se, &(handle->_timer));
+        slot = &s_wheel._l0[index];
+        s_wheel._next_tick++;
 
-        if (status) {
-            DUER_LOGE("Timer Create Failed!!!, status:%d", status);
-            break;
+        // the callback might start the timers into this slot again, they are handled next round
+        while (slot->_next != (duer_timers_t *)slot) {
+            timer = slot->_next;
+            if (timer->_expires >= s_wheel._next_tick) {
+                // added while handling this tick, 256 ticks later
+                break;
+            }
+            duer_timer_wheel_del(timer);
+            duer_timer_run(timer);
         }
+    }
+}
 
-        rs = DUER_OK;
-    } while (0);
+/*
+ * Obtain the tick to wake up, only the level 0 is scanned,
+ * the thread wakes up at the end of the level 0 round for cascading anyway.
+ */
+static unsigned long long duer_timer_next_wake(void)
+{
+    unsigned long long tick = s_wheel._next_tick;
+    int index = tick & DUER_TIMER_L0_MASK;
 
-    if (rs < DUER_OK) {
-        duer_timer_release(handle);
-        handle = NULL;
+    if (index == 0) {
+        // cascade first
+        return tick;
     }
 
-    return handle;
+    for (; index < DUER_TIMER_L0_SIZE; ++index, ++tick) {
+        if (s_wheel._l0[index]._next != (duer_timers_t *)&s_wheel._l0[index]) {
+            break;
+        }
+    }
+
+    return tick;
 }
 
-int duer_timer_start(duer_timer_handler handle, size_t delay)
+static void *duer_timer_thread(void *arg)
 {
-    duer_timers_t *timer = (duer_timers_t *)handle;
-    int rs = DUER_ERR_FAILED;
+    struct timespec ts;
+    unsigned long long ms;
 
+    pthread_mutex_lock(&s_wheel._mutex);
     do {
-        if (timer == NULL || timer->_timer == NULL) {
-            rs = DUER_ERR_INVALID_PARAMETER;
-            break;
+        duer_timer_expire(duer_timer_now_tick());
+
+        if (s_wheel._count == 0) {
+            s_wheel._wake_tick = (unsigned long long)-1;
+            pthread_cond_wait(&s_wheel._cond, &s_wheel._mutex);
+            continue;
         }
 
-        long long freq_nanosecs = delay * 1000000LL;
-        struct itimerspec ts;
-        ts.it_value.tv_sec = freq_nanosecs / 1000000000;
-        ts.it_value.tv_nsec = freq_nanosecs % 1000000000;
-        if (DUER_TIMER_PERIODIC == timer->_type) {
-            ts.it_interval.tv_sec = ts.it_value.tv_sec;
-            ts.it_interval.tv_nsec = ts.it_value.tv_nsec;
-        } else {
-            ts.it_interval.tv_sec = 0;
-            ts.it_interval.tv_nsec = 0;
+        s_wheel._wake_tick = duer_timer_next_wake();
+        ms = s_wheel._wake_tick;
+        ts.tv_sec = s_wheel._base.tv_sec + ms / 1000;
+        ts.tv_nsec = s_wheel._base.tv_nsec + (ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
         }
+        pthread_cond_timedwait(&s_wheel._cond, &s_wheel._mutex, &ts);
+    } while (1);
 
-        int status = timer_settime(timer->_timer, 0, &ts, NULL);
-        if (status) {
-            DUER_LOGW("timer start failed!error:%d", status);
+    pthread_mutex_unlock(&s_wheel._mutex);
+
+    return NULL;
+}
+
+static void duer_timer_wheel_init(void)
+{
+    pthread_condattr_t attr;
+    int i;
+    int j;
+
+    clock_gettime(CLOCK_MONOTONIC, &s_wheel._base);
+
+    for (i = 0; i < DUER_TIMER_L0_SIZE; ++i) {
+        duer_timer_list_init(&s_wheel._l0[i]);
+    }
+    for (i = 0; i < DUER_TIMER_LEVELS - 1; ++i) {
+        for (j = 0; j < DUER_TIMER_LN_SIZE; ++j) {
+            duer_timer_list_init(&s_wheel._ln[i][j]);
         }
+    }
 
+    pthread_mutex_init(&s_wheel._mutex, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_wheel._cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&s_wheel._done, NULL);
+    s_wheel._wake_tick = (unsigned long long)-1;
 
-        rs = DUER_OK;
-    } while (0);
+    if (pthread_create(&s_wheel._thread, NULL, duer_timer_thread, NULL) != 0) {
+        DUER_LOGE("Create the timer thread failed!!!");
+        return;
+    }
+    pthread_detach(s_wheel._thread);
 
-    return rs;
+    s_wheel_status = DUER_OK;
 }
 
-int duer_timer_is_valid(duer_timer_handler handle)
+duer_timer_handler duer_timer_acquire(duer_timer_callback callback, void *param, int type)
+{
+    duer_timers_t *handle = NULL;
+
+    DUER_LOGD("duer_timer_acquire, type:%d", type);
+
+    pthread_once(&s_wheel_once, duer_timer_wheel_init);
+    if (s_wheel_status != DUER_OK) {
+        DUER_LOGE("Timer Create Failed!!!");
+        return NULL;
+    }
+
+    handle = (duer_timers_t *)DUER_MALLOC(sizeof(duer_timers_t));
+    if (handle == NULL) {
+        DUER_LOGE("Memory Overflow!!!");
+        return NULL;
+    }
+
+    DUER_MEMSET(handle, 0, sizeof(duer_timers_t));
+    handle->_callback = callback;
+    handle->_param = param;
+    handle->_type = type;
+
+    return handle;
+}
+
+int duer_timer_start(duer_timer_handler handle, size_t delay)
 {
     duer_timers_t *timer = (duer_timers_t *)handle;
-    return ((timer != NULL) && (timer->_timer != NULL));
+    bool wakeup = false;
+
+    if (timer == NULL) {
+        return DUER_ERR_INVALID_PARAMETER;
+    }
+
+    pthread_mutex_lock(&s_wheel._mutex);
+    duer_timer_wheel_del(timer);
+    timer->_generation++;
+    // same as timer_settime, zero delay disarms the timer
+    if (delay > 0) {
+        // round up to the next tick, so the timer never fires before the delay
+        timer->_expires = (unsigned long long)((duer_timer_now_ns() + 999999) / 1000000) + delay;
+        timer->_period = delay;
+        duer_timer_wheel_add(timer);
+        wakeup = timer->_expires < s_wheel._wake_tick;
+    }
+    pthread_mutex_unlock(&s_wheel._mutex);
+
+    if (wakeup) {
+        pthread_cond_signal(&s_wheel._cond);
+    }
+
+    return DUER_OK;
+}
+
+int duer_timer_is_valid(duer_timer_handler handle)
+{
+    return handle != NULL;
 }
 
 int duer_timer_stop(duer_timer_handler handle)
 {
     duer_timers_t *timer = (duer_timers_t *)handle;
-    if (timer != NULL && timer->_timer != NULL) {
-        struct itimerspec ts;
-        ts.it_value.tv_sec = 0;
-        ts.it_value.tv_nsec = 0;
-        ts.it_interval.tv_sec = 0;
-        ts.it_interval.tv_nsec = 0;
-
-        int status = timer_settime(timer->_timer, 0, &ts, NULL);
-        if (status) {
-            DUER_LOGW("timer stop failed!error:%d", status);
-        }
+
+    if (timer != NULL) {
+        pthread_mutex_lock(&s_wheel._mutex);
+        duer_timer_wheel_del(timer);
+        timer->_generation++;
+        pthread_mutex_unlock(&s_wheel._mutex);
     }
+
     return 0;
 }
 
 void duer_timer_release(duer_timer_handler handle)
 {
     duer_timers_t *timer = (duer_timers_t *)handle;
-    if (timer != NULL) {
-        if (timer->_timer != NULL) {
-            duer_timer_stop(timer);
-            int status = timer_delete(timer->_timer);
-            if (status) {
-                DUER_LOGW("timer delete failed!error:%d", status);
+
+    if (timer == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&s_wheel._mutex);
+    duer_timer_wheel_del(timer);
+    timer->_generation++;
+    if (s_wheel._running == timer) {
+        if (pthread_equal(pthread_self(), s_wheel._thread)) {
+            // released in its own callback, freed after it returns
+            timer->_released = true;
+            timer = NULL;
+        } else {
+            while (s_wheel._running == timer) {
+                pthread_cond_wait(&s_wheel._done, &s_wheel._mutex);
             }
-            timer->_timer = NULL;
         }
+    }
+    pthread_mutex_unlock(&s_wheel._mutex);
+
+    if (timer) {
         DUER_FREE(timer);
     }
 }
@@ -23,6 +23,7 @@
 #include "baidu_ca_adapter_internal.h"
 #include "lightduer_memory.h"
 #include "lightduer_debug.h"
+#include "lightduer_dns.h"
 #include "lightduer_timestamp.h"
 #include "lightduer_sleep.h"
 #include "lightduer_net_transport.h"
@@ -93,5 +94,8 @@ void baidu_ca_adapter_initialize(void)
     duer_thread_init(duer_get_thread_id_impl);
 
     duer_random_init(duer_random_impl);
+
+    // the name servers are added by the application with duer_dns_add_server
+    duer_dns_initialize();
 }
 
@@ -22,6 +22,7 @@
 #include "baidu_ca_adapter_internal.h"
 
 #include "lightduer_connagent.h"
+#include "lightduer_dns.h"
 #include "lightduer_log.h"
 #include "lightduer_lib.h"
 #include "lightduer_memory.h"
@@ -70,12 +71,43 @@ static void bcasoc_unlock() {
     duer_mutex_unlock(g_mutex);
 }
 
+/*
+ * Resolve the IPv4 address with the shared resolver (cached)
+ *
+ * @Return unsigned int, the address in host order, 0 if not resolved
+ */
+static unsigned int bcasoc_resolve_cached(const char *host)
+{
+    duer_dns_result_t result;
+    const duer_u8_t *ip = NULL;
+    duer_size_t i = 0;
+
+    if (duer_dns_resolve(host, &result) != DUER_OK) {
+        return 0;
+    }
+
+    for (i = 0; i < result.count; ++i) {
+        if (result.addrs[i].family == DUER_DNS_INET) {
+            ip = result.addrs[i].addr;
+            DUER_LOGI("DNS lookup succeeded. IP=%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+            return ((unsigned int)ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3];
+        }
+    }
+
+    return 0;
+}
+
 static unsigned int bcasoc_parse_ip(const duer_addr_t *addr)
 {
     unsigned int rs = 0;
 
     if (addr && addr->host) {
         DUER_LOGV("bcasoc_parse_ip: ip = %s", addr->host);
+        rs = bcasoc_resolve_cached(addr->host);
+        if (rs != 0) {
+            return rs;
+        }
+        // no name server added or answered, ask the system
         struct hostent *hp = gethostbyname(addr->host);
         if (!hp) {
             DUER_LOGE("DNS failed!!!");
@@ -152,6 +152,20 @@ int duer_events_call(duer_events_handler handler, duer_events_func func, int wha
     return rs;
 }
 
+int duer_events_call_with_priority(duer_events_handler handler, duer_events_priority_t priority,
+                                   duer_events_func func, int what, void *object)
+{
+    // the rtos::Queue has no priority, handled in order
+    return duer_events_call(handler, func, what, object);
+}
+
+int duer_events_call_coalesced(duer_events_handler handler, duer_events_priority_t priority,
+                               duer_events_func func, int what, void *object)
+{
+    // not folded here, the func is expected to handle the duplicated calls
+    return duer_events_call_with_priority(handler, priority, func, what, object);
+}
+
 void duer_events_destroy(duer_events_handler handler)
 {
     DuerHandler *events = (DuerHandler *)handler;
@@ -22,6 +22,24 @@ baidu_json* baidu_json_CreateObject(void) {
     return mock_ptr_type(baidu_json*);
 }
 
+baidu_json* baidu_json_CreateObjectWithAllocator(const baidu_json_Allocator *allocator) {
+    check_expected(allocator);
+    return mock_ptr_type(baidu_json*);
+}
+
+baidu_json* baidu_json_CreateNumberWithAllocator(double num, const baidu_json_Allocator *allocator) {
+    check_expected(num);
+    check_expected(allocator);
+    return mock_ptr_type(baidu_json*);
+}
+
+baidu_json* baidu_json_CreateStringWithAllocator(const char *string,
+                                                 const baidu_json_Allocator *allocator) {
+    check_expected(string);
+    check_expected(allocator);
+    return mock_ptr_type(baidu_json*);
+}
+
 baidu_json* baidu_json_CreateNumber(double num) {
     check_expected(num);
     return mock_ptr_type(baidu_json*);
@@ -43,6 +61,12 @@ void baidu_json_AddItemToObject(baidu_json *object, const char *string, baidu_js
     check_expected(item);
 }
 
+void baidu_json_AddItemToObjectCS(baidu_json *object, const char *string, baidu_json *item) {
+    check_expected(object);
+    check_expected(string);
+    check_expected(item);
+}
+
 baidu_json* baidu_json_CreateString(const char *string) {
     check_expected(string);
     return mock_ptr_type(baidu_json*);
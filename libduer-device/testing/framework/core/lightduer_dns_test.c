@@ -0,0 +1,358 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <string.h>
+
+#undef DUER_MEMORY_DEBUG
+#include "lightduer_dns.h"
+#include "lightduer_events.h"
+#include "lightduer_memory.h"
+#include "lightduer_mutex.h"
+#include "lightduer_net_transport_wrapper.h"
+#include "lightduer_random.h"
+
+#define MUTEX       ((duer_mutex_t)0x55AA)
+#define TRANS       ((duer_trans_handler)0xAADD)
+#define EVENTS      ((duer_events_handler)0x11BB)
+
+// the stub name server: the query for "www.baidu.com" is answered with
+// 1.2.3.4 (ttl 60s), the others with NXDOMAIN (SOA minimum 30s);
+// the A answers of the next s_drop_a servers are lost
+static duer_u8_t s_query[2][512];
+static int s_query_len[2];
+static int s_queries = 0;
+static int s_answers = 0;
+static int s_drop_a = 0;
+static duer_u16_t s_random = 0x1234;
+static duer_u32_t s_now = 1000;
+static duer_events_func s_pending_func = NULL;
+static void *s_pending_object = NULL;
+
+DUER_INT void* duer_malloc(duer_size_t size) {
+    return test_malloc(size);
+}
+
+DUER_INT void duer_free(void* ptr) {
+    test_free(ptr);
+}
+
+duer_mutex_t duer_mutex_create() {
+    return MUTEX;
+}
+
+duer_status_t duer_mutex_lock(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+duer_status_t duer_mutex_unlock(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+duer_u32_t duer_timestamp() {
+    return s_now;
+}
+
+void duer_sleep(duer_u32_t ms) {
+    s_now += ms;
+}
+
+duer_s32_t duer_random(void) {
+    s_random = s_random * 25173 + 13849;
+    return s_random;
+}
+
+duer_events_handler duer_events_create(const char *name, size_t stack_size, size_t queue_length) {
+    return EVENTS;
+}
+
+int duer_events_call(duer_events_handler handler, duer_events_func func, int what, void *object) {
+    s_pending_func = func;
+    s_pending_object = object;
+    return DUER_OK;
+}
+
+duer_trans_handler duer_trans_acquire(duer_transevt_func func, const void *key_info) {
+    return TRANS;
+}
+
+duer_status_t duer_trans_set_read_timeout(duer_trans_handler hdlr, duer_u32_t timeout) {
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_connect(duer_trans_handler hdlr, const duer_addr_t* addr) {
+    assert_int_equal(addr->port, 53);
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_send(duer_trans_handler hdlr, const void* data,
+                              duer_size_t size, const duer_addr_t* addr) {
+    assert_true(s_queries < 2);
+    memcpy(s_query[s_queries], data, size);
+    s_query_len[s_queries++] = size;
+    return size;
+}
+
+static int stub_answer(const duer_u8_t *query, int len, duer_u8_t *buf) {
+    static const duer_u8_t host[] = "\x03www\x05""baidu\x03""com";
+    static const duer_u8_t a_rr[] = {
+        0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C,
+        0x00, 0x04, 0x01, 0x02, 0x03, 0x04
+    };
+    static const duer_u8_t soa_rr[] = {
+        0xC0, 0x0C, 0x00, 0x06, 0x00, 0x01, 0x00, 0x00, 0x0E, 0x10, 0x00, 0x16,
+        0x00, 0x00,                                         // MNAME, RNAME
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,     // SERIAL, REFRESH
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,     // RETRY, EXPIRE
+        0x00, 0x00, 0x00, 0x1E                              // MINIMUM
+    };
+    duer_bool found = memcmp(query + 12, host, sizeof(host) - 1) == 0;
+    duer_bool is_a = query[len - 3] == DUER_DNS_TYPE_A;
+
+    memcpy(buf, query, len);
+    buf[2] |= 0x80;
+    if (!found) {
+        buf[3] |= 0x03;
+        buf[9] = 1;
+        memcpy(buf + len, soa_rr, sizeof(soa_rr));
+        return len + sizeof(soa_rr);
+    }
+    if (!is_a) {
+        // no AAAA record
+        return len;
+    }
+    buf[7] = 1;
+    memcpy(buf + len, a_rr, sizeof(a_rr));
+    return len + sizeof(a_rr);
+}
+
+duer_status_t duer_trans_recv(duer_trans_handler hdlr, void* data,
+                              duer_size_t size, duer_addr_t* addr) {
+    const duer_u8_t *query = NULL;
+    int len = 0;
+
+    while (s_answers < s_queries) {
+        query = s_query[s_answers];
+        len = s_query_len[s_answers++];
+        if (s_drop_a == 0 || query[len - 3] != DUER_DNS_TYPE_A) {
+            return stub_answer(query, len, data);
+        }
+    }
+
+    return DUER_ERR_TRANS_WOULD_BLOCK;
+}
+
+duer_status_t duer_trans_close(duer_trans_handler hdlr) {
+    s_queries = 0;
+    s_answers = 0;
+    if (s_drop_a > 0) {
+        s_drop_a--;
+    }
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_release(duer_trans_handler hdlr) {
+    return DUER_OK;
+}
+
+static int s_callbacks = 0;
+static duer_status_t s_callback_status = DUER_ERR_FAILED;
+
+static void lookup_callback(duer_status_t status, const char *host,
+                            const duer_dns_result_t *result, void *ctx) {
+    assert_string_equal(host, "www.baidu.com");
+    assert_ptr_equal(ctx, &s_callbacks);
+    s_callbacks++;
+    s_callback_status = status;
+}
+
+void duer_dns_build_query_test(void** state) {
+    static const duer_u8_t expected[] = {
+        0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x03, 'w', 'w', 'w', 0x05, 'b', 'a', 'i', 'd', 'u', 0x03, 'c', 'o', 'm', 0x00,
+        0x00, 0x1C, 0x00, 0x01
+    };
+    duer_u8_t buf[64];
+
+    assert_int_equal(duer_dns_build_query(buf, sizeof(buf), 0x1234, "www.baidu.com.",
+                                          DUER_DNS_TYPE_AAAA), sizeof(expected));
+    assert_memory_equal(buf, expected, sizeof(expected));
+
+    assert_int_equal(duer_dns_build_query(buf, sizeof(buf), 0, "www..com", DUER_DNS_TYPE_A),
+                     DUER_ERR_INVALID_PARAMETER);
+    assert_int_equal(duer_dns_build_query(buf, sizeof(buf), 0, "", DUER_DNS_TYPE_A),
+                     DUER_ERR_INVALID_PARAMETER);
+    assert_int_equal(duer_dns_build_query(buf, 16, 0, "www.baidu.com", DUER_DNS_TYPE_A),
+                     DUER_ERR_INVALID_PARAMETER);
+}
+
+void duer_dns_parse_response_test(void** state) {
+    // a CNAME chain to two addresses, the names compressed
+    static const duer_u8_t response[] = {
+        0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
+        0x03, 'w', 'w', 'w', 0x05, 'b', 'a', 'i', 'd', 'u', 0x03, 'c', 'o', 'm', 0x00,
+        0x00, 0x01, 0x00, 0x01,
+        0xC0, 0x0C, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x06,
+        0x01, 'a', 0x01, 'b', 0xC0, 0x16,
+        0xC0, 0x2B, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2C, 0x00, 0x04,
+        0x0A, 0x00, 0x00, 0x01,
+        0xC0, 0x2B, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x04,
+        0x0A, 0x00, 0x00, 0x02,
+    };
+    static const duer_u8_t ip[] = {0x0A, 0x00, 0x00, 0x01};
+    duer_dns_result_t result;
+
+    assert_int_equal(duer_dns_parse_response(response, sizeof(response), 0x1234, &result),
+                     DUER_OK);
+    assert_int_equal(result.count, 2);
+    assert_int_equal(result.ttl, 60);
+    assert_int_equal(result.addrs[0].family, DUER_DNS_INET);
+    assert_memory_equal(result.addrs[0].addr, ip, sizeof(ip));
+
+    // not the answer to the query
+    assert_int_equal(duer_dns_parse_response(response, sizeof(response), 0x1235, &result),
+                     DUER_ERR_INVALID_PARAMETER);
+    // truncated
+    assert_int_equal(duer_dns_parse_response(response, sizeof(response) - 1, 0x1234, &result),
+                     DUER_ERR_INVALID_PARAMETER);
+}
+
+void duer_dns_literal_test(void** state) {
+    static const duer_u8_t ip[] = {192, 168, 1, 20};
+    duer_dns_result_t result;
+
+    assert_int_equal(duer_dns_resolve("192.168.1.20", &result), DUER_OK);
+    assert_int_equal(result.count, 1);
+    assert_memory_equal(result.addrs[0].addr, ip, sizeof(ip));
+
+    assert_int_equal(duer_dns_resolve("LocalHost", &result), DUER_OK);
+    assert_int_equal(result.addrs[0].addr[0], 127);
+
+    // no server added
+    assert_int_equal(duer_dns_resolve("www.baidu.com", &result), DUER_ERR_INVALID_PARAMETER);
+}
+
+void duer_dns_cache_test(void** state) {
+    static const duer_u8_t ip[] = {1, 2, 3, 4};
+    duer_dns_result_t result;
+    duer_dns_stats_t stats;
+
+    duer_dns_initialize();
+    assert_int_equal(duer_dns_add_server("127.0.0.1", 53), DUER_OK);
+    assert_int_equal(duer_dns_add_server("localhost", 53), DUER_ERR_INVALID_PARAMETER);
+
+    assert_int_equal(duer_dns_resolve("www.baidu.com", &result), DUER_OK);
+    assert_int_equal(result.count, 1);
+    assert_int_equal(result.ttl, 60);
+    assert_memory_equal(result.addrs[0].addr, ip, sizeof(ip));
+
+    // cached, case insensitive
+    assert_int_equal(duer_dns_resolve("WWW.Baidu.com", &result), DUER_OK);
+    assert_int_equal(duer_dns_lookup("www.baidu.com", lookup_callback, &s_callbacks), DUER_OK);
+    assert_int_equal(s_callbacks, 1);
+
+    // the host doesn't exist, cached for the SOA minimum
+    assert_int_equal(duer_dns_resolve("nx.baidu.com", &result), DUER_ERR_FAILED);
+    assert_int_equal(result.ttl, 30);
+    assert_int_equal(duer_dns_resolve("nx.baidu.com", &result), DUER_ERR_FAILED);
+
+    duer_dns_get_stats(&stats);
+    assert_int_equal(stats.lookups, 5);
+    assert_int_equal(stats.misses, 2);
+    assert_int_equal(stats.hits, 3);
+    assert_int_equal(stats.negative_hits, 1);
+    assert_int_equal(stats.queries, 4);
+    assert_int_equal(stats.entries, 2);
+
+    // expired
+    s_now += 60 * 1000;
+    assert_int_equal(duer_dns_lookup("www.baidu.com", lookup_callback, &s_callbacks),
+                     DUER_ERR_TRANS_WOULD_BLOCK);
+    assert_int_equal(duer_dns_prefetch("www.baidu.com"), DUER_OK);
+    assert_int_equal(s_callbacks, 1);
+    s_pending_func(0, s_pending_object);
+    assert_int_equal(s_callbacks, 2);
+    assert_int_equal(s_callback_status, DUER_OK);
+
+    duer_dns_get_stats(&stats);
+    assert_int_equal(stats.joined, 1);
+    assert_int_equal(stats.queries, 6);
+
+    duer_dns_flush();
+    duer_dns_clear_servers();
+    duer_dns_get_stats(&stats);
+    assert_int_equal(stats.entries, 0);
+}
+
+void duer_dns_partial_answer_test(void** state) {
+    duer_dns_result_t result;
+    duer_dns_stats_t stats;
+    duer_u32_t failures = 0;
+
+    duer_dns_initialize();
+    assert_int_equal(duer_dns_add_server("127.0.0.1", 53), DUER_OK);
+    assert_int_equal(duer_dns_add_server("127.0.0.2", 53), DUER_OK);
+    duer_dns_get_stats(&stats);
+    failures = stats.failures;
+
+    // AAAA NODATA, the A answer lost by both servers: not cached as negative
+    s_drop_a = 2;
+    assert_int_equal(duer_dns_resolve("www.baidu.com", &result), DUER_ERR_TRANS_TIMEOUT);
+    duer_dns_get_stats(&stats);
+    assert_int_equal(stats.entries, 0);
+    assert_int_equal(stats.failures, failures + 1);
+
+    // lost by the first server only, the second answers
+    s_drop_a = 1;
+    assert_int_equal(duer_dns_resolve("www.baidu.com", &result), DUER_OK);
+    assert_int_equal(result.count, 1);
+    assert_int_equal(result.addrs[0].addr[0], 1);
+    assert_int_equal(s_drop_a, 0);
+
+    duer_dns_flush();
+    duer_dns_clear_servers();
+}
+
+void duer_dns_query_id_test(void** state) {
+    duer_dns_result_t result;
+    duer_u16_t ids[4];
+
+    duer_dns_initialize();
+    assert_int_equal(duer_dns_add_server("127.0.0.1", 53), DUER_OK);
+
+    // the ids come from duer_random, not a counter
+    assert_int_equal(duer_dns_resolve("nx1.baidu.com", &result), DUER_ERR_FAILED);
+    ids[0] = (s_query[0][0] << 8) | s_query[0][1];
+    ids[1] = (s_query[1][0] << 8) | s_query[1][1];
+    assert_int_equal(duer_dns_resolve("nx2.baidu.com", &result), DUER_ERR_FAILED);
+    ids[2] = (s_query[0][0] << 8) | s_query[0][1];
+    ids[3] = (s_query[1][0] << 8) | s_query[1][1];
+    assert_int_not_equal(ids[0], ids[1]);
+    assert_int_not_equal((duer_u16_t)(ids[1] - ids[0]), 1);
+    assert_int_not_equal((duer_u16_t)(ids[2] - ids[0]), 2);
+    assert_int_not_equal(ids[2], ids[3]);
+
+    duer_dns_flush();
+    duer_dns_clear_servers();
+}
+
+CMOCKA_UNIT_TEST(duer_dns_build_query_test);
+CMOCKA_UNIT_TEST(duer_dns_parse_response_test);
+CMOCKA_UNIT_TEST(duer_dns_literal_test);
+CMOCKA_UNIT_TEST(duer_dns_cache_test);
+CMOCKA_UNIT_TEST(duer_dns_partial_answer_test);
+CMOCKA_UNIT_TEST(duer_dns_query_id_test);
@@ -0,0 +1,236 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <string.h>
+
+#undef DUER_MEMORY_DEBUG
+#include "baidu_json.h"
+#include "lightduer_memory.h"
+#include "lightduer_mutex.h"
+
+#define MUTEX       ((duer_mutex_t)0x55AA)
+
+// the blocks alive in the heap behind the pool, slabs included
+static int s_heap_blocks = 0;
+static int s_heap_reallocs = 0;
+
+static void *heap_malloc(duer_context ctx, duer_size_t size) {
+    void *rs = malloc(size);
+    if (rs) {
+        s_heap_blocks++;
+    }
+    return rs;
+}
+
+static void *heap_realloc(duer_context ctx, void *ptr, duer_size_t size) {
+    s_heap_reallocs++;
+    return realloc(ptr, size);
+}
+
+static void heap_free(duer_context ctx, void *ptr) {
+    if (ptr) {
+        s_heap_blocks--;
+    }
+    free(ptr);
+}
+
+void baidu_json_InitHooks(baidu_json_Hooks* hooks) {
+}
+
+duer_mutex_t duer_mutex_create() {
+    return MUTEX;
+}
+
+duer_status_t duer_mutex_lock(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+duer_status_t duer_mutex_unlock(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+static duer_mempool_stats_t s_before;
+
+static int test_memory_setup(void **state) {
+    baidu_ca_memory_init(NULL, heap_malloc, heap_realloc, heap_free);
+    return duer_mempool_get_stats(&s_before) == DUER_OK ? 0 : -1;
+}
+
+static void test_memory_reuse(void **state) {
+    duer_mempool_stats_t stats;
+    char *a = duer_malloc(10);
+    char *b = NULL;
+    int heap = s_heap_blocks;
+
+    assert_non_null(a);
+    memset(a, 0x5A, 10);
+    duer_free(a);
+
+    // the freed chunk is served again from the free list of the class
+    b = duer_malloc(16);
+    assert_ptr_equal(a, b);
+    assert_int_equal(heap, s_heap_blocks);
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.classes[0].size, 16);
+    assert_int_equal(stats.classes[0].hits, s_before.classes[0].hits + 1);
+    assert_int_equal(stats.classes[0].in_use, s_before.classes[0].in_use + 1);
+
+    duer_free(b);
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.classes[0].in_use, s_before.classes[0].in_use);
+}
+
+static void test_memory_realloc(void **state) {
+    duer_mempool_stats_t stats;
+    char *a = duer_malloc(20);
+    char *b = NULL;
+    int i;
+
+    assert_non_null(a);
+    for (i = 0; i < 20; i++) {
+        a[i] = (char)i;
+    }
+
+    // shrink and grow inside the 32 bytes class keep the chunk
+    assert_ptr_equal(duer_realloc(a, 17), a);
+    assert_ptr_equal(duer_realloc(a, 32), a);
+
+    // moved to the 128 bytes class, the content is copied
+    b = duer_realloc(a, 100);
+    assert_non_null(b);
+    assert_ptr_not_equal(a, b);
+    for (i = 0; i < 20; i++) {
+        assert_int_equal(b[i], i);
+    }
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.classes[1].in_use, s_before.classes[1].in_use);
+    assert_int_equal(stats.classes[3].in_use, s_before.classes[3].in_use + 1);
+
+    // shrink to a smaller class gives back the big chunk
+    a = duer_realloc(b, 8);
+    assert_non_null(a);
+    for (i = 0; i < 8; i++) {
+        assert_int_equal(a[i], i);
+    }
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.classes[3].in_use, s_before.classes[3].in_use);
+    assert_int_equal(stats.classes[0].in_use, s_before.classes[0].in_use + 1);
+
+    duer_free(a);
+
+    // NULL is the same as malloc
+    a = duer_realloc(NULL, 40);
+    assert_non_null(a);
+    duer_free(a);
+}
+
+static void test_memory_large(void **state) {
+    duer_mempool_stats_t stats;
+    int heap = s_heap_blocks;
+    int reallocs = s_heap_reallocs;
+    char *a = duer_malloc(1000);
+    char *b = NULL;
+
+    assert_non_null(a);
+    assert_int_equal(heap + 1, s_heap_blocks);
+    memset(a, 0x3C, 1000);
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.large_counts, s_before.large_counts + 1);
+    assert_int_equal(stats.large_total, s_before.large_total + 1);
+
+    // large to large is left to f_realloc
+    b = duer_realloc(a, 4000);
+    assert_non_null(b);
+    assert_int_equal(reallocs + 1, s_heap_reallocs);
+    assert_int_equal(b[999], 0x3C);
+
+    // large to small goes back to the pool, the block is freed
+    a = duer_realloc(b, 64);
+    assert_non_null(a);
+    assert_int_equal(a[63], 0x3C);
+    assert_int_equal(reallocs + 1, s_heap_reallocs);
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.large_counts, s_before.large_counts);
+    assert_int_equal(stats.classes[2].in_use, s_before.classes[2].in_use + 1);
+
+    // small to large
+    b = duer_realloc(a, 512);
+    assert_non_null(b);
+    assert_int_equal(b[63], 0x3C);
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.large_counts, s_before.large_counts + 1);
+    assert_int_equal(stats.classes[2].in_use, s_before.classes[2].in_use);
+
+    duer_free(b);
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.large_counts, s_before.large_counts);
+}
+
+static void test_memory_high_water(void **state) {
+    enum { COUNT = 100 };
+    duer_mempool_stats_t stats;
+    void *chunks[COUNT];
+    int heap = 0;
+    int slabs = 0;
+    int i;
+
+    for (i = 0; i < COUNT; i++) {
+        chunks[i] = duer_malloc(256);
+        assert_non_null(chunks[i]);
+    }
+
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_true(stats.classes[4].high_water >= s_before.classes[4].in_use + COUNT);
+    slabs = stats.classes[4].slabs;
+    assert_true(slabs > s_before.classes[4].slabs);
+
+    heap = s_heap_blocks;
+    for (i = 0; i < COUNT; i++) {
+        duer_free(chunks[i]);
+    }
+
+    // the slabs are kept, see DUER_MEMPOOL_SLAB_SIZE
+    assert_int_equal(heap, s_heap_blocks);
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.classes[4].in_use, s_before.classes[4].in_use);
+    assert_int_equal(stats.classes[4].slabs, slabs);
+
+    // and serve the next burst without touching the heap
+    for (i = 0; i < COUNT; i++) {
+        chunks[i] = duer_malloc(200);
+        assert_non_null(chunks[i]);
+    }
+    assert_int_equal(heap, s_heap_blocks);
+    assert_int_equal(duer_mempool_get_stats(&stats), DUER_OK);
+    assert_int_equal(stats.classes[4].slabs, slabs);
+
+    for (i = 0; i < COUNT; i++) {
+        duer_free(chunks[i]);
+    }
+}
+
+CMOCKA_UNIT_TEST_SETUP(test_memory_reuse, test_memory_setup);
+CMOCKA_UNIT_TEST_SETUP(test_memory_realloc, test_memory_setup);
+CMOCKA_UNIT_TEST_SETUP(test_memory_large, test_memory_setup);
+CMOCKA_UNIT_TEST_SETUP(test_memory_high_water, test_memory_setup);
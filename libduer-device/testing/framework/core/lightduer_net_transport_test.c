@@ -25,7 +25,7 @@
 #define DATA_LEN 4
 #define TIMEOUT 10
 
-static duer_socket_t bcasoc_create(duer_context context) {
+static duer_socket_t bcasoc_create(duer_transevt_func context) {
     check_expected(context);
     return mock_ptr_type(duer_socket_t);
 }
@@ -46,6 +46,16 @@ static duer_status_t bcasoc_send(duer_socket_t ctx,
     return mock_type(duer_status_t);
 }
 
+static duer_status_t bcasoc_sendv(duer_socket_t ctx,
+                                  const duer_iovec_t *iov, duer_size_t iovcnt,
+                                  const duer_addr_t *addr) {
+    check_expected(ctx);
+    check_expected(iov);
+    check_expected(iovcnt);
+    check_expected(addr);
+    return mock_type(duer_status_t);
+}
+
 static duer_status_t bcasoc_recv(duer_socket_t ctx,
                                  void *data, duer_size_t size, duer_addr_t *addr) {
     check_expected(ctx);
@@ -76,12 +86,21 @@ static duer_status_t bcasoc_destroy(duer_socket_t ctx) {
     return mock_type(duer_status_t);
 }
 
+void* duer_malloc(duer_size_t size) {
+    check_expected(size);
+    return mock_ptr_type(void*);
+}
+
+void duer_free(void* ptr) {
+    check_expected(ptr);
+}
+
 static int duer_trans_create(void** state) {
     duer_trans_ptr trans = test_malloc(sizeof(duer_trans_t));
 
     assert_ptr_not_equal(trans, NULL);
     memset(trans, 0, sizeof(duer_trans_t));
-    trans->soc_context = (duer_context)SOC_CONTEXT;
+    trans->transevt_callback = (duer_transevt_func)SOC_CONTEXT;
     trans->ctx = (duer_socket_t)CONTEXT;
     trans->read_timeout = DUER_READ_FOREVER;
     *state = trans;
@@ -129,7 +148,7 @@ void duer_trans_wrapper_create_test(void** state) {
 void duer_trans_wrapper_connect_test(void** state) {
     duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
 
-    assert_ptr_equal(p_trans->soc_context, SOC_CONTEXT); // set in duer_trans_create
+    assert_ptr_equal(p_trans->transevt_callback, SOC_CONTEXT); // set in duer_trans_create
 
     duer_status_t status = duer_trans_wrapper_connect(NULL, NULL);
     assert_int_equal(status, DUER_ERR_FAILED);
@@ -144,7 +163,7 @@ void duer_trans_wrapper_connect_test(void** state) {
 void duer_trans_wrapper_send_test(void** state) {
     duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
 
-    assert_ptr_equal(p_trans->soc_context, SOC_CONTEXT); // set in duer_trans_create
+    assert_ptr_equal(p_trans->transevt_callback, SOC_CONTEXT); // set in duer_trans_create
 
     duer_status_t status = duer_trans_wrapper_send(NULL, NULL, 0, NULL);
     assert_int_equal(status, DUER_ERR_FAILED);
@@ -160,10 +179,60 @@ void duer_trans_wrapper_send_test(void** state) {
     assert_int_equal(status, DUER_OK);
 }
 
+void duer_trans_wrapper_sendv_test(void** state) {
+    duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
+    char buffer[DATA_LEN + 4];
+    duer_iovec_t iov[2] = {{"ab", 2}, {"cd", 2}};
+
+    duer_status_t status = duer_trans_wrapper_sendv(NULL, iov, 2, NULL);
+    assert_int_equal(status, DUER_ERR_FAILED);
+
+    status = duer_trans_wrapper_sendv(p_trans, iov, 0, NULL);
+    assert_int_equal(status, DUER_ERR_FAILED);
+
+    // one segment is sent as it is
+    expect_value(bcasoc_send, ctx, CONTEXT);
+    expect_value(bcasoc_send, data, iov[0].base);
+    expect_value(bcasoc_send, size, 2);
+    expect_value(bcasoc_send, addr, ADDR);
+    will_return(bcasoc_send, 2);
+    status = duer_trans_wrapper_sendv(p_trans, iov, 1, (duer_addr_t*)ADDR);
+    assert_int_equal(status, 2);
+
+    // no platform sendv, gathered for one send
+    expect_value(duer_malloc, size, DATA_LEN);
+    will_return(duer_malloc, buffer);
+    expect_value(bcasoc_send, ctx, CONTEXT);
+    expect_value(bcasoc_send, data, buffer);
+    expect_value(bcasoc_send, size, DATA_LEN);
+    expect_value(bcasoc_send, addr, ADDR);
+    will_return(bcasoc_send, DATA_LEN);
+    expect_value(duer_free, ptr, buffer);
+    status = duer_trans_wrapper_sendv(p_trans, iov, 2, (duer_addr_t*)ADDR);
+    assert_int_equal(status, DATA_LEN);
+    assert_memory_equal(buffer, "abcd", DATA_LEN);
+
+    expect_value(duer_malloc, size, DATA_LEN);
+    will_return(duer_malloc, NULL);
+    status = duer_trans_wrapper_sendv(p_trans, iov, 2, (duer_addr_t*)ADDR);
+    assert_int_equal(status, DUER_ERR_MEMORY_OVERLOW);
+
+    // the platform sendv takes the segments directly
+    baidu_ca_transport_sendv_init(bcasoc_sendv);
+    expect_value(bcasoc_sendv, ctx, CONTEXT);
+    expect_value(bcasoc_sendv, iov, iov);
+    expect_value(bcasoc_sendv, iovcnt, 2);
+    expect_value(bcasoc_sendv, addr, ADDR);
+    will_return(bcasoc_sendv, DATA_LEN);
+    status = duer_trans_wrapper_sendv(p_trans, iov, 2, (duer_addr_t*)ADDR);
+    assert_int_equal(status, DATA_LEN);
+    baidu_ca_transport_sendv_init(NULL);
+}
+
 void duer_trans_wrapper_recv_test(void** state) {
     duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
 
-    assert_ptr_equal(p_trans->soc_context, SOC_CONTEXT); // set in duer_trans_create
+    assert_ptr_equal(p_trans->transevt_callback, SOC_CONTEXT); // set in duer_trans_create
 
     duer_status_t status = duer_trans_wrapper_recv(NULL, NULL, 0, NULL);
     assert_int_equal(status, DUER_ERR_FAILED);
@@ -203,7 +272,7 @@ void duer_trans_wrapper_recv_test(void** state) {
 void duer_trans_wrapper_recv_timeout_test(void** state){
     duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
 
-    assert_ptr_equal(p_trans->soc_context, SOC_CONTEXT); // set in duer_trans_create
+    assert_ptr_equal(p_trans->transevt_callback, SOC_CONTEXT); // set in duer_trans_create
 
     duer_status_t status = duer_trans_wrapper_recv_timeout(NULL, NULL, 0, 0, NULL);
     assert_int_equal(status, DUER_ERR_FAILED);
@@ -223,7 +292,7 @@ void duer_trans_wrapper_recv_timeout_test(void** state){
 void duer_trans_wrapper_close_test(void** state) {
     duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
 
-    assert_ptr_equal(p_trans->soc_context, SOC_CONTEXT); // set in duer_trans_create
+    assert_ptr_equal(p_trans->transevt_callback, SOC_CONTEXT); // set in duer_trans_create
 
     duer_status_t status = duer_trans_wrapper_close(NULL);
     assert_int_equal(status, DUER_ERR_FAILED);
@@ -237,7 +306,7 @@ void duer_trans_wrapper_close_test(void** state) {
 void duer_trans_wrapper_destroy_test(void** state) {
     duer_trans_ptr p_trans = (duer_trans_ptr)(*state);
 
-    assert_ptr_equal(p_trans->soc_context, SOC_CONTEXT); // set in duer_trans_create
+    assert_ptr_equal(p_trans->transevt_callback, SOC_CONTEXT); // set in duer_trans_create
 
     duer_status_t status = duer_trans_wrapper_destroy(NULL);
     assert_int_equal(status, DUER_ERR_FAILED);
@@ -255,6 +324,8 @@ CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_trans_wrapper_connect_test,
                                 duer_trans_create, duer_trans_destroy);
 CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_trans_wrapper_send_test,
                                 duer_trans_create, duer_trans_destroy);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_trans_wrapper_sendv_test,
+                                duer_trans_create, duer_trans_destroy);
 CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_trans_wrapper_recv_test,
                                 duer_trans_create, duer_trans_destroy);
 CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_trans_wrapper_recv_timeout_test,
@@ -0,0 +1,228 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+#undef DUER_MEMORY_DEBUG
+#include "lightduer_aes.h"
+#include "lightduer_memory.h"
+#include "lightduer_debug.h"
+#include "mbedtls/aes.h"
+
+DUER_INT void* duer_malloc(duer_size_t size) {
+    return test_malloc(size);
+}
+
+DUER_INT void duer_free(void* ptr) {
+    test_free(ptr);
+}
+
+DUER_INT void duer_debug(duer_u32_t level, const char* file, duer_u32_t line,
+                         const char* fmt, ...) {
+}
+
+// NIST SP 800-38A, F.2.1 CBC-AES128.Encrypt
+static const unsigned char s_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static const unsigned char s_iv[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+
+static const unsigned char s_plain[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+
+static const unsigned char s_cipher[64] = {
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+    0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+    0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+    0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+    0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7,
+};
+
+/*
+ * The CBC by the software block cipher, the accelerated one is compared with
+ */
+static void soft_cbc(const unsigned char* key, unsigned int keybits, int mode,
+                     const unsigned char iv[16], size_t length,
+                     const unsigned char* input, unsigned char* output) {
+    mbedtls_aes_context aes;
+    unsigned char chain[16];
+    unsigned char block[16];
+    size_t i;
+    int j;
+
+    mbedtls_aes_init(&aes);
+    if (mode == MBEDTLS_AES_ENCRYPT) {
+        mbedtls_aes_setkey_enc(&aes, key, keybits);
+    } else {
+        mbedtls_aes_setkey_dec(&aes, key, keybits);
+    }
+
+    memcpy(chain, iv, sizeof(chain));
+    for (i = 0; i < length; i += 16) {
+        if (mode == MBEDTLS_AES_ENCRYPT) {
+            for (j = 0; j < 16; j++) {
+                block[j] = input[i + j] ^ chain[j];
+            }
+            mbedtls_aes_encrypt(&aes, block, output + i);
+            memcpy(chain, output + i, 16);
+        } else {
+            memcpy(block, input + i, 16);
+            mbedtls_aes_decrypt(&aes, block, output + i);
+            for (j = 0; j < 16; j++) {
+                output[i + j] ^= chain[j];
+            }
+            memcpy(chain, block, 16);
+        }
+    }
+
+    mbedtls_aes_free(&aes);
+}
+
+static int create_context(void** state) {
+    *state = duer_aes_context_init();
+    assert_non_null(*state);
+    return 0;
+}
+
+static int destroy_context(void** state) {
+    assert_int_equal(duer_aes_context_destroy(*state), DUER_OK);
+    return 0;
+}
+
+void duer_aes_setkey_test(void** state) {
+    unsigned char key[32] = {0};
+
+    assert_int_equal(duer_aes_setkey(NULL, key, 128), DUER_ERR_INVALID_PARAMETER);
+    assert_int_equal(duer_aes_setkey(*state, key, 100), DUER_ERR_INVALID_PARAMETER);
+    assert_int_equal(duer_aes_setkey(*state, key, 128), DUER_OK);
+    assert_int_equal(duer_aes_setkey(*state, key, 192), DUER_OK);
+    assert_int_equal(duer_aes_setkey(*state, key, 256), DUER_OK);
+}
+
+void duer_aes_cbc_encrypt_test(void** state) {
+    unsigned char output[sizeof(s_plain)];
+    unsigned char iv[16];
+
+    memcpy(iv, s_iv, sizeof(iv));
+    assert_int_equal(duer_aes_setkey(*state, s_key, 128), DUER_OK);
+    assert_int_equal(duer_aes_setiv(*state, iv), DUER_OK);
+
+    //begin the known answer
+    assert_int_equal(duer_aes_cbc_encrypt(*state, sizeof(s_plain), s_plain, output), DUER_OK);
+    assert_memory_equal(output, s_cipher, sizeof(s_cipher));
+    //end the known answer
+    //begin in place, and every message starts from the iv
+    memcpy(output, s_plain, sizeof(output));
+    assert_int_equal(duer_aes_cbc_encrypt(*state, sizeof(output), output, output), DUER_OK);
+    assert_memory_equal(output, s_cipher, sizeof(s_cipher));
+    //end in place, and every message starts from the iv
+}
+
+void duer_aes_cbc_decrypt_test(void** state) {
+    unsigned char output[sizeof(s_cipher)];
+    unsigned char iv[16];
+
+    memcpy(iv, s_iv, sizeof(iv));
+    assert_int_equal(duer_aes_setkey(*state, s_key, 128), DUER_OK);
+    assert_int_equal(duer_aes_setiv(*state, iv), DUER_OK);
+
+    assert_int_equal(duer_aes_cbc_decrypt(*state, sizeof(s_cipher), s_cipher, output), DUER_OK);
+    assert_memory_equal(output, s_plain, sizeof(s_plain));
+}
+
+void duer_aes_cbc_decrypt_update_test(void** state) {
+    unsigned char output[sizeof(s_cipher)];
+    unsigned char iv[16];
+
+    assert_int_equal(duer_aes_setkey(*state, s_key, 128), DUER_OK);
+
+    // the chain continues across the parts
+    memcpy(iv, s_iv, sizeof(iv));
+    assert_int_equal(duer_aes_cbc_decrypt_update(*state, 16, iv, s_cipher, output), DUER_OK);
+    assert_int_equal(duer_aes_cbc_decrypt_update(*state, 32, iv, s_cipher + 16, output + 16),
+                     DUER_OK);
+    assert_int_equal(duer_aes_cbc_decrypt_update(*state, 16, iv, s_cipher + 48, output + 48),
+                     DUER_OK);
+    assert_memory_equal(output, s_plain, sizeof(s_plain));
+    assert_memory_equal(iv, s_cipher + 48, sizeof(iv));
+}
+
+/*
+ * The accelerated AES (if the CPU has it) against the software one,
+ * for all the key sizes and the random data
+ */
+void duer_aes_cbc_software_test(void** state) {
+    static const unsigned int keybits[] = {128, 192, 256};
+    unsigned char key[32];
+    unsigned char iv[16];
+    unsigned char input[1024];
+    unsigned char output[1024];
+    unsigned char expected[1024];
+    size_t length;
+    size_t i;
+    size_t k;
+    int round;
+
+    srand(20171018);
+    for (round = 0; round < 50; round++) {
+        for (i = 0; i < sizeof(key); i++) {
+            key[i] = (unsigned char)rand();
+        }
+        for (i = 0; i < sizeof(iv); i++) {
+            iv[i] = (unsigned char)rand();
+        }
+        for (i = 0; i < sizeof(input); i++) {
+            input[i] = (unsigned char)rand();
+        }
+        k = round % 3;
+        length = 16 * (1 + rand() % (sizeof(input) / 16));
+
+        assert_int_equal(duer_aes_setkey(*state, key, keybits[k]), DUER_OK);
+        assert_int_equal(duer_aes_setiv(*state, iv), DUER_OK);
+
+        soft_cbc(key, keybits[k], MBEDTLS_AES_ENCRYPT, iv, length, input, expected);
+        assert_int_equal(duer_aes_cbc_encrypt(*state, length, input, output), DUER_OK);
+        assert_memory_equal(output, expected, length);
+
+        soft_cbc(key, keybits[k], MBEDTLS_AES_DECRYPT, iv, length, input, expected);
+        assert_int_equal(duer_aes_cbc_decrypt(*state, length, input, output), DUER_OK);
+        assert_memory_equal(output, expected, length);
+    }
+}
+
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_aes_setkey_test, create_context, destroy_context);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_aes_cbc_encrypt_test, create_context, destroy_context);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_aes_cbc_decrypt_test, create_context, destroy_context);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_aes_cbc_decrypt_update_test, create_context, destroy_context);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_aes_cbc_software_test, create_context, destroy_context);
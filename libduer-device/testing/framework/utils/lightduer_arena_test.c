@@ -0,0 +1,92 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#undef DUER_MEMORY_DEBUG
+#include "lightduer_arena.h"
+
+DUER_INT void* duer_malloc(duer_size_t size) {
+    check_expected(size);
+    return mock_ptr_type(void*);
+}
+
+DUER_INT void duer_free(void* ptr) {
+    check_expected(ptr);
+}
+
+// the alloced memory is 8-bytes aligned, and the first block holds 256 bytes
+const static size_t arena_size = 256;
+
+static int create_arena(void** state) {
+    char* buffer = test_malloc(1024);
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, buffer);
+    *state = duer_arena_create(arena_size);
+    assert_ptr_equal(*state, buffer);
+    return 0;
+}
+
+static int destroy_arena(void** state) {
+    expect_value(duer_free, ptr, *state);
+    duer_arena_destroy(*state);
+    test_free(*state);
+    return 0;
+}
+
+void duer_arena_create_test(void** state) {
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, NULL);
+    assert_ptr_equal(duer_arena_create(arena_size), NULL);
+}
+
+void duer_arena_alloc_test(void** state) {
+    //begin invalid parameter
+    assert_ptr_equal(duer_arena_alloc(NULL, 8), NULL);
+    assert_ptr_equal(duer_arena_alloc(*state, 0), NULL);
+    //end invalid parameter
+    //begin alloc from the first block
+    char* p1 = duer_arena_alloc(*state, 3);
+    char* p2 = duer_arena_alloc(*state, 16);
+    assert_non_null(p1);
+    assert_int_equal(((size_t)p1) % 8, 0);
+    assert_ptr_equal(p2, p1 + 8);
+    assert_int_equal(duer_arena_used(*state), 24);
+    //end alloc from the first block
+    //begin the first block exhausted
+    char* block = test_malloc(1024);
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, block);
+    char* p3 = duer_arena_alloc(*state, arena_size);
+    assert_true(p3 > block && p3 < block + 1024);
+    assert_int_equal(duer_arena_used(*state), 24 + arena_size);
+    //end the first block exhausted
+    //begin grow failed
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, NULL);
+    assert_ptr_equal(duer_arena_alloc(*state, arena_size * 2), NULL);
+    //end grow failed
+    //begin reset release the extra block
+    expect_value(duer_free, ptr, block);
+    duer_arena_reset(*state);
+    assert_int_equal(duer_arena_used(*state), 0);
+    assert_ptr_equal(duer_arena_alloc(*state, 3), p1);
+    //end reset release the extra block
+    test_free(block);
+}
+
+CMOCKA_UNIT_TEST(duer_arena_create_test);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_arena_alloc_test, create_arena, destroy_arena);
@@ -0,0 +1,108 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#undef DUER_MEMORY_DEBUG
+#include "lightduer_ring_cache.h"
+
+DUER_INT void* duer_malloc(duer_size_t size) {
+    check_expected(size);
+    return mock_ptr_type(void*);
+}
+
+DUER_INT void duer_free(void* ptr) {
+    check_expected(ptr);
+}
+
+const static size_t capacity = 3;
+static void* s_dropped = NULL;
+
+static void drop_data(void* data) {
+    s_dropped = data;
+}
+
+static duer_rcache_handler create_cache(duer_rcache_policy_t policy) {
+    char* buffer = test_malloc(1024);
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, buffer);
+    duer_rcache_handler cache = duer_rcache_create(capacity, policy, drop_data);
+    assert_ptr_equal(cache, buffer);
+    return cache;
+}
+
+static void destroy_cache(duer_rcache_handler cache) {
+    expect_value(duer_free, ptr, cache);
+    duer_rcache_destroy(cache);
+    test_free(cache);
+}
+
+void duer_rcache_create_test(void** state) {
+    assert_ptr_equal(duer_rcache_create(0, DUER_RCACHE_REJECT, NULL), NULL);
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, NULL);
+    assert_ptr_equal(duer_rcache_create(capacity, DUER_RCACHE_REJECT, NULL), NULL);
+}
+
+void duer_rcache_reject_test(void** state) {
+    int data[4];
+    size_t i = 0;
+    duer_rcache_handler cache = create_cache(DUER_RCACHE_REJECT);
+    //begin invalid parameter
+    assert_int_equal(duer_rcache_push(NULL, data), DUER_ERR_INVALID_PARAMETER);
+    assert_ptr_equal(duer_rcache_pop(NULL), NULL);
+    assert_ptr_equal(duer_rcache_top(cache), NULL);
+    //end invalid parameter
+    //begin push until full
+    for (i = 0; i < capacity; ++i) {
+        assert_int_equal(duer_rcache_push(cache, &data[i]), DUER_OK);
+    }
+    assert_int_equal(duer_rcache_push(cache, &data[3]), DUER_ERR_TRANS_WOULD_BLOCK);
+    assert_int_equal(duer_rcache_length(cache), capacity);
+    assert_int_equal(duer_rcache_dropped(cache), 0);
+    //end push until full
+    //begin wrap around
+    assert_ptr_equal(duer_rcache_pop(cache), &data[0]);
+    assert_int_equal(duer_rcache_push(cache, &data[3]), DUER_OK);
+    for (i = 1; i <= capacity; ++i) {
+        assert_ptr_equal(duer_rcache_top(cache), &data[i]);
+        assert_ptr_equal(duer_rcache_pop(cache), &data[i]);
+    }
+    assert_ptr_equal(duer_rcache_pop(cache), NULL);
+    assert_int_equal(duer_rcache_length(cache), 0);
+    //end wrap around
+    destroy_cache(cache);
+}
+
+void duer_rcache_drop_oldest_test(void** state) {
+    int data[4];
+    size_t i = 0;
+    duer_rcache_handler cache = create_cache(DUER_RCACHE_DROP_OLDEST);
+
+    for (i = 0; i < 4; ++i) {
+        assert_int_equal(duer_rcache_push(cache, &data[i]), DUER_OK);
+    }
+    assert_ptr_equal(s_dropped, &data[0]);
+    assert_int_equal(duer_rcache_dropped(cache), 1);
+    assert_int_equal(duer_rcache_length(cache), capacity);
+    assert_ptr_equal(duer_rcache_pop(cache), &data[1]);
+
+    destroy_cache(cache);
+}
+
+CMOCKA_UNIT_TEST(duer_rcache_create_test);
+CMOCKA_UNIT_TEST(duer_rcache_reject_test);
+CMOCKA_UNIT_TEST(duer_rcache_drop_oldest_test);
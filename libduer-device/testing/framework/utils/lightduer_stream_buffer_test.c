@@ -0,0 +1,132 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#undef DUER_MEMORY_DEBUG
+#include "lightduer_stream_buffer.h"
+
+// will_return 1 to alloc, 0 to fail
+DUER_INT void* duer_malloc(duer_size_t size) {
+    check_expected(size);
+    return mock_type(int) ? test_malloc(size) : NULL;
+}
+
+DUER_INT void duer_free(void* ptr) {
+    test_free(ptr);
+}
+
+static duer_sbuf_handler create_buffer(void) {
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, 1);
+    duer_sbuf_handler buf = duer_sbuf_create(8, 32);
+    assert_ptr_not_equal(buf, NULL);
+    return buf;
+}
+
+static void write_buffer(duer_sbuf_handler buf, const char* data) {
+    duer_size_t room = 0;
+    char* p = duer_sbuf_reserve(buf, strlen(data), &room);
+    assert_ptr_not_equal(p, NULL);
+    assert_true(room >= strlen(data));
+    memcpy(p, data, strlen(data));
+    duer_sbuf_commit(buf, strlen(data));
+}
+
+void duer_sbuf_create_test(void** state) {
+    assert_ptr_equal(duer_sbuf_create(0, 32), NULL);
+    assert_ptr_equal(duer_sbuf_create(8, 4), NULL);
+    expect_any(duer_malloc, size);
+    will_return(duer_malloc, 0);
+    assert_ptr_equal(duer_sbuf_create(8, 32), NULL);
+}
+
+void duer_sbuf_partial_test(void** state) {
+    duer_sbuf_handler buf = create_buffer();
+    duer_size_t size = 0;
+    duer_size_t room = 0;
+    char* data = NULL;
+
+    assert_ptr_equal(duer_sbuf_data(buf, &size), NULL);
+    assert_int_equal(size, 0);
+
+    // the memory is alloced on the first reserve
+    expect_value(duer_malloc, size, 8);
+    will_return(duer_malloc, 1);
+    write_buffer(buf, "abcdef");
+    data = duer_sbuf_data(buf, &size);
+    assert_int_equal(size, 6);
+    assert_memory_equal(data, "abcdef", 6);
+
+    // a message read, the partial one is kept
+    duer_sbuf_consume(buf, 4);
+    assert_int_equal(duer_sbuf_length(buf), 2);
+
+    // moved to the front for the room, without alloc
+    write_buffer(buf, "ghijkl");
+    data = duer_sbuf_data(buf, &size);
+    assert_int_equal(size, 8);
+    assert_memory_equal(data, "efghijkl", 8);
+
+    // all read, starts from the front again
+    duer_sbuf_consume(buf, 8);
+    assert_int_equal(duer_sbuf_length(buf), 0);
+    data = duer_sbuf_reserve(buf, 1, &room);
+    assert_int_equal(room, 8);
+
+    duer_sbuf_destroy(buf);
+}
+
+void duer_sbuf_grow_test(void** state) {
+    duer_sbuf_handler buf = create_buffer();
+    duer_size_t size = 0;
+    duer_size_t room = 0;
+    char* data = NULL;
+
+    expect_value(duer_malloc, size, 8);
+    will_return(duer_malloc, 1);
+    write_buffer(buf, "0123456");
+    duer_sbuf_consume(buf, 4);
+
+    // grown for the large message, only the unread bytes are kept
+    expect_value(duer_malloc, size, 16);
+    will_return(duer_malloc, 1);
+    write_buffer(buf, "abcdefghij");
+    data = duer_sbuf_data(buf, &size);
+    assert_int_equal(size, 13);
+    assert_memory_equal(data, "456abcdefghij", 13);
+
+    // can't grow over the max, the content is kept
+    assert_ptr_equal(duer_sbuf_reserve(buf, 20, &room), NULL);
+    expect_value(duer_malloc, size, 32);
+    will_return(duer_malloc, 0);
+    assert_ptr_equal(duer_sbuf_reserve(buf, 19, &room), NULL);
+    assert_int_equal(duer_sbuf_length(buf), 13);
+
+    // shrinked back when empty
+    duer_sbuf_reset(buf);
+    assert_int_equal(duer_sbuf_length(buf), 0);
+    expect_value(duer_malloc, size, 8);
+    will_return(duer_malloc, 1);
+    duer_sbuf_reserve(buf, 1, &room);
+    assert_int_equal(room, 8);
+
+    duer_sbuf_destroy(buf);
+}
+
+CMOCKA_UNIT_TEST(duer_sbuf_create_test);
+CMOCKA_UNIT_TEST(duer_sbuf_partial_test);
+CMOCKA_UNIT_TEST(duer_sbuf_grow_test);
@@ -0,0 +1,642 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#undef DUER_MEMORY_DEBUG
+#include <stdlib.h>
+#include <string.h>
+#include "lightduer_coap.h"
+#include "lightduer_memory.h"
+#include "lightduer_timestamp.h"
+#include "lightduer_net_transport_wrapper.h"
+
+#define TEST_COAP_TCP_HDR   (0xbeefdead)
+#define TEST_PACKET_MAX     (1200)
+#define TEST_SENT_MAX       (32)
+#define TEST_RESULT_MAX     (32)
+#define TEST_BLOCK_HDR      (16)    // the size kept in front of the block, aligned
+
+#define TEST_OPT_BLOCK2     (23)
+#define TEST_OPT_BLOCK1     (27)
+#define TEST_OPT_SIZE2      (28)
+
+#define TEST_TYPE_NON       (1)
+#define TEST_TYPE_ACK       (2)
+
+#define TEST_CODE_CONTINUE  (0x5f)  // 2.31
+
+// the answer held is one block, the message with the token and the payload
+#define TEST_HELD_PAYLOAD   (333)
+#define TEST_HELD_SIZE      (sizeof(duer_msg_t) + 1 + TEST_HELD_PAYLOAD)
+
+/*
+ * The CoAP message sent by the client, parsed from the TCP frame
+ */
+typedef struct _test_sent_s {
+    int         type;
+    int         code;
+    duer_u16_t  msg_id;
+    int         token_len;
+    duer_u8_t   token[8];
+    long        block1;     // -1 if none
+    long        block2;     // -1 if none
+    size_t      payload_len;
+} test_sent_t;
+
+typedef struct _test_result_s {
+    int         code;
+    duer_u8_t   token;
+    size_t      block_offset;
+    int         block_more;
+    size_t      payload_len;
+} test_result_t;
+
+static int s_trans;
+static int s_send_ready;
+static duer_u32_t s_now;    // by milliseconds
+
+static test_sent_t s_sent[TEST_SENT_MAX];
+static int s_sent_count;
+static test_result_t s_results[TEST_RESULT_MAX];
+static int s_result_count;
+
+static duer_u8_t s_rx[TEST_PACKET_MAX * 4];
+static size_t s_rx_len;
+
+static int s_allocated;
+static size_t s_watch_size; // the live blocks of the size are counted
+static int s_watched;
+
+/*
+ * The size is kept in front of the block, to count the watched ones
+ */
+DUER_INT_IMPL void *duer_malloc(duer_size_t size)
+{
+    size_t *block = malloc(TEST_BLOCK_HDR + size);
+
+    if (!block) {
+        return NULL;
+    }
+
+    *block = size;
+    s_allocated++;
+    if (size == s_watch_size) {
+        s_watched++;
+    }
+
+    return (char *)block + TEST_BLOCK_HDR;
+}
+
+DUER_INT_IMPL void duer_free(void *ptr)
+{
+    size_t *block = NULL;
+
+    if (!ptr) {
+        return;
+    }
+
+    block = (size_t *)((char *)ptr - TEST_BLOCK_HDR);
+    s_allocated--;
+    if (*block == s_watch_size) {
+        s_watched--;
+    }
+    free(block);
+}
+
+DUER_INT_IMPL void *duer_realloc(void *ptr, duer_size_t size)
+{
+    void *p = duer_malloc(size);
+    size_t *block = NULL;
+
+    if (p && ptr) {
+        block = (size_t *)((char *)ptr - TEST_BLOCK_HDR);
+        memcpy(p, ptr, *block < size ? *block : size);
+        duer_free(ptr);
+    }
+
+    return p;
+}
+
+duer_u32_t duer_timestamp(void)
+{
+    return s_now;
+}
+
+static long test_option_value(const duer_u8_t *p, int len)
+{
+    long value = 0;
+
+    while (len-- > 0) {
+        value = (value << 8) | *p++;
+    }
+
+    return value;
+}
+
+static void test_parse(const duer_u8_t *p, size_t size)
+{
+    test_sent_t *sent = &s_sent[s_sent_count];
+    const duer_u8_t *end = p + size;
+    int number = 0;
+    int delta;
+    int len;
+
+    assert_true(s_sent_count < TEST_SENT_MAX);
+    memset(sent, 0, sizeof(*sent));
+    sent->block1 = -1;
+    sent->block2 = -1;
+    sent->type = (p[0] >> 4) & 0x03;
+    sent->token_len = p[0] & 0x0f;
+    sent->code = p[1];
+    sent->msg_id = (p[2] << 8) | p[3];
+    memcpy(sent->token, p + 4, sent->token_len);
+    p += 4 + sent->token_len;
+
+    while (p < end && *p != 0xff) {
+        delta = *p >> 4;
+        len = *p & 0x0f;
+        p++;
+        if (delta == 13) {
+            delta = 13 + *p++;
+        } else if (delta == 14) {
+            delta = 269 + ((p[0] << 8) | p[1]);
+            p += 2;
+        }
+        if (len == 13) {
+            len = 13 + *p++;
+        } else if (len == 14) {
+            len = 269 + ((p[0] << 8) | p[1]);
+            p += 2;
+        }
+        number += delta;
+        if (number == TEST_OPT_BLOCK1) {
+            sent->block1 = test_option_value(p, len);
+        } else if (number == TEST_OPT_BLOCK2) {
+            sent->block2 = test_option_value(p, len);
+        }
+        p += len;
+    }
+
+    if (p < end) {
+        sent->payload_len = end - p - 1;
+    }
+
+    s_sent_count++;
+}
+
+duer_trans_handler duer_trans_acquire(duer_transevt_func func, const void *key_info)
+{
+    return &s_trans;
+}
+
+duer_status_t duer_trans_set_pk(duer_trans_handler hdlr, const void *data, duer_size_t size)
+{
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_set_read_timeout(duer_trans_handler hdlr, duer_u32_t timeout)
+{
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_connect(duer_trans_handler hdlr, const duer_addr_t *addr)
+{
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_sendv(duer_trans_handler hdlr, const duer_iovec_t *iov,
+                               duer_size_t iovcnt, const duer_addr_t *addr)
+{
+    duer_u8_t buf[TEST_PACKET_MAX + 8];
+    size_t size = 0;
+    size_t i;
+
+    for (i = 0; i < iovcnt; i++) {
+        assert_true(size + iov[i].len <= sizeof(buf));
+        memcpy(buf + size, iov[i].base, iov[i].len);
+        size += iov[i].len;
+    }
+
+    // skip the frame header of the TCP
+    test_parse(buf + 8, size - 8);
+
+    return size;
+}
+
+duer_status_t duer_trans_recv(duer_trans_handler hdlr, void *data, duer_size_t size,
+                              duer_addr_t *addr)
+{
+    if (s_rx_len == 0) {
+        return DUER_ERR_TRANS_WOULD_BLOCK;
+    }
+
+    size = size < s_rx_len ? size : s_rx_len;
+    memcpy(data, s_rx, size);
+    memmove(s_rx, s_rx + size, s_rx_len - size);
+    s_rx_len -= size;
+
+    return size;
+}
+
+duer_status_t duer_trans_close(duer_trans_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_release(duer_trans_handler hdlr)
+{
+    return DUER_OK;
+}
+
+duer_status_t duer_trans_release_idle(duer_trans_handler hdlr)
+{
+    return DUER_OK;
+}
+
+static void test_transevt(duer_transevt_e event)
+{
+    if (event == DUER_TEVT_SEND_RDY) {
+        s_send_ready++;
+    }
+}
+
+static duer_status_t test_result(duer_context ctx, duer_coap_handler hdlr,
+                                 const duer_msg_t *msg, const duer_addr_t *addr)
+{
+    test_result_t *result = &s_results[s_result_count++];
+
+    assert_true(s_result_count <= TEST_RESULT_MAX);
+    result->code = msg->msg_code;
+    result->token = msg->token_len > 0 ? msg->token[0] : 0;
+    result->block_offset = msg->block_offset;
+    result->block_more = msg->block_more;
+    result->payload_len = msg->payload_len;
+
+    return DUER_OK;
+}
+
+static duer_u8_t *test_option(duer_u8_t *p, int *last, int number, long value)
+{
+    duer_u8_t bytes[4];
+    int len = 0;
+    int delta = number - *last;
+
+    while (value > 0) {
+        bytes[len++] = value & 0xff;
+        value >>= 8;
+    }
+
+    // the deltas here < 269
+    if (delta < 13) {
+        *p++ = (delta << 4) | len;
+    } else {
+        *p++ = (13 << 4) | len;
+        *p++ = delta - 13;
+    }
+    while (len > 0) {
+        *p++ = bytes[--len];
+    }
+    *last = number;
+
+    return p;
+}
+
+/*
+ * The server answers by the message queued in the stream, the options are
+ * left out if < 0, then the client reads it
+ */
+static duer_status_t test_answer(duer_coap_handler coap, int type, int code,
+                                 duer_u16_t msg_id, duer_u8_t token,
+                                 long block2, long block1, long size2, size_t payload_len)
+{
+    duer_u8_t *frame = s_rx + s_rx_len;
+    duer_u8_t *p = frame + 8;
+    int last = 0;
+    size_t size;
+
+    *p++ = (type << 4) | 0x40 | 1;
+    *p++ = code;
+    *p++ = msg_id >> 8;
+    *p++ = msg_id & 0xff;
+    *p++ = token;
+
+    if (block2 >= 0) {
+        p = test_option(p, &last, TEST_OPT_BLOCK2, block2);
+    }
+    if (block1 >= 0) {
+        p = test_option(p, &last, TEST_OPT_BLOCK1, block1);
+    }
+    if (size2 > 0) {
+        p = test_option(p, &last, TEST_OPT_SIZE2, size2);
+    }
+    if (payload_len > 0) {
+        *p++ = 0xff;
+        memset(p, 'd', payload_len);
+        p += payload_len;
+    }
+
+    size = p - frame - 8;
+    frame[0] = (TEST_COAP_TCP_HDR >> 24) & 0xff;
+    frame[1] = (TEST_COAP_TCP_HDR >> 16) & 0xff;
+    frame[2] = (TEST_COAP_TCP_HDR >> 8) & 0xff;
+    frame[3] = TEST_COAP_TCP_HDR & 0xff;
+    frame[4] = 0;
+    frame[5] = 0;
+    frame[6] = (size >> 8) & 0xff;
+    frame[7] = size & 0xff;
+    s_rx_len += size + 8;
+
+    return duer_coap_data_available(coap);
+}
+
+static duer_status_t test_request(duer_coap_handler coap, duer_msg_t *msg, int type,
+                                  duer_u8_t *token, duer_u8_t *payload, size_t payload_len)
+{
+    static char path[] = "v1/device/data";
+
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_type = type;
+    msg->msg_code = DUER_MSG_REQ_POST;
+    msg->token = token;
+    msg->token_len = 1;
+    msg->path = (duer_u8_t *)path;
+    msg->path_len = sizeof(path) - 1;
+    msg->payload = payload;
+    msg->payload_len = payload_len;
+
+    return duer_coap_send(coap, msg);
+}
+
+static int coap_setup(void **state)
+{
+    static char host[] = "127.0.0.1";
+    duer_addr_t addr;
+    duer_coap_handler coap = NULL;
+
+    s_allocated = 0;
+    s_watch_size = TEST_HELD_SIZE;
+    s_watched = 0;
+    s_send_ready = 0;
+    s_sent_count = 0;
+    s_result_count = 0;
+    s_rx_len = 0;
+    s_now = 1000000;
+
+    coap = duer_coap_acquire(test_result, NULL, test_transevt, NULL);
+    assert_non_null(coap);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.type = DUER_PROTO_TCP;
+    addr.host = host;
+    addr.host_size = sizeof(host);
+    addr.port = 5683;
+    assert_int_equal(duer_coap_connect(coap, &addr, NULL, 0), DUER_OK);
+
+    *state = coap;
+
+    return 0;
+}
+
+static int coap_teardown(void **state)
+{
+    duer_coap_release(*state);
+    // the held answers and the kept requests are freed with the context
+    assert_int_equal(s_watched, 0);
+    assert_int_equal(s_allocated, 0);
+
+    return 0;
+}
+
+/*
+ * A Block2 response: the block out of order is dropped, and the transfer
+ * goes on from the missing one
+ */
+void duer_coap_block2_missing_test(void **state)
+{
+    duer_coap_handler coap = *state;
+    duer_u8_t token = 'a';
+    duer_msg_t msg;
+
+    assert_int_equal(test_request(coap, &msg, DUER_MSG_TYPE_CONFIRMABLE, &token, NULL, 0),
+                     DUER_OK);
+    assert_int_equal(s_sent_count, 1);
+
+    // the first of 3 blocks, piggybacked
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CONTENT, s_sent[0].msg_id, token,
+                DUER_COAP_BLOCK_VALUE(0, 1, 6), -1, 3072, 1024);
+    assert_int_equal(s_result_count, 1);
+    assert_int_equal(s_results[0].block_offset, 0);
+    assert_int_equal(s_results[0].block_more, 1);
+
+    // the following one is requested by the token kept
+    assert_int_equal(s_sent_count, 2);
+    assert_int_equal(s_sent[1].token[0], token);
+    assert_int_equal(s_sent[1].block2, DUER_COAP_BLOCK_VALUE(1, 0, 6));
+
+    // the block 2 comes before the block 1, it's dropped
+    test_answer(coap, TEST_TYPE_NON, DUER_MSG_RSP_CONTENT, 0x100, token,
+                DUER_COAP_BLOCK_VALUE(2, 0, 6), -1, 0, 1024);
+    assert_int_equal(s_result_count, 1);
+
+    test_answer(coap, TEST_TYPE_NON, DUER_MSG_RSP_CONTENT, 0x101, token,
+                DUER_COAP_BLOCK_VALUE(1, 1, 6), -1, 0, 1024);
+    assert_int_equal(s_result_count, 2);
+    assert_int_equal(s_results[1].block_offset, 1024);
+    assert_int_equal(s_sent[s_sent_count - 1].block2, DUER_COAP_BLOCK_VALUE(2, 0, 6));
+
+    test_answer(coap, TEST_TYPE_NON, DUER_MSG_RSP_CONTENT, 0x102, token,
+                DUER_COAP_BLOCK_VALUE(2, 0, 6), -1, 0, 1024);
+    assert_int_equal(s_result_count, 3);
+    assert_int_equal(s_results[2].block_offset, 2048);
+    assert_int_equal(s_results[2].block_more, 0);
+}
+
+/*
+ * A Block2 response the server stops answering is given up, the late
+ * block isn't passed
+ */
+void duer_coap_block2_timeout_test(void **state)
+{
+    duer_coap_handler coap = *state;
+    duer_u8_t token = 'b';
+    duer_msg_t msg;
+    int sent = 0;
+
+    assert_int_equal(test_request(coap, &msg, DUER_MSG_TYPE_CONFIRMABLE, &token, NULL, 0),
+                     DUER_OK);
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CONTENT, s_sent[0].msg_id, token,
+                DUER_COAP_BLOCK_VALUE(0, 1, 6), -1, 3072, 1024);
+    assert_int_equal(s_result_count, 1);
+
+    s_now += 31 * 1000;
+    duer_coap_exec(coap, s_now / 1000);
+    sent = s_sent_count;
+
+    test_answer(coap, TEST_TYPE_NON, DUER_MSG_RSP_CONTENT, 0x100, token,
+                DUER_COAP_BLOCK_VALUE(1, 1, 6), -1, 0, 1024);
+    assert_int_equal(s_result_count, 1);
+    // nor the following block is requested
+    assert_int_equal(s_sent_count, sent);
+}
+
+/*
+ * A Block1 request: the 2.31 repeated doesn't move the transfer back, nor
+ * send the blocks again
+ */
+void duer_coap_block1_duplicate_test(void **state)
+{
+    duer_coap_handler coap = *state;
+    duer_u8_t token = 'c';
+    duer_u8_t payload[4096];
+    duer_msg_t msg;
+    int sent = 0;
+    int i;
+
+    memset(payload, 'u', sizeof(payload));
+    assert_int_equal(test_request(coap, &msg, DUER_MSG_TYPE_CONFIRMABLE, &token,
+                                  payload, sizeof(payload)),
+                     DUER_ERR_TRANS_WOULD_BLOCK);
+    // one block till the server agrees the size
+    assert_int_equal(s_sent_count, 1);
+    assert_int_equal(s_sent[0].block1, DUER_COAP_BLOCK_VALUE(0, 1, 6));
+    assert_int_equal(s_sent[0].payload_len, 1024);
+
+    test_answer(coap, TEST_TYPE_ACK, TEST_CODE_CONTINUE, s_sent[0].msg_id, token,
+                -1, DUER_COAP_BLOCK_VALUE(0, 1, 6), 0, 0);
+    assert_int_equal(s_result_count, 0);
+    assert_int_equal(s_send_ready, 1);
+
+    // the window opens, the rest go
+    assert_int_equal(duer_coap_send(coap, &msg), DUER_ERR_TRANS_WOULD_BLOCK);
+    assert_int_equal(s_sent_count, 4);
+    for (i = 1; i < 4; i++) {
+        assert_int_equal(s_sent[i].block1, DUER_COAP_BLOCK_VALUE(i, i < 3, 6));
+    }
+
+    // the 2.31 of the block 0 again
+    test_answer(coap, TEST_TYPE_ACK, TEST_CODE_CONTINUE, s_sent[0].msg_id, token,
+                -1, DUER_COAP_BLOCK_VALUE(0, 1, 6), 0, 0);
+    assert_int_equal(s_result_count, 0);
+    sent = s_sent_count;
+    assert_int_equal(duer_coap_send(coap, &msg), DUER_ERR_TRANS_WOULD_BLOCK);
+    assert_int_equal(s_sent_count, sent);
+
+    test_answer(coap, TEST_TYPE_ACK, TEST_CODE_CONTINUE, s_sent[1].msg_id, token,
+                -1, DUER_COAP_BLOCK_VALUE(1, 1, 6), 0, 0);
+    test_answer(coap, TEST_TYPE_ACK, TEST_CODE_CONTINUE, s_sent[2].msg_id, token,
+                -1, DUER_COAP_BLOCK_VALUE(2, 1, 6), 0, 0);
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CHANGED, s_sent[3].msg_id, token,
+                -1, DUER_COAP_BLOCK_VALUE(3, 0, 6), 0, 0);
+    assert_int_equal(s_result_count, 1);
+    assert_int_equal(s_results[0].code, DUER_MSG_RSP_CHANGED);
+
+    assert_int_equal(duer_coap_send(coap, &msg), DUER_OK);
+    assert_int_equal(s_sent_count, sent);
+}
+
+/*
+ * The window of the confirmable requests: the one beyond waits till the
+ * earliest is answered, the answers come in the order sent
+ */
+void duer_coap_nstart_order_test(void **state)
+{
+    duer_coap_handler coap = *state;
+    duer_u8_t tokens[] = {'1', '2', '3'};
+    duer_msg_t msgs[3];
+
+    assert_int_equal(duer_coap_set_nstart(coap, 2), DUER_OK);
+
+    assert_int_equal(test_request(coap, &msgs[0], DUER_MSG_TYPE_CONFIRMABLE, &tokens[0],
+                                  NULL, 0), DUER_OK);
+    assert_int_equal(test_request(coap, &msgs[1], DUER_MSG_TYPE_CONFIRMABLE, &tokens[1],
+                                  NULL, 0), DUER_OK);
+    assert_int_equal(test_request(coap, &msgs[2], DUER_MSG_TYPE_CONFIRMABLE, &tokens[2],
+                                  NULL, 0), DUER_ERR_TRANS_WOULD_BLOCK);
+    assert_int_equal(s_sent_count, 2);
+
+    // the second answered first, it's held
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CHANGED, s_sent[1].msg_id, tokens[1],
+                -1, -1, 0, 4);
+    assert_int_equal(s_result_count, 0);
+    assert_int_equal(s_send_ready, 0);
+
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CHANGED, s_sent[0].msg_id, tokens[0],
+                -1, -1, 0, 0);
+    assert_int_equal(s_result_count, 2);
+    assert_int_equal(s_results[0].token, tokens[0]);
+    assert_int_equal(s_results[1].token, tokens[1]);
+    assert_int_equal(s_results[1].payload_len, 4);
+    assert_int_equal(s_send_ready, 1);
+
+    assert_int_equal(duer_coap_send(coap, &msgs[2]), DUER_OK);
+    assert_int_equal(s_sent_count, 3);
+}
+
+/*
+ * The earliest request not answered in time is given up, the answers held
+ * behind it are passed and freed, and the window opens
+ */
+void duer_coap_inflight_expire_test(void **state)
+{
+    duer_coap_handler coap = *state;
+    duer_u8_t tokens[] = {'1', '2', '3'};
+    duer_msg_t msgs[3];
+
+    assert_int_equal(duer_coap_set_nstart(coap, 2), DUER_OK);
+    test_request(coap, &msgs[0], DUER_MSG_TYPE_CONFIRMABLE, &tokens[0], NULL, 0);
+    test_request(coap, &msgs[1], DUER_MSG_TYPE_CONFIRMABLE, &tokens[1], NULL, 0);
+
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CHANGED, s_sent[1].msg_id, tokens[1],
+                -1, -1, 0, TEST_HELD_PAYLOAD);
+    assert_int_equal(s_result_count, 0);
+    assert_int_equal(s_watched, 1);
+
+    s_now += 31 * 1000;
+    duer_coap_exec(coap, s_now / 1000);
+    assert_int_equal(s_result_count, 1);
+    assert_int_equal(s_results[0].token, tokens[1]);
+    assert_int_equal(s_results[0].payload_len, TEST_HELD_PAYLOAD);
+    assert_int_equal(s_watched, 0);
+    assert_int_equal(s_send_ready, 1);
+
+    assert_int_equal(test_request(coap, &msgs[2], DUER_MSG_TYPE_CONFIRMABLE, &tokens[2],
+                                  NULL, 0), DUER_OK);
+}
+
+/*
+ * The answers held are freed with the context, see coap_teardown
+ */
+void duer_coap_inflight_release_test(void **state)
+{
+    duer_coap_handler coap = *state;
+    duer_u8_t tokens[] = {'1', '2'};
+    duer_msg_t msgs[2];
+
+    test_request(coap, &msgs[0], DUER_MSG_TYPE_CONFIRMABLE, &tokens[0], NULL, 0);
+    test_request(coap, &msgs[1], DUER_MSG_TYPE_CONFIRMABLE, &tokens[1], NULL, 0);
+    test_answer(coap, TEST_TYPE_ACK, DUER_MSG_RSP_CHANGED, s_sent[1].msg_id, tokens[1],
+                -1, -1, 0, TEST_HELD_PAYLOAD);
+    assert_int_equal(s_result_count, 0);
+    assert_int_equal(s_watched, 1);
+}
+
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_coap_block2_missing_test, coap_setup, coap_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_coap_block2_timeout_test, coap_setup, coap_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_coap_block1_duplicate_test, coap_setup, coap_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_coap_nstart_order_test, coap_setup, coap_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_coap_inflight_expire_test, coap_setup, coap_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(duer_coap_inflight_release_test, coap_setup, coap_teardown);
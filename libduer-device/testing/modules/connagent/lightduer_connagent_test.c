@@ -55,6 +55,9 @@ void duer_engine_add_resources(int what, void *object) {
 void duer_engine_send(int what, void *object) {
 }
 
+void duer_engine_release_idle(int what, void *object) {
+}
+
 int duer_engine_enqueue_report_data(const baidu_json *data) {
     check_expected(data);
     return mock_type(int);
@@ -0,0 +1,315 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <string.h>
+
+#undef DUER_MEMORY_DEBUG
+#include "lightduer_ca.h"
+#include "lightduer_engine.h"
+#include "lightduer_memory.h"
+#include "lightduer_mutex.h"
+#include "lightduer_timers.h"
+
+#define HANDLER     ((duer_handler)0x55AA)
+#define MUTEX       ((duer_mutex_t)0x66BB)
+#define TIMER       ((duer_timer_handler)0x77CC)
+
+#define TEST_SENT_MAX   (8)
+
+// the payloads given to baidu_ca_send_data, and the sends posted to the events
+static char *s_sent[TEST_SENT_MAX];
+static int s_sent_count = 0;
+static int s_send_posts = 0;
+// the sends to fail with DUER_ERR_TRANS_WOULD_BLOCK
+static int s_blocks = 0;
+
+DUER_INT void* duer_malloc(duer_size_t size) {
+    return malloc(size);
+}
+
+DUER_INT void* duer_realloc(void* ptr, duer_size_t size) {
+    return realloc(ptr, size);
+}
+
+DUER_INT void duer_free(void* ptr) {
+    free(ptr);
+}
+
+duer_mutex_t duer_mutex_create() {
+    return MUTEX;
+}
+
+duer_status_t duer_mutex_lock(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+duer_status_t duer_mutex_unlock(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+duer_status_t duer_mutex_destroy(duer_mutex_t mutex) {
+    return DUER_OK;
+}
+
+duer_timer_handler duer_timer_acquire(duer_timer_callback callback, void *param, int type) {
+    return TIMER;
+}
+
+int duer_timer_start(duer_timer_handler handle, size_t delay) {
+    return DUER_OK;
+}
+
+int duer_timer_stop(duer_timer_handler handle) {
+    return DUER_OK;
+}
+
+void duer_timer_release(duer_timer_handler handle) {
+}
+
+int duer_data_send(void) {
+    s_send_posts++;
+    return DUER_OK;
+}
+
+int duer_data_idle(void) {
+    return DUER_OK;
+}
+
+int duer_data_report(const baidu_json *data) {
+    return DUER_OK;
+}
+
+int duer_data_available(void) {
+    return DUER_OK;
+}
+
+duer_handler baidu_ca_acquire(duer_transevt_func soc_ctx) {
+    return HANDLER;
+}
+
+duer_bool baidu_ca_is_started(duer_handler hdlr) {
+    return DUER_TRUE;
+}
+
+duer_bool baidu_ca_is_stopped(duer_handler hdlr) {
+    return DUER_FALSE;
+}
+
+duer_status_t baidu_ca_load_configuration(duer_handler hdlr, const void *data,
+                                          duer_size_t size) {
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_start(duer_handler hdlr) {
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_stop(duer_handler hdlr) {
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_release(duer_handler hdlr) {
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_release_idle(duer_handler hdlr) {
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_add_resources(duer_handler hdlr, const duer_res_t list_res[],
+                                     duer_size_t list_res_size) {
+    return DUER_OK;
+}
+
+duer_status_t baidu_ca_data_available(duer_handler hdlr, const duer_addr_t *addr) {
+    return DUER_ERR_TRANS_WOULD_BLOCK;
+}
+
+duer_msg_t *baidu_ca_build_report_message(duer_handler hdlr, duer_bool confirmable) {
+    duer_msg_t *msg = malloc(sizeof(duer_msg_t));
+
+    if (msg) {
+        memset(msg, 0, sizeof(duer_msg_t));
+        msg->msg_code = DUER_MSG_REQ_POST;
+    }
+
+    return msg;
+}
+
+duer_msg_t *baidu_ca_build_response_message(duer_handler hdlr, const duer_msg_t *msg,
+                                            duer_u8_t msg_code) {
+    duer_msg_t *rs = malloc(sizeof(duer_msg_t));
+
+    if (rs) {
+        memset(rs, 0, sizeof(duer_msg_t));
+        rs->msg_code = msg_code;
+    }
+
+    return rs;
+}
+
+void baidu_ca_release_message(duer_handler hdlr, duer_msg_t *msg) {
+    free(msg);
+}
+
+duer_status_t baidu_ca_send_data(duer_handler hdlr, const duer_msg_t *msg,
+                                 const duer_addr_t *addr) {
+    char *payload = NULL;
+
+    if (s_blocks > 0) {
+        s_blocks--;
+        return DUER_ERR_TRANS_WOULD_BLOCK;
+    }
+
+    assert_true(s_sent_count < TEST_SENT_MAX);
+    payload = malloc(msg->payload_len + 1);
+    assert_non_null(payload);
+    memcpy(payload, msg->payload, msg->payload_len);
+    payload[msg->payload_len] = '\0';
+    s_sent[s_sent_count++] = payload;
+
+    return DUER_OK;
+}
+
+static int test_engine_setup(void **state) {
+    s_sent_count = 0;
+    s_send_posts = 0;
+    s_blocks = 0;
+    duer_engine_create(0, NULL);
+    return 0;
+}
+
+static int test_engine_teardown(void **state) {
+    int i;
+
+    duer_engine_destroy(0, NULL);
+    for (i = 0; i < s_sent_count; i++) {
+        free(s_sent[i]);
+    }
+
+    return 0;
+}
+
+static baidu_json *test_report(const char *key, const char *value) {
+    baidu_json *data = baidu_json_CreateObject();
+
+    assert_non_null(data);
+    baidu_json_AddStringToObject(data, key, value);
+
+    return data;
+}
+
+static void test_engine_enqueue(const char *key, const char *value) {
+    baidu_json *data = test_report(key, value);
+
+    assert_int_equal(duer_engine_enqueue_report_data(data), DUER_OK);
+    baidu_json_Delete(data);
+}
+
+/*
+ * The open batch is closed by a report larger than the budget, both are
+ * sent without waiting for the linger
+ */
+static void test_engine_batch_large(void **state) {
+    char large[128];
+
+    memset(large, 'x', sizeof(large) - 1);
+    large[sizeof(large) - 1] = '\0';
+
+    assert_int_equal(duer_engine_set_report_batch(100, 64), DUER_OK);
+
+    test_engine_enqueue("a", "1");
+    test_engine_enqueue("b", "2");
+    // still open
+    assert_int_equal(duer_engine_qcache_length(), 0);
+
+    test_engine_enqueue("c", large);
+    assert_int_equal(duer_engine_qcache_length(), 2);
+    assert_int_equal(s_send_posts, 1);
+
+    duer_engine_send(0, NULL);
+    assert_int_equal(s_sent_count, 2);
+    assert_string_equal(s_sent[0], "{\"data\":[{\"a\":\"1\"},{\"b\":\"2\"}]}");
+    assert_int_equal(strncmp(s_sent[1], "{\"data\":{\"c\":\"xxx", 17), 0);
+    assert_int_equal(duer_engine_qcache_length(), 0);
+}
+
+/*
+ * The batch closed by a small report which opens the next one
+ */
+static void test_engine_batch_next(void **state) {
+    char value[40];
+
+    memset(value, 'y', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    assert_int_equal(duer_engine_set_report_batch(100, 64), DUER_OK);
+
+    test_engine_enqueue("a", value);
+    test_engine_enqueue("b", value);
+    // the first batch is ready, the second one open
+    assert_int_equal(duer_engine_qcache_length(), 1);
+    assert_int_equal(s_send_posts, 1);
+
+    duer_engine_send(0, NULL);
+    assert_int_equal(s_sent_count, 1);
+    assert_int_equal(strncmp(s_sent[0], "{\"data\":{\"a\":\"yyy", 17), 0);
+
+    assert_int_equal(duer_engine_set_report_batch(0, 0), DUER_OK);
+    duer_engine_send(0, NULL);
+    assert_int_equal(s_sent_count, 2);
+    assert_int_equal(strncmp(s_sent[1], "{\"data\":{\"b\":\"yyy", 17), 0);
+}
+
+/*
+ * The responses are sent ahead of the reports queued before them,
+ * but not ahead of the report blocked
+ */
+static void test_engine_response_first(void **state) {
+    duer_msg_t req;
+
+    memset(&req, 0, sizeof(req));
+    req.msg_code = DUER_MSG_REQ_PUT;
+
+    test_engine_enqueue("a", "1");
+    test_engine_enqueue("b", "2");
+    assert_int_equal(duer_engine_enqueue_response(&req, DUER_MSG_RSP_CHANGED, "r1", 2), DUER_OK);
+
+    duer_engine_send(0, NULL);
+    assert_int_equal(s_sent_count, 3);
+    assert_string_equal(s_sent[0], "r1");
+    assert_string_equal(s_sent[1], "{\"data\":{\"a\":\"1\"}}");
+    assert_string_equal(s_sent[2], "{\"data\":{\"b\":\"2\"}}");
+
+    test_engine_enqueue("c", "3");
+    s_blocks = 1;
+    duer_engine_send(0, NULL);
+    assert_int_equal(s_sent_count, 3);
+
+    // the transport keeps the rest of "c", it's sent again first
+    assert_int_equal(duer_engine_enqueue_response(&req, DUER_MSG_RSP_CHANGED, "r2", 2), DUER_OK);
+    duer_engine_send(0, NULL);
+    assert_int_equal(s_sent_count, 5);
+    assert_string_equal(s_sent[3], "{\"data\":{\"c\":\"3\"}}");
+    assert_string_equal(s_sent[4], "r2");
+    assert_int_equal(duer_engine_qcache_length(), 0);
+}
+
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(test_engine_batch_large, test_engine_setup, test_engine_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(test_engine_batch_next, test_engine_setup, test_engine_teardown);
+CMOCKA_UNIT_TEST_SETUP_TEARDOWN(test_engine_response_first, test_engine_setup, test_engine_teardown);
@@ -42,16 +42,19 @@ void duer_dcs_report_play_event_normal_test()
     baidu_json *event = 0x02;
     int rs = DUER_OK;
 
-    will_return(baidu_json_CreateObject, data);
+    expect_value(baidu_json_CreateObjectWithAllocator, allocator, NULL);
+    will_return(baidu_json_CreateObjectWithAllocator, data);
 
-    expect_string(duer_create_dcs_event, namespace, "ai.dueros.device_interface.audio_player");
-    expect_string(duer_create_dcs_event, name, "PlaybackQueueCleared");
-    expect_value(duer_create_dcs_event, msg_id, NULL);
-    will_return(duer_create_dcs_event, event);
+    expect_string(duer_create_dcs_event_with_allocator, namespace,
+                  "ai.dueros.device_interface.audio_player");
+    expect_string(duer_create_dcs_event_with_allocator, name, "PlaybackQueueCleared");
+    expect_value(duer_create_dcs_event_with_allocator, msg_id, NULL);
+    expect_value(duer_create_dcs_event_with_allocator, allocator, NULL);
+    will_return(duer_create_dcs_event_with_allocator, event);
 
-    expect_value(baidu_json_AddItemToObject, object, data);
-    expect_string(baidu_json_AddItemToObject, string, "event");
-    expect_value(baidu_json_AddItemToObject, item, event);
+    expect_value(baidu_json_AddItemToObjectCS, object, data);
+    expect_string(baidu_json_AddItemToObjectCS, string, "event");
+    expect_value(baidu_json_AddItemToObjectCS, item, event);
 
     expect_value(duer_data_report, data, data);
     will_return(duer_data_report, DUER_OK);
@@ -83,7 +86,8 @@ void duer_dcs_report_play_event_abnormal_test3()
     baidu_json *data = NULL;
     int rs = DUER_OK;
 
-    will_return(baidu_json_CreateObject, data);
+    expect_value(baidu_json_CreateObjectWithAllocator, allocator, NULL);
+    will_return(baidu_json_CreateObjectWithAllocator, data);
     rs = duer_dcs_report_play_event(DCS_PLAY_QUEUE_CLEARED);
     assert_int_equal(rs, DUER_ERR_FAILED);
 }
@@ -94,12 +98,15 @@ void duer_dcs_report_play_event_abnormal_test4()
     baidu_json *event = NULL;
     int rs = DUER_OK;
 
-    will_return(baidu_json_CreateObject, data);
+    expect_value(baidu_json_CreateObjectWithAllocator, allocator, NULL);
+    will_return(baidu_json_CreateObjectWithAllocator, data);
 
-    expect_string(duer_create_dcs_event, namespace, "ai.dueros.device_interface.audio_player");
-    expect_string(duer_create_dcs_event, name, "PlaybackQueueCleared");
-    expect_value(duer_create_dcs_event, msg_id, NULL);
-    will_return(duer_create_dcs_event, event);
+    expect_string(duer_create_dcs_event_with_allocator, namespace,
+                  "ai.dueros.device_interface.audio_player");
+    expect_string(duer_create_dcs_event_with_allocator, name, "PlaybackQueueCleared");
+    expect_value(duer_create_dcs_event_with_allocator, msg_id, NULL);
+    expect_value(duer_create_dcs_event_with_allocator, allocator, NULL);
+    will_return(duer_create_dcs_event_with_allocator, event);
 
     expect_value(baidu_json_Delete, c, data);
 
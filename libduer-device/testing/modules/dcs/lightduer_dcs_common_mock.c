@@ -61,6 +61,26 @@ baidu_json *duer_create_dcs_event(const char *namespace, const char *name, const
     return (baidu_json *)mock();
 }
 
+baidu_json *duer_create_dcs_event_with_allocator(const char *namespace,
+                                                const char *name,
+                                                const char *msg_id,
+                                                const baidu_json_Allocator *allocator)
+{
+    check_expected(namespace);
+    check_expected(name);
+    check_expected(msg_id);
+    check_expected(allocator);
+
+    return (baidu_json *)mock();
+}
+
+const baidu_json_Allocator *duer_dcs_directive_allocator(const baidu_json *directive,
+                                                         baidu_json_Allocator *allocator)
+{
+    check_expected(directive);
+    return (const baidu_json_Allocator *)mock();
+}
+
 int duer_data_report(const baidu_json *data)
 {
     check_expected(data);
@@ -0,0 +1,191 @@
+/**
+ * Copyright (2017) Baidu Inc. All rights reserveed.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#undef DUER_MEMORY_DEBUG
+#include <stdlib.h>
+#include <string.h>
+#include "lightduer_dcs_router.h"
+#include "lightduer_dcs_local.h"
+#include "lightduer_connagent.h"
+#include "lightduer_memory.h"
+#include "lightduer_mutex.h"
+
+static int s_mutex;
+static int s_exception_count;
+static const baidu_json *s_routed;
+static void *s_handler_memory;
+static void *s_foreign_memory;
+static void *s_nested_memory;
+static baidu_json *s_string;
+
+DUER_INT void *duer_malloc(duer_size_t size)
+{
+    return malloc(size);
+}
+
+DUER_INT void *duer_realloc(void *ptr, duer_size_t size)
+{
+    return realloc(ptr, size);
+}
+
+DUER_INT void duer_free(void *ptr)
+{
+    free(ptr);
+}
+
+duer_mutex_t duer_mutex_create()
+{
+    return &s_mutex;
+}
+
+duer_status_t duer_mutex_lock(duer_mutex_t mutex)
+{
+    return DUER_OK;
+}
+
+duer_status_t duer_mutex_unlock(duer_mutex_t mutex)
+{
+    return DUER_OK;
+}
+
+int duer_add_resources(const duer_res_t *res, size_t length)
+{
+    return DUER_OK;
+}
+
+char *duer_strdup_internal(const char *str)
+{
+    char *dup = malloc(strlen(str) + 1);
+
+    strcpy(dup, str);
+
+    return dup;
+}
+
+void duer_report_exception_internal(const char *directive, const char *type, const char *msg)
+{
+    s_exception_count++;
+}
+
+void duer_declare_sys_interface_internal(void)
+{
+}
+
+static duer_status_t route_payload(const char *payload)
+{
+    duer_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.payload = (duer_u8_t *)payload;
+    msg.payload_len = strlen(payload);
+
+    return duer_dcs_router(NULL, &msg, NULL);
+}
+
+static duer_status_t nested_cb(const baidu_json *directive)
+{
+    // the arena is busy: the directive routed meanwhile lives on the heap
+    s_nested_memory = duer_dcs_directive_alloc(directive, 16);
+
+    return DUER_OK;
+}
+
+static duer_status_t speak_cb(const baidu_json *directive)
+{
+    baidu_json_Allocator allocator;
+    const baidu_json_Allocator *arena = NULL;
+    baidu_json *foreign = baidu_json_CreateObject();
+
+    s_routed = directive;
+    s_handler_memory = duer_dcs_directive_alloc(directive, 16);
+    s_foreign_memory = duer_dcs_directive_alloc(foreign, 16);
+    baidu_json_Delete(foreign);
+
+    arena = duer_dcs_directive_allocator(directive, &allocator);
+    assert_non_null(arena);
+    s_string = baidu_json_CreateStringWithAllocator("in the arena", arena);
+
+    assert_int_equal(route_payload("{\"directive\":{\"header\":{\"name\":\"Nested\"}}}"),
+                     DUER_OK);
+
+    return DUER_OK;
+}
+
+static int setup(void **state)
+{
+    static int initialized = 0;
+    duer_directive_list list[] = {
+        {"Speak", speak_cb},
+        {"Nested", nested_cb},
+    };
+
+    if (!initialized) {
+        duer_dcs_framework_init();
+        duer_add_dcs_directive(list, sizeof(list) / sizeof(list[0]));
+        initialized = 1;
+    }
+
+    s_routed = NULL;
+    s_handler_memory = NULL;
+    s_foreign_memory = NULL;
+    s_nested_memory = NULL;
+    s_string = NULL;
+    s_exception_count = 0;
+
+    return 0;
+}
+
+void duer_dcs_directive_alloc_owner_test(void **state)
+{
+    baidu_json_Allocator allocator;
+
+    assert_int_equal(route_payload("{\"directive\":{\"header\":{\"name\":\"Speak\"}}}"),
+                     DUER_OK);
+    assert_int_equal(s_exception_count, 0);
+
+    // only the directive routed gets the arena, and only while its handler runs
+    assert_non_null(s_routed);
+    assert_non_null(s_handler_memory);
+    assert_null(s_foreign_memory);
+    assert_non_null(s_string);
+    assert_string_equal(s_string->valuestring, "in the arena");
+
+    assert_null(s_nested_memory);
+
+    assert_null(duer_dcs_directive_alloc(s_routed, 16));
+    assert_null(duer_dcs_directive_allocator(s_routed, &allocator));
+}
+
+void duer_dcs_directive_alloc_param_test(void **state)
+{
+    baidu_json_Allocator allocator;
+
+    assert_null(duer_dcs_directive_alloc(NULL, 16));
+    assert_null(duer_dcs_directive_allocator(NULL, &allocator));
+}
+
+void duer_dcs_router_unknown_test(void **state)
+{
+    assert_int_equal(route_payload("{\"directive\":{\"header\":{\"name\":\"Unknown\"}}}"),
+                     DUER_MSG_RSP_NOT_FOUND);
+    assert_int_equal(s_exception_count, 1);
+}
+
+CMOCKA_UNIT_TEST_SETUP(duer_dcs_directive_alloc_param_test, setup);
+CMOCKA_UNIT_TEST_SETUP(duer_dcs_directive_alloc_owner_test, setup);
+CMOCKA_UNIT_TEST_SETUP(duer_dcs_router_unknown_test, setup);